@@ -0,0 +1,167 @@
+#pragma once
+#ifndef ASSET_ARCHIVE_H
+#define ASSET_ARCHIVE_H
+
+#include <mapped_file.h>
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <iostream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Many asset files packed into one, so loading hundreds of textures costs a single open and
+// mmap instead of an open, a stat and a run of reads per file. Entries are looked up by the
+// path they were packed from and point straight into the mapping, ready for
+// stbi_load_from_memory. The archive is mapped with MADV_SEQUENTIAL since a load pass reads
+// the entries in roughly the order they were packed.
+//
+// file layout: magic "GLPK", format version, entry count, then per entry a 64 bit offset,
+// 64 bit size and 32 bit name length, then the names, then the file data with every file
+// starting on an ALIGNMENT byte boundary
+//
+//     AssetArchive::pack("assets.pak", { "img/wood.png", "img/leaves.png" });
+//     AssetArchive assets;
+//     assets.open("assets.pak");
+//     const AssetArchive::Entry* wood = assets.find("img/wood.png");
+class AssetArchive
+{
+public:
+    static const size_t ALIGNMENT = 64;
+
+    struct Entry
+    {
+        const unsigned char* data;
+        size_t size;
+    };
+
+    // write the named files into one archive, false if any is unreadable or the write fails
+    // ------------------------------------------------------------------------
+    static bool pack(const std::string& archivePath, const std::vector<std::string>& paths)
+    {
+        std::vector<MappedFile> files(paths.size());
+        for (size_t i = 0; i < paths.size(); i++)
+        {
+            if (!files[i].open(paths[i], MADV_SEQUENTIAL))
+            {
+                std::cout << "Asset failed to load at path: " << paths[i] << std::endl;
+                return false;
+            }
+        }
+        Header header = { MAGIC, VERSION, (uint32_t)paths.size(), 0 };
+        uint64_t offset = sizeof(header) + paths.size() * sizeof(IndexEntry);
+        for (const std::string& path : paths)
+            offset += path.size();
+        std::vector<IndexEntry> index;
+        for (size_t i = 0; i < paths.size(); i++)
+        {
+            offset = (offset + ALIGNMENT - 1) / ALIGNMENT * ALIGNMENT;
+            index.push_back({ offset, (uint64_t)files[i].size(), (uint32_t)paths[i].size(), 0 });
+            offset += files[i].size();
+        }
+
+        // write to a temporary name first so a crash never leaves a truncated archive
+        std::string temporary = archivePath + ".tmp";
+        FILE* f = fopen(temporary.c_str(), "wb");
+        if (!f)
+            return false;
+        bool ok = fwrite(&header, sizeof(header), 1, f) == 1 && fwrite(index.data(), sizeof(IndexEntry), index.size(), f) == index.size();
+        for (size_t i = 0; ok && i < paths.size(); i++)
+            ok = fwrite(paths[i].data(), 1, paths[i].size(), f) == paths[i].size();
+        static const unsigned char zeros[ALIGNMENT] = {};
+        for (size_t i = 0; ok && i < paths.size(); i++)
+        {
+            long position = ftell(f);
+            ok = position >= 0 && fwrite(zeros, 1, (size_t)(index[i].offset - position), f) == index[i].offset - position &&
+                fwrite(files[i].data(), 1, files[i].size(), f) == files[i].size();
+        }
+        ok = fclose(f) == 0 && ok;
+        std::error_code error;
+        if (ok)
+            std::filesystem::rename(temporary, archivePath, error);
+        else
+            std::filesystem::remove(temporary, error);
+        return ok && !error;
+    }
+    // map an archive and read its index, false if missing or damaged
+    // ------------------------------------------------------------------------
+    bool open(const std::string& archivePath)
+    {
+        entries.clear();
+        if (!file.open(archivePath, MADV_SEQUENTIAL))
+            return false;
+        const unsigned char* data = file.data();
+        size_t size = file.size();
+        Header header;
+        bool ok = size >= sizeof(header);
+        if (ok)
+        {
+            memcpy(&header, data, sizeof(header));
+            ok = header.magic == MAGIC && header.version == VERSION &&
+                header.count <= (size - sizeof(header)) / sizeof(IndexEntry);
+        }
+        size_t nameOffset = sizeof(header) + (ok ? header.count * sizeof(IndexEntry) : 0);
+        for (uint32_t i = 0; ok && i < header.count; i++)
+        {
+            IndexEntry entry;
+            memcpy(&entry, data + sizeof(header) + i * sizeof(IndexEntry), sizeof(entry));
+            ok = entry.nameLength <= size - nameOffset && entry.offset <= size && entry.size <= size - entry.offset;
+            if (ok)
+                entries[std::string((const char*)data + nameOffset, entry.nameLength)] = { data + entry.offset, (size_t)entry.size };
+            nameOffset += ok ? entry.nameLength : 0;
+        }
+        if (!ok)
+        {
+            std::cout << "Asset archive is damaged: " << archivePath << std::endl;
+            close();
+            return false;
+        }
+        path = archivePath;
+        return true;
+    }
+    void close()
+    {
+        entries.clear();
+        file.close();
+        path.clear();
+    }
+    // nullptr if the archive holds no file packed from this path
+    const Entry* find(const std::string& name) const
+    {
+        auto found = entries.find(name);
+        return found == entries.end() ? nullptr : &found->second;
+    }
+    const std::string& archivePath() const
+    {
+        return path;
+    }
+    size_t entryCount() const
+    {
+        return entries.size();
+    }
+    size_t size() const
+    {
+        return file.size();
+    }
+
+private:
+    static const uint32_t MAGIC = 0x4B504C47;
+    static const uint32_t VERSION = 1;
+
+    struct Header
+    {
+        uint32_t magic, version, count, reserved;
+    };
+    struct IndexEntry
+    {
+        uint64_t offset, size;
+        uint32_t nameLength, reserved;
+    };
+    MappedFile file;
+    std::string path;
+    std::unordered_map<std::string, Entry> entries;
+};
+#endif
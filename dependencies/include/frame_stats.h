@@ -0,0 +1,116 @@
+#pragma once
+#ifndef FRAME_STATS_H
+#define FRAME_STATS_H
+
+#include <glad/glad.h>
+
+#include <algorithm>
+#include <chrono>
+#include <vector>
+#include <iostream>
+
+// Collects CPU frame times, GPU frame times and draw call counts for the benchmark report.
+// GPU time comes from GL_TIME_ELAPSED queries kept on a small ring, so a result is only read
+// back a few frames after it was issued and the CPU never waits on the GPU mid-run.
+class FrameStats
+{
+public:
+    static const int QUERY_RING = 4;
+
+    FrameStats()
+    {
+        glGenQueries(QUERY_RING, queries);
+    }
+    ~FrameStats()
+    {
+        release();
+    }
+    FrameStats(const FrameStats&) = delete;
+    FrameStats& operator=(const FrameStats&) = delete;
+    // delete the queries while the context is still current, the destructor then has nothing left to do
+    // ------------------------------------------------------------------------
+    void release()
+    {
+        if (!released)
+            glDeleteQueries(QUERY_RING, queries);
+        released = true;
+    }
+    // call before any rendering commands of the frame
+    // ------------------------------------------------------------------------
+    void beginFrame()
+    {
+        int slot = (int)(frame % QUERY_RING);
+        // the slot was issued QUERY_RING frames ago, collect it before reusing
+        if (frame >= QUERY_RING)
+            collect(slot);
+        glBeginQuery(GL_TIME_ELAPSED, queries[slot]);
+        frameStart = std::chrono::steady_clock::now();
+        drawCalls = 0;
+        vertexBytes = 0;
+    }
+    // call after the last draw of the frame (before swapping buffers)
+    // ------------------------------------------------------------------------
+    void endFrame()
+    {
+        glEndQuery(GL_TIME_ELAPSED);
+        cpuTimes.push_back(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - frameStart).count());
+        drawCallCounts.push_back(drawCalls);
+        vertexByteCounts.push_back((double)vertexBytes);
+        frame++;
+    }
+    // count draw calls issued this frame and the vertex buffer bytes they fetch
+    // ------------------------------------------------------------------------
+    void addDraws(unsigned int count = 1, size_t bytes = 0)
+    {
+        drawCalls += count;
+        vertexBytes += bytes;
+    }
+    unsigned long long frames() const
+    {
+        return frame;
+    }
+    // read back outstanding queries and print min/median/p99 for each series
+    // ------------------------------------------------------------------------
+    void report(std::ostream& out)
+    {
+        unsigned long long first = frame > QUERY_RING ? frame - QUERY_RING : 0;
+        for (unsigned long long f = first; f < frame; f++)
+            collect((int)(f % QUERY_RING));
+        out << "frames: " << frame << std::endl;
+        printSeries(out, "cpu frame ms", cpuTimes);
+        printSeries(out, "gpu frame ms", gpuTimes);
+        std::vector<double> draws(drawCallCounts.begin(), drawCallCounts.end());
+        printSeries(out, "draw calls", draws);
+        printSeries(out, "vertex bytes", vertexByteCounts);
+    }
+
+private:
+    GLuint queries[QUERY_RING];
+    bool released = false;
+    unsigned long long frame = 0;
+    unsigned int drawCalls = 0;
+    size_t vertexBytes = 0;
+    std::chrono::steady_clock::time_point frameStart;
+    std::vector<double> cpuTimes;
+    std::vector<double> gpuTimes;
+    std::vector<unsigned int> drawCallCounts;
+    std::vector<double> vertexByteCounts;
+
+    void collect(int slot)
+    {
+        GLuint64 elapsed = 0;
+        glGetQueryObjectui64v(queries[slot], GL_QUERY_RESULT, &elapsed);
+        gpuTimes.push_back((double)elapsed / 1.0e6);
+    }
+    // ------------------------------------------------------------------------
+    static void printSeries(std::ostream& out, const char* label, std::vector<double> values)
+    {
+        if (values.empty())
+            return;
+        std::sort(values.begin(), values.end());
+        size_t p99 = std::min(values.size() - 1, (size_t)(values.size() * 0.99));
+        out << label << ": min " << values.front() << " median " << values[values.size() / 2]
+            << " p99 " << values[p99] << std::endl;
+    }
+};
+#endif
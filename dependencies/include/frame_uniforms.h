@@ -0,0 +1,97 @@
+#pragma once
+#ifndef FRAME_UNIFORMS_H
+#define FRAME_UNIFORMS_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <cstring>
+
+// CPU side of the std140 FrameData block declared in every shader:
+//
+//     layout (std140) uniform FrameData
+//     {
+//         mat4 view;
+//         mat4 projection;
+//         mat4 viewProjection;
+//         vec4 viewPos;
+//         vec4 lightPos;
+//         vec4 lightColor;
+//     };
+//
+// vec3 values are stored as vec4 so the C++ struct needs no std140 padding rules.
+struct FrameData
+{
+    glm::mat4 view;
+    glm::mat4 projection;
+    glm::mat4 viewProjection;
+    glm::vec4 viewPos;
+    glm::vec4 lightPos;
+    glm::vec4 lightColor;
+};
+
+// One uniform buffer holding RING copies of FrameData. Each update() writes the next slot with an
+// unsynchronized map and binds that range to BINDING, so the driver never waits for a draw that
+// still reads an older slot. When the ring wraps the whole buffer is orphaned (invalidated)
+// instead, which hands the driver fresh storage once every RING frames.
+class FrameUniforms
+{
+public:
+    static const GLuint BINDING = 0;
+    static const int RING = 64;
+
+    // must be called with a current GL context
+    // ------------------------------------------------------------------------
+    void create()
+    {
+        GLint alignment = 256;
+        glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
+        stride = (sizeof(FrameData) + alignment - 1) / alignment * alignment;
+        glGenBuffers(1, &buffer);
+        glBindBuffer(GL_UNIFORM_BUFFER, buffer);
+        glBufferData(GL_UNIFORM_BUFFER, stride * RING, NULL, GL_STREAM_DRAW);
+        glBindBuffer(GL_UNIFORM_BUFFER, 0);
+    }
+    // point a program's FrameData block at BINDING, programs without the block are skipped
+    // ------------------------------------------------------------------------
+    static void attach(GLuint program)
+    {
+        GLuint index = glGetUniformBlockIndex(program, "FrameData");
+        if (index != GL_INVALID_INDEX)
+            glUniformBlockBinding(program, index, BINDING);
+    }
+    // write this frame's data into the next slot of the ring and bind it
+    // ------------------------------------------------------------------------
+    void update(const FrameData& data)
+    {
+        GLintptr offset = (GLintptr)(slot * stride);
+        GLbitfield access = GL_MAP_WRITE_BIT | (slot == 0 ? GL_MAP_INVALIDATE_BUFFER_BIT
+            : GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT);
+        glBindBuffer(GL_UNIFORM_BUFFER, buffer);
+        void* target = glMapBufferRange(GL_UNIFORM_BUFFER, offset, sizeof(FrameData), access);
+        if (target)
+        {
+            memcpy(target, &data, sizeof(FrameData));
+            glUnmapBuffer(GL_UNIFORM_BUFFER);
+        }
+        glBindBufferRange(GL_UNIFORM_BUFFER, BINDING, buffer, offset, sizeof(FrameData));
+        slot = (slot + 1) % RING;
+        bytesUploaded += sizeof(FrameData);
+    }
+    void release()
+    {
+        glDeleteBuffers(1, &buffer);
+        buffer = 0;
+    }
+    unsigned long long uploadedBytes() const
+    {
+        return bytesUploaded;
+    }
+
+private:
+    GLuint buffer = 0;
+    size_t stride = 0;
+    int slot = 0;
+    unsigned long long bytesUploaded = 0;
+};
+#endif
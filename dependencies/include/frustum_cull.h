@@ -0,0 +1,225 @@
+#pragma once
+#ifndef FRUSTUM_CULL_H
+#define FRUSTUM_CULL_H
+
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <vector>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define FRUSTUM_CULL_SSE
+#include <emmintrin.h>
+#endif
+// the AVX path is compiled with a per-function target attribute and only chosen at run time
+// on CPUs that report AVX, so the build itself still only needs SSE2
+#if defined(FRUSTUM_CULL_SSE) && (defined(__GNUC__) || defined(__clang__))
+#define FRUSTUM_CULL_AVX
+#define FRUSTUM_CULL_AVX_TARGET __attribute__((target("avx")))
+#include <immintrin.h>
+inline bool frustumCullAvxAvailable()
+{
+    return __builtin_cpu_supports("avx");
+}
+#elif defined(_MSC_VER) && defined(__AVX__)
+// VC++ has no per-function targets; building with /arch:AVX already requires the CPU to have it
+#define FRUSTUM_CULL_AVX
+#define FRUSTUM_CULL_AVX_TARGET
+#include <immintrin.h>
+inline bool frustumCullAvxAvailable()
+{
+    return true;
+}
+#endif
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+// six planes (a, b, c, d) with ax + by + cz + d >= 0 inside, normals pointing inwards
+struct Frustum
+{
+    glm::vec4 planes[6];
+
+    // Gribb/Hartmann extraction from a projection * view matrix
+    // ------------------------------------------------------------------------
+    static Frustum fromMatrix(const glm::mat4& m)
+    {
+        glm::vec4 row[4];
+        for (int i = 0; i < 4; i++)
+            row[i] = glm::vec4(m[0][i], m[1][i], m[2][i], m[3][i]);
+        Frustum f;
+        f.planes[0] = row[3] + row[0]; // left
+        f.planes[1] = row[3] - row[0]; // right
+        f.planes[2] = row[3] + row[1]; // bottom
+        f.planes[3] = row[3] - row[1]; // top
+        f.planes[4] = row[3] + row[2]; // near
+        f.planes[5] = row[3] - row[2]; // far
+        for (glm::vec4& plane : f.planes)
+            plane /= glm::length(glm::vec3(plane));
+        return f;
+    }
+};
+
+// axis aligned boxes as structure of arrays so each component loads 4 or 8 boxes at once
+struct AabbList
+{
+    std::vector<float> minX, minY, minZ, maxX, maxY, maxZ;
+
+    void add(const glm::vec3& min, const glm::vec3& max)
+    {
+        minX.push_back(min.x);
+        minY.push_back(min.y);
+        minZ.push_back(min.z);
+        maxX.push_back(max.x);
+        maxY.push_back(max.y);
+        maxZ.push_back(max.z);
+    }
+    void clear()
+    {
+        minX.clear(); minY.clear(); minZ.clear();
+        maxX.clear(); maxY.clear(); maxZ.clear();
+    }
+    size_t size() const { return minX.size(); }
+};
+
+inline int lowestSetBit(unsigned int mask)
+{
+#ifdef _MSC_VER
+    unsigned long index;
+    _BitScanForward(&index, mask);
+    return (int)index;
+#else
+    return __builtin_ctz(mask);
+#endif
+}
+
+// A box is outside when its corner furthest along a plane normal (the "positive vertex") is
+// behind that plane. Since every lane tests the same plane, picking min or max per axis is a
+// choice of array, not a per-lane select. Each function writes the indices of boxes that
+// survive into visible (sized for boxes.size()) and returns how many there are.
+// ------------------------------------------------------------------------
+inline size_t cullAabbsScalar(const Frustum& frustum, const AabbList& boxes, size_t first, uint32_t* visible)
+{
+    size_t count = 0;
+    for (size_t i = first; i < boxes.size(); i++)
+    {
+        bool inside = true;
+        for (int p = 0; p < 6 && inside; p++)
+        {
+            const glm::vec4& plane = frustum.planes[p];
+            float x = plane.x > 0.0f ? boxes.maxX[i] : boxes.minX[i];
+            float y = plane.y > 0.0f ? boxes.maxY[i] : boxes.minY[i];
+            float z = plane.z > 0.0f ? boxes.maxZ[i] : boxes.minZ[i];
+            inside = plane.x * x + plane.y * y + plane.z * z + plane.w >= 0.0f;
+        }
+        if (inside)
+            visible[count++] = (uint32_t)i;
+    }
+    return count;
+}
+
+inline size_t cullAabbsScalar(const Frustum& frustum, const AabbList& boxes, uint32_t* visible)
+{
+    return cullAabbsScalar(frustum, boxes, 0, visible);
+}
+
+#ifdef FRUSTUM_CULL_SSE
+// four boxes per instruction
+// ------------------------------------------------------------------------
+inline size_t cullAabbsSSE(const Frustum& frustum, const AabbList& boxes, uint32_t* visible)
+{
+    const float* xs[6][3];
+    __m128 a[6], b[6], c[6], d[6];
+    for (int p = 0; p < 6; p++)
+    {
+        const glm::vec4& plane = frustum.planes[p];
+        xs[p][0] = plane.x > 0.0f ? boxes.maxX.data() : boxes.minX.data();
+        xs[p][1] = plane.y > 0.0f ? boxes.maxY.data() : boxes.minY.data();
+        xs[p][2] = plane.z > 0.0f ? boxes.maxZ.data() : boxes.minZ.data();
+        a[p] = _mm_set1_ps(plane.x);
+        b[p] = _mm_set1_ps(plane.y);
+        c[p] = _mm_set1_ps(plane.z);
+        d[p] = _mm_set1_ps(plane.w);
+    }
+    size_t count = 0, n = boxes.size() & ~(size_t)3;
+    const __m128 zero = _mm_setzero_ps();
+    for (size_t i = 0; i < n; i += 4)
+    {
+        __m128 outside = _mm_setzero_ps();
+        for (int p = 0; p < 6; p++)
+        {
+            __m128 dist = _mm_add_ps(_mm_mul_ps(a[p], _mm_loadu_ps(xs[p][0] + i)), d[p]);
+            dist = _mm_add_ps(dist, _mm_mul_ps(b[p], _mm_loadu_ps(xs[p][1] + i)));
+            dist = _mm_add_ps(dist, _mm_mul_ps(c[p], _mm_loadu_ps(xs[p][2] + i)));
+            outside = _mm_or_ps(outside, _mm_cmplt_ps(dist, zero));
+        }
+        int mask = ~_mm_movemask_ps(outside) & 0xF;
+        while (mask)
+        {
+            int bit = lowestSetBit((unsigned int)mask);
+            visible[count++] = (uint32_t)(i + bit);
+            mask &= mask - 1;
+        }
+    }
+    return count + cullAabbsScalar(frustum, boxes, n, visible + count);
+}
+#endif
+
+#ifdef FRUSTUM_CULL_AVX
+// eight boxes per instruction, only call when frustumCullAvxAvailable()
+// ------------------------------------------------------------------------
+FRUSTUM_CULL_AVX_TARGET inline size_t cullAabbsAVX(const Frustum& frustum, const AabbList& boxes, uint32_t* visible)
+{
+    const float* xs[6][3];
+    __m256 a[6], b[6], c[6], d[6];
+    for (int p = 0; p < 6; p++)
+    {
+        const glm::vec4& plane = frustum.planes[p];
+        xs[p][0] = plane.x > 0.0f ? boxes.maxX.data() : boxes.minX.data();
+        xs[p][1] = plane.y > 0.0f ? boxes.maxY.data() : boxes.minY.data();
+        xs[p][2] = plane.z > 0.0f ? boxes.maxZ.data() : boxes.minZ.data();
+        a[p] = _mm256_set1_ps(plane.x);
+        b[p] = _mm256_set1_ps(plane.y);
+        c[p] = _mm256_set1_ps(plane.z);
+        d[p] = _mm256_set1_ps(plane.w);
+    }
+    size_t count = 0, n = boxes.size() & ~(size_t)7;
+    const __m256 zero = _mm256_setzero_ps();
+    for (size_t i = 0; i < n; i += 8)
+    {
+        __m256 outside = _mm256_setzero_ps();
+        for (int p = 0; p < 6; p++)
+        {
+            __m256 dist = _mm256_add_ps(_mm256_mul_ps(a[p], _mm256_loadu_ps(xs[p][0] + i)), d[p]);
+            dist = _mm256_add_ps(dist, _mm256_mul_ps(b[p], _mm256_loadu_ps(xs[p][1] + i)));
+            dist = _mm256_add_ps(dist, _mm256_mul_ps(c[p], _mm256_loadu_ps(xs[p][2] + i)));
+            outside = _mm256_or_ps(outside, _mm256_cmp_ps(dist, zero, _CMP_LT_OQ));
+        }
+        int mask = ~_mm256_movemask_ps(outside) & 0xFF;
+        while (mask)
+        {
+            int bit = lowestSetBit((unsigned int)mask);
+            visible[count++] = (uint32_t)(i + bit);
+            mask &= mask - 1;
+        }
+    }
+    return count + cullAabbsScalar(frustum, boxes, n, visible + count);
+}
+#endif
+
+// widest path this CPU runs
+// ------------------------------------------------------------------------
+inline size_t cullAabbs(const Frustum& frustum, const AabbList& boxes, uint32_t* visible)
+{
+#if defined(FRUSTUM_CULL_AVX)
+    static const bool avx = frustumCullAvxAvailable();
+    if (avx)
+        return cullAabbsAVX(frustum, boxes, visible);
+#endif
+#if defined(FRUSTUM_CULL_SSE)
+    return cullAabbsSSE(frustum, boxes, visible);
+#else
+    return cullAabbsScalar(frustum, boxes, visible);
+#endif
+}
+#endif
@@ -0,0 +1,444 @@
+#pragma once
+#ifndef GL_STATE_SHADOW_H
+#define GL_STATE_SHADOW_H
+
+#include <glad/glad.h>
+
+#include <ostream>
+
+// Optional state tracking underneath every GL call in the program. install() swaps the glad
+// function pointers of the bind/use/enable family for wrappers that remember what is bound and
+// drop calls that would not change anything, so code above glad keeps calling glBindTexture and
+// friends as usual. With elide = false the wrappers only count, which gives the baseline the
+// elided numbers are compared against.
+//
+// The shadow starts out unknown, so the first call of each kind always reaches the driver.
+// Deleting a bound object resets its binding to unknown, and glBindBufferBase/Range update the
+// generic buffer binding they also set. GL_ELEMENT_ARRAY_BUFFER is part of the VAO and always
+// passes through. A call that fails with a GL error would leave the shadow wrong, the program
+// never relies on failing binds.
+class GLStateShadow
+{
+public:
+    enum Call
+    {
+        USE_PROGRAM,
+        BIND_VERTEX_ARRAY,
+        ACTIVE_TEXTURE,
+        BIND_TEXTURE,
+        ENABLE,
+        DISABLE,
+        BIND_BUFFER,
+        BIND_FRAMEBUFFER,
+        BIND_RENDERBUFFER,
+        DEPTH_MASK,
+        BLEND_FUNC,
+        CALL_COUNT
+    };
+    static const int TEXTURE_UNITS = 32;
+
+    // must be called after gladLoadGLLoader, once
+    // ------------------------------------------------------------------------
+    static void install(bool elide)
+    {
+        eliding = elide;
+        invalidate();
+        original.useProgram = glad_glUseProgram;
+        original.bindVertexArray = glad_glBindVertexArray;
+        original.activeTexture = glad_glActiveTexture;
+        original.bindTexture = glad_glBindTexture;
+        original.enable = glad_glEnable;
+        original.disable = glad_glDisable;
+        original.bindBuffer = glad_glBindBuffer;
+        original.bindBufferBase = glad_glBindBufferBase;
+        original.bindBufferRange = glad_glBindBufferRange;
+        original.bindFramebuffer = glad_glBindFramebuffer;
+        original.bindRenderbuffer = glad_glBindRenderbuffer;
+        original.depthMask = glad_glDepthMask;
+        original.blendFunc = glad_glBlendFunc;
+        original.blendFuncSeparate = glad_glBlendFuncSeparate;
+        original.deleteProgram = glad_glDeleteProgram;
+        original.deleteVertexArrays = glad_glDeleteVertexArrays;
+        original.deleteTextures = glad_glDeleteTextures;
+        original.deleteBuffers = glad_glDeleteBuffers;
+        original.deleteFramebuffers = glad_glDeleteFramebuffers;
+        original.deleteRenderbuffers = glad_glDeleteRenderbuffers;
+
+        glad_glUseProgram = useProgram;
+        glad_glBindVertexArray = bindVertexArray;
+        glad_glActiveTexture = activeTexture;
+        glad_glBindTexture = bindTexture;
+        glad_glEnable = enable;
+        glad_glDisable = disable;
+        glad_glBindBuffer = bindBuffer;
+        glad_glBindBufferBase = bindBufferBase;
+        glad_glBindBufferRange = bindBufferRange;
+        glad_glBindFramebuffer = bindFramebuffer;
+        glad_glBindRenderbuffer = bindRenderbuffer;
+        glad_glDepthMask = depthMask;
+        glad_glBlendFunc = blendFunc;
+        glad_glBlendFuncSeparate = blendFuncSeparate;
+        glad_glDeleteProgram = deleteProgram;
+        glad_glDeleteVertexArrays = deleteVertexArrays;
+        glad_glDeleteTextures = deleteTextures;
+        glad_glDeleteBuffers = deleteBuffers;
+        glad_glDeleteFramebuffers = deleteFramebuffers;
+        glad_glDeleteRenderbuffers = deleteRenderbuffers;
+        installed = true;
+    }
+    static bool active()
+    {
+        return installed;
+    }
+    static bool elides()
+    {
+        return eliding;
+    }
+    // forget the shadowed state, for code that changes GL state behind glad's back
+    // ------------------------------------------------------------------------
+    static void invalidate()
+    {
+        state.program = UNKNOWN;
+        state.vao = UNKNOWN;
+        state.activeUnit = UNKNOWN;
+        for (int unit = 0; unit < TEXTURE_UNITS; unit++)
+            for (int target = 0; target < TEXTURE_TARGETS; target++)
+                state.textures[unit][target] = UNKNOWN;
+        for (int cap = 0; cap < CAPS; cap++)
+            state.caps[cap] = UNKNOWN;
+        for (int target = 0; target < BUFFER_TARGETS; target++)
+            state.buffers[target] = UNKNOWN;
+        state.drawFramebuffer = UNKNOWN;
+        state.readFramebuffer = UNKNOWN;
+        state.renderbuffer = UNKNOWN;
+        state.depthMask = UNKNOWN;
+        for (GLuint& factor : state.blend)
+            factor = UNKNOWN;
+    }
+    // calls that reached the driver and calls dropped since the last resetCounters()
+    // ------------------------------------------------------------------------
+    static unsigned long long issued(Call call)
+    {
+        return issuedCalls[call];
+    }
+    static unsigned long long elided(Call call)
+    {
+        return elidedCalls[call];
+    }
+    static unsigned long long totalIssued()
+    {
+        unsigned long long total = 0;
+        for (int call = 0; call < CALL_COUNT; call++)
+            total += issuedCalls[call];
+        return total;
+    }
+    static unsigned long long totalElided()
+    {
+        unsigned long long total = 0;
+        for (int call = 0; call < CALL_COUNT; call++)
+            total += elidedCalls[call];
+        return total;
+    }
+    static void resetCounters()
+    {
+        for (int call = 0; call < CALL_COUNT; call++)
+            issuedCalls[call] = elidedCalls[call] = 0;
+    }
+    static const char* callName(Call call)
+    {
+        static const char* const names[CALL_COUNT] = {
+            "glUseProgram", "glBindVertexArray", "glActiveTexture", "glBindTexture", "glEnable", "glDisable",
+            "glBindBuffer", "glBindFramebuffer", "glBindRenderbuffer", "glDepthMask", "glBlendFunc"
+        };
+        return names[call];
+    }
+    // per call issued / elided counts averaged over frames
+    // ------------------------------------------------------------------------
+    static void report(std::ostream& out, unsigned long long frames)
+    {
+        if (!installed || !frames)
+            return;
+        double issuedPerFrame = (double)totalIssued() / frames;
+        double elidedPerFrame = (double)totalElided() / frames;
+        out << "GL state calls (" << (eliding ? "shadowed" : "counted only") << "): "
+            << issuedPerFrame + elidedPerFrame << " made, " << issuedPerFrame << " reached the driver, "
+            << elidedPerFrame << " elided per frame" << std::endl;
+        for (int call = 0; call < CALL_COUNT; call++)
+        {
+            if (!issuedCalls[call] && !elidedCalls[call])
+                continue;
+            out << "    " << callName((Call)call) << ": " << (double)issuedCalls[call] / frames << " issued, "
+                << (double)elidedCalls[call] / frames << " elided" << std::endl;
+        }
+    }
+
+private:
+    static const GLuint UNKNOWN = 0xFFFFFFFFu;
+    static const int TEXTURE_TARGETS = 3;
+    static const int BUFFER_TARGETS = 4;
+    static const int CAPS = 8;
+
+    struct Entries
+    {
+        PFNGLUSEPROGRAMPROC useProgram;
+        PFNGLBINDVERTEXARRAYPROC bindVertexArray;
+        PFNGLACTIVETEXTUREPROC activeTexture;
+        PFNGLBINDTEXTUREPROC bindTexture;
+        PFNGLENABLEPROC enable;
+        PFNGLDISABLEPROC disable;
+        PFNGLBINDBUFFERPROC bindBuffer;
+        PFNGLBINDBUFFERBASEPROC bindBufferBase;
+        PFNGLBINDBUFFERRANGEPROC bindBufferRange;
+        PFNGLBINDFRAMEBUFFERPROC bindFramebuffer;
+        PFNGLBINDRENDERBUFFERPROC bindRenderbuffer;
+        PFNGLDEPTHMASKPROC depthMask;
+        PFNGLBLENDFUNCPROC blendFunc;
+        PFNGLBLENDFUNCSEPARATEPROC blendFuncSeparate;
+        PFNGLDELETEPROGRAMPROC deleteProgram;
+        PFNGLDELETEVERTEXARRAYSPROC deleteVertexArrays;
+        PFNGLDELETETEXTURESPROC deleteTextures;
+        PFNGLDELETEBUFFERSPROC deleteBuffers;
+        PFNGLDELETEFRAMEBUFFERSPROC deleteFramebuffers;
+        PFNGLDELETERENDERBUFFERSPROC deleteRenderbuffers;
+    };
+    struct State
+    {
+        GLuint program, vao, activeUnit;
+        GLuint textures[TEXTURE_UNITS][TEXTURE_TARGETS];
+        GLuint caps[CAPS];
+        GLuint buffers[BUFFER_TARGETS];
+        GLuint drawFramebuffer, readFramebuffer, renderbuffer;
+        GLuint depthMask;
+        // source rgb, destination rgb, source alpha, destination alpha
+        GLuint blend[4];
+    };
+
+    static inline Entries original = {};
+    static inline State state = {};
+    static inline bool installed = false, eliding = false;
+    static inline unsigned long long issuedCalls[CALL_COUNT] = {}, elidedCalls[CALL_COUNT] = {};
+
+    // true when the call has to reach the driver, shadow is updated to value either way
+    static bool change(Call call, GLuint& shadow, GLuint value)
+    {
+        if (eliding && shadow == value)
+        {
+            elidedCalls[call]++;
+            return false;
+        }
+        shadow = value;
+        issuedCalls[call]++;
+        return true;
+    }
+    // untracked targets and caps always reach the driver
+    static bool passThrough(Call call)
+    {
+        issuedCalls[call]++;
+        return true;
+    }
+    static int textureTarget(GLenum target)
+    {
+        switch (target)
+        {
+        case GL_TEXTURE_2D: return 0;
+        case GL_TEXTURE_2D_ARRAY: return 1;
+        case GL_TEXTURE_CUBE_MAP: return 2;
+        default: return -1;
+        }
+    }
+    static int bufferTarget(GLenum target)
+    {
+        switch (target)
+        {
+        case GL_ARRAY_BUFFER: return 0;
+        case GL_UNIFORM_BUFFER: return 1;
+        case GL_PIXEL_UNPACK_BUFFER: return 2;
+        case GL_COPY_WRITE_BUFFER: return 3;
+        default: return -1;
+        }
+    }
+    static int capIndex(GLenum cap)
+    {
+        switch (cap)
+        {
+        case GL_DEPTH_TEST: return 0;
+        case GL_BLEND: return 1;
+        case GL_CULL_FACE: return 2;
+        case GL_SCISSOR_TEST: return 3;
+        case GL_STENCIL_TEST: return 4;
+        case GL_POLYGON_OFFSET_FILL: return 5;
+        case GL_MULTISAMPLE: return 6;
+        case GL_FRAMEBUFFER_SRGB: return 7;
+        default: return -1;
+        }
+    }
+    static void forget(GLuint& shadow, GLuint deleted)
+    {
+        if (shadow == deleted)
+            shadow = UNKNOWN;
+    }
+
+    // the wrappers glad dispatches to once installed
+    // ------------------------------------------------------------------------
+    static void APIENTRY useProgram(GLuint program)
+    {
+        if (change(USE_PROGRAM, state.program, program))
+            original.useProgram(program);
+    }
+    static void APIENTRY bindVertexArray(GLuint array)
+    {
+        if (change(BIND_VERTEX_ARRAY, state.vao, array))
+            original.bindVertexArray(array);
+    }
+    static void APIENTRY activeTexture(GLenum texture)
+    {
+        GLuint unit = texture - GL_TEXTURE0;
+        if (unit >= (GLuint)TEXTURE_UNITS)
+        {
+            state.activeUnit = UNKNOWN;
+            passThrough(ACTIVE_TEXTURE);
+            original.activeTexture(texture);
+        }
+        else if (change(ACTIVE_TEXTURE, state.activeUnit, unit))
+            original.activeTexture(texture);
+    }
+    static void APIENTRY bindTexture(GLenum target, GLuint texture)
+    {
+        int index = textureTarget(target);
+        if (index < 0 || state.activeUnit == UNKNOWN)
+        {
+            if (index >= 0)
+                for (int unit = 0; unit < TEXTURE_UNITS; unit++)
+                    state.textures[unit][index] = UNKNOWN;
+            passThrough(BIND_TEXTURE);
+            original.bindTexture(target, texture);
+        }
+        else if (change(BIND_TEXTURE, state.textures[state.activeUnit][index], texture))
+            original.bindTexture(target, texture);
+    }
+    static void APIENTRY enable(GLenum cap)
+    {
+        int index = capIndex(cap);
+        if (index < 0 ? passThrough(ENABLE) : change(ENABLE, state.caps[index], GL_TRUE))
+            original.enable(cap);
+    }
+    static void APIENTRY disable(GLenum cap)
+    {
+        int index = capIndex(cap);
+        if (index < 0 ? passThrough(DISABLE) : change(DISABLE, state.caps[index], GL_FALSE))
+            original.disable(cap);
+    }
+    static void APIENTRY bindBuffer(GLenum target, GLuint buffer)
+    {
+        int index = bufferTarget(target);
+        if (index < 0 ? passThrough(BIND_BUFFER) : change(BIND_BUFFER, state.buffers[index], buffer))
+            original.bindBuffer(target, buffer);
+    }
+    // indexed binds always go through, they also replace the generic binding
+    static void APIENTRY bindBufferBase(GLenum target, GLuint index, GLuint buffer)
+    {
+        int generic = bufferTarget(target);
+        if (generic >= 0)
+            state.buffers[generic] = buffer;
+        original.bindBufferBase(target, index, buffer);
+    }
+    static void APIENTRY bindBufferRange(GLenum target, GLuint index, GLuint buffer, GLintptr offset, GLsizeiptr size)
+    {
+        int generic = bufferTarget(target);
+        if (generic >= 0)
+            state.buffers[generic] = buffer;
+        original.bindBufferRange(target, index, buffer, offset, size);
+    }
+    static void APIENTRY bindFramebuffer(GLenum target, GLuint framebuffer)
+    {
+        bool issue;
+        if (target == GL_DRAW_FRAMEBUFFER)
+            issue = change(BIND_FRAMEBUFFER, state.drawFramebuffer, framebuffer);
+        else if (target == GL_READ_FRAMEBUFFER)
+            issue = change(BIND_FRAMEBUFFER, state.readFramebuffer, framebuffer);
+        else
+        {
+            // GL_FRAMEBUFFER sets both, it is only redundant when both already match
+            GLuint both = state.drawFramebuffer == state.readFramebuffer ? state.drawFramebuffer : UNKNOWN;
+            issue = change(BIND_FRAMEBUFFER, both, framebuffer);
+            state.drawFramebuffer = state.readFramebuffer = framebuffer;
+        }
+        if (issue)
+            original.bindFramebuffer(target, framebuffer);
+    }
+    static void APIENTRY bindRenderbuffer(GLenum target, GLuint renderbuffer)
+    {
+        if (change(BIND_RENDERBUFFER, state.renderbuffer, renderbuffer))
+            original.bindRenderbuffer(target, renderbuffer);
+    }
+    static void APIENTRY depthMask(GLboolean flag)
+    {
+        if (change(DEPTH_MASK, state.depthMask, flag ? GL_TRUE : GL_FALSE))
+            original.depthMask(flag);
+    }
+    static void APIENTRY blendFunc(GLenum sfactor, GLenum dfactor)
+    {
+        blendFuncSeparate(sfactor, dfactor, sfactor, dfactor);
+    }
+    static void APIENTRY blendFuncSeparate(GLenum sfactorRGB, GLenum dfactorRGB, GLenum sfactorAlpha, GLenum dfactorAlpha)
+    {
+        const GLuint factors[4] = { sfactorRGB, dfactorRGB, sfactorAlpha, dfactorAlpha };
+        bool same = true;
+        for (int i = 0; i < 4; i++)
+            same = same && state.blend[i] == factors[i];
+        if (eliding && same)
+        {
+            elidedCalls[BLEND_FUNC]++;
+            return;
+        }
+        for (int i = 0; i < 4; i++)
+            state.blend[i] = factors[i];
+        issuedCalls[BLEND_FUNC]++;
+        original.blendFuncSeparate(sfactorRGB, dfactorRGB, sfactorAlpha, dfactorAlpha);
+    }
+
+    // deleting a bound object unbinds it, the shadow no longer knows what is bound there
+    // ------------------------------------------------------------------------
+    static void APIENTRY deleteProgram(GLuint program)
+    {
+        forget(state.program, program);
+        original.deleteProgram(program);
+    }
+    static void APIENTRY deleteVertexArrays(GLsizei n, const GLuint* arrays)
+    {
+        for (GLsizei i = 0; i < n; i++)
+            forget(state.vao, arrays[i]);
+        original.deleteVertexArrays(n, arrays);
+    }
+    static void APIENTRY deleteTextures(GLsizei n, const GLuint* textures)
+    {
+        for (GLsizei i = 0; i < n; i++)
+            for (int unit = 0; unit < TEXTURE_UNITS; unit++)
+                for (int target = 0; target < TEXTURE_TARGETS; target++)
+                    forget(state.textures[unit][target], textures[i]);
+        original.deleteTextures(n, textures);
+    }
+    static void APIENTRY deleteBuffers(GLsizei n, const GLuint* buffers)
+    {
+        for (GLsizei i = 0; i < n; i++)
+            for (int target = 0; target < BUFFER_TARGETS; target++)
+                forget(state.buffers[target], buffers[i]);
+        original.deleteBuffers(n, buffers);
+    }
+    static void APIENTRY deleteFramebuffers(GLsizei n, const GLuint* framebuffers)
+    {
+        for (GLsizei i = 0; i < n; i++)
+        {
+            forget(state.drawFramebuffer, framebuffers[i]);
+            forget(state.readFramebuffer, framebuffers[i]);
+        }
+        original.deleteFramebuffers(n, framebuffers);
+    }
+    static void APIENTRY deleteRenderbuffers(GLsizei n, const GLuint* renderbuffers)
+    {
+        for (GLsizei i = 0; i < n; i++)
+            forget(state.renderbuffer, renderbuffers[i]);
+        original.deleteRenderbuffers(n, renderbuffers);
+    }
+};
+#endif
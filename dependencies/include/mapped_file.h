@@ -0,0 +1,88 @@
+#pragma once
+#ifndef MAPPED_FILE_H
+#define MAPPED_FILE_H
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cstddef>
+#include <string>
+#include <utility>
+
+// Read-only memory mapping of a whole file. The pages are faulted in by the kernel as they
+// are touched, so nothing is copied into a user buffer before the data is used. Files read
+// once from start to end, like images handed to a decoder, should be opened with
+// MADV_SEQUENTIAL so the kernel reads ahead aggressively and drops pages behind the reader.
+class MappedFile
+{
+public:
+    MappedFile() = default;
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+    MappedFile(MappedFile&& other) noexcept
+    {
+        *this = std::move(other);
+    }
+    MappedFile& operator=(MappedFile&& other) noexcept
+    {
+        if (this != &other)
+        {
+            close();
+            bytes = other.bytes;
+            length = other.length;
+            other.bytes = nullptr;
+            other.length = 0;
+        }
+        return *this;
+    }
+    ~MappedFile()
+    {
+        close();
+    }
+    // false if the file is missing, empty or cannot be mapped; advice goes to madvise
+    // ------------------------------------------------------------------------
+    bool open(const std::string& path, int advice = MADV_NORMAL)
+    {
+        close();
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0)
+            return false;
+        struct stat info;
+        if (fstat(fd, &info) == 0 && info.st_size > 0)
+        {
+            void* mapping = mmap(nullptr, (size_t)info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (mapping != MAP_FAILED)
+            {
+                bytes = (const unsigned char*)mapping;
+                length = (size_t)info.st_size;
+            }
+        }
+        // the mapping keeps its own reference to the file
+        ::close(fd);
+        if (bytes && advice != MADV_NORMAL)
+            madvise((void*)bytes, length, advice);
+        return bytes != nullptr;
+    }
+    void close()
+    {
+        if (bytes)
+            munmap((void*)bytes, length);
+        bytes = nullptr;
+        length = 0;
+    }
+    const unsigned char* data() const
+    {
+        return bytes;
+    }
+    size_t size() const
+    {
+        return length;
+    }
+
+private:
+    const unsigned char* bytes = nullptr;
+    size_t length = 0;
+};
+#endif
@@ -0,0 +1,212 @@
+#pragma once
+#ifndef MESH_BUILDER_H
+#define MESH_BUILDER_H
+
+#include <cstring>
+#include <deque>
+#include <iostream>
+#include <unordered_map>
+#include <vector>
+
+// Indexed mesh built from an unindexed triangle list, vertices are interleaved floats
+struct IndexedMesh
+{
+    std::vector<float> vertices;
+    std::vector<unsigned short> indices;
+    int floatsPerVertex = 0;
+
+    size_t vertexCount() const { return floatsPerVertex ? vertices.size() / floatsPerVertex : 0; }
+};
+
+// average cache miss ratio (transformed vertices per triangle) of a FIFO post-transform cache
+// ------------------------------------------------------------------------
+inline float computeACMR(const std::vector<unsigned short>& indices, int cacheSize = 16)
+{
+    if (indices.size() < 3)
+        return 0.0f;
+    std::deque<unsigned short> cache;
+    unsigned int misses = 0;
+    for (unsigned short index : indices)
+    {
+        bool hit = false;
+        for (unsigned short cached : cache)
+            if (cached == index)
+            {
+                hit = true;
+                break;
+            }
+        if (hit)
+            continue;
+        misses++;
+        cache.push_back(index);
+        if ((int)cache.size() > cacheSize)
+            cache.pop_front();
+    }
+    return (float)misses / (float)(indices.size() / 3);
+}
+
+// merge bitwise identical vertices of a triangle list into a vertex buffer plus 16 bit indices,
+// an empty mesh if there are more unique vertices than 16 bit indices can address
+// ------------------------------------------------------------------------
+inline IndexedMesh weldVertices(const float* vertices, size_t vertexCount, int floatsPerVertex)
+{
+    struct VertexKey
+    {
+        const float* data;
+        int count;
+        bool operator==(const VertexKey& other) const
+        {
+            return memcmp(data, other.data, count * sizeof(float)) == 0;
+        }
+    };
+    struct VertexHash
+    {
+        size_t operator()(const VertexKey& key) const
+        {
+            // FNV-1a over the raw bytes
+            size_t h = 14695981039346656037ull;
+            const unsigned char* bytes = (const unsigned char*)key.data;
+            for (size_t i = 0; i < key.count * sizeof(float); i++)
+                h = (h ^ bytes[i]) * 1099511628211ull;
+            return h;
+        }
+    };
+
+    IndexedMesh mesh;
+    mesh.floatsPerVertex = floatsPerVertex;
+    mesh.indices.reserve(vertexCount);
+    std::unordered_map<VertexKey, unsigned short, VertexHash> unique;
+    for (size_t i = 0; i < vertexCount; i++)
+    {
+        VertexKey key{ vertices + i * floatsPerVertex, floatsPerVertex };
+        auto found = unique.find(key);
+        if (found != unique.end())
+        {
+            mesh.indices.push_back(found->second);
+            continue;
+        }
+        if (unique.size() > 0xFFFF)
+        {
+            std::cout << "Mesh has more than 65536 unique vertices, too many for 16 bit indices" << std::endl;
+            return IndexedMesh();
+        }
+        unsigned short index = (unsigned short)unique.size();
+        unique.emplace(key, index);
+        mesh.vertices.insert(mesh.vertices.end(), key.data, key.data + floatsPerVertex);
+        mesh.indices.push_back(index);
+    }
+    return mesh;
+}
+
+// reorder triangles for post-transform cache locality (Tipsify, Sander et al. 2007)
+// ------------------------------------------------------------------------
+inline void optimizeVertexCache(std::vector<unsigned short>& indices, size_t vertexCount, int cacheSize = 16)
+{
+    size_t triangleCount = indices.size() / 3;
+    if (triangleCount == 0)
+        return;
+
+    // vertex -> triangle adjacency in one flat array
+    std::vector<unsigned int> live(vertexCount, 0), offsets(vertexCount + 1, 0);
+    for (unsigned short index : indices)
+        live[index]++;
+    for (size_t v = 0; v < vertexCount; v++)
+        offsets[v + 1] = offsets[v] + live[v];
+    std::vector<unsigned int> adjacency(indices.size()), fill(offsets.begin(), offsets.end() - 1);
+    for (size_t i = 0; i < indices.size(); i++)
+        adjacency[fill[indices[i]]++] = (unsigned int)(i / 3);
+
+    std::vector<int> cacheTime(vertexCount, 0);
+    std::vector<char> emitted(triangleCount, 0);
+    std::vector<unsigned short> deadEnd, candidates, result;
+    result.reserve(indices.size());
+    int timestamp = cacheSize + 1;
+    size_t cursor = 1;
+    int fanning = 0;
+
+    while (fanning >= 0)
+    {
+        candidates.clear();
+        for (unsigned int a = offsets[fanning]; a < offsets[fanning + 1]; a++)
+        {
+            unsigned int t = adjacency[a];
+            if (emitted[t])
+                continue;
+            for (int corner = 0; corner < 3; corner++)
+            {
+                unsigned short v = indices[t * 3 + corner];
+                result.push_back(v);
+                deadEnd.push_back(v);
+                candidates.push_back(v);
+                live[v]--;
+                if (timestamp - cacheTime[v] > cacheSize)
+                    cacheTime[v] = timestamp++;
+            }
+            emitted[t] = 1;
+        }
+
+        // prefer a candidate still in cache that will not be evicted by its own fan
+        int best = -1, bestPriority = -1;
+        for (unsigned short v : candidates)
+        {
+            if (live[v] == 0)
+                continue;
+            int priority = 0;
+            if (timestamp - cacheTime[v] + 2 * (int)live[v] <= cacheSize)
+                priority = timestamp - cacheTime[v];
+            if (priority > bestPriority)
+            {
+                bestPriority = priority;
+                best = v;
+            }
+        }
+        // otherwise walk back through recently used vertices, then scan forward
+        while (best < 0 && !deadEnd.empty())
+        {
+            unsigned short v = deadEnd.back();
+            deadEnd.pop_back();
+            if (live[v] > 0)
+                best = v;
+        }
+        while (best < 0 && cursor < vertexCount)
+        {
+            if (live[cursor] > 0)
+                best = (int)cursor;
+            cursor++;
+        }
+        fanning = best;
+    }
+    indices.swap(result);
+}
+
+// renumber vertices in first use order so vertex fetch walks the buffer forwards
+// ------------------------------------------------------------------------
+inline void optimizeVertexFetch(IndexedMesh& mesh)
+{
+    std::vector<int> remap(mesh.vertexCount(), -1);
+    std::vector<float> vertices;
+    vertices.reserve(mesh.vertices.size());
+    unsigned short next = 0;
+    for (unsigned short& index : mesh.indices)
+    {
+        if (remap[index] < 0)
+        {
+            remap[index] = next++;
+            const float* source = &mesh.vertices[index * mesh.floatsPerVertex];
+            vertices.insert(vertices.end(), source, source + mesh.floatsPerVertex);
+        }
+        index = (unsigned short)remap[index];
+    }
+    mesh.vertices.swap(vertices);
+}
+
+// weld, cache optimize and fetch optimize a triangle list in one go
+// ------------------------------------------------------------------------
+inline IndexedMesh buildIndexedMesh(const float* vertices, size_t vertexCount, int floatsPerVertex, int cacheSize = 16)
+{
+    IndexedMesh mesh = weldVertices(vertices, vertexCount, floatsPerVertex);
+    optimizeVertexCache(mesh.indices, mesh.vertexCount(), cacheSize);
+    optimizeVertexFetch(mesh);
+    return mesh;
+}
+#endif
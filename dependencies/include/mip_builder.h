@@ -0,0 +1,422 @@
+#pragma once
+#ifndef MIP_BUILDER_H
+#define MIP_BUILDER_H
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <thread>
+#include <vector>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define MIP_BUILDER_SSE
+#include <emmintrin.h>
+#endif
+// the AVX2 passes are compiled with a per-function target attribute and only chosen at run
+// time on CPUs that report AVX2, so the build itself still only needs SSE2
+#if defined(MIP_BUILDER_SSE) && (defined(__GNUC__) || defined(__clang__))
+#define MIP_BUILDER_AVX2
+#define MIP_BUILDER_AVX2_TARGET __attribute__((target("avx2")))
+#include <immintrin.h>
+#elif defined(_MSC_VER) && defined(__AVX2__)
+// VC++ has no per-function targets; building with /arch:AVX2 already requires the CPU to have it
+#define MIP_BUILDER_AVX2
+#define MIP_BUILDER_AVX2_TARGET
+#include <immintrin.h>
+#endif
+
+enum MipFilter
+{
+    // average of the source texels under each destination texel
+    MIP_FILTER_BOX,
+    // sinc under a Kaiser window (alpha 4), three destination texels either side
+    MIP_FILTER_KAISER,
+    // sinc under a sinc window, three destination texels either side
+    MIP_FILTER_LANCZOS
+};
+
+enum MipSimd
+{
+    MIP_SIMD_SCALAR,
+    MIP_SIMD_SSE,
+    MIP_SIMD_AVX2,
+    // widest path this CPU runs
+    MIP_SIMD_BEST
+};
+
+struct MipOptions
+{
+    MipFilter filter = MIP_FILTER_KAISER;
+    // texels hold sRGB encoded colour: filter in linear light and encode the result again
+    bool srgb = true;
+    // weight colour by alpha while filtering so transparent texels do not bleed their colour
+    // into the edges of cutouts; levels are stored with straight alpha again
+    bool premultiplyAlpha = true;
+    // 0 uses every core
+    int threads = 0;
+    MipSimd simd = MIP_SIMD_BEST;
+};
+
+struct MipLevel
+{
+    int width, height;
+    std::vector<unsigned char> pixels;
+};
+
+inline const char* mipFilterName(MipFilter filter)
+{
+    return filter == MIP_FILTER_BOX ? "box" : filter == MIP_FILTER_KAISER ? "kaiser" : "lanczos";
+}
+
+// CPU mip chain builder for 8 bit images of 1 to 4 channels (2 is grey + alpha, as stb_image
+// decodes them). Each level is filtered from the previous one in floats, four per texel:
+// a vertical pass turns rows into half as many rows, then a horizontal pass halves each row.
+// Both passes use precomputed taps per destination row or column, which also covers odd sizes
+// where the scale is not exactly 2. The vertical pass works on whole rows, 4 or 8 floats per
+// instruction; the horizontal pass on one texel (SSE) or two (AVX2) per instruction. Rows are
+// split across threads in both passes.
+class MipBuilder
+{
+public:
+    // every level below the base, down to 1 x 1
+    // ------------------------------------------------------------------------
+    std::vector<MipLevel> build(const unsigned char* pixels, int width, int height, int channels, const MipOptions& options)
+    {
+        setup(options);
+        std::vector<MipLevel> levels;
+        current.resize((size_t)width * height * 4);
+        int alpha = alphaChannel(channels);
+        parallelRows(height, width, [&](int first, int last)
+        {
+            for (int y = first; y < last; y++)
+                decodeRow(pixels + (size_t)y * width * channels, &current[(size_t)y * width * 4], width, channels, alpha);
+        });
+        while (width > 1 || height > 1)
+        {
+            int nextWidth = std::max(1, width / 2), nextHeight = std::max(1, height / 2);
+            downsample(width, height, nextWidth, nextHeight);
+            width = nextWidth;
+            height = nextHeight;
+            MipLevel level = { width, height, std::vector<unsigned char>((size_t)width * height * channels) };
+            parallelRows(height, width, [&](int first, int last)
+            {
+                for (int y = first; y < last; y++)
+                    encodeRow(&current[(size_t)y * width * 4], &level.pixels[(size_t)y * width * channels], width, channels, alpha);
+            });
+            levels.push_back(std::move(level));
+        }
+        return levels;
+    }
+    // ------------------------------------------------------------------------
+    static MipSimd bestSimd()
+    {
+#if defined(MIP_BUILDER_AVX2) && (defined(__GNUC__) || defined(__clang__))
+        static const bool avx2 = __builtin_cpu_supports("avx2");
+        if (avx2)
+            return MIP_SIMD_AVX2;
+#elif defined(MIP_BUILDER_AVX2)
+        return MIP_SIMD_AVX2;
+#endif
+#if defined(MIP_BUILDER_SSE)
+        return MIP_SIMD_SSE;
+#else
+        return MIP_SIMD_SCALAR;
+#endif
+    }
+    static const char* simdName(MipSimd simd)
+    {
+        return simd == MIP_SIMD_AVX2 ? "avx2" : simd == MIP_SIMD_SSE ? "sse" : "scalar";
+    }
+
+private:
+    // below this many destination texels per thread a pass stays on one thread
+    static const int MIN_TEXELS_PER_THREAD = 16384;
+    static const int ENCODE_TABLE_SIZE = 16384;
+
+    // one destination row or column: count taps starting at index[i * count]
+    struct Taps
+    {
+        int count = 0;
+        std::vector<int> index;
+        std::vector<float> weight;
+    };
+
+    MipOptions settings;
+    MipSimd simd = MIP_SIMD_SCALAR;
+    int threads = 1;
+    float decodeTable[256];
+    std::vector<unsigned char> encodeTable;
+    std::vector<float> current, vertical, next;
+    Taps rowTaps, columnTaps;
+
+    static int alphaChannel(int channels)
+    {
+        return channels == 4 ? 3 : channels == 2 ? 1 : -1;
+    }
+    static float srgbToLinear(float value)
+    {
+        return value <= 0.04045f ? value / 12.92f : std::pow((value + 0.055f) / 1.055f, 2.4f);
+    }
+    static float linearToSrgb(float value)
+    {
+        return value <= 0.0031308f ? value * 12.92f : 1.055f * std::pow(value, 1.0f / 2.4f) - 0.055f;
+    }
+    // ------------------------------------------------------------------------
+    void setup(const MipOptions& options)
+    {
+        settings = options;
+        // paths this CPU lacks fall back to the widest one it has
+        simd = std::min(options.simd, bestSimd());
+        threads = options.threads > 0 ? options.threads : (int)std::max(1u, std::thread::hardware_concurrency());
+        for (int i = 0; i < 256; i++)
+            decodeTable[i] = srgbToLinear(i / 255.0f);
+        if (encodeTable.empty())
+        {
+            encodeTable.resize(ENCODE_TABLE_SIZE);
+            for (int i = 0; i < ENCODE_TABLE_SIZE; i++)
+                encodeTable[i] = (unsigned char)(linearToSrgb(i / (float)(ENCODE_TABLE_SIZE - 1)) * 255.0f + 0.5f);
+        }
+    }
+    // ------------------------------------------------------------------------
+    void decodeRow(const unsigned char* in, float* out, int width, int channels, int alpha) const
+    {
+        for (int x = 0; x < width; x++, in += channels, out += 4)
+        {
+            float a = alpha >= 0 ? in[alpha] / 255.0f : 1.0f;
+            for (int c = 0; c < 4; c++)
+            {
+                if (c >= channels)
+                    out[c] = 0.0f;
+                else if (c == alpha)
+                    out[c] = a;
+                else
+                {
+                    float value = settings.srgb ? decodeTable[in[c]] : in[c] / 255.0f;
+                    out[c] = settings.premultiplyAlpha ? value * a : value;
+                }
+            }
+        }
+    }
+    // ------------------------------------------------------------------------
+    void encodeRow(const float* in, unsigned char* out, int width, int channels, int alpha) const
+    {
+        for (int x = 0; x < width; x++, in += 4, out += channels)
+        {
+            float a = alpha >= 0 ? std::min(std::max(in[alpha], 0.0f), 1.0f) : 1.0f;
+            for (int c = 0; c < channels; c++)
+            {
+                if (c == alpha)
+                {
+                    out[c] = (unsigned char)(a * 255.0f + 0.5f);
+                    continue;
+                }
+                float value = in[c];
+                if (settings.premultiplyAlpha && alpha >= 0)
+                    value = a > 0.0f ? value / a : 0.0f;
+                value = std::min(std::max(value, 0.0f), 1.0f);
+                out[c] = settings.srgb ? encodeTable[(int)(value * (ENCODE_TABLE_SIZE - 1) + 0.5f)] : (unsigned char)(value * 255.0f + 0.5f);
+            }
+        }
+    }
+    // filter weight at a distance in destination texels
+    // ------------------------------------------------------------------------
+    static float sinc(float x)
+    {
+        if (std::fabs(x) < 1e-6f)
+            return 1.0f;
+        const float pi = 3.14159265358979f;
+        return std::sin(pi * x) / (pi * x);
+    }
+    static float besselI0(float x)
+    {
+        float sum = 1.0f, term = 1.0f;
+        for (int k = 1; k < 20; k++)
+        {
+            term *= (x / (2.0f * k)) * (x / (2.0f * k));
+            sum += term;
+        }
+        return sum;
+    }
+    float support() const
+    {
+        return settings.filter == MIP_FILTER_BOX ? 0.5f : 3.0f;
+    }
+    float filter(float x) const
+    {
+        x = std::fabs(x);
+        float width = support();
+        if (settings.filter == MIP_FILTER_BOX)
+            return x <= width ? 1.0f : 0.0f;
+        if (x >= width)
+            return 0.0f;
+        if (settings.filter == MIP_FILTER_LANCZOS)
+            return sinc(x) * sinc(x / width);
+        const float alpha = 4.0f;
+        float ratio = x / width;
+        return sinc(x) * besselI0(alpha * std::sqrt(1.0f - ratio * ratio)) / besselI0(alpha);
+    }
+    // taps of every destination texel along one axis, source indices clamped to the edge
+    // ------------------------------------------------------------------------
+    void computeTaps(int sourceSize, int destinationSize, Taps& taps) const
+    {
+        float scale = (float)sourceSize / destinationSize;
+        float radius = support() * scale;
+        taps.count = (int)std::ceil(radius * 2.0f) + 1;
+        taps.index.assign((size_t)destinationSize * taps.count, 0);
+        taps.weight.assign((size_t)destinationSize * taps.count, 0.0f);
+        for (int d = 0; d < destinationSize; d++)
+        {
+            float center = (d + 0.5f) * scale;
+            int first = (int)std::floor(center - radius);
+            float total = 0.0f;
+            for (int t = 0; t < taps.count; t++)
+            {
+                int source = first + t;
+                float weight = filter((source + 0.5f - center) / scale);
+                taps.index[(size_t)d * taps.count + t] = std::min(std::max(source, 0), sourceSize - 1);
+                taps.weight[(size_t)d * taps.count + t] = weight;
+                total += weight;
+            }
+            for (int t = 0; t < taps.count; t++)
+                taps.weight[(size_t)d * taps.count + t] /= total;
+        }
+    }
+    // ------------------------------------------------------------------------
+    void downsample(int width, int height, int nextWidth, int nextHeight)
+    {
+        computeTaps(height, nextHeight, rowTaps);
+        computeTaps(width, nextWidth, columnTaps);
+        vertical.resize((size_t)width * nextHeight * 4);
+        next.resize((size_t)nextWidth * nextHeight * 4);
+        parallelRows(nextHeight, width, [&](int first, int last)
+        {
+            for (int y = first; y < last; y++)
+                verticalRow(y, width);
+        });
+        parallelRows(nextHeight, nextWidth, [&](int first, int last)
+        {
+            for (int y = first; y < last; y++)
+                horizontalRow(&vertical[(size_t)y * width * 4], &next[(size_t)y * nextWidth * 4], nextWidth);
+        });
+        current.swap(next);
+    }
+    // one destination row as the weighted sum of whole source rows
+    // ------------------------------------------------------------------------
+    void verticalRow(int y, int width)
+    {
+        const int* index = &rowTaps.index[(size_t)y * rowTaps.count];
+        const float* weight = &rowTaps.weight[(size_t)y * rowTaps.count];
+        float* out = &vertical[(size_t)y * width * 4];
+        size_t n = (size_t)width * 4, i = 0;
+#ifdef MIP_BUILDER_AVX2
+        if (simd == MIP_SIMD_AVX2)
+            i = verticalRowAvx2(index, weight, out, n);
+#endif
+#ifdef MIP_BUILDER_SSE
+        if (simd != MIP_SIMD_SCALAR)
+        {
+            for (; i + 4 <= n; i += 4)
+            {
+                __m128 sum = _mm_setzero_ps();
+                for (int t = 0; t < rowTaps.count; t++)
+                    sum = _mm_add_ps(sum, _mm_mul_ps(_mm_set1_ps(weight[t]), _mm_loadu_ps(&current[(size_t)index[t] * n + i])));
+                _mm_storeu_ps(out + i, sum);
+            }
+        }
+#endif
+        for (; i < n; i++)
+        {
+            float sum = 0.0f;
+            for (int t = 0; t < rowTaps.count; t++)
+                sum += weight[t] * current[(size_t)index[t] * n + i];
+            out[i] = sum;
+        }
+    }
+    // each destination texel as the weighted sum of source texels of the same row
+    // ------------------------------------------------------------------------
+    void horizontalRow(const float* in, float* out, int nextWidth)
+    {
+        int count = columnTaps.count, x = 0;
+#ifdef MIP_BUILDER_AVX2
+        if (simd == MIP_SIMD_AVX2)
+            x = horizontalRowAvx2(in, out, nextWidth);
+#endif
+#ifdef MIP_BUILDER_SSE
+        if (simd != MIP_SIMD_SCALAR)
+        {
+            for (; x < nextWidth; x++)
+            {
+                const int* index = &columnTaps.index[(size_t)x * count];
+                const float* weight = &columnTaps.weight[(size_t)x * count];
+                __m128 sum = _mm_setzero_ps();
+                for (int t = 0; t < count; t++)
+                    sum = _mm_add_ps(sum, _mm_mul_ps(_mm_set1_ps(weight[t]), _mm_loadu_ps(in + (size_t)index[t] * 4)));
+                _mm_storeu_ps(out + (size_t)x * 4, sum);
+            }
+        }
+#endif
+        for (; x < nextWidth; x++)
+        {
+            const int* index = &columnTaps.index[(size_t)x * count];
+            const float* weight = &columnTaps.weight[(size_t)x * count];
+            for (int c = 0; c < 4; c++)
+            {
+                float sum = 0.0f;
+                for (int t = 0; t < count; t++)
+                    sum += weight[t] * in[(size_t)index[t] * 4 + c];
+                out[(size_t)x * 4 + c] = sum;
+            }
+        }
+    }
+#ifdef MIP_BUILDER_AVX2
+    // the AVX2 parts of the two passes, 8 floats of a row or two texels at a time; each
+    // returns where it stopped for the narrower paths to finish the row
+    // ------------------------------------------------------------------------
+    MIP_BUILDER_AVX2_TARGET size_t verticalRowAvx2(const int* index, const float* weight, float* out, size_t n) const
+    {
+        size_t i = 0;
+        for (; i + 8 <= n; i += 8)
+        {
+            __m256 sum = _mm256_setzero_ps();
+            for (int t = 0; t < rowTaps.count; t++)
+                sum = _mm256_add_ps(sum, _mm256_mul_ps(_mm256_set1_ps(weight[t]), _mm256_loadu_ps(&current[(size_t)index[t] * n + i])));
+            _mm256_storeu_ps(out + i, sum);
+        }
+        return i;
+    }
+    MIP_BUILDER_AVX2_TARGET int horizontalRowAvx2(const float* in, float* out, int nextWidth) const
+    {
+        int count = columnTaps.count, x = 0;
+        for (; x + 2 <= nextWidth; x += 2)
+        {
+            const int* index = &columnTaps.index[(size_t)x * count];
+            const float* weight = &columnTaps.weight[(size_t)x * count];
+            __m256 sum = _mm256_setzero_ps();
+            for (int t = 0; t < count; t++)
+            {
+                __m256 texels = _mm256_insertf128_ps(_mm256_castps128_ps256(_mm_loadu_ps(in + (size_t)index[t] * 4)),
+                    _mm_loadu_ps(in + (size_t)index[count + t] * 4), 1);
+                __m256 weights = _mm256_insertf128_ps(_mm256_castps128_ps256(_mm_set1_ps(weight[t])), _mm_set1_ps(weight[count + t]), 1);
+                sum = _mm256_add_ps(sum, _mm256_mul_ps(weights, texels));
+            }
+            _mm256_storeu_ps(out + (size_t)x * 4, sum);
+        }
+        return x;
+    }
+#endif
+    // run function(first, last) over blocks of rows, the calling thread takes the first block
+    // ------------------------------------------------------------------------
+    template <typename Function>
+    void parallelRows(int rows, int width, const Function& function) const
+    {
+        long long texels = (long long)rows * width;
+        int blocks = (int)std::max<long long>(1, std::min<long long>(std::min(threads, rows), texels / MIN_TEXELS_PER_THREAD));
+        std::vector<std::thread> workers;
+        for (int b = 1; b < blocks; b++)
+            workers.emplace_back(function, rows * b / blocks, rows * (b + 1) / blocks);
+        function(0, rows / blocks);
+        for (std::thread& worker : workers)
+            worker.join();
+    }
+};
+#endif
@@ -0,0 +1,239 @@
+#pragma once
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include <glad/glad.h>
+
+#include <chrono>
+#include <cstdio>
+#include <iostream>
+#include <map>
+#include <string>
+#include <vector>
+
+// Named CPU and GPU scopes for the frame loop.
+//
+//     { PROFILE_CPU("opaque"); PROFILE_GPU("opaque"); ...draws... }
+//
+// GPU scopes are bracketed with glQueryCounter(GL_TIMESTAMP) queries. Each frame records into
+// one slot of a FRAMES_IN_FLIGHT deep ring and a slot is only read back when it comes round
+// again, so the results are long finished and the readback never stalls the pipeline.
+// Timestamps need nothing beyond GL 3.3 and work on Mesa's software rasterizers.
+class Profiler
+{
+public:
+    static const int FRAMES_IN_FLIGHT = 4;
+
+    static Profiler& instance()
+    {
+        static Profiler profiler;
+        return profiler;
+    }
+    // must be called with a current GL context, scopes are no-ops until then
+    // ------------------------------------------------------------------------
+    void enable()
+    {
+        enabled = true;
+        epoch = std::chrono::steady_clock::now();
+        // line the GPU clock up with the CPU one so both tracks share a timeline
+        GLint64 gpuNow = 0;
+        glGetInteger64v(GL_TIMESTAMP, &gpuNow);
+        gpuOffsetNs = (double)gpuNow;
+    }
+    bool isEnabled() const { return enabled; }
+    // delete the queries while the context is still current, the singleton outlives it;
+    // scopes are no-ops again afterwards
+    // ------------------------------------------------------------------------
+    void release()
+    {
+        for (FrameSlot& slot : slots)
+        {
+            if (!slot.queries.empty())
+                glDeleteQueries((GLsizei)slot.queries.size(), slot.queries.data());
+            slot.queries.clear();
+            slot.used = 0;
+            slot.scopes.clear();
+            slot.open.clear();
+        }
+        enabled = false;
+    }
+    // ------------------------------------------------------------------------
+    void beginFrame()
+    {
+        if (!enabled)
+            return;
+        FrameSlot& slot = slots[frame % FRAMES_IN_FLIGHT];
+        resolve(slot);
+        slot.used = 0;
+        slot.scopes.clear();
+    }
+    void endFrame()
+    {
+        if (!enabled)
+            return;
+        frame++;
+    }
+    // ------------------------------------------------------------------------
+    void beginGpu(const char* name)
+    {
+        if (!enabled)
+            return;
+        FrameSlot& slot = slots[frame % FRAMES_IN_FLIGHT];
+        GpuScopeRecord record;
+        record.name = name;
+        record.begin = query(slot);
+        record.end = 0;
+        glQueryCounter(record.begin, GL_TIMESTAMP);
+        slot.open.push_back(slot.scopes.size());
+        slot.scopes.push_back(record);
+    }
+    void endGpu()
+    {
+        if (!enabled)
+            return;
+        FrameSlot& slot = slots[frame % FRAMES_IN_FLIGHT];
+        GpuScopeRecord& record = slot.scopes[slot.open.back()];
+        slot.open.pop_back();
+        record.end = query(slot);
+        glQueryCounter(record.end, GL_TIMESTAMP);
+    }
+    // ------------------------------------------------------------------------
+    double cpuNowUs() const
+    {
+        return std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - epoch).count();
+    }
+    void addCpu(const char* name, double startUs, double endUs)
+    {
+        if (enabled)
+            record(name, false, startUs, endUs - startUs);
+    }
+    // collect outstanding frames, then write every event in Chrome's trace event format
+    // ------------------------------------------------------------------------
+    bool writeChromeTrace(const char* path)
+    {
+        flush();
+        FILE* f = fopen(path, "w");
+        if (!f)
+        {
+            std::cout << "Failed to write profile trace: " << path << std::endl;
+            return false;
+        }
+        fprintf(f, "{\"traceEvents\":[\n");
+        fprintf(f, "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":1,\"args\":{\"name\":\"CPU\"}},\n");
+        fprintf(f, "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":2,\"args\":{\"name\":\"GPU\"}}");
+        for (const Event& e : events)
+            fprintf(f, ",\n{\"name\":\"%s\",\"cat\":\"%s\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,\"pid\":1,\"tid\":%d}",
+                e.name, e.gpu ? "gpu" : "cpu", e.startUs, e.durationUs, e.gpu ? 2 : 1);
+        fprintf(f, "\n]}\n");
+        fclose(f);
+        return true;
+    }
+    // average time per frame of every scope
+    // ------------------------------------------------------------------------
+    void report(std::ostream& out)
+    {
+        flush();
+        if (!frame)
+            return;
+        std::map<std::string, double> totals[2];
+        for (const Event& e : events)
+            totals[e.gpu][e.name] += e.durationUs;
+        for (int gpu = 0; gpu < 2; gpu++)
+            for (const auto& entry : totals[gpu])
+                out << (gpu ? "gpu " : "cpu ") << entry.first << ": " << entry.second / 1000.0 / frame << " ms per frame" << std::endl;
+    }
+
+private:
+    struct GpuScopeRecord
+    {
+        const char* name;
+        GLuint begin, end;
+    };
+    struct FrameSlot
+    {
+        std::vector<GLuint> queries;
+        size_t used = 0;
+        std::vector<GpuScopeRecord> scopes;
+        std::vector<size_t> open;
+    };
+    struct Event
+    {
+        const char* name;
+        bool gpu;
+        double startUs, durationUs;
+    };
+    // keeps long runs from growing without bound
+    static const size_t MAX_EVENTS = 1000000;
+
+    bool enabled = false;
+    unsigned long long frame = 0;
+    FrameSlot slots[FRAMES_IN_FLIGHT];
+    std::vector<Event> events;
+    std::chrono::steady_clock::time_point epoch;
+    double gpuOffsetNs = 0.0;
+
+    GLuint query(FrameSlot& slot)
+    {
+        if (slot.used == slot.queries.size())
+        {
+            GLuint q;
+            glGenQueries(1, &q);
+            slot.queries.push_back(q);
+        }
+        return slot.queries[slot.used++];
+    }
+    // ------------------------------------------------------------------------
+    void resolve(FrameSlot& slot)
+    {
+        for (const GpuScopeRecord& scope : slot.scopes)
+        {
+            if (!scope.end)
+                continue;
+            GLuint64 begin = 0, end = 0;
+            glGetQueryObjectui64v(scope.begin, GL_QUERY_RESULT, &begin);
+            glGetQueryObjectui64v(scope.end, GL_QUERY_RESULT, &end);
+            record(scope.name, true, ((double)begin - gpuOffsetNs) / 1000.0, ((double)end - (double)begin) / 1000.0);
+        }
+        slot.scopes.clear();
+        slot.open.clear();
+    }
+    void flush()
+    {
+        for (FrameSlot& slot : slots)
+            resolve(slot);
+    }
+    void record(const char* name, bool gpu, double startUs, double durationUs)
+    {
+        if (events.size() < MAX_EVENTS)
+            events.push_back(Event{ name, gpu, startUs, durationUs });
+    }
+};
+
+// ------------------------------------------------------------------------
+struct GpuProfileScope
+{
+    explicit GpuProfileScope(const char* name) { Profiler::instance().beginGpu(name); }
+    ~GpuProfileScope() { Profiler::instance().endGpu(); }
+};
+struct CpuProfileScope
+{
+    const char* name;
+    double start;
+    explicit CpuProfileScope(const char* scopeName)
+        : name(scopeName), start(Profiler::instance().isEnabled() ? Profiler::instance().cpuNowUs() : 0.0)
+    {
+    }
+    ~CpuProfileScope()
+    {
+        Profiler& profiler = Profiler::instance();
+        if (profiler.isEnabled())
+            profiler.addCpu(name, start, profiler.cpuNowUs());
+    }
+};
+
+#define PROFILE_CONCAT_INNER(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_INNER(a, b)
+// names must be string literals (or otherwise outlive the profiler)
+#define PROFILE_GPU(name) GpuProfileScope PROFILE_CONCAT(gpuProfileScope, __LINE__)(name)
+#define PROFILE_CPU(name) CpuProfileScope PROFILE_CONCAT(cpuProfileScope, __LINE__)(name)
+#endif
@@ -0,0 +1,136 @@
+#pragma once
+#ifndef PROGRAM_CACHE_H
+#define PROGRAM_CACHE_H
+
+#include <glad/glad.h>
+
+#include <cstdint>
+#include <cstdio>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+// On-disk cache of linked program binaries (GL_ARB_get_program_binary). Entries are keyed by
+// a hash of the shader sources and the driver's vendor/renderer/version strings, so a driver
+// update or an edited shader simply misses and the caller compiles from source again.
+//
+// file layout: magic "GLPB", format version, 64 bit key, binary format, length, binary bytes
+class ProgramCache
+{
+public:
+    // empty disables the cache
+    static inline std::string directory;
+    static inline unsigned int hits = 0, misses = 0, stores = 0;
+
+    static bool available()
+    {
+        if (directory.empty() || !GLAD_GL_ARB_get_program_binary)
+            return false;
+        GLint formats = 0;
+        glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+        return formats > 0;
+    }
+    // ------------------------------------------------------------------------
+    static uint64_t key(const std::string& vertexCode, const std::string& fragmentCode)
+    {
+        uint64_t h = 14695981039346656037ull;
+        auto mix = [&h](const char* text)
+        {
+            for (const char* c = text ? text : ""; *c; c++)
+                h = (h ^ (unsigned char)*c) * 1099511628211ull;
+            // separator so "ab"+"c" and "a"+"bc" differ
+            h = (h ^ 0xFF) * 1099511628211ull;
+        };
+        mix(vertexCode.c_str());
+        mix(fragmentCode.c_str());
+        mix((const char*)glGetString(GL_VENDOR));
+        mix((const char*)glGetString(GL_RENDERER));
+        mix((const char*)glGetString(GL_VERSION));
+        return h;
+    }
+    // restore a cached binary into program, false if missing or rejected by the driver
+    // ------------------------------------------------------------------------
+    static bool load(GLuint program, uint64_t programKey)
+    {
+        FILE* f = fopen(path(programKey).c_str(), "rb");
+        if (!f)
+        {
+            misses++;
+            return false;
+        }
+        Header header;
+        std::vector<char> binary;
+        bool ok = fread(&header, sizeof(header), 1, f) == 1 && header.magic == MAGIC &&
+            header.version == VERSION && header.key == programKey;
+        if (ok)
+        {
+            binary.resize(header.length);
+            ok = fread(binary.data(), 1, binary.size(), f) == binary.size();
+        }
+        fclose(f);
+        GLint linked = GL_FALSE;
+        if (ok)
+        {
+            glProgramBinary(program, header.format, binary.data(), (GLsizei)binary.size());
+            glGetProgramiv(program, GL_LINK_STATUS, &linked);
+        }
+        if (linked)
+            hits++;
+        else
+            misses++;
+        return linked == GL_TRUE;
+    }
+    // write the binary of a freshly linked program
+    // ------------------------------------------------------------------------
+    static void store(GLuint program, uint64_t programKey)
+    {
+        GLint length = 0;
+        glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+        if (length <= 0)
+            return;
+        std::vector<char> binary(length);
+        Header header = { MAGIC, VERSION, programKey, 0, 0 };
+        GLsizei written = 0;
+        glGetProgramBinary(program, length, &written, &header.format, binary.data());
+        header.length = (uint32_t)written;
+
+        std::error_code error;
+        std::filesystem::create_directories(directory, error);
+        // write to a temporary name first so a crash never leaves a truncated entry
+        std::string target = path(programKey), temporary = target + ".tmp";
+        FILE* f = fopen(temporary.c_str(), "wb");
+        if (!f)
+            return;
+        bool ok = fwrite(&header, sizeof(header), 1, f) == 1 && fwrite(binary.data(), 1, written, f) == (size_t)written;
+        fclose(f);
+        if (ok)
+        {
+            std::filesystem::rename(temporary, target, error);
+            stores += error ? 0 : 1;
+        }
+        else
+        {
+            std::filesystem::remove(temporary, error);
+        }
+    }
+
+private:
+    struct Header
+    {
+        uint32_t magic;
+        uint32_t version;
+        uint64_t key;
+        GLenum format;
+        uint32_t length;
+    };
+    static const uint32_t MAGIC = 0x42504C47; // "GLPB"
+    static const uint32_t VERSION = 1;
+
+    static std::string path(uint64_t programKey)
+    {
+        char name[32];
+        snprintf(name, sizeof(name), "%016llx.bin", (unsigned long long)programKey);
+        return directory + "/" + name;
+    }
+};
+#endif
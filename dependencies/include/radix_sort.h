@@ -0,0 +1,112 @@
+#pragma once
+#ifndef RADIX_SORT_H
+#define RADIX_SORT_H
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <thread>
+#include <vector>
+
+// map a float to an unsigned int that sorts in the same order: positive floats get the sign
+// bit set, negative floats are inverted so larger magnitudes come first
+inline uint32_t floatToSortableKey(float value)
+{
+    uint32_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    uint32_t mask = (uint32_t)((int32_t)bits >> 31) | 0x80000000u;
+    return bits ^ mask;
+}
+
+// Stable least significant digit radix sort of 32 bit keys with a 32 bit payload, four passes
+// of 8 bits. Passes where every key has the same digit are skipped, which is common for depth
+// keys since nearby floats share their exponent. With more than one thread each pass splits the
+// array into one block per thread: every block builds its own histogram, offsets are assigned
+// digit by digit across blocks in order, and the blocks scatter in parallel, so the result is
+// identical to the single threaded sort.
+class RadixSorter
+{
+public:
+    static const int RADIX_BITS = 8;
+    static const int BUCKETS = 1 << RADIX_BITS;
+    // below this many keys the thread start up costs more than it saves
+    static const size_t MIN_KEYS_PER_THREAD = 32768;
+
+    // sort keys ascending and apply the same permutation to values
+    // ------------------------------------------------------------------------
+    void sort(std::vector<uint32_t>& keys, std::vector<uint32_t>& values, int threads = 1)
+    {
+        size_t n = keys.size();
+        int blocks = (int)std::max<size_t>(1, std::min<size_t>((size_t)std::max(threads, 1), n / MIN_KEYS_PER_THREAD));
+        keyScratch.resize(n);
+        valueScratch.resize(n);
+        histograms.assign((size_t)blocks * BUCKETS, 0);
+
+        for (int shift = 0; shift < 32; shift += RADIX_BITS)
+        {
+            const uint32_t* keysIn = keys.data();
+            const uint32_t* valuesIn = values.data();
+            uint32_t* keysOut = keyScratch.data();
+            uint32_t* valuesOut = valueScratch.data();
+
+            parallel(blocks, [&](int block)
+            {
+                size_t* histogram = &histograms[(size_t)block * BUCKETS];
+                std::fill(histogram, histogram + BUCKETS, 0);
+                for (size_t i = blockBegin(block, blocks, n); i < blockBegin(block + 1, blocks, n); i++)
+                    histogram[(keysIn[i] >> shift) & (BUCKETS - 1)]++;
+            });
+            // exclusive prefix sum, digit major then block, which keeps the sort stable
+            size_t offset = 0;
+            bool trivial = false;
+            for (int digit = 0; digit < BUCKETS && !trivial; digit++)
+            {
+                size_t digitTotal = 0;
+                for (int block = 0; block < blocks; block++)
+                {
+                    size_t& slot = histograms[(size_t)block * BUCKETS + digit];
+                    size_t count = slot;
+                    slot = offset;
+                    offset += count;
+                    digitTotal += count;
+                }
+                trivial = digitTotal == n;
+            }
+            if (trivial)
+                continue;
+            parallel(blocks, [&](int block)
+            {
+                size_t* next = &histograms[(size_t)block * BUCKETS];
+                for (size_t i = blockBegin(block, blocks, n); i < blockBegin(block + 1, blocks, n); i++)
+                {
+                    size_t destination = next[(keysIn[i] >> shift) & (BUCKETS - 1)]++;
+                    keysOut[destination] = keysIn[i];
+                    valuesOut[destination] = valuesIn[i];
+                }
+            });
+            keys.swap(keyScratch);
+            values.swap(valueScratch);
+        }
+    }
+
+private:
+    std::vector<uint32_t> keyScratch, valueScratch;
+    std::vector<size_t> histograms;
+
+    static size_t blockBegin(int block, int blocks, size_t n)
+    {
+        return n * (size_t)block / (size_t)blocks;
+    }
+    // run function(0 .. count - 1), the calling thread takes block 0
+    template <typename Function>
+    static void parallel(int count, const Function& function)
+    {
+        std::vector<std::thread> workers;
+        for (int i = 1; i < count; i++)
+            workers.emplace_back(function, i);
+        function(0);
+        for (std::thread& worker : workers)
+            worker.join();
+    }
+};
+#endif
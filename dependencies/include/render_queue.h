@@ -0,0 +1,192 @@
+#pragma once
+#ifndef RENDER_QUEUE_H
+#define RENDER_QUEUE_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <radix_sort.h>
+
+#include <cstdint>
+#include <vector>
+
+// Shadow copy of the bindings the command bucket touches. Each bind is only passed on to GL
+// when it changes the bound object; with enabled = false every bind is issued, which is what
+// hand written draw loops end up doing. Code outside the bucket binds GL state directly, so the
+// shadow is reset at the start of every submit.
+class GLStateCache
+{
+public:
+    static const int TEXTURE_UNITS = 16;
+
+    explicit GLStateCache(bool enabled = true) : enabled(enabled)
+    {
+        reset();
+    }
+    // forget everything, the next bind of each kind always reaches GL
+    // ------------------------------------------------------------------------
+    void reset()
+    {
+        program = UNKNOWN;
+        vao = UNKNOWN;
+        activeUnit = UNKNOWN;
+        for (GLuint& texture : textures)
+            texture = UNKNOWN;
+    }
+    // ------------------------------------------------------------------------
+    bool useProgram(GLuint id)
+    {
+        if (enabled && program == id)
+            return skip();
+        program = id;
+        glUseProgram(id);
+        return issue();
+    }
+    bool bindVertexArray(GLuint id)
+    {
+        if (enabled && vao == id)
+            return skip();
+        vao = id;
+        glBindVertexArray(id);
+        return issue();
+    }
+    bool bindTexture2D(GLuint unit, GLuint id)
+    {
+        if (enabled && textures[unit] == id)
+            return skip();
+        if (!enabled || activeUnit != unit)
+        {
+            activeUnit = unit;
+            glActiveTexture(GL_TEXTURE0 + unit);
+            issue();
+        }
+        textures[unit] = id;
+        glBindTexture(GL_TEXTURE_2D, id);
+        return issue();
+    }
+    // GL calls made and redundant ones skipped since the counters were last cleared
+    unsigned long long issued = 0, skipped = 0;
+
+private:
+    static const GLuint UNKNOWN = 0xFFFFFFFFu;
+    bool enabled;
+    GLuint program, vao, activeUnit;
+    GLuint textures[TEXTURE_UNITS];
+
+    bool issue()
+    {
+        issued++;
+        return true;
+    }
+    bool skip()
+    {
+        skipped++;
+        return false;
+    }
+};
+
+// one indexed draw with the state it needs, GL_UNSIGNED_SHORT indices from the bound VAO's EBO
+struct DrawCommand
+{
+    GLuint program;
+    GLuint texture;
+    GLuint vao;
+    GLsizei indexCount;
+    GLint modelLocation;
+    GLint colorLocation;
+    glm::mat4 model;
+    glm::vec3 color;
+};
+
+enum RenderPass
+{
+    PASS_OPAQUE = 0,
+    PASS_TRANSPARENT = 1
+};
+
+// 64 bit sort key, most significant field first:
+//     opaque       pass 4 | program 12 | texture 16 | vao 12 | depth 20   (state, then front to back)
+//     transparent  pass 4 | depth 20 (inverted) | program 12 | texture 16 | vao 12   (back to front)
+// GL object names are truncated to their field; a collision only weakens the grouping, the
+// command still carries the full names. depth is the distance from the camera over farPlane.
+// ------------------------------------------------------------------------
+inline uint64_t drawSortKey(RenderPass pass, GLuint program, GLuint texture, GLuint vao, float depth, float farPlane)
+{
+    float normalized = glm::clamp(depth / farPlane, 0.0f, 1.0f);
+    uint64_t depthBits = (uint64_t)(normalized * 0xFFFFF);
+    uint64_t state = ((uint64_t)(program & 0xFFF) << 28) | ((uint64_t)(texture & 0xFFFF) << 12) | (vao & 0xFFF);
+    if (pass == PASS_TRANSPARENT)
+        return ((uint64_t)pass << 60) | ((0xFFFFF - depthBits) << 40) | state;
+    return ((uint64_t)pass << 60) | (state << 20) | depthBits;
+}
+
+// Draws are collected in any order with a sort key, sorted once per frame and replayed through
+// a GLStateCache so consecutive draws sharing a program, texture or VAO bind it once.
+class CommandBucket
+{
+public:
+    void clear()
+    {
+        keys.clear();
+        commands.clear();
+        order.clear();
+    }
+    void add(uint64_t key, const DrawCommand& command)
+    {
+        order.push_back((uint32_t)commands.size());
+        keys.push_back(key);
+        commands.push_back(command);
+    }
+    // order the commands by key: two stable radix sorts, low 32 bits then high 32 bits
+    // ------------------------------------------------------------------------
+    void sort(int threads = 1)
+    {
+        sortKeys.resize(order.size());
+        for (size_t i = 0; i < order.size(); i++)
+            sortKeys[i] = (uint32_t)keys[order[i]];
+        sorter.sort(sortKeys, order, threads);
+        for (size_t i = 0; i < order.size(); i++)
+            sortKeys[i] = (uint32_t)(keys[order[i]] >> 32);
+        sorter.sort(sortKeys, order, threads);
+    }
+    // issue every command in the current order, returns the number of draws
+    // ------------------------------------------------------------------------
+    size_t submit(GLStateCache& state)
+    {
+        state.reset();
+        const DrawCommand* previous = NULL;
+        for (uint32_t index : order)
+        {
+            const DrawCommand& command = commands[index];
+            bool programChanged = state.useProgram(command.program);
+            if (command.texture)
+                state.bindTexture2D(0, command.texture);
+            state.bindVertexArray(command.vao);
+            // uniforms belong to the program, the colour only needs setting when it differs
+            bool sameColor = previous && !programChanged && previous->color == command.color;
+            if (command.colorLocation >= 0 && !sameColor)
+            {
+                glUniform3fv(command.colorLocation, 1, &command.color[0]);
+                uniformCalls++;
+            }
+            glUniformMatrix4fv(command.modelLocation, 1, GL_FALSE, &command.model[0][0]);
+            uniformCalls++;
+            glDrawElements(GL_TRIANGLES, command.indexCount, GL_UNSIGNED_SHORT, (void*)0);
+            drawCalls++;
+            previous = &command;
+        }
+        return order.size();
+    }
+    size_t size() const
+    {
+        return commands.size();
+    }
+    // uniform and draw calls issued by submit() since construction
+    unsigned long long uniformCalls = 0, drawCalls = 0;
+
+private:
+    std::vector<uint64_t> keys;
+    std::vector<DrawCommand> commands;
+    std::vector<uint32_t> order, sortKeys;
+    RadixSorter sorter;
+};
+#endif
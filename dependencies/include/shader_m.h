@@ -4,16 +4,28 @@
 
 #include <glad/glad.h>
 #include <glm/glm.hpp>
+#include <program_cache.h>
 
 #include <string>
+#include <vector>
 #include <fstream>
 #include <sstream>
 #include <iostream>
+#include <thread>
+
+// resolved uniform location, fetch once with Shader::uniform() and reuse every frame
+struct UniformHandle
+{
+    GLint location = -1;
+    bool valid() const { return location >= 0; }
+};
 
 class Shader
 {
 public:
     unsigned int ID;
+    // number of glGetUniformLocation calls made by all shaders, reset by the caller each frame
+    static inline unsigned int driverUniformLookups = 0;
     // constructor generates the shader on the fly
     // ------------------------------------------------------------------------
     Shader(const char* vertexPath, const char* fragmentPath)
@@ -21,55 +33,16 @@ public:
         // 1. retrieve the vertex/fragment source code from filePath
         std::string vertexCode;
         std::string fragmentCode;
-        std::ifstream vShaderFile;
-        std::ifstream fShaderFile;
-        // ensure ifstream objects can throw exceptions:
-        vShaderFile.exceptions(std::ifstream::failbit | std::ifstream::badbit);
-        fShaderFile.exceptions(std::ifstream::failbit | std::ifstream::badbit);
-        try
-        {
-            // open files
-            vShaderFile.open(vertexPath);
-            fShaderFile.open(fragmentPath);
-            std::stringstream vShaderStream, fShaderStream;
-            // read file's buffer contents into streams
-            vShaderStream << vShaderFile.rdbuf();
-            fShaderStream << fShaderFile.rdbuf();
-            // close file handlers
-            vShaderFile.close();
-            fShaderFile.close();
-            // convert stream into string
-            vertexCode = vShaderStream.str();
-            fragmentCode = fShaderStream.str();
-        }
-        catch (std::ifstream::failure& e)
-        {
-            std::cout << "ERROR::SHADER::FILE_NOT_SUCCESSFULLY_READ: " << e.what() << std::endl;
-        }
-        const char* vShaderCode = vertexCode.c_str();
-        const char* fShaderCode = fragmentCode.c_str();
-        // 2. compile shaders
-        unsigned int vertex, fragment;
-        // vertex shader
-        vertex = glCreateShader(GL_VERTEX_SHADER);
-        glShaderSource(vertex, 1, &vShaderCode, NULL);
-        glCompileShader(vertex);
-        checkCompileErrors(vertex, "VERTEX");
-        // fragment Shader
-        fragment = glCreateShader(GL_FRAGMENT_SHADER);
-        glShaderSource(fragment, 1, &fShaderCode, NULL);
-        glCompileShader(fragment);
-        checkCompileErrors(fragment, "FRAGMENT");
-        // shader Program
-        ID = glCreateProgram();
-        glAttachShader(ID, vertex);
-        glAttachShader(ID, fragment);
-        glLinkProgram(ID);
-        checkCompileErrors(ID, "PROGRAM");
-        // delete the shaders as they're linked into our program now and no longer necessary
-        glDeleteShader(vertex);
-        glDeleteShader(fragment);
-
+        readFiles(vertexPath, fragmentPath, vertexCode, fragmentCode);
+        complete(submit(vertexCode, fragmentCode));
+    }
+    // build from source text instead of files
+    // ------------------------------------------------------------------------
+    static Shader fromSource(const std::string& vertexCode, const std::string& fragmentCode)
+    {
+        Shader shader;
+        shader.complete(shader.submit(vertexCode, fragmentCode));
+        return shader;
     }
     // activate the shader
     // ------------------------------------------------------------------------
@@ -77,69 +50,289 @@ public:
     {
         glUseProgram(ID);
     }
+    // look up a uniform once, the returned handle skips hashing and driver queries
+    // ------------------------------------------------------------------------
+    UniformHandle uniform(const std::string& name) const
+    {
+        return UniformHandle{ location(name) };
+    }
     // utility uniform functions
     // ------------------------------------------------------------------------
     void setBool(const std::string& name, bool value) const
     {
-        glUniform1i(glGetUniformLocation(ID, name.c_str()), (int)value);
+        glUniform1i(location(name), (int)value);
     }
     // ------------------------------------------------------------------------
     void setInt(const std::string& name, int value) const
     {
-        glUniform1i(glGetUniformLocation(ID, name.c_str()), value);
+        glUniform1i(location(name), value);
     }
     // ------------------------------------------------------------------------
     void setFloat(const std::string& name, float value) const
     {
-        glUniform1f(glGetUniformLocation(ID, name.c_str()), value);
+        glUniform1f(location(name), value);
     }
     // ------------------------------------------------------------------------
     void setVec2(const std::string& name, const glm::vec2& value) const
     {
-        glUniform2fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]);
+        glUniform2fv(location(name), 1, &value[0]);
     }
     void setVec2(const std::string& name, float x, float y) const
     {
-        glUniform2f(glGetUniformLocation(ID, name.c_str()), x, y);
+        glUniform2f(location(name), x, y);
     }
     // ------------------------------------------------------------------------
     void setVec3(const std::string& name, const glm::vec3& value) const
     {
-        glUniform3fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]);
+        glUniform3fv(location(name), 1, &value[0]);
     }
     void setVec3(const std::string& name, float x, float y, float z) const
     {
-        glUniform3f(glGetUniformLocation(ID, name.c_str()), x, y, z);
+        glUniform3f(location(name), x, y, z);
     }
     // ------------------------------------------------------------------------
     void setVec4(const std::string& name, const glm::vec4& value) const
     {
-        glUniform4fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]);
+        glUniform4fv(location(name), 1, &value[0]);
     }
     void setVec4(const std::string& name, float x, float y, float z, float w) const
     {
-        glUniform4f(glGetUniformLocation(ID, name.c_str()), x, y, z, w);
+        glUniform4f(location(name), x, y, z, w);
     }
     // ------------------------------------------------------------------------
     void setMat2(const std::string& name, const glm::mat2& mat) const
     {
-        glUniformMatrix2fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+        glUniformMatrix2fv(location(name), 1, GL_FALSE, &mat[0][0]);
     }
     // ------------------------------------------------------------------------
     void setMat3(const std::string& name, const glm::mat3& mat) const
     {
-        glUniformMatrix3fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+        glUniformMatrix3fv(location(name), 1, GL_FALSE, &mat[0][0]);
     }
     // ------------------------------------------------------------------------
     void setMat4(const std::string& name, const glm::mat4& mat) const
     {
-        glUniformMatrix4fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+        glUniformMatrix4fv(location(name), 1, GL_FALSE, &mat[0][0]);
     }
 
+    // handle based setters for the hot path
+    // ------------------------------------------------------------------------
+    void setBool(UniformHandle h, bool value) const { glUniform1i(h.location, (int)value); }
+    void setInt(UniformHandle h, int value) const { glUniform1i(h.location, value); }
+    void setFloat(UniformHandle h, float value) const { glUniform1f(h.location, value); }
+    void setVec2(UniformHandle h, const glm::vec2& value) const { glUniform2fv(h.location, 1, &value[0]); }
+    void setVec2(UniformHandle h, float x, float y) const { glUniform2f(h.location, x, y); }
+    void setVec3(UniformHandle h, const glm::vec3& value) const { glUniform3fv(h.location, 1, &value[0]); }
+    void setVec3(UniformHandle h, float x, float y, float z) const { glUniform3f(h.location, x, y, z); }
+    void setVec4(UniformHandle h, const glm::vec4& value) const { glUniform4fv(h.location, 1, &value[0]); }
+    void setVec4(UniformHandle h, float x, float y, float z, float w) const { glUniform4f(h.location, x, y, z, w); }
+    void setMat2(UniformHandle h, const glm::mat2& mat) const { glUniformMatrix2fv(h.location, 1, GL_FALSE, &mat[0][0]); }
+    void setMat3(UniformHandle h, const glm::mat3& mat) const { glUniformMatrix3fv(h.location, 1, GL_FALSE, &mat[0][0]); }
+    void setMat4(UniformHandle h, const glm::mat4& mat) const { glUniformMatrix4fv(h.location, 1, GL_FALSE, &mat[0][0]); }
+
 private:
+    friend class ShaderBatch;
+
+    Shader() : ID(0) {}
+
+    // open addressed name -> location table, filled from glGetActiveUniform after linking
+    struct UniformSlot
+    {
+        unsigned int hash = 0;
+        GLint location = -1;
+        std::string name;
+    };
+    mutable std::vector<UniformSlot> uniformTable;
+    mutable unsigned int uniformCount = 0;
+
+    static unsigned int hashName(const std::string& name)
+    {
+        // FNV-1a
+        unsigned int h = 2166136261u;
+        for (char c : name)
+            h = (h ^ (unsigned char)c) * 16777619u;
+        return h ? h : 1u;
+    }
+    // ------------------------------------------------------------------------
+    void insertUniform(const std::string& name, GLint loc) const
+    {
+        // keep load factor under one half
+        if ((uniformCount + 1) * 2 > uniformTable.size())
+        {
+            std::vector<UniformSlot> old;
+            old.swap(uniformTable);
+            uniformTable.resize(old.empty() ? 16 : old.size() * 2);
+            uniformCount = 0;
+            for (UniformSlot& slot : old)
+                if (slot.hash)
+                    insertUniform(slot.name, slot.location);
+        }
+        unsigned int h = hashName(name);
+        size_t mask = uniformTable.size() - 1;
+        for (size_t i = h & mask;; i = (i + 1) & mask)
+        {
+            UniformSlot& slot = uniformTable[i];
+            if (!slot.hash)
+            {
+                slot.hash = h;
+                slot.location = loc;
+                slot.name = name;
+                uniformCount++;
+                return;
+            }
+            if (slot.hash == h && slot.name == name)
+            {
+                slot.location = loc;
+                return;
+            }
+        }
+    }
+    // ------------------------------------------------------------------------
+    GLint location(const std::string& name) const
+    {
+        if (!uniformTable.empty())
+        {
+            unsigned int h = hashName(name);
+            size_t mask = uniformTable.size() - 1;
+            for (size_t i = h & mask; uniformTable[i].hash; i = (i + 1) & mask)
+                if (uniformTable[i].hash == h && uniformTable[i].name == name)
+                    return uniformTable[i].location;
+        }
+        // not reflected (e.g. an array element past [0]), ask the driver once and remember it
+        driverUniformLookups++;
+        GLint loc = glGetUniformLocation(ID, name.c_str());
+        insertUniform(name, loc);
+        return loc;
+    }
+    // ------------------------------------------------------------------------
+    void reflectUniforms()
+    {
+        GLint count = 0, maxLength = 0;
+        glGetProgramiv(ID, GL_ACTIVE_UNIFORMS, &count);
+        glGetProgramiv(ID, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxLength);
+        std::vector<GLchar> buffer(maxLength > 0 ? maxLength : 1);
+        for (GLint i = 0; i < count; i++)
+        {
+            GLsizei length = 0;
+            GLint size = 0;
+            GLenum type = 0;
+            glGetActiveUniform(ID, (GLuint)i, (GLsizei)buffer.size(), &length, &size, &type, buffer.data());
+            std::string name(buffer.data(), length);
+            driverUniformLookups++;
+            GLint loc = glGetUniformLocation(ID, name.c_str());
+            // uniforms inside blocks have no location
+            if (loc < 0)
+                continue;
+            insertUniform(name, loc);
+            // arrays are reported as "name[0]", make the bare name resolve too
+            if (name.size() > 3 && name.compare(name.size() - 3, 3, "[0]") == 0)
+                insertUniform(name.substr(0, name.size() - 3), loc);
+        }
+    }
+    // ------------------------------------------------------------------------
+    static void readFiles(const char* vertexPath, const char* fragmentPath, std::string& vertexCode, std::string& fragmentCode)
+    {
+        std::ifstream vShaderFile;
+        std::ifstream fShaderFile;
+        // ensure ifstream objects can throw exceptions:
+        vShaderFile.exceptions(std::ifstream::failbit | std::ifstream::badbit);
+        fShaderFile.exceptions(std::ifstream::failbit | std::ifstream::badbit);
+        try
+        {
+            // open files
+            vShaderFile.open(vertexPath);
+            fShaderFile.open(fragmentPath);
+            std::stringstream vShaderStream, fShaderStream;
+            // read file's buffer contents into streams
+            vShaderStream << vShaderFile.rdbuf();
+            fShaderStream << fShaderFile.rdbuf();
+            // close file handlers
+            vShaderFile.close();
+            fShaderFile.close();
+            // convert stream into string
+            vertexCode = vShaderStream.str();
+            fragmentCode = fShaderStream.str();
+        }
+        catch (std::ifstream::failure& e)
+        {
+            std::cout << "ERROR::SHADER::FILE_NOT_SUCCESSFULLY_READ: " << e.what() << std::endl;
+        }
+    }
+    // shaders of a program whose compile and link were issued but not yet checked
+    struct PendingProgram
+    {
+        unsigned int vertex = 0, fragment = 0;
+        uint64_t cacheKey = 0;
+        bool store = false;
+    };
+    // issue compile and link without asking for any status, or restore the program from the
+    // binary cache. Nothing here waits on the driver, so many programs can be in flight at once.
+    // ------------------------------------------------------------------------
+    PendingProgram submit(const std::string& vertexCode, const std::string& fragmentCode)
+    {
+        PendingProgram pending;
+        // 2. restore a cached program binary when the sources and driver match
+        ID = glCreateProgram();
+        bool cached = ProgramCache::available();
+        pending.cacheKey = cached ? ProgramCache::key(vertexCode, fragmentCode) : 0;
+        if (cached && ProgramCache::load(ID, pending.cacheKey))
+            return pending;
+        // a rejected binary can leave the program in a failed state, start from a fresh one
+        if (cached)
+        {
+            glDeleteProgram(ID);
+            ID = glCreateProgram();
+            glProgramParameteri(ID, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+            pending.store = true;
+        }
+        const char* vShaderCode = vertexCode.c_str();
+        const char* fShaderCode = fragmentCode.c_str();
+        // 3. compile shaders
+        // vertex shader
+        pending.vertex = glCreateShader(GL_VERTEX_SHADER);
+        glShaderSource(pending.vertex, 1, &vShaderCode, NULL);
+        glCompileShader(pending.vertex);
+        // fragment Shader
+        pending.fragment = glCreateShader(GL_FRAGMENT_SHADER);
+        glShaderSource(pending.fragment, 1, &fShaderCode, NULL);
+        glCompileShader(pending.fragment);
+        // shader Program
+        glAttachShader(ID, pending.vertex);
+        glAttachShader(ID, pending.fragment);
+        glLinkProgram(ID);
+        return pending;
+    }
+    // true once the driver has finished linking, without blocking (GL_COMPLETION_STATUS_KHR)
+    // ------------------------------------------------------------------------
+    bool linkFinished() const
+    {
+        if (!GLAD_GL_KHR_parallel_shader_compile && !GLAD_GL_ARB_parallel_shader_compile)
+            return true;
+        GLint done = GL_TRUE;
+        glGetProgramiv(ID, GL_COMPLETION_STATUS_KHR, &done);
+        return done == GL_TRUE;
+    }
+    // check status and logs of a submitted program, store its binary and reflect its uniforms
+    // ------------------------------------------------------------------------
+    void complete(const PendingProgram& pending)
+    {
+        if (pending.vertex)
+        {
+            checkCompileErrors(pending.vertex, "VERTEX");
+            checkCompileErrors(pending.fragment, "FRAGMENT");
+            bool linked = checkCompileErrors(ID, "PROGRAM");
+            if (linked && pending.store)
+                ProgramCache::store(ID, pending.cacheKey);
+            // delete the shaders as they're linked into our program now and no longer necessary
+            glDeleteShader(pending.vertex);
+            glDeleteShader(pending.fragment);
+        }
+        // 4. reflect every active uniform into the location table
+        reflectUniforms();
+    }
     // utility function for checking shader compilation/linking errors.
     // ------------------------------------------------------------------------
-    void checkCompileErrors(GLuint shader, std::string type)
+    bool checkCompileErrors(GLuint shader, std::string type)
     {
         GLint success;
         GLchar infoLog[1024];
@@ -161,6 +354,82 @@ private:
                 std::cout << "ERROR::PROGRAM_LINKING_ERROR of type: " << type << "\n" << infoLog << "\n -- --------------------------------------------------- -- " << std::endl;
             }
         }
+        return success == GL_TRUE;
     }
 };
+
+// Builds many programs at once. add() only issues the compile and link calls, finish() then
+// waits for all of them, so drivers with KHR/ARB_parallel_shader_compile compile on their own
+// threads while later programs are still being submitted. Without the extension the status
+// queries in finish() block one program at a time, as the Shader constructor does.
+//
+//     ShaderBatch batch;
+//     batch.add("a.vs", "a.fs");
+//     batch.add("b.vs", "b.fs");
+//     std::vector<Shader> shaders = batch.finish();
+class ShaderBatch
+{
+public:
+    ShaderBatch()
+    {
+        // let the driver pick how many compiler threads to use
+        if (GLAD_GL_KHR_parallel_shader_compile)
+            glMaxShaderCompilerThreadsKHR(0xFFFFFFFFu);
+        else if (GLAD_GL_ARB_parallel_shader_compile)
+            glMaxShaderCompilerThreadsARB(0xFFFFFFFFu);
+    }
+    static bool parallel()
+    {
+        return GLAD_GL_KHR_parallel_shader_compile || GLAD_GL_ARB_parallel_shader_compile;
+    }
+    // queue a program, returns its index in the vector finish() returns
+    // ------------------------------------------------------------------------
+    size_t add(const char* vertexPath, const char* fragmentPath)
+    {
+        std::string vertexCode, fragmentCode;
+        Shader::readFiles(vertexPath, fragmentPath, vertexCode, fragmentCode);
+        return addSource(vertexCode, fragmentCode);
+    }
+    size_t addSource(const std::string& vertexCode, const std::string& fragmentCode)
+    {
+        Shader shader;
+        pending.push_back(shader.submit(vertexCode, fragmentCode));
+        shaders.push_back(std::move(shader));
+        return shaders.size() - 1;
+    }
+    // complete programs as the driver finishes them, in whatever order that happens
+    // ------------------------------------------------------------------------
+    std::vector<Shader> finish()
+    {
+        std::vector<bool> done(shaders.size(), false);
+        size_t remaining = shaders.size();
+        while (remaining)
+        {
+            size_t completed = 0;
+            for (size_t i = 0; i < shaders.size(); i++)
+            {
+                if (done[i] || !shaders[i].linkFinished())
+                    continue;
+                shaders[i].complete(pending[i]);
+                done[i] = true;
+                completed++;
+            }
+            remaining -= completed;
+            polls++;
+            if (remaining && !completed)
+                std::this_thread::yield();
+        }
+        pending.clear();
+        std::vector<Shader> result;
+        result.swap(shaders);
+        return result;
+    }
+    // passes over the pending programs finish() needed, 1 means nothing was still compiling
+    unsigned int pollCount() const { return polls; }
+
+private:
+    std::vector<Shader> shaders;
+    std::vector<Shader::PendingProgram> pending;
+    unsigned int polls = 0;
+};
 #endif
\ No newline at end of file
@@ -523,6 +523,77 @@ STBIDEF void stbi_set_unpremultiply_on_load_thread(int flag_true_if_should_unpre
 STBIDEF void stbi_convert_iphone_png_to_rgb_thread(int flag_true_if_should_convert);
 STBIDEF void stbi_set_flip_vertically_on_load_thread(int flag_true_if_should_flip);
 
+// JPEG kernel selection, mostly for benchmarking: the IDCT, YCbCr->RGB and upsampling
+// kernels are picked per image from the widest set both the build and the CPU support,
+// capped at the level set here (default STBI_JPEG_KERNELS_AVX2). Applies to all threads.
+#define STBI_JPEG_KERNELS_SCALAR 0
+#define STBI_JPEG_KERNELS_SIMD   1   // SSE2 or NEON
+#define STBI_JPEG_KERNELS_AVX2   2
+STBIDEF void stbi_jpeg_set_kernels(int max_level);
+// the level images are decoded with under the current cap
+STBIDEF int  stbi_jpeg_kernels(void);
+
+// JPEG stage timing for images loaded on the calling thread, in CPU timestamp counter
+// ticks (always zero on CPUs without one). entropy is Huffman decoding and dequantization,
+// idct the inverse DCT, upsample the chroma resampling and color the YCbCr->RGB
+// conversion and output interleave.
+typedef struct
+{
+   unsigned long long entropy, idct, upsample, color;
+} stbi_jpeg_stage_ticks;
+STBIDEF void stbi_jpeg_stage_timing(int flag_true_if_should_time);
+STBIDEF void stbi_jpeg_get_stage_ticks(stbi_jpeg_stage_ticks *ticks, int reset);
+
+// Multithreaded JPEG decoding for images loaded on the calling thread. stb_image creates
+// no threads itself: run must call task(task_data, i) once for every i in [0, count),
+// spread over up to thread_count threads, and return once all calls have finished. Large
+// baseline images loaded from memory then decode their restart intervals (DRI) in
+// parallel; without restart markers the entropy decoding stays serial but the IDCT, the
+// upsampling and the color conversion still run in parallel bands of rows. Stage timing
+// charges parallel interval decoding to entropy and the parallel output pass to color.
+// Pass NULL or thread_count < 2 to decode everything on the calling thread again.
+typedef void stbi_parallel_task(void *task_data, int index);
+typedef void stbi_parallel_for(void *pool, stbi_parallel_task *task, void *task_data, int count);
+STBIDEF void stbi_jpeg_set_parallel(stbi_parallel_for *run, void *pool, int thread_count);
+
+// PNG unfilter kernel selection, mostly for benchmarking and testing: rows are unfiltered
+// with the widest kernels both the build and the CPU support, capped at the level set here
+// (default STBI_PNG_KERNELS_AVX2). Sub, Avg and Paeth have SIMD kernels for 8-bit RGB and
+// RGBA only; Up has them for every format. Applies to all threads.
+#define STBI_PNG_KERNELS_SCALAR 0
+#define STBI_PNG_KERNELS_SSE2   1
+#define STBI_PNG_KERNELS_SSSE3  2
+#define STBI_PNG_KERNELS_AVX2   3
+STBIDEF void stbi_png_set_kernels(int max_level);
+// the level images are unfiltered with under the current cap
+STBIDEF int  stbi_png_kernels(void);
+
+// Row streaming, for images too large to hold decoded: callback receives the image in
+// bands of up to rows_per_call rows while it decodes, y being the first row of the band
+// and the rows packed (x * channels samples each). *x, *y and *channels_in_file are
+// filled in before the first call. Non-interlaced PNG, baseline JPEG and HDR decode with
+// buffers of a few rows; progressive JPEG keeps its coefficients for the whole image,
+// and interlaced PNG and the other formats decode in full before being handed over band
+// by band. With vertical flipping on, the bands arrive bottom band first, each already
+// flipped. The rows are only valid during the call; return 0 from it to stop decoding.
+// Returns 1 once every row has been delivered.
+typedef int stbi_rows_callback(void *user, void *rows, int y, int row_count);
+STBIDEF int stbi_load_rows_from_memory   (stbi_uc const *buffer, int len, int *x, int *y, int *channels_in_file, int desired_channels, int rows_per_call, stbi_rows_callback *callback, void *user);
+STBIDEF int stbi_load_rows_from_callbacks(stbi_io_callbacks const *clbk, void *clbk_user, int *x, int *y, int *channels_in_file, int desired_channels, int rows_per_call, stbi_rows_callback *callback, void *user);
+#ifndef STBI_NO_STDIO
+STBIDEF int stbi_load_rows               (char const *filename, int *x, int *y, int *channels_in_file, int desired_channels, int rows_per_call, stbi_rows_callback *callback, void *user);
+STBIDEF int stbi_load_rows_from_file     (FILE *f, int *x, int *y, int *channels_in_file, int desired_channels, int rows_per_call, stbi_rows_callback *callback, void *user);
+#endif
+#ifndef STBI_NO_LINEAR
+// the same with float samples, as stbi_loadf returns them
+STBIDEF int stbi_loadf_rows_from_memory   (stbi_uc const *buffer, int len, int *x, int *y, int *channels_in_file, int desired_channels, int rows_per_call, stbi_rows_callback *callback, void *user);
+STBIDEF int stbi_loadf_rows_from_callbacks(stbi_io_callbacks const *clbk, void *clbk_user, int *x, int *y, int *channels_in_file, int desired_channels, int rows_per_call, stbi_rows_callback *callback, void *user);
+#ifndef STBI_NO_STDIO
+STBIDEF int stbi_loadf_rows               (char const *filename, int *x, int *y, int *channels_in_file, int desired_channels, int rows_per_call, stbi_rows_callback *callback, void *user);
+STBIDEF int stbi_loadf_rows_from_file     (FILE *f, int *x, int *y, int *channels_in_file, int desired_channels, int rows_per_call, stbi_rows_callback *callback, void *user);
+#endif
+#endif
+
 // ZLIB client - used by PNG, available for other purposes
 
 STBIDEF char *stbi_zlib_decode_malloc_guesssize(const char *buffer, int len, int initial_size, int *outlen);
@@ -533,6 +604,12 @@ STBIDEF int   stbi_zlib_decode_buffer(char *obuffer, int olen, const char *ibuff
 STBIDEF char *stbi_zlib_decode_noheader_malloc(const char *buffer, int len, int *outlen);
 STBIDEF int   stbi_zlib_decode_noheader_buffer(char *obuffer, int olen, const char *ibuffer, int ilen);
 
+// inflate engine selection, mostly for benchmarking: by default Huffman blocks decode from a
+// 64-bit bit buffer with lookup tables that return up to two literals per probe and copy
+// matches 16 bytes at a time; 0 selects the original byte-at-a-time decoder. Applies to all
+// threads, so set it before any decoding starts.
+STBIDEF void stbi_zlib_set_fast_inflate(int flag_true_if_fast);
+
 
 #ifdef __cplusplus
 }
@@ -642,12 +719,14 @@ typedef unsigned short stbi__uint16;
 typedef   signed short stbi__int16;
 typedef unsigned int   stbi__uint32;
 typedef   signed int   stbi__int32;
+typedef unsigned __int64 stbi__uint64;
 #else
 #include <stdint.h>
 typedef uint16_t stbi__uint16;
 typedef int16_t  stbi__int16;
 typedef uint32_t stbi__uint32;
 typedef int32_t  stbi__int32;
+typedef uint64_t stbi__uint64;
 #endif
 
 // should produce compiler error if size is wrong
@@ -749,7 +828,7 @@ static int stbi__cpuid3(void)
 
 #define STBI_SIMD_ALIGN(type, name) __declspec(align(16)) type name
 
-#if !defined(STBI_NO_JPEG) && defined(STBI_SSE2)
+#if (!defined(STBI_NO_JPEG) || !defined(STBI_NO_PNG)) && defined(STBI_SSE2)
 static int stbi__sse2_available(void)
 {
    int info3 = stbi__cpuid3();
@@ -760,7 +839,7 @@ static int stbi__sse2_available(void)
 #else // assume GCC-style if not VC++
 #define STBI_SIMD_ALIGN(type, name) type name __attribute__((aligned(16)))
 
-#if !defined(STBI_NO_JPEG) && defined(STBI_SSE2)
+#if (!defined(STBI_NO_JPEG) || !defined(STBI_NO_PNG)) && defined(STBI_SSE2)
 static int stbi__sse2_available(void)
 {
    // If we're even attempting to compile this on GCC/Clang, that means
@@ -773,6 +852,55 @@ static int stbi__sse2_available(void)
 #endif
 #endif
 
+// x86 AVX2
+// the AVX2 kernels are compiled with a per-function target attribute and only chosen at
+// run time on CPUs that report AVX2, so the library as a whole still only requires SSE2
+#if defined(STBI_SSE2) && !defined(STBI_NO_AVX2)
+#if defined(__GNUC__) || defined(__clang__)
+#define STBI_AVX2
+#define STBI__AVX2_TARGET __attribute__((target("avx2")))
+#include <immintrin.h>
+#if !defined(STBI_NO_JPEG) || !defined(STBI_NO_PNG)
+static int stbi__avx2_available(void)
+{
+   return __builtin_cpu_supports("avx2");
+}
+#endif
+#elif defined(_MSC_VER) && defined(__AVX2__)
+// VC++ has no per-function targets; building with /arch:AVX2 already requires the CPU to have it
+#define STBI_AVX2
+#define STBI__AVX2_TARGET
+#include <immintrin.h>
+#if !defined(STBI_NO_JPEG) || !defined(STBI_NO_PNG)
+static int stbi__avx2_available(void)
+{
+   return 1;
+}
+#endif
+#endif
+#endif
+
+// x86 SSSE3, only used by the PNG unfilter kernels, compiled and chosen like AVX2
+#if defined(STBI_SSE2) && !defined(STBI_NO_SSSE3) && !defined(STBI_NO_PNG)
+#if defined(__GNUC__) || defined(__clang__)
+#define STBI_SSSE3
+#define STBI__SSSE3_TARGET __attribute__((target("ssse3")))
+#include <tmmintrin.h>
+static int stbi__ssse3_available(void)
+{
+   return __builtin_cpu_supports("ssse3");
+}
+#elif defined(_MSC_VER) && defined(__AVX__)
+#define STBI_SSSE3
+#define STBI__SSSE3_TARGET
+#include <tmmintrin.h>
+static int stbi__ssse3_available(void)
+{
+   return 1;
+}
+#endif
+#endif
+
 // ARM NEON
 #if defined(STBI_NO_SIMD) && defined(STBI_NEON)
 #undef STBI_NEON
@@ -799,12 +927,29 @@ static int stbi__sse2_available(void)
 //
 //  stbi__context struct and start_xxx functions
 
+// destination of the stbi_load_rows functions: decoders that can stream hand each
+// finished row to stbi__rows_put, which converts it to the requested sample type and
+// passes the rows on in bands
+typedef struct
+{
+   stbi_rows_callback *callback;
+   void *user;
+   int *x, *y, *comp;
+   int band, is_float, flip;
+   int w, h, n;
+   int done;          // rows put so far, in decoding order
+   int finished;      // the decoder streamed the whole image and read it to the end
+   stbi_uc *buffer;   // one band
+   stbi_uc *scratch;  // 16-bit rows reduced to 8 bits on their way to float
+} stbi__rows;
+
 // stbi__context structure is our basic context used by all images, so it
 // contains all the IO context, plus some basic image information
 typedef struct
 {
    stbi__uint32 img_x, img_y;
    int img_n, img_out_n;
+   stbi__rows *rows;    // set to stream rows instead of returning the image
 
    stbi_io_callbacks io;
    void *io_user_data;
@@ -825,6 +970,7 @@ static void stbi__refill_buffer(stbi__context *s);
 static void stbi__start_mem(stbi__context *s, stbi_uc const *buffer, int len)
 {
    s->io.read = NULL;
+   s->rows = NULL;
    s->read_from_callbacks = 0;
    s->callback_already_read = 0;
    s->img_buffer = s->img_buffer_original = (stbi_uc *) buffer;
@@ -836,6 +982,7 @@ static void stbi__start_callbacks(stbi__context *s, stbi_io_callbacks *c, void *
 {
    s->io = *c;
    s->io_user_data = user;
+   s->rows = NULL;
    s->buflen = sizeof(s->buffer_start);
    s->read_from_callbacks = 1;
    s->callback_already_read = 0;
@@ -904,6 +1051,9 @@ typedef struct
    int channel_order;
 } stbi__result_info;
 
+static int      stbi__rows_begin(stbi__rows *r, int w, int h, int img_n, int req_comp);
+static int      stbi__rows_put(stbi__rows *r, const void *row, int bits);
+
 #ifndef STBI_NO_JPEG
 static int      stbi__jpeg_test(stbi__context *s);
 static void    *stbi__jpeg_load(stbi__context *s, int *x, int *y, int *comp, int req_comp, stbi__result_info *ri);
@@ -1509,6 +1659,132 @@ STBIDEF float *stbi_loadf_from_file(FILE *f, int *x, int *y, int *comp, int req_
 
 #endif // !STBI_NO_LINEAR
 
+static int stbi__load_rows_main(stbi__context *s, int *x, int *y, int *comp, int req_comp, int rows_per_call, stbi_rows_callback *callback, void *user, int is_float)
+{
+   stbi__result_info ri;
+   stbi__rows r;
+   void *result;
+   int bits, ok, img_n;
+   if (req_comp < 0 || req_comp > 4) return stbi__err("bad req_comp", "Internal error");
+   if (!comp) comp = &img_n;
+   memset(&r, 0, sizeof(r));
+   r.callback = callback;
+   r.user = user;
+   r.x = x;
+   r.y = y;
+   r.comp = comp;
+   r.band = rows_per_call > 0 ? rows_per_call : 1;
+   r.is_float = is_float;
+   r.flip = stbi__vertically_flip_on_load;
+   s->rows = &r;
+
+   // decoders that stream put the rows themselves and return NULL; the others (and
+   // images a streaming decoder cannot take row by row) return the whole image
+   #ifndef STBI_NO_HDR
+   if (stbi__hdr_test(s)) {
+      result = stbi__hdr_load(s, x, y, comp, req_comp, &ri);
+      bits = 32;
+   } else
+   #endif
+   {
+      result = stbi__load_main(s, x, y, comp, req_comp, &ri, 8);
+      bits = ri.bits_per_channel;
+   }
+   if (result) {
+      int j, channels = req_comp ? req_comp : *comp;
+      size_t row_bytes = (size_t) *x * channels * (bits / 8);
+      ok = stbi__rows_begin(&r, *x, *y, *comp, req_comp);
+      for (j=0; ok && j < *y; ++j)
+         ok = stbi__rows_put(&r, (stbi_uc *) result + row_bytes * j, bits);
+      r.finished = 1;
+      STBI_FREE(result);
+   }
+   ok = r.finished && r.buffer != NULL && r.done == r.h;
+   STBI_FREE(r.buffer);
+   STBI_FREE(r.scratch);
+   return ok;
+}
+
+STBIDEF int stbi_load_rows_from_memory(stbi_uc const *buffer, int len, int *x, int *y, int *comp, int req_comp, int rows_per_call, stbi_rows_callback *callback, void *user)
+{
+   stbi__context s;
+   stbi__start_mem(&s,buffer,len);
+   return stbi__load_rows_main(&s,x,y,comp,req_comp,rows_per_call,callback,user,0);
+}
+
+STBIDEF int stbi_load_rows_from_callbacks(stbi_io_callbacks const *clbk, void *clbk_user, int *x, int *y, int *comp, int req_comp, int rows_per_call, stbi_rows_callback *callback, void *user)
+{
+   stbi__context s;
+   stbi__start_callbacks(&s, (stbi_io_callbacks *) clbk, clbk_user);
+   return stbi__load_rows_main(&s,x,y,comp,req_comp,rows_per_call,callback,user,0);
+}
+
+#ifndef STBI_NO_STDIO
+STBIDEF int stbi_load_rows(char const *filename, int *x, int *y, int *comp, int req_comp, int rows_per_call, stbi_rows_callback *callback, void *user)
+{
+   int result;
+   FILE *f = stbi__fopen(filename, "rb");
+   if (!f) return stbi__err("can't fopen", "Unable to open file");
+   result = stbi_load_rows_from_file(f,x,y,comp,req_comp,rows_per_call,callback,user);
+   fclose(f);
+   return result;
+}
+
+STBIDEF int stbi_load_rows_from_file(FILE *f, int *x, int *y, int *comp, int req_comp, int rows_per_call, stbi_rows_callback *callback, void *user)
+{
+   int result;
+   stbi__context s;
+   stbi__start_file(&s,f);
+   result = stbi__load_rows_main(&s,x,y,comp,req_comp,rows_per_call,callback,user,0);
+   if (result) {
+      // need to 'unget' all the characters in the IO buffer
+      fseek(f, - (int) (s.img_buffer_end - s.img_buffer), SEEK_CUR);
+   }
+   return result;
+}
+#endif // !STBI_NO_STDIO
+
+#ifndef STBI_NO_LINEAR
+STBIDEF int stbi_loadf_rows_from_memory(stbi_uc const *buffer, int len, int *x, int *y, int *comp, int req_comp, int rows_per_call, stbi_rows_callback *callback, void *user)
+{
+   stbi__context s;
+   stbi__start_mem(&s,buffer,len);
+   return stbi__load_rows_main(&s,x,y,comp,req_comp,rows_per_call,callback,user,1);
+}
+
+STBIDEF int stbi_loadf_rows_from_callbacks(stbi_io_callbacks const *clbk, void *clbk_user, int *x, int *y, int *comp, int req_comp, int rows_per_call, stbi_rows_callback *callback, void *user)
+{
+   stbi__context s;
+   stbi__start_callbacks(&s, (stbi_io_callbacks *) clbk, clbk_user);
+   return stbi__load_rows_main(&s,x,y,comp,req_comp,rows_per_call,callback,user,1);
+}
+
+#ifndef STBI_NO_STDIO
+STBIDEF int stbi_loadf_rows(char const *filename, int *x, int *y, int *comp, int req_comp, int rows_per_call, stbi_rows_callback *callback, void *user)
+{
+   int result;
+   FILE *f = stbi__fopen(filename, "rb");
+   if (!f) return stbi__err("can't fopen", "Unable to open file");
+   result = stbi_loadf_rows_from_file(f,x,y,comp,req_comp,rows_per_call,callback,user);
+   fclose(f);
+   return result;
+}
+
+STBIDEF int stbi_loadf_rows_from_file(FILE *f, int *x, int *y, int *comp, int req_comp, int rows_per_call, stbi_rows_callback *callback, void *user)
+{
+   int result;
+   stbi__context s;
+   stbi__start_file(&s,f);
+   result = stbi__load_rows_main(&s,x,y,comp,req_comp,rows_per_call,callback,user,1);
+   if (result) {
+      // need to 'unget' all the characters in the IO buffer
+      fseek(f, - (int) (s.img_buffer_end - s.img_buffer), SEEK_CUR);
+   }
+   return result;
+}
+#endif // !STBI_NO_STDIO
+#endif // !STBI_NO_LINEAR
+
 // these is-hdr-or-not is defined independent of whether STBI_NO_LINEAR is
 // defined, for API simplicity; if STBI_NO_LINEAR is defined, it always
 // reports false!
@@ -1751,9 +2027,37 @@ static stbi_uc stbi__compute_y(int r, int g, int b)
 #if defined(STBI_NO_PNG) && defined(STBI_NO_BMP) && defined(STBI_NO_PSD) && defined(STBI_NO_TGA) && defined(STBI_NO_GIF) && defined(STBI_NO_PIC) && defined(STBI_NO_PNM)
 // nothing
 #else
+// convert one row of x pixels with img_n components to one with req_comp components; 0 for
+// an unsupported conversion
+static int stbi__convert_format_row(unsigned char *dest, unsigned char *src, int img_n, int req_comp, unsigned int x)
+{
+   int i;
+   #define STBI__COMBO(a,b)  ((a)*8+(b))
+   #define STBI__CASE(a,b)   case STBI__COMBO(a,b): for(i=x-1; i >= 0; --i, src += a, dest += b)
+   // convert source image with img_n components to one with req_comp components;
+   // avoid switch per pixel, so use switch per scanline and massive macros
+   switch (STBI__COMBO(img_n, req_comp)) {
+      STBI__CASE(1,2) { dest[0]=src[0]; dest[1]=255;                                     } break;
+      STBI__CASE(1,3) { dest[0]=dest[1]=dest[2]=src[0];                                  } break;
+      STBI__CASE(1,4) { dest[0]=dest[1]=dest[2]=src[0]; dest[3]=255;                     } break;
+      STBI__CASE(2,1) { dest[0]=src[0];                                                  } break;
+      STBI__CASE(2,3) { dest[0]=dest[1]=dest[2]=src[0];                                  } break;
+      STBI__CASE(2,4) { dest[0]=dest[1]=dest[2]=src[0]; dest[3]=src[1];                  } break;
+      STBI__CASE(3,4) { dest[0]=src[0];dest[1]=src[1];dest[2]=src[2];dest[3]=255;        } break;
+      STBI__CASE(3,1) { dest[0]=stbi__compute_y(src[0],src[1],src[2]);                   } break;
+      STBI__CASE(3,2) { dest[0]=stbi__compute_y(src[0],src[1],src[2]); dest[1] = 255;    } break;
+      STBI__CASE(4,1) { dest[0]=stbi__compute_y(src[0],src[1],src[2]);                   } break;
+      STBI__CASE(4,2) { dest[0]=stbi__compute_y(src[0],src[1],src[2]); dest[1] = src[3]; } break;
+      STBI__CASE(4,3) { dest[0]=src[0];dest[1]=src[1];dest[2]=src[2];                    } break;
+      default: STBI_ASSERT(0); return stbi__err("unsupported", "Unsupported format conversion");
+   }
+   #undef STBI__CASE
+   return 1;
+}
+
 static unsigned char *stbi__convert_format(unsigned char *data, int img_n, int req_comp, unsigned int x, unsigned int y)
 {
-   int i,j;
+   int j;
    unsigned char *good;
 
    if (req_comp == img_n) return data;
@@ -1766,29 +2070,11 @@ static unsigned char *stbi__convert_format(unsigned char *data, int img_n, int r
    }
 
    for (j=0; j < (int) y; ++j) {
-      unsigned char *src  = data + j * x * img_n   ;
-      unsigned char *dest = good + j * x * req_comp;
-
-      #define STBI__COMBO(a,b)  ((a)*8+(b))
-      #define STBI__CASE(a,b)   case STBI__COMBO(a,b): for(i=x-1; i >= 0; --i, src += a, dest += b)
-      // convert source image with img_n components to one with req_comp components;
-      // avoid switch per pixel, so use switch per scanline and massive macros
-      switch (STBI__COMBO(img_n, req_comp)) {
-         STBI__CASE(1,2) { dest[0]=src[0]; dest[1]=255;                                     } break;
-         STBI__CASE(1,3) { dest[0]=dest[1]=dest[2]=src[0];                                  } break;
-         STBI__CASE(1,4) { dest[0]=dest[1]=dest[2]=src[0]; dest[3]=255;                     } break;
-         STBI__CASE(2,1) { dest[0]=src[0];                                                  } break;
-         STBI__CASE(2,3) { dest[0]=dest[1]=dest[2]=src[0];                                  } break;
-         STBI__CASE(2,4) { dest[0]=dest[1]=dest[2]=src[0]; dest[3]=src[1];                  } break;
-         STBI__CASE(3,4) { dest[0]=src[0];dest[1]=src[1];dest[2]=src[2];dest[3]=255;        } break;
-         STBI__CASE(3,1) { dest[0]=stbi__compute_y(src[0],src[1],src[2]);                   } break;
-         STBI__CASE(3,2) { dest[0]=stbi__compute_y(src[0],src[1],src[2]); dest[1] = 255;    } break;
-         STBI__CASE(4,1) { dest[0]=stbi__compute_y(src[0],src[1],src[2]);                   } break;
-         STBI__CASE(4,2) { dest[0]=stbi__compute_y(src[0],src[1],src[2]); dest[1] = src[3]; } break;
-         STBI__CASE(4,3) { dest[0]=src[0];dest[1]=src[1];dest[2]=src[2];                    } break;
-         default: STBI_ASSERT(0); STBI_FREE(data); STBI_FREE(good); return stbi__errpuc("unsupported", "Unsupported format conversion");
+      if (!stbi__convert_format_row(good + j * x * req_comp, data + j * x * img_n, img_n, req_comp, x)) {
+         STBI_FREE(data);
+         STBI_FREE(good);
+         return NULL;
       }
-      #undef STBI__CASE
    }
 
    STBI_FREE(data);
@@ -1808,9 +2094,36 @@ static stbi__uint16 stbi__compute_y_16(int r, int g, int b)
 #if defined(STBI_NO_PNG) && defined(STBI_NO_PSD)
 // nothing
 #else
+// 16-bit version of stbi__convert_format_row
+static int stbi__convert_format16_row(stbi__uint16 *dest, stbi__uint16 *src, int img_n, int req_comp, unsigned int x)
+{
+   int i;
+   #define STBI__COMBO(a,b)  ((a)*8+(b))
+   #define STBI__CASE(a,b)   case STBI__COMBO(a,b): for(i=x-1; i >= 0; --i, src += a, dest += b)
+   // convert source image with img_n components to one with req_comp components;
+   // avoid switch per pixel, so use switch per scanline and massive macros
+   switch (STBI__COMBO(img_n, req_comp)) {
+      STBI__CASE(1,2) { dest[0]=src[0]; dest[1]=0xffff;                                     } break;
+      STBI__CASE(1,3) { dest[0]=dest[1]=dest[2]=src[0];                                     } break;
+      STBI__CASE(1,4) { dest[0]=dest[1]=dest[2]=src[0]; dest[3]=0xffff;                     } break;
+      STBI__CASE(2,1) { dest[0]=src[0];                                                     } break;
+      STBI__CASE(2,3) { dest[0]=dest[1]=dest[2]=src[0];                                     } break;
+      STBI__CASE(2,4) { dest[0]=dest[1]=dest[2]=src[0]; dest[3]=src[1];                     } break;
+      STBI__CASE(3,4) { dest[0]=src[0];dest[1]=src[1];dest[2]=src[2];dest[3]=0xffff;        } break;
+      STBI__CASE(3,1) { dest[0]=stbi__compute_y_16(src[0],src[1],src[2]);                   } break;
+      STBI__CASE(3,2) { dest[0]=stbi__compute_y_16(src[0],src[1],src[2]); dest[1] = 0xffff; } break;
+      STBI__CASE(4,1) { dest[0]=stbi__compute_y_16(src[0],src[1],src[2]);                   } break;
+      STBI__CASE(4,2) { dest[0]=stbi__compute_y_16(src[0],src[1],src[2]); dest[1] = src[3]; } break;
+      STBI__CASE(4,3) { dest[0]=src[0];dest[1]=src[1];dest[2]=src[2];                       } break;
+      default: STBI_ASSERT(0); return stbi__err("unsupported", "Unsupported format conversion");
+   }
+   #undef STBI__CASE
+   return 1;
+}
+
 static stbi__uint16 *stbi__convert_format16(stbi__uint16 *data, int img_n, int req_comp, unsigned int x, unsigned int y)
 {
-   int i,j;
+   int j;
    stbi__uint16 *good;
 
    if (req_comp == img_n) return data;
@@ -1823,29 +2136,11 @@ static stbi__uint16 *stbi__convert_format16(stbi__uint16 *data, int img_n, int r
    }
 
    for (j=0; j < (int) y; ++j) {
-      stbi__uint16 *src  = data + j * x * img_n   ;
-      stbi__uint16 *dest = good + j * x * req_comp;
-
-      #define STBI__COMBO(a,b)  ((a)*8+(b))
-      #define STBI__CASE(a,b)   case STBI__COMBO(a,b): for(i=x-1; i >= 0; --i, src += a, dest += b)
-      // convert source image with img_n components to one with req_comp components;
-      // avoid switch per pixel, so use switch per scanline and massive macros
-      switch (STBI__COMBO(img_n, req_comp)) {
-         STBI__CASE(1,2) { dest[0]=src[0]; dest[1]=0xffff;                                     } break;
-         STBI__CASE(1,3) { dest[0]=dest[1]=dest[2]=src[0];                                     } break;
-         STBI__CASE(1,4) { dest[0]=dest[1]=dest[2]=src[0]; dest[3]=0xffff;                     } break;
-         STBI__CASE(2,1) { dest[0]=src[0];                                                     } break;
-         STBI__CASE(2,3) { dest[0]=dest[1]=dest[2]=src[0];                                     } break;
-         STBI__CASE(2,4) { dest[0]=dest[1]=dest[2]=src[0]; dest[3]=src[1];                     } break;
-         STBI__CASE(3,4) { dest[0]=src[0];dest[1]=src[1];dest[2]=src[2];dest[3]=0xffff;        } break;
-         STBI__CASE(3,1) { dest[0]=stbi__compute_y_16(src[0],src[1],src[2]);                   } break;
-         STBI__CASE(3,2) { dest[0]=stbi__compute_y_16(src[0],src[1],src[2]); dest[1] = 0xffff; } break;
-         STBI__CASE(4,1) { dest[0]=stbi__compute_y_16(src[0],src[1],src[2]);                   } break;
-         STBI__CASE(4,2) { dest[0]=stbi__compute_y_16(src[0],src[1],src[2]); dest[1] = src[3]; } break;
-         STBI__CASE(4,3) { dest[0]=src[0];dest[1]=src[1];dest[2]=src[2];                       } break;
-         default: STBI_ASSERT(0); STBI_FREE(data); STBI_FREE(good); return (stbi__uint16*) stbi__errpuc("unsupported", "Unsupported format conversion");
+      if (!stbi__convert_format16_row(good + j * x * req_comp, data + j * x * img_n, img_n, req_comp, x)) {
+         STBI_FREE(data);
+         STBI_FREE(good);
+         return NULL;
       }
-      #undef STBI__CASE
    }
 
    STBI_FREE(data);
@@ -1854,25 +2149,30 @@ static stbi__uint16 *stbi__convert_format16(stbi__uint16 *data, int img_n, int r
 #endif
 
 #ifndef STBI_NO_LINEAR
-static float   *stbi__ldr_to_hdr(stbi_uc *data, int x, int y, int comp)
+static void stbi__ldr_to_hdr_pixels(float *output, const stbi_uc *data, int count, int comp)
 {
    int i,k,n;
-   float *output;
-   if (!data) return NULL;
-   output = (float *) stbi__malloc_mad4(x, y, comp, sizeof(float), 0);
-   if (output == NULL) { STBI_FREE(data); return stbi__errpf("outofmem", "Out of memory"); }
    // compute number of non-alpha components
    if (comp & 1) n = comp; else n = comp-1;
-   for (i=0; i < x*y; ++i) {
+   for (i=0; i < count; ++i) {
       for (k=0; k < n; ++k) {
          output[i*comp + k] = (float) (pow(data[i*comp+k]/255.0f, stbi__l2h_gamma) * stbi__l2h_scale);
       }
    }
    if (n < comp) {
-      for (i=0; i < x*y; ++i) {
+      for (i=0; i < count; ++i) {
          output[i*comp + n] = data[i*comp + n]/255.0f;
       }
    }
+}
+
+static float   *stbi__ldr_to_hdr(stbi_uc *data, int x, int y, int comp)
+{
+   float *output;
+   if (!data) return NULL;
+   output = (float *) stbi__malloc_mad4(x, y, comp, sizeof(float), 0);
+   if (output == NULL) { STBI_FREE(data); return stbi__errpf("outofmem", "Out of memory"); }
+   stbi__ldr_to_hdr_pixels(output, data, x*y, comp);
    STBI_FREE(data);
    return output;
 }
@@ -1880,16 +2180,12 @@ static float   *stbi__ldr_to_hdr(stbi_uc *data, int x, int y, int comp)
 
 #ifndef STBI_NO_HDR
 #define stbi__float2int(x)   ((int) (x))
-static stbi_uc *stbi__hdr_to_ldr(float   *data, int x, int y, int comp)
+static void stbi__hdr_to_ldr_pixels(stbi_uc *output, const float *data, int count, int comp)
 {
    int i,k,n;
-   stbi_uc *output;
-   if (!data) return NULL;
-   output = (stbi_uc *) stbi__malloc_mad3(x, y, comp, 0);
-   if (output == NULL) { STBI_FREE(data); return stbi__errpuc("outofmem", "Out of memory"); }
    // compute number of non-alpha components
    if (comp & 1) n = comp; else n = comp-1;
-   for (i=0; i < x*y; ++i) {
+   for (i=0; i < count; ++i) {
       for (k=0; k < n; ++k) {
          float z = (float) pow(data[i*comp+k]*stbi__h2l_scale_i, stbi__h2l_gamma_i) * 255 + 0.5f;
          if (z < 0) z = 0;
@@ -1903,11 +2199,94 @@ static stbi_uc *stbi__hdr_to_ldr(float   *data, int x, int y, int comp)
          output[i*comp + k] = (stbi_uc) stbi__float2int(z);
       }
    }
+}
+
+static stbi_uc *stbi__hdr_to_ldr(float   *data, int x, int y, int comp)
+{
+   stbi_uc *output;
+   if (!data) return NULL;
+   output = (stbi_uc *) stbi__malloc_mad3(x, y, comp, 0);
+   if (output == NULL) { STBI_FREE(data); return stbi__errpuc("outofmem", "Out of memory"); }
+   stbi__hdr_to_ldr_pixels(output, data, x*y, comp);
    STBI_FREE(data);
    return output;
 }
 #endif
 
+//////////////////////////////////////////////////////////////////////////////
+//
+//  row streaming, see stbi_load_rows
+
+// the decoder knows the size and format; set up the band buffer and report them
+static int stbi__rows_begin(stbi__rows *r, int w, int h, int img_n, int req_comp)
+{
+   int sample = r->is_float ? sizeof(float) : 1;
+   r->w = w;
+   r->h = h;
+   r->n = req_comp ? req_comp : img_n;
+   if (r->x) *r->x = w;
+   if (r->y) *r->y = h;
+   if (r->comp) *r->comp = img_n;
+   if (r->band > h) r->band = h;
+   if (!stbi__mad3sizes_valid(r->band, w, r->n * sample, 0)) return stbi__err("too large", "Image too large to decode");
+   r->buffer = (stbi_uc *) stbi__malloc_mad3(r->band, w, r->n * sample, 0);
+   if (r->buffer == NULL) return stbi__err("outofmem", "Out of memory");
+   if (r->is_float) {
+      r->scratch = (stbi_uc *) stbi__malloc_mad3(w, r->n, 1, 0);
+      if (r->scratch == NULL) return stbi__err("outofmem", "Out of memory");
+   }
+   return 1;
+}
+
+// convert one row of 8 or 16 bit or float samples into the band
+static void stbi__rows_convert(stbi__rows *r, stbi_uc *dest, const void *row, int bits)
+{
+   int i, count = r->w * r->n;
+   if (!r->is_float) {
+      if (bits == 8)
+         memcpy(dest, row, count);
+      else if (bits == 16) {
+         for (i=0; i < count; ++i)
+            dest[i] = (stbi_uc) (((const stbi__uint16 *) row)[i] >> 8);
+      }
+      #ifndef STBI_NO_HDR
+      else
+         stbi__hdr_to_ldr_pixels(dest, (const float *) row, r->w, r->n);
+      #endif
+   } else {
+      #ifndef STBI_NO_LINEAR
+      const stbi_uc *ldr = (const stbi_uc *) row;
+      if (bits == 32) {
+         memcpy(dest, row, count * sizeof(float));
+         return;
+      }
+      if (bits == 16) {
+         // like stbi_loadf, which goes through the 8-bit result
+         for (i=0; i < count; ++i)
+            r->scratch[i] = (stbi_uc) (((const stbi__uint16 *) row)[i] >> 8);
+         ldr = r->scratch;
+      }
+      stbi__ldr_to_hdr_pixels((float *) dest, ldr, r->w, r->n);
+      #endif
+   }
+}
+
+// take the next row in decoding order, passing the band on once it is complete; 0 when
+// the callback stops the decode
+static int stbi__rows_put(stbi__rows *r, const void *row, int bits)
+{
+   int start = r->done - r->done % r->band;
+   int count = r->h - start < r->band ? r->h - start : r->band;
+   int slot = r->done - start;
+   size_t row_bytes = (size_t) r->w * r->n * (r->is_float ? sizeof(float) : 1);
+   STBI_ASSERT(r->done < r->h);
+   if (r->flip) slot = count-1 - slot;
+   stbi__rows_convert(r, r->buffer + slot * row_bytes, row, bits);
+   if (++r->done - start < count) return 1;
+   if (r->callback(r->user, r->buffer, r->flip ? r->h - start - count : start, count)) return 1;
+   return stbi__err("stopped", "Row callback stopped decoding");
+}
+
 //////////////////////////////////////////////////////////////////////////////
 //
 //  "baseline" JPEG/JFIF decoder
@@ -1968,6 +2347,7 @@ typedef struct
       int dc_pred;
 
       int x,y,w2,h2;
+      int row0;         // first row held in data; only a window of rows when streaming
       stbi_uc *data;
       void *raw_data, *raw_coeff;
       stbi_uc *linebuf;
@@ -1993,10 +2373,15 @@ typedef struct
    int scan_n, order[4];
    int restart_interval, todo;
 
+   struct stbi__jpeg_stream *stream; // set when the rows go to stbi__context.rows
+   int window;                       // the planes hold two units of rows, see row0
+
 // kernels
    void (*idct_block_kernel)(stbi_uc *out, int out_stride, short data[64]);
    void (*YCbCr_to_RGB_kernel)(stbi_uc *out, const stbi_uc *y, const stbi_uc *pcb, const stbi_uc *pcr, int count, int step);
    stbi_uc *(*resample_row_hv_2_kernel)(stbi_uc *out, stbi_uc *in_near, stbi_uc *in_far, int w, int hs);
+   stbi_uc *(*resample_row_v_2_kernel)(stbi_uc *out, stbi_uc *in_near, stbi_uc *in_far, int w, int hs);
+   stbi_uc *(*resample_row_h_2_kernel)(stbi_uc *out, stbi_uc *in_near, stbi_uc *in_far, int w, int hs);
 } stbi__jpeg;
 
 static int stbi__build_huffman(stbi__huffman *h, int *count)
@@ -2703,84 +3088,259 @@ static void stbi__idct_simd(stbi_uc *out, int out_stride, short data[64])
 
 #endif // STBI_SSE2
 
-#ifdef STBI_NEON
-
-// NEON integer IDCT. should produce bit-identical
-// results to the generic C version.
-static void stbi__idct_simd(stbi_uc *out, int out_stride, short data[64])
+#ifdef STBI_AVX2
+// AVX2 integer IDCT. the 16-bit butterflies and the transposes are the SSE2 ones, but each
+// 32-bit product and sum covers a whole row in one register instead of two, halving the
+// multiply-adds and wide adds. bit-identical to the generic C version, like stbi__idct_simd.
+static STBI__AVX2_TARGET void stbi__idct_avx2(stbi_uc *out, int out_stride, short data[64])
 {
-   int16x8_t row0, row1, row2, row3, row4, row5, row6, row7;
+   __m128i row0, row1, row2, row3, row4, row5, row6, row7;
+   __m128i tmp;
 
-   int16x4_t rot0_0 = vdup_n_s16(stbi__f2f(0.5411961f));
-   int16x4_t rot0_1 = vdup_n_s16(stbi__f2f(-1.847759065f));
-   int16x4_t rot0_2 = vdup_n_s16(stbi__f2f( 0.765366865f));
-   int16x4_t rot1_0 = vdup_n_s16(stbi__f2f( 1.175875602f));
-   int16x4_t rot1_1 = vdup_n_s16(stbi__f2f(-0.899976223f));
-   int16x4_t rot1_2 = vdup_n_s16(stbi__f2f(-2.562915447f));
-   int16x4_t rot2_0 = vdup_n_s16(stbi__f2f(-1.961570560f));
-   int16x4_t rot2_1 = vdup_n_s16(stbi__f2f(-0.390180644f));
-   int16x4_t rot3_0 = vdup_n_s16(stbi__f2f( 0.298631336f));
-   int16x4_t rot3_1 = vdup_n_s16(stbi__f2f( 2.053119869f));
-   int16x4_t rot3_2 = vdup_n_s16(stbi__f2f( 3.072711026f));
-   int16x4_t rot3_3 = vdup_n_s16(stbi__f2f( 1.501321110f));
+   // dot product constant: even elems=x, odd elems=y
+   #define dct_const(x,y)  _mm256_setr_epi16((x),(y),(x),(y),(x),(y),(x),(y),(x),(y),(x),(y),(x),(y),(x),(y))
 
-#define dct_long_mul(out, inq, coeff) \
-   int32x4_t out##_l = vmull_s16(vget_low_s16(inq), coeff); \
-   int32x4_t out##_h = vmull_s16(vget_high_s16(inq), coeff)
+   // out(0) = c0[even]*x + c0[odd]*y   (c0, x, y 16-bit, out 32-bit)
+   // out(1) = c1[even]*x + c1[odd]*y
+   #define dct_rot(out0,out1, x,y,c0,c1) \
+      __m256i c0##xy = _mm256_inserti128_si256(_mm256_castsi128_si256(_mm_unpacklo_epi16((x),(y))), \
+                                               _mm_unpackhi_epi16((x),(y)), 1); \
+      __m256i out0 = _mm256_madd_epi16(c0##xy, c0); \
+      __m256i out1 = _mm256_madd_epi16(c0##xy, c1)
 
-#define dct_long_mac(out, acc, inq, coeff) \
-   int32x4_t out##_l = vmlal_s16(acc##_l, vget_low_s16(inq), coeff); \
-   int32x4_t out##_h = vmlal_s16(acc##_h, vget_high_s16(inq), coeff)
+   // out = in << 12  (in 16-bit, out 32-bit)
+   #define dct_widen(out, in) \
+      __m256i out = _mm256_slli_epi32(_mm256_cvtepi16_epi32(in), 12)
 
-#define dct_widen(out, inq) \
-   int32x4_t out##_l = vshll_n_s16(vget_low_s16(inq), 12); \
-   int32x4_t out##_h = vshll_n_s16(vget_high_s16(inq), 12)
+   // wide add
+   #define dct_wadd(out, a, b) \
+      __m256i out = _mm256_add_epi32(a, b)
 
-// wide add
-#define dct_wadd(out, a, b) \
-   int32x4_t out##_l = vaddq_s32(a##_l, b##_l); \
-   int32x4_t out##_h = vaddq_s32(a##_h, b##_h)
+   // wide sub
+   #define dct_wsub(out, a, b) \
+      __m256i out = _mm256_sub_epi32(a, b)
 
-// wide sub
-#define dct_wsub(out, a, b) \
-   int32x4_t out##_l = vsubq_s32(a##_l, b##_l); \
-   int32x4_t out##_h = vsubq_s32(a##_h, b##_h)
+   // butterfly a/b, add bias, then shift by "s" and pack both results in one go
+   #define dct_bfly32o(out0, out1, a,b,bias,s) \
+      { \
+         __m256i abiased = _mm256_add_epi32(a, bias); \
+         __m256i sum = _mm256_srai_epi32(_mm256_add_epi32(abiased, b), s); \
+         __m256i dif = _mm256_srai_epi32(_mm256_sub_epi32(abiased, b), s); \
+         __m256i packed = _mm256_permute4x64_epi64(_mm256_packs_epi32(sum, dif), 0xd8); \
+         out0 = _mm256_castsi256_si128(packed); \
+         out1 = _mm256_extracti128_si256(packed, 1); \
+      }
 
-// butterfly a/b, then shift using "shiftop" by "s" and pack
-#define dct_bfly32o(out0,out1, a,b,shiftop,s) \
-   { \
-      dct_wadd(sum, a, b); \
-      dct_wsub(dif, a, b); \
-      out0 = vcombine_s16(shiftop(sum_l, s), shiftop(sum_h, s)); \
-      out1 = vcombine_s16(shiftop(dif_l, s), shiftop(dif_h, s)); \
-   }
+   // 8-bit interleave step (for transposes)
+   #define dct_interleave8(a, b) \
+      tmp = a; \
+      a = _mm_unpacklo_epi8(a, b); \
+      b = _mm_unpackhi_epi8(tmp, b)
 
-#define dct_pass(shiftop, shift) \
-   { \
-      /* even part */ \
-      int16x8_t sum26 = vaddq_s16(row2, row6); \
-      dct_long_mul(p1e, sum26, rot0_0); \
-      dct_long_mac(t2e, p1e, row6, rot0_1); \
-      dct_long_mac(t3e, p1e, row2, rot0_2); \
-      int16x8_t sum04 = vaddq_s16(row0, row4); \
-      int16x8_t dif04 = vsubq_s16(row0, row4); \
-      dct_widen(t0e, sum04); \
-      dct_widen(t1e, dif04); \
-      dct_wadd(x0, t0e, t3e); \
-      dct_wsub(x3, t0e, t3e); \
-      dct_wadd(x1, t1e, t2e); \
-      dct_wsub(x2, t1e, t2e); \
-      /* odd part */ \
-      int16x8_t sum15 = vaddq_s16(row1, row5); \
-      int16x8_t sum17 = vaddq_s16(row1, row7); \
-      int16x8_t sum35 = vaddq_s16(row3, row5); \
-      int16x8_t sum37 = vaddq_s16(row3, row7); \
-      int16x8_t sumodd = vaddq_s16(sum17, sum35); \
-      dct_long_mul(p5o, sumodd, rot1_0); \
-      dct_long_mac(p1o, p5o, sum17, rot1_1); \
-      dct_long_mac(p2o, p5o, sum35, rot1_2); \
-      dct_long_mul(p3o, sum37, rot2_0); \
-      dct_long_mul(p4o, sum15, rot2_1); \
+   // 16-bit interleave step (for transposes)
+   #define dct_interleave16(a, b) \
+      tmp = a; \
+      a = _mm_unpacklo_epi16(a, b); \
+      b = _mm_unpackhi_epi16(tmp, b)
+
+   #define dct_pass(bias,shift) \
+      { \
+         /* even part */ \
+         dct_rot(t2e,t3e, row2,row6, rot0_0,rot0_1); \
+         __m128i sum04 = _mm_add_epi16(row0, row4); \
+         __m128i dif04 = _mm_sub_epi16(row0, row4); \
+         dct_widen(t0e, sum04); \
+         dct_widen(t1e, dif04); \
+         dct_wadd(x0, t0e, t3e); \
+         dct_wsub(x3, t0e, t3e); \
+         dct_wadd(x1, t1e, t2e); \
+         dct_wsub(x2, t1e, t2e); \
+         /* odd part */ \
+         dct_rot(y0o,y2o, row7,row3, rot2_0,rot2_1); \
+         dct_rot(y1o,y3o, row5,row1, rot3_0,rot3_1); \
+         __m128i sum17 = _mm_add_epi16(row1, row7); \
+         __m128i sum35 = _mm_add_epi16(row3, row5); \
+         dct_rot(y4o,y5o, sum17,sum35, rot1_0,rot1_1); \
+         dct_wadd(x4, y0o, y4o); \
+         dct_wadd(x5, y1o, y5o); \
+         dct_wadd(x6, y2o, y5o); \
+         dct_wadd(x7, y3o, y4o); \
+         dct_bfly32o(row0,row7, x0,x7,bias,shift); \
+         dct_bfly32o(row1,row6, x1,x6,bias,shift); \
+         dct_bfly32o(row2,row5, x2,x5,bias,shift); \
+         dct_bfly32o(row3,row4, x3,x4,bias,shift); \
+      }
+
+   __m256i rot0_0 = dct_const(stbi__f2f(0.5411961f), stbi__f2f(0.5411961f) + stbi__f2f(-1.847759065f));
+   __m256i rot0_1 = dct_const(stbi__f2f(0.5411961f) + stbi__f2f( 0.765366865f), stbi__f2f(0.5411961f));
+   __m256i rot1_0 = dct_const(stbi__f2f(1.175875602f) + stbi__f2f(-0.899976223f), stbi__f2f(1.175875602f));
+   __m256i rot1_1 = dct_const(stbi__f2f(1.175875602f), stbi__f2f(1.175875602f) + stbi__f2f(-2.562915447f));
+   __m256i rot2_0 = dct_const(stbi__f2f(-1.961570560f) + stbi__f2f( 0.298631336f), stbi__f2f(-1.961570560f));
+   __m256i rot2_1 = dct_const(stbi__f2f(-1.961570560f), stbi__f2f(-1.961570560f) + stbi__f2f( 3.072711026f));
+   __m256i rot3_0 = dct_const(stbi__f2f(-0.390180644f) + stbi__f2f( 2.053119869f), stbi__f2f(-0.390180644f));
+   __m256i rot3_1 = dct_const(stbi__f2f(-0.390180644f), stbi__f2f(-0.390180644f) + stbi__f2f( 1.501321110f));
+
+   // rounding biases in column/row passes, see stbi__idct_block for explanation.
+   __m256i bias_0 = _mm256_set1_epi32(512);
+   __m256i bias_1 = _mm256_set1_epi32(65536 + (128<<17));
+
+   // load
+   row0 = _mm_load_si128((const __m128i *) (data + 0*8));
+   row1 = _mm_load_si128((const __m128i *) (data + 1*8));
+   row2 = _mm_load_si128((const __m128i *) (data + 2*8));
+   row3 = _mm_load_si128((const __m128i *) (data + 3*8));
+   row4 = _mm_load_si128((const __m128i *) (data + 4*8));
+   row5 = _mm_load_si128((const __m128i *) (data + 5*8));
+   row6 = _mm_load_si128((const __m128i *) (data + 6*8));
+   row7 = _mm_load_si128((const __m128i *) (data + 7*8));
+
+   // column pass
+   dct_pass(bias_0, 10);
+
+   {
+      // 16bit 8x8 transpose pass 1
+      dct_interleave16(row0, row4);
+      dct_interleave16(row1, row5);
+      dct_interleave16(row2, row6);
+      dct_interleave16(row3, row7);
+
+      // transpose pass 2
+      dct_interleave16(row0, row2);
+      dct_interleave16(row1, row3);
+      dct_interleave16(row4, row6);
+      dct_interleave16(row5, row7);
+
+      // transpose pass 3
+      dct_interleave16(row0, row1);
+      dct_interleave16(row2, row3);
+      dct_interleave16(row4, row5);
+      dct_interleave16(row6, row7);
+   }
+
+   // row pass
+   dct_pass(bias_1, 17);
+
+   {
+      // pack
+      __m128i p0 = _mm_packus_epi16(row0, row1); // a0a1a2a3...a7b0b1b2b3...b7
+      __m128i p1 = _mm_packus_epi16(row2, row3);
+      __m128i p2 = _mm_packus_epi16(row4, row5);
+      __m128i p3 = _mm_packus_epi16(row6, row7);
+
+      // 8bit 8x8 transpose pass 1
+      dct_interleave8(p0, p2); // a0e0a1e1...
+      dct_interleave8(p1, p3); // c0g0c1g1...
+
+      // transpose pass 2
+      dct_interleave8(p0, p1); // a0c0e0g0...
+      dct_interleave8(p2, p3); // b0d0f0h0...
+
+      // transpose pass 3
+      dct_interleave8(p0, p2); // a0b0c0d0...
+      dct_interleave8(p1, p3); // a4b4c4d4...
+
+      // store
+      _mm_storel_epi64((__m128i *) out, p0); out += out_stride;
+      _mm_storel_epi64((__m128i *) out, _mm_shuffle_epi32(p0, 0x4e)); out += out_stride;
+      _mm_storel_epi64((__m128i *) out, p2); out += out_stride;
+      _mm_storel_epi64((__m128i *) out, _mm_shuffle_epi32(p2, 0x4e)); out += out_stride;
+      _mm_storel_epi64((__m128i *) out, p1); out += out_stride;
+      _mm_storel_epi64((__m128i *) out, _mm_shuffle_epi32(p1, 0x4e)); out += out_stride;
+      _mm_storel_epi64((__m128i *) out, p3); out += out_stride;
+      _mm_storel_epi64((__m128i *) out, _mm_shuffle_epi32(p3, 0x4e));
+   }
+
+#undef dct_const
+#undef dct_rot
+#undef dct_widen
+#undef dct_wadd
+#undef dct_wsub
+#undef dct_bfly32o
+#undef dct_interleave8
+#undef dct_interleave16
+#undef dct_pass
+}
+
+#endif // STBI_AVX2
+
+#ifdef STBI_NEON
+
+// NEON integer IDCT. should produce bit-identical
+// results to the generic C version.
+static void stbi__idct_simd(stbi_uc *out, int out_stride, short data[64])
+{
+   int16x8_t row0, row1, row2, row3, row4, row5, row6, row7;
+
+   int16x4_t rot0_0 = vdup_n_s16(stbi__f2f(0.5411961f));
+   int16x4_t rot0_1 = vdup_n_s16(stbi__f2f(-1.847759065f));
+   int16x4_t rot0_2 = vdup_n_s16(stbi__f2f( 0.765366865f));
+   int16x4_t rot1_0 = vdup_n_s16(stbi__f2f( 1.175875602f));
+   int16x4_t rot1_1 = vdup_n_s16(stbi__f2f(-0.899976223f));
+   int16x4_t rot1_2 = vdup_n_s16(stbi__f2f(-2.562915447f));
+   int16x4_t rot2_0 = vdup_n_s16(stbi__f2f(-1.961570560f));
+   int16x4_t rot2_1 = vdup_n_s16(stbi__f2f(-0.390180644f));
+   int16x4_t rot3_0 = vdup_n_s16(stbi__f2f( 0.298631336f));
+   int16x4_t rot3_1 = vdup_n_s16(stbi__f2f( 2.053119869f));
+   int16x4_t rot3_2 = vdup_n_s16(stbi__f2f( 3.072711026f));
+   int16x4_t rot3_3 = vdup_n_s16(stbi__f2f( 1.501321110f));
+
+#define dct_long_mul(out, inq, coeff) \
+   int32x4_t out##_l = vmull_s16(vget_low_s16(inq), coeff); \
+   int32x4_t out##_h = vmull_s16(vget_high_s16(inq), coeff)
+
+#define dct_long_mac(out, acc, inq, coeff) \
+   int32x4_t out##_l = vmlal_s16(acc##_l, vget_low_s16(inq), coeff); \
+   int32x4_t out##_h = vmlal_s16(acc##_h, vget_high_s16(inq), coeff)
+
+#define dct_widen(out, inq) \
+   int32x4_t out##_l = vshll_n_s16(vget_low_s16(inq), 12); \
+   int32x4_t out##_h = vshll_n_s16(vget_high_s16(inq), 12)
+
+// wide add
+#define dct_wadd(out, a, b) \
+   int32x4_t out##_l = vaddq_s32(a##_l, b##_l); \
+   int32x4_t out##_h = vaddq_s32(a##_h, b##_h)
+
+// wide sub
+#define dct_wsub(out, a, b) \
+   int32x4_t out##_l = vsubq_s32(a##_l, b##_l); \
+   int32x4_t out##_h = vsubq_s32(a##_h, b##_h)
+
+// butterfly a/b, then shift using "shiftop" by "s" and pack
+#define dct_bfly32o(out0,out1, a,b,shiftop,s) \
+   { \
+      dct_wadd(sum, a, b); \
+      dct_wsub(dif, a, b); \
+      out0 = vcombine_s16(shiftop(sum_l, s), shiftop(sum_h, s)); \
+      out1 = vcombine_s16(shiftop(dif_l, s), shiftop(dif_h, s)); \
+   }
+
+#define dct_pass(shiftop, shift) \
+   { \
+      /* even part */ \
+      int16x8_t sum26 = vaddq_s16(row2, row6); \
+      dct_long_mul(p1e, sum26, rot0_0); \
+      dct_long_mac(t2e, p1e, row6, rot0_1); \
+      dct_long_mac(t3e, p1e, row2, rot0_2); \
+      int16x8_t sum04 = vaddq_s16(row0, row4); \
+      int16x8_t dif04 = vsubq_s16(row0, row4); \
+      dct_widen(t0e, sum04); \
+      dct_widen(t1e, dif04); \
+      dct_wadd(x0, t0e, t3e); \
+      dct_wsub(x3, t0e, t3e); \
+      dct_wadd(x1, t1e, t2e); \
+      dct_wsub(x2, t1e, t2e); \
+      /* odd part */ \
+      int16x8_t sum15 = vaddq_s16(row1, row5); \
+      int16x8_t sum17 = vaddq_s16(row1, row7); \
+      int16x8_t sum35 = vaddq_s16(row3, row5); \
+      int16x8_t sum37 = vaddq_s16(row3, row7); \
+      int16x8_t sumodd = vaddq_s16(sum17, sum35); \
+      dct_long_mul(p5o, sumodd, rot1_0); \
+      dct_long_mac(p1o, p5o, sum17, rot1_1); \
+      dct_long_mac(p2o, p5o, sum35, rot1_2); \
+      dct_long_mul(p3o, sum37, rot2_0); \
+      dct_long_mul(p4o, sum15, rot2_1); \
       dct_wadd(sump13o, p1o, p3o); \
       dct_wadd(sump24o, p2o, p4o); \
       dct_wadd(sump23o, p2o, p3o); \
@@ -2945,14 +3505,264 @@ static void stbi__jpeg_reset(stbi__jpeg *j)
    // since we don't even allow 1<<30 pixels
 }
 
+// per-thread stage timing, see stbi_jpeg_stage_timing
+#ifdef STBI_THREAD_LOCAL
+static STBI_THREAD_LOCAL int stbi__jpeg_timing;
+static STBI_THREAD_LOCAL stbi_jpeg_stage_ticks stbi__jpeg_ticks;
+#else
+static int stbi__jpeg_timing;
+static stbi_jpeg_stage_ticks stbi__jpeg_ticks;
+#endif
+
+static unsigned long long stbi__ticks(void)
+{
+#if defined(_MSC_VER) && _MSC_VER >= 1400 && defined(STBI_SSE2)
+   return __rdtsc();
+#elif defined(__GNUC__) && (defined(STBI__X86_TARGET) || defined(STBI__X64_TARGET))
+   return __builtin_ia32_rdtsc();
+#else
+   return 0;
+#endif
+}
+
+// charge the ticks since *tick to one stage and restart the clock from now
+static void stbi__jpeg_stage(unsigned long long *tick, unsigned long long *stage)
+{
+   if (stbi__jpeg_timing) {
+      unsigned long long now = stbi__ticks();
+      *stage += now - *tick;
+      *tick = now;
+   }
+}
+
+STBIDEF void stbi_jpeg_stage_timing(int flag_true_if_should_time)
+{
+   stbi__jpeg_timing = flag_true_if_should_time;
+}
+
+STBIDEF void stbi_jpeg_get_stage_ticks(stbi_jpeg_stage_ticks *ticks, int reset)
+{
+   *ticks = stbi__jpeg_ticks;
+   if (reset)
+      memset(&stbi__jpeg_ticks, 0, sizeof(stbi__jpeg_ticks));
+}
+
+// per-thread parallel decoding hooks, see stbi_jpeg_set_parallel
+#ifdef STBI_THREAD_LOCAL
+static STBI_THREAD_LOCAL stbi_parallel_for *stbi__jpeg_parallel_run;
+static STBI_THREAD_LOCAL void *stbi__jpeg_parallel_pool;
+static STBI_THREAD_LOCAL int stbi__jpeg_parallel_threads;
+#else
+static stbi_parallel_for *stbi__jpeg_parallel_run;
+static void *stbi__jpeg_parallel_pool;
+static int stbi__jpeg_parallel_threads;
+#endif
+
+// smaller images decode in about a millisecond, not worth handing to other threads
+#define STBI__JPEG_PARALLEL_MIN_PIXELS  (1 << 18)
+
+STBIDEF void stbi_jpeg_set_parallel(stbi_parallel_for *run, void *pool, int thread_count)
+{
+   stbi__jpeg_parallel_run = run;
+   stbi__jpeg_parallel_pool = pool;
+   stbi__jpeg_parallel_threads = thread_count;
+}
+
+// number of threads to spread this image over, 1 to decode it serially
+static int stbi__jpeg_parallel(stbi__jpeg *z)
+{
+   if (!stbi__jpeg_parallel_run || stbi__jpeg_parallel_threads < 2)
+      return 1;
+   // windowed planes are decoded and put a few rows at a time, in order
+   if (z->window)
+      return 1;
+   if ((double) z->s->img_x * z->s->img_y < STBI__JPEG_PARALLEL_MIN_PIXELS)
+      return 1;
+   return stbi__jpeg_parallel_threads;
+}
+
+// split count items into a few tasks per thread, so uneven tasks still balance;
+// returns the number of tasks and sets the items per task
+static int stbi__jpeg_split(int count, int threads, int *per_task)
+{
+   int tasks = threads > 1 ? threads * 4 : 1;
+   if (tasks > count) tasks = count;
+   *per_task = (count + tasks - 1) / tasks;
+   return (count + *per_task - 1) / *per_task;
+}
+
+static void stbi__jpeg_run(stbi_parallel_task *task, void *task_data, int count)
+{
+   if (count > 1)
+      stbi__jpeg_parallel_run(stbi__jpeg_parallel_pool, task, task_data, count);
+   else if (count == 1)
+      task(task_data, 0);
+}
+
+// decode and idct count baseline MCUs starting at MCU first, for one restart interval
+static int stbi__jpeg_decode_mcus(stbi__jpeg *z, int first, int count)
+{
+   STBI_SIMD_ALIGN(short, data[64]);
+   int m;
+   if (z->scan_n == 1) {
+      int n = z->order[0], ha = z->img_comp[n].ha;
+      int w = (z->img_comp[n].x+7) >> 3;
+      for (m=first; m < first+count; ++m) {
+         int i = m % w, j = m / w;
+         if (!stbi__jpeg_decode_block(z, data, z->huff_dc+z->img_comp[n].hd, z->huff_ac+ha, z->fast_ac[ha], n, z->dequant[z->img_comp[n].tq])) return 0;
+         z->idct_block_kernel(z->img_comp[n].data+z->img_comp[n].w2*j*8+i*8, z->img_comp[n].w2, data);
+      }
+   } else {
+      int k,x,y;
+      for (m=first; m < first+count; ++m) {
+         int i = m % z->img_mcu_x, j = m / z->img_mcu_x;
+         for (k=0; k < z->scan_n; ++k) {
+            int n = z->order[k], ha = z->img_comp[n].ha;
+            for (y=0; y < z->img_comp[n].v; ++y) {
+               for (x=0; x < z->img_comp[n].h; ++x) {
+                  int x2 = (i*z->img_comp[n].h + x)*8;
+                  int y2 = (j*z->img_comp[n].v + y)*8;
+                  if (!stbi__jpeg_decode_block(z, data, z->huff_dc+z->img_comp[n].hd, z->huff_ac+ha, z->fast_ac[ha], n, z->dequant[z->img_comp[n].tq])) return 0;
+                  z->idct_block_kernel(z->img_comp[n].data+z->img_comp[n].w2*y2+x2, z->img_comp[n].w2, data);
+               }
+            }
+         }
+      }
+   }
+   return 1;
+}
+
+typedef struct
+{
+   stbi__jpeg *z;
+   stbi_uc **start, **end; // entropy-coded data of each restart interval
+   stbi_uc *ok;            // per task
+   int mcus, intervals, per_task;
+} stbi__jpeg_interval_job;
+
+static void stbi__jpeg_decode_intervals(void *task_data, int index)
+{
+   stbi__jpeg_interval_job *job = (stbi__jpeg_interval_job *) task_data;
+   int k = index * job->per_task, last = k + job->per_task, ri = job->z->restart_interval;
+   // every task decodes with its own bit reader and dc predictions
+   stbi__jpeg *z = (stbi__jpeg *) stbi__malloc(sizeof(stbi__jpeg));
+   stbi__context s;
+   job->ok[index] = z != NULL;
+   if (!z) return;
+   memcpy(z, job->z, sizeof(*z));
+   memcpy(&s, job->z->s, sizeof(s));
+   z->s = &s;
+   if (last > job->intervals) last = job->intervals;
+   for (; k < last && job->ok[index]; ++k) {
+      int count = job->mcus - k*ri < ri ? job->mcus - k*ri : ri;
+      s.img_buffer = job->start[k];
+      s.img_buffer_end = job->end[k];
+      stbi__jpeg_reset(z);
+      job->ok[index] = (stbi_uc) stbi__jpeg_decode_mcus(z, k*ri, count);
+   }
+   STBI_FREE(z);
+}
+
+// find where each restart interval of the scan at the current position starts and ends,
+// without consuming anything; 0 unless there is exactly the expected number of intervals
+static int stbi__jpeg_find_intervals(stbi__jpeg *z, stbi__jpeg_interval_job *job)
+{
+   stbi_uc *p = z->s->img_buffer, *end = z->s->img_buffer_end;
+   int count = 0;
+   job->start[0] = p;
+   for (;;) {
+      p = (stbi_uc *) memchr(p, 0xff, end - p);
+      if (!p || p+1 >= end) return 0; // truncated, leave it to the serial decoder
+      if (p[1] == 0x00) { p += 2; continue; } // stuffed zero
+      if (p[1] == 0xff) { p += 1; continue; } // fill byte
+      job->end[count++] = p;
+      if (!STBI__RESTART(p[1])) break;
+      if (count == job->intervals) return 0;
+      p += 2;
+      job->start[count] = p;
+   }
+   return count == job->intervals;
+}
+
+// decode a baseline scan with restart markers by spreading its intervals over threads;
+// returns 0 without having consumed anything if the scan has to be decoded serially
+static int stbi__jpeg_parallel_scan(stbi__jpeg *z, int threads)
+{
+   stbi__jpeg_interval_job job;
+   int n = z->order[0], ri = z->restart_interval, tasks, k, ok;
+   if (!ri || z->s->read_from_callbacks)
+      return 0;
+   job.z = z;
+   if (z->scan_n == 1)
+      job.mcus = ((z->img_comp[n].x+7) >> 3) * ((z->img_comp[n].y+7) >> 3);
+   else
+      job.mcus = z->img_mcu_x * z->img_mcu_y;
+   job.intervals = (job.mcus + ri - 1) / ri;
+   if (job.intervals < 2)
+      return 0;
+   tasks = stbi__jpeg_split(job.intervals, threads, &job.per_task);
+   job.start = (stbi_uc **) stbi__malloc_mad3(job.intervals, 2, sizeof(stbi_uc *), tasks);
+   if (!job.start)
+      return 0;
+   job.end = job.start + job.intervals;
+   job.ok = (stbi_uc *) (job.end + job.intervals);
+   ok = stbi__jpeg_find_intervals(z, &job);
+   if (ok) {
+      stbi__jpeg_run(stbi__jpeg_decode_intervals, &job, tasks);
+      for (k=0; k < tasks; ++k)
+         ok &= job.ok[k];
+   }
+   if (ok) {
+      // continue after the marker that ends the scan, as the serial decoder would
+      stbi_uc *marker = job.end[job.intervals-1];
+      z->s->img_buffer = marker + 2;
+      z->marker = marker[1];
+   }
+   STBI_FREE(job.start);
+   return ok;
+}
+
+// without restart markers the entropy decoding has to stay serial; store the coefficients
+// of this scan's components like a progressive scan does, so the idct can run in parallel
+// from stbi__jpeg_finish
+static int stbi__jpeg_defer_idct(stbi__jpeg *z)
+{
+   int k;
+   for (k=0; k < z->scan_n; ++k) {
+      int n = z->order[k];
+      if (z->img_comp[n].coeff) continue;
+      z->img_comp[n].coeff_w = z->img_comp[n].w2 / 8;
+      z->img_comp[n].coeff_h = z->img_comp[n].h2 / 8;
+      z->img_comp[n].raw_coeff = stbi__malloc_mad3(z->img_comp[n].w2, z->img_comp[n].h2, sizeof(short), 15);
+      if (z->img_comp[n].raw_coeff == NULL)
+         return stbi__err("outofmem", "Out of memory");
+      z->img_comp[n].coeff = (short*) (((size_t) z->img_comp[n].raw_coeff + 15) & ~15);
+   }
+   return 1;
+}
+
+static int stbi__jpeg_stream_scan(stbi__jpeg *z);
+static int stbi__jpeg_stream_unit(stbi__jpeg *z);
+
 static int stbi__parse_entropy_coded_data(stbi__jpeg *z)
 {
    stbi__jpeg_reset(z);
    if (!z->progressive) {
+      int threads = stbi__jpeg_parallel(z);
+      if (threads > 1) {
+         // restart intervals decode and idct in parallel, charged to entropy
+         unsigned long long tick = stbi__jpeg_timing ? stbi__ticks() : 0;
+         if (stbi__jpeg_parallel_scan(z, threads)) {
+            stbi__jpeg_stage(&tick, &stbi__jpeg_ticks.entropy);
+            return 1;
+         }
+         if (!stbi__jpeg_defer_idct(z)) return 0;
+      }
       if (z->scan_n == 1) {
          int i,j;
          STBI_SIMD_ALIGN(short, data[64]);
          int n = z->order[0];
+         unsigned long long tick = stbi__jpeg_timing ? stbi__ticks() : 0;
          // non-interleaved data, we just need to process one block at a time,
          // in trivial scanline order
          // number of blocks to do just depends on how many actual "pixels" this
@@ -2962,8 +3772,14 @@ static int stbi__parse_entropy_coded_data(stbi__jpeg *z)
          for (j=0; j < h; ++j) {
             for (i=0; i < w; ++i) {
                int ha = z->img_comp[n].ha;
-               if (!stbi__jpeg_decode_block(z, data, z->huff_dc+z->img_comp[n].hd, z->huff_ac+ha, z->fast_ac[ha], n, z->dequant[z->img_comp[n].tq])) return 0;
-               z->idct_block_kernel(z->img_comp[n].data+z->img_comp[n].w2*j*8+i*8, z->img_comp[n].w2, data);
+               // deferred idct: decode straight into the coefficient buffer
+               short *block = z->img_comp[n].coeff ? z->img_comp[n].coeff + 64 * (i + j * z->img_comp[n].coeff_w) : data;
+               if (!stbi__jpeg_decode_block(z, block, z->huff_dc+z->img_comp[n].hd, z->huff_ac+ha, z->fast_ac[ha], n, z->dequant[z->img_comp[n].tq])) return 0;
+               stbi__jpeg_stage(&tick, &stbi__jpeg_ticks.entropy);
+               if (!z->img_comp[n].coeff) {
+                  z->idct_block_kernel(z->img_comp[n].data+z->img_comp[n].w2*(j*8-z->img_comp[n].row0)+i*8, z->img_comp[n].w2, data);
+                  stbi__jpeg_stage(&tick, &stbi__jpeg_ticks.idct);
+               }
                // every data block is an MCU, so countdown the restart interval
                if (--z->todo <= 0) {
                   if (z->code_bits < 24) stbi__grow_buffer_unsafe(z);
@@ -2973,11 +3789,13 @@ static int stbi__parse_entropy_coded_data(stbi__jpeg *z)
                   stbi__jpeg_reset(z);
                }
             }
+            if (z->stream && !stbi__jpeg_stream_unit(z)) return 0;
          }
          return 1;
       } else { // interleaved
          int i,j,k,x,y;
          STBI_SIMD_ALIGN(short, data[64]);
+         unsigned long long tick = stbi__jpeg_timing ? stbi__ticks() : 0;
          for (j=0; j < z->img_mcu_y; ++j) {
             for (i=0; i < z->img_mcu_x; ++i) {
                // scan an interleaved mcu... process scan_n components in order
@@ -2990,8 +3808,13 @@ static int stbi__parse_entropy_coded_data(stbi__jpeg *z)
                         int x2 = (i*z->img_comp[n].h + x)*8;
                         int y2 = (j*z->img_comp[n].v + y)*8;
                         int ha = z->img_comp[n].ha;
-                        if (!stbi__jpeg_decode_block(z, data, z->huff_dc+z->img_comp[n].hd, z->huff_ac+ha, z->fast_ac[ha], n, z->dequant[z->img_comp[n].tq])) return 0;
-                        z->idct_block_kernel(z->img_comp[n].data+z->img_comp[n].w2*y2+x2, z->img_comp[n].w2, data);
+                        short *block = z->img_comp[n].coeff ? z->img_comp[n].coeff + 64 * ((x2 >> 3) + (y2 >> 3) * z->img_comp[n].coeff_w) : data;
+                        if (!stbi__jpeg_decode_block(z, block, z->huff_dc+z->img_comp[n].hd, z->huff_ac+ha, z->fast_ac[ha], n, z->dequant[z->img_comp[n].tq])) return 0;
+                        stbi__jpeg_stage(&tick, &stbi__jpeg_ticks.entropy);
+                        if (!z->img_comp[n].coeff) {
+                           z->idct_block_kernel(z->img_comp[n].data+z->img_comp[n].w2*(y2-z->img_comp[n].row0)+x2, z->img_comp[n].w2, data);
+                           stbi__jpeg_stage(&tick, &stbi__jpeg_ticks.idct);
+                        }
                      }
                   }
                }
@@ -3003,6 +3826,7 @@ static int stbi__parse_entropy_coded_data(stbi__jpeg *z)
                   stbi__jpeg_reset(z);
                }
             }
+            if (z->stream && !stbi__jpeg_stream_unit(z)) return 0;
          }
          return 1;
       }
@@ -3076,25 +3900,52 @@ static void stbi__jpeg_dequantize(short *data, stbi__uint16 *dequant)
       data[i] *= dequant[i];
 }
 
-static void stbi__jpeg_finish(stbi__jpeg *z)
+typedef struct
 {
-   if (z->progressive) {
-      // dequantize and idct the data
-      int i,j,n;
-      for (n=0; n < z->s->img_n; ++n) {
-         int w = (z->img_comp[n].x+7) >> 3;
-         int h = (z->img_comp[n].y+7) >> 3;
-         for (j=0; j < h; ++j) {
-            for (i=0; i < w; ++i) {
-               short *data = z->img_comp[n].coeff + 64 * (i + j * z->img_comp[n].coeff_w);
+   stbi__jpeg *z;
+   int rows, per_task; // block rows of all components with stored coefficients
+} stbi__jpeg_idct_job;
+
+static void stbi__jpeg_idct_rows(void *task_data, int index)
+{
+   stbi__jpeg_idct_job *job = (stbi__jpeg_idct_job *) task_data;
+   stbi__jpeg *z = job->z;
+   int first = index * job->per_task, last = first + job->per_task, row = 0;
+   int i,j,n;
+   for (n=0; n < z->s->img_n && row < last; ++n) {
+      int w = (z->img_comp[n].x+7) >> 3;
+      int h = (z->img_comp[n].y+7) >> 3;
+      if (!z->img_comp[n].coeff) continue;
+      for (j=0; j < h && row < last; ++j, ++row) {
+         if (row < first) continue;
+         for (i=0; i < w; ++i) {
+            short *data = z->img_comp[n].coeff + 64 * (i + j * z->img_comp[n].coeff_w);
+            // baseline blocks were dequantized while decoding
+            if (z->progressive)
                stbi__jpeg_dequantize(data, z->dequant[z->img_comp[n].tq]);
-               z->idct_block_kernel(z->img_comp[n].data+z->img_comp[n].w2*j*8+i*8, z->img_comp[n].w2, data);
-            }
+            z->idct_block_kernel(z->img_comp[n].data+z->img_comp[n].w2*j*8+i*8, z->img_comp[n].w2, data);
          }
       }
    }
 }
 
+static void stbi__jpeg_finish(stbi__jpeg *z)
+{
+   // idct the coefficients that progressive scans and deferred baseline scans stored
+   stbi__jpeg_idct_job job;
+   int n, tasks;
+   unsigned long long tick = stbi__jpeg_timing ? stbi__ticks() : 0;
+   job.z = z;
+   job.rows = 0;
+   for (n=0; n < z->s->img_n; ++n)
+      if (z->img_comp[n].coeff)
+         job.rows += (z->img_comp[n].y+7) >> 3;
+   if (!job.rows) return;
+   tasks = stbi__jpeg_split(job.rows, stbi__jpeg_parallel(z), &job.per_task);
+   stbi__jpeg_run(stbi__jpeg_idct_rows, &job, tasks);
+   stbi__jpeg_stage(&tick, &stbi__jpeg_ticks.idct);
+}
+
 static int stbi__process_marker(stbi__jpeg *z, int m)
 {
    int L;
@@ -3263,7 +4114,7 @@ static int stbi__free_jpeg_components(stbi__jpeg *z, int ncomp, int why)
 static int stbi__process_frame_header(stbi__jpeg *z, int scan)
 {
    stbi__context *s = z->s;
-   int Lf,p,i,q, h_max=1,v_max=1,c;
+   int Lf,p,i,q, h_max=1,v_max=1,c,rows;
    Lf = stbi__get16be(s);         if (Lf < 11) return stbi__err("bad SOF len","Corrupt JPEG"); // JPEG
    p  = stbi__get8(s);            if (p != 8) return stbi__err("only 8-bit","JPEG format not supported: 8-bit only"); // JPEG baseline
    s->img_y = stbi__get16be(s);   if (s->img_y == 0) return stbi__err("no header height", "JPEG format not supported: delayed height"); // Legal, but we don't handle it--but neither does IJG
@@ -3316,6 +4167,7 @@ static int stbi__process_frame_header(stbi__jpeg *z, int scan)
    // these sizes can't be more than 17 bits
    z->img_mcu_x = (s->img_x + z->img_mcu_w-1) / z->img_mcu_w;
    z->img_mcu_y = (s->img_y + z->img_mcu_h-1) / z->img_mcu_h;
+   z->window = z->stream && !z->progressive;
 
    for (i=0; i < s->img_n; ++i) {
       // number of effective pixels (e.g. for non-interleaved MCU)
@@ -3333,7 +4185,14 @@ static int stbi__process_frame_header(stbi__jpeg *z, int scan)
       z->img_comp[i].coeff = 0;
       z->img_comp[i].raw_coeff = 0;
       z->img_comp[i].linebuf = NULL;
-      z->img_comp[i].raw_data = stbi__malloc_mad2(z->img_comp[i].w2, z->img_comp[i].h2, 15);
+      z->img_comp[i].row0 = 0;
+      rows = z->img_comp[i].h2;
+      if (z->window) {
+         // two units of rows, an MCU row each or a block row of a lone component
+         int unit = s->img_n == 1 ? 8 : z->img_comp[i].v * 8;
+         if (rows > 2*unit) rows = 2*unit;
+      }
+      z->img_comp[i].raw_data = stbi__malloc_mad2(z->img_comp[i].w2, rows, 15);
       if (z->img_comp[i].raw_data == NULL)
          return stbi__free_jpeg_components(z, i+1, stbi__err("outofmem", "Out of memory"));
       // align blocks for idct using mmx/sse
@@ -3420,8 +4279,12 @@ static int stbi__decode_jpeg_image(stbi__jpeg *j)
    m = stbi__get_marker(j);
    while (!stbi__EOI(m)) {
       if (stbi__SOS(m)) {
+         // progressive scans only decode coefficients, the idct runs in stbi__jpeg_finish
+         unsigned long long tick = stbi__jpeg_timing ? stbi__ticks() : 0;
          if (!stbi__process_scan_header(j)) return 0;
+         if (j->stream && !stbi__jpeg_stream_scan(j)) return 0;
          if (!stbi__parse_entropy_coded_data(j)) return 0;
+         if (j->progressive) stbi__jpeg_stage(&tick, &stbi__jpeg_ticks.entropy);
          if (j->marker == STBI__MARKER_none ) {
          j->marker = stbi__skip_jpeg_junk_at_end(j);
             // if we reach eof without hitting a marker, stbi__get_marker() below will fail and we'll eventually return 0
@@ -3436,12 +4299,11 @@ static int stbi__decode_jpeg_image(stbi__jpeg *j)
          if (NL != j->s->img_y) return stbi__err("bad DNL height", "Corrupt JPEG");
          m = stbi__get_marker(j);
       } else {
-         if (!stbi__process_marker(j, m)) return 1;
+         if (!stbi__process_marker(j, m)) { stbi__jpeg_finish(j); return 1; }
          m = stbi__get_marker(j);
       }
    }
-   if (j->progressive)
-      stbi__jpeg_finish(j);
+   stbi__jpeg_finish(j);
    return 1;
 }
 
@@ -3642,6 +4504,131 @@ static stbi_uc *stbi__resample_row_hv_2_simd(stbi_uc *out, stbi_uc *in_near, stb
 }
 #endif
 
+#ifdef STBI_AVX2
+static STBI__AVX2_TARGET stbi_uc *stbi__resample_row_v_2_avx2(stbi_uc *out, stbi_uc *in_near, stbi_uc *in_far, int w, int hs)
+{
+   // 32 samples at a time; the in-lane unpack and pack cancel out, so no lane fixups
+   int i = 0;
+   __m256i zero = _mm256_setzero_si256();
+   __m256i bias = _mm256_set1_epi16(2);
+   STBI_NOTUSED(hs);
+   for (; i+31 < w; i += 32) {
+      __m256i nearb = _mm256_loadu_si256((__m256i *) (in_near + i));
+      __m256i farb  = _mm256_loadu_si256((__m256i *) (in_far + i));
+      __m256i nearl = _mm256_unpacklo_epi8(nearb, zero);
+      __m256i nearh = _mm256_unpackhi_epi8(nearb, zero);
+      __m256i farl  = _mm256_add_epi16(_mm256_unpacklo_epi8(farb, zero), bias);
+      __m256i farh  = _mm256_add_epi16(_mm256_unpackhi_epi8(farb, zero), bias);
+      __m256i outl  = _mm256_add_epi16(_mm256_add_epi16(_mm256_slli_epi16(nearl, 1), nearl), farl);
+      __m256i outh  = _mm256_add_epi16(_mm256_add_epi16(_mm256_slli_epi16(nearh, 1), nearh), farh);
+      _mm256_storeu_si256((__m256i *) (out + i), _mm256_packus_epi16(_mm256_srli_epi16(outl, 2), _mm256_srli_epi16(outh, 2)));
+   }
+   for (; i < w; ++i)
+      out[i] = stbi__div4(3*in_near[i] + in_far[i] + 2);
+   return out;
+}
+
+static STBI__AVX2_TARGET stbi_uc *stbi__resample_row_h_2_avx2(stbi_uc *out, stbi_uc *in_near, stbi_uc *in_far, int w, int hs)
+{
+   // need to generate two samples horizontally for every one in input
+   int i;
+   stbi_uc *input = in_near;
+
+   if (w == 1) {
+      // if only one sample, can't do any interpolation
+      out[0] = out[1] = input[0];
+      return out;
+   }
+
+   out[0] = input[0];
+   out[1] = stbi__div4(input[0]*3 + input[1] + 2);
+   // 16 input samples at a time, the neighbours come from unaligned loads one sample
+   // either side; the last sample is left to the boundary code below
+   for (i=1; i+16 < w; i += 16) {
+      __m256i curr = _mm256_cvtepu8_epi16(_mm_loadu_si128((__m128i *) (input + i)));
+      __m256i prev = _mm256_cvtepu8_epi16(_mm_loadu_si128((__m128i *) (input + i - 1)));
+      __m256i next = _mm256_cvtepu8_epi16(_mm_loadu_si128((__m128i *) (input + i + 1)));
+      __m256i n    = _mm256_add_epi16(_mm256_add_epi16(_mm256_slli_epi16(curr, 1), curr), _mm256_set1_epi16(2));
+      __m256i even = _mm256_srli_epi16(_mm256_add_epi16(n, prev), 2);
+      __m256i odd  = _mm256_srli_epi16(_mm256_add_epi16(n, next), 2);
+      // interleave even and odd samples; in-lane unpack then pack leaves them in order
+      __m256i int0 = _mm256_unpacklo_epi16(even, odd);
+      __m256i int1 = _mm256_unpackhi_epi16(even, odd);
+      _mm256_storeu_si256((__m256i *) (out + i*2), _mm256_packus_epi16(int0, int1));
+   }
+   for (; i < w-1; ++i) {
+      int n = 3*input[i]+2;
+      out[i*2+0] = stbi__div4(n+input[i-1]);
+      out[i*2+1] = stbi__div4(n+input[i+1]);
+   }
+   out[i*2+0] = stbi__div4(input[w-2]*3 + input[w-1] + 2);
+   out[i*2+1] = input[w-1];
+
+   STBI_NOTUSED(in_far);
+   STBI_NOTUSED(hs);
+
+   return out;
+}
+
+static STBI__AVX2_TARGET stbi_uc *stbi__resample_row_hv_2_avx2(stbi_uc *out, stbi_uc *in_near, stbi_uc *in_far, int w, int hs)
+{
+   // need to generate 2x2 samples for every one in input
+   int i=0,t0,t1;
+
+   if (w == 1) {
+      out[0] = out[1] = stbi__div4(3*in_near[0] + in_far[0] + 2);
+      return out;
+   }
+
+   t1 = 3*in_near[0] + in_far[0];
+   // the stbi__resample_row_hv_2_simd filter on groups of 16 pixels
+   for (; i < ((w-1) & ~15); i += 16) {
+      // vertical pass, 3*x + y = 4*x + (y - x)
+      __m256i farw  = _mm256_cvtepu8_epi16(_mm_loadu_si128((__m128i *) (in_far + i)));
+      __m256i nearw = _mm256_cvtepu8_epi16(_mm_loadu_si128((__m128i *) (in_near + i)));
+      __m256i curr  = _mm256_add_epi16(_mm256_slli_epi16(nearw, 2), _mm256_sub_epi16(farw, nearw));
+
+      // "prev" and "next" are the current row shifted by one pixel. the shift crosses the
+      // 128-bit lanes, so each lane is aligned against its neighbour lane (or zero)
+      __m256i prv0 = _mm256_alignr_epi8(curr, _mm256_permute2x128_si256(curr, curr, 0x08), 14);
+      __m256i nxt0 = _mm256_alignr_epi8(_mm256_permute2x128_si256(curr, curr, 0x81), curr, 2);
+      __m256i prev = _mm256_insert_epi16(prv0, t1, 0);
+      __m256i next = _mm256_insert_epi16(nxt0, 3*in_near[i+16] + in_far[i+16], 15);
+
+      // horizontal filter, polyphase as in the SSE2 version
+      __m256i bias = _mm256_set1_epi16(8);
+      __m256i curb = _mm256_add_epi16(_mm256_slli_epi16(curr, 2), bias);
+      __m256i even = _mm256_add_epi16(_mm256_sub_epi16(prev, curr), curb);
+      __m256i odd  = _mm256_add_epi16(_mm256_sub_epi16(next, curr), curb);
+
+      // interleave even and odd pixels, undo scaling, pack; the in-lane unpack and pack
+      // leave the 32 output bytes in order
+      __m256i int0 = _mm256_srli_epi16(_mm256_unpacklo_epi16(even, odd), 4);
+      __m256i int1 = _mm256_srli_epi16(_mm256_unpackhi_epi16(even, odd), 4);
+      _mm256_storeu_si256((__m256i *) (out + i*2), _mm256_packus_epi16(int0, int1));
+
+      // "previous" value for next iter
+      t1 = 3*in_near[i+15] + in_far[i+15];
+   }
+
+   t0 = t1;
+   t1 = 3*in_near[i] + in_far[i];
+   out[i*2] = stbi__div16(3*t1 + t0 + 8);
+
+   for (++i; i < w; ++i) {
+      t0 = t1;
+      t1 = 3*in_near[i]+in_far[i];
+      out[i*2-1] = stbi__div16(3*t0 + t1 + 8);
+      out[i*2  ] = stbi__div16(3*t1 + t0 + 8);
+   }
+   out[w*2-1] = stbi__div4(t1+2);
+
+   STBI_NOTUSED(hs);
+
+   return out;
+}
+#endif
+
 static stbi_uc *stbi__resample_row_generic(stbi_uc *out, stbi_uc *in_near, stbi_uc *in_far, int w, int hs)
 {
    // resample with nearest-neighbor
@@ -3816,25 +4803,149 @@ static void stbi__YCbCr_to_RGB_simd(stbi_uc *out, stbi_uc const *y, stbi_uc cons
 }
 #endif
 
+#ifdef STBI_AVX2
+static STBI__AVX2_TARGET void stbi__YCbCr_to_RGB_avx2(stbi_uc *out, stbi_uc const *y, stbi_uc const *pcb, stbi_uc const *pcr, int count, int step)
+{
+   int i = 0;
+
+   // the stbi__YCbCr_to_RGB_simd arithmetic on 16 pixels at a time. unlike the SSE2 kernel
+   // this also does step == 3, which is what every load without req_comp asks for.
+   if (step == 3 || step == 4) {
+      __m128i signflip  = _mm_set1_epi8(-0x80);
+      __m256i cr_const0 = _mm256_set1_epi16(   (short) ( 1.40200f*4096.0f+0.5f));
+      __m256i cr_const1 = _mm256_set1_epi16( - (short) ( 0.71414f*4096.0f+0.5f));
+      __m256i cb_const0 = _mm256_set1_epi16( - (short) ( 0.34414f*4096.0f+0.5f));
+      __m256i cb_const1 = _mm256_set1_epi16(   (short) ( 1.77200f*4096.0f+0.5f));
+      __m256i y_bias = _mm256_set1_epi16(128);
+      __m256i xw = _mm256_set1_epi16(255); // alpha channel
+      // drops the alpha byte of the 4 pixels in each 128-bit lane
+      __m256i rgb_shuffle = _mm256_setr_epi8(0,1,2,4,5,6,8,9,10,12,13,14,-1,-1,-1,-1,
+                                             0,1,2,4,5,6,8,9,10,12,13,14,-1,-1,-1,-1);
+      // the step == 3 stores run 4 bytes past the 16 pixels, so stop while 2 more follow
+      int limit = step == 4 ? count - 15 : count - 17;
+
+      for (; i < limit; i += 16) {
+         // load, unpack to short (and left-shift cr, cb by 8)
+         __m256i yw  = _mm256_or_si256(_mm256_slli_epi16(_mm256_cvtepu8_epi16(_mm_loadu_si128((__m128i *) (y+i))), 8), y_bias);
+         __m256i crw = _mm256_slli_epi16(_mm256_cvtepu8_epi16(_mm_xor_si128(_mm_loadu_si128((__m128i *) (pcr+i)), signflip)), 8);
+         __m256i cbw = _mm256_slli_epi16(_mm256_cvtepu8_epi16(_mm_xor_si128(_mm_loadu_si128((__m128i *) (pcb+i)), signflip)), 8);
+
+         // color transform
+         __m256i yws = _mm256_srli_epi16(yw, 4);
+         __m256i cr0 = _mm256_mulhi_epi16(cr_const0, crw);
+         __m256i cb0 = _mm256_mulhi_epi16(cb_const0, cbw);
+         __m256i cb1 = _mm256_mulhi_epi16(cbw, cb_const1);
+         __m256i cr1 = _mm256_mulhi_epi16(crw, cr_const1);
+         __m256i rws = _mm256_add_epi16(cr0, yws);
+         __m256i gwt = _mm256_add_epi16(cb0, yws);
+         __m256i bws = _mm256_add_epi16(yws, cb1);
+         __m256i gws = _mm256_add_epi16(gwt, cr1);
+
+         // descale
+         __m256i rw = _mm256_srai_epi16(rws, 4);
+         __m256i bw = _mm256_srai_epi16(bws, 4);
+         __m256i gw = _mm256_srai_epi16(gws, 4);
+
+         // back to byte, set up for transpose
+         __m256i brb = _mm256_packus_epi16(rw, bw);
+         __m256i gxb = _mm256_packus_epi16(gw, xw);
+
+         // transpose to interleave channels, within each lane
+         __m256i t0 = _mm256_unpacklo_epi8(brb, gxb);
+         __m256i t1 = _mm256_unpackhi_epi8(brb, gxb);
+         __m256i o0 = _mm256_unpacklo_epi16(t0, t1); // pixels 0-3 | 8-11
+         __m256i o1 = _mm256_unpackhi_epi16(t0, t1); // pixels 4-7 | 12-15
+
+         // store
+         if (step == 4) {
+            _mm256_storeu_si256((__m256i *) (out + 0), _mm256_permute2x128_si256(o0, o1, 0x20));
+            _mm256_storeu_si256((__m256i *) (out + 32), _mm256_permute2x128_si256(o0, o1, 0x31));
+            out += 64;
+         } else {
+            // 12 useful bytes per lane, each store overwrites the junk tail of the one before
+            __m256i p0 = _mm256_shuffle_epi8(o0, rgb_shuffle);
+            __m256i p1 = _mm256_shuffle_epi8(o1, rgb_shuffle);
+            _mm_storeu_si128((__m128i *) (out + 0), _mm256_castsi256_si128(p0));
+            _mm_storeu_si128((__m128i *) (out + 12), _mm256_castsi256_si128(p1));
+            _mm_storeu_si128((__m128i *) (out + 24), _mm256_extracti128_si256(p0, 1));
+            _mm_storeu_si128((__m128i *) (out + 36), _mm256_extracti128_si256(p1, 1));
+            out += 48;
+         }
+      }
+   }
+
+   for (; i < count; ++i) {
+      int y_fixed = (y[i] << 20) + (1<<19); // rounding
+      int r,g,b;
+      int cr = pcr[i] - 128;
+      int cb = pcb[i] - 128;
+      r = y_fixed + cr* stbi__float2fixed(1.40200f);
+      g = y_fixed + cr*-stbi__float2fixed(0.71414f) + ((cb*-stbi__float2fixed(0.34414f)) & 0xffff0000);
+      b = y_fixed                                   +   cb* stbi__float2fixed(1.77200f);
+      r >>= 20;
+      g >>= 20;
+      b >>= 20;
+      if ((unsigned) r > 255) { if (r < 0) r = 0; else r = 255; }
+      if ((unsigned) g > 255) { if (g < 0) g = 0; else g = 255; }
+      if ((unsigned) b > 255) { if (b < 0) b = 0; else b = 255; }
+      out[0] = (stbi_uc)r;
+      out[1] = (stbi_uc)g;
+      out[2] = (stbi_uc)b;
+      out[3] = 255;
+      out += step;
+   }
+}
+#endif
+
+static int stbi__jpeg_kernel_cap = STBI_JPEG_KERNELS_AVX2;
+
+STBIDEF void stbi_jpeg_set_kernels(int max_level)
+{
+   stbi__jpeg_kernel_cap = max_level;
+}
+
+STBIDEF int stbi_jpeg_kernels(void)
+{
+   int level = STBI_JPEG_KERNELS_SCALAR;
+#if defined(STBI_SSE2)
+   if (stbi__sse2_available()) level = STBI_JPEG_KERNELS_SIMD;
+#elif defined(STBI_NEON)
+   level = STBI_JPEG_KERNELS_SIMD;
+#endif
+#ifdef STBI_AVX2
+   if (level == STBI_JPEG_KERNELS_SIMD && stbi__avx2_available()) level = STBI_JPEG_KERNELS_AVX2;
+#endif
+   return level < stbi__jpeg_kernel_cap ? level : stbi__jpeg_kernel_cap;
+}
+
 // set up the kernels
 static void stbi__setup_jpeg(stbi__jpeg *j)
 {
+   int level = stbi_jpeg_kernels();
+   STBI_NOTUSED(level);
+
    j->idct_block_kernel = stbi__idct_block;
    j->YCbCr_to_RGB_kernel = stbi__YCbCr_to_RGB_row;
    j->resample_row_hv_2_kernel = stbi__resample_row_hv_2;
+   j->resample_row_v_2_kernel = stbi__resample_row_v_2;
+   j->resample_row_h_2_kernel = stbi__resample_row_h_2;
 
-#ifdef STBI_SSE2
-   if (stbi__sse2_available()) {
+#if defined(STBI_SSE2) || defined(STBI_NEON)
+   if (level >= STBI_JPEG_KERNELS_SIMD) {
       j->idct_block_kernel = stbi__idct_simd;
       j->YCbCr_to_RGB_kernel = stbi__YCbCr_to_RGB_simd;
       j->resample_row_hv_2_kernel = stbi__resample_row_hv_2_simd;
    }
 #endif
 
-#ifdef STBI_NEON
-   j->idct_block_kernel = stbi__idct_simd;
-   j->YCbCr_to_RGB_kernel = stbi__YCbCr_to_RGB_simd;
-   j->resample_row_hv_2_kernel = stbi__resample_row_hv_2_simd;
+#ifdef STBI_AVX2
+   if (level >= STBI_JPEG_KERNELS_AVX2) {
+      j->idct_block_kernel = stbi__idct_avx2;
+      j->YCbCr_to_RGB_kernel = stbi__YCbCr_to_RGB_avx2;
+      j->resample_row_hv_2_kernel = stbi__resample_row_hv_2_avx2;
+      j->resample_row_v_2_kernel = stbi__resample_row_v_2_avx2;
+      j->resample_row_h_2_kernel = stbi__resample_row_h_2_avx2;
+   }
 #endif
 }
 
@@ -3854,11 +4965,273 @@ typedef struct
    int ypos;    // which pre-expansion row we're on
 } stbi__resample;
 
-// fast 0..255 * 0..255 => 0..255 rounded multiplication
-static stbi_uc stbi__blinn_8x8(stbi_uc x, stbi_uc y)
+// fast 0..255 * 0..255 => 0..255 rounded multiplication
+static stbi_uc stbi__blinn_8x8(stbi_uc x, stbi_uc y)
+{
+   unsigned int t = x*y + 128;
+   return (stbi_uc) ((t + (t >>8)) >> 8);
+}
+
+// upsample and color convert one output row, advancing the resampling state; tick is
+// NULL when the rows are timed as a whole
+static void stbi__jpeg_output_row(stbi__jpeg *z, stbi__resample *res_comp, stbi_uc **linebuf, stbi_uc *out, int n, int decode_n, int is_rgb, unsigned long long *tick)
+{
+   int k;
+   unsigned int i;
+   stbi_uc *coutput[4] = { NULL, NULL, NULL, NULL };
+   for (k=0; k < decode_n; ++k) {
+      stbi__resample *r = &res_comp[k];
+      int y_bot = r->ystep >= (r->vs >> 1);
+      coutput[k] = r->resample(linebuf[k],
+                               y_bot ? r->line1 : r->line0,
+                               y_bot ? r->line0 : r->line1,
+                               r->w_lores, r->hs);
+      if (++r->ystep >= r->vs) {
+         r->ystep = 0;
+         r->line0 = r->line1;
+         if (++r->ypos < z->img_comp[k].y)
+            r->line1 += z->img_comp[k].w2;
+      }
+   }
+   if (tick) stbi__jpeg_stage(tick, &stbi__jpeg_ticks.upsample);
+   if (n >= 3) {
+      stbi_uc *y = coutput[0];
+      if (z->s->img_n == 3) {
+         if (is_rgb) {
+            for (i=0; i < z->s->img_x; ++i) {
+               out[0] = y[i];
+               out[1] = coutput[1][i];
+               out[2] = coutput[2][i];
+               out[3] = 255;
+               out += n;
+            }
+         } else {
+            z->YCbCr_to_RGB_kernel(out, y, coutput[1], coutput[2], z->s->img_x, n);
+         }
+      } else if (z->s->img_n == 4) {
+         if (z->app14_color_transform == 0) { // CMYK
+            for (i=0; i < z->s->img_x; ++i) {
+               stbi_uc m = coutput[3][i];
+               out[0] = stbi__blinn_8x8(coutput[0][i], m);
+               out[1] = stbi__blinn_8x8(coutput[1][i], m);
+               out[2] = stbi__blinn_8x8(coutput[2][i], m);
+               out[3] = 255;
+               out += n;
+            }
+         } else if (z->app14_color_transform == 2) { // YCCK
+            z->YCbCr_to_RGB_kernel(out, y, coutput[1], coutput[2], z->s->img_x, n);
+            for (i=0; i < z->s->img_x; ++i) {
+               stbi_uc m = coutput[3][i];
+               out[0] = stbi__blinn_8x8(255 - out[0], m);
+               out[1] = stbi__blinn_8x8(255 - out[1], m);
+               out[2] = stbi__blinn_8x8(255 - out[2], m);
+               out += n;
+            }
+         } else { // YCbCr + alpha?  Ignore the fourth channel for now
+            z->YCbCr_to_RGB_kernel(out, y, coutput[1], coutput[2], z->s->img_x, n);
+         }
+      } else
+         for (i=0; i < z->s->img_x; ++i) {
+            out[0] = out[1] = out[2] = y[i];
+            out[3] = 255; // not used if n==3
+            out += n;
+         }
+   } else {
+      if (is_rgb) {
+         if (n == 1)
+            for (i=0; i < z->s->img_x; ++i)
+               *out++ = stbi__compute_y(coutput[0][i], coutput[1][i], coutput[2][i]);
+         else {
+            for (i=0; i < z->s->img_x; ++i, out += 2) {
+               out[0] = stbi__compute_y(coutput[0][i], coutput[1][i], coutput[2][i]);
+               out[1] = 255;
+            }
+         }
+      } else if (z->s->img_n == 4 && z->app14_color_transform == 0) {
+         for (i=0; i < z->s->img_x; ++i) {
+            stbi_uc m = coutput[3][i];
+            stbi_uc r = stbi__blinn_8x8(coutput[0][i], m);
+            stbi_uc g = stbi__blinn_8x8(coutput[1][i], m);
+            stbi_uc b = stbi__blinn_8x8(coutput[2][i], m);
+            out[0] = stbi__compute_y(r, g, b);
+            out[1] = 255;
+            out += n;
+         }
+      } else if (z->s->img_n == 4 && z->app14_color_transform == 2) {
+         for (i=0; i < z->s->img_x; ++i) {
+            out[0] = stbi__blinn_8x8(255 - coutput[0][i], coutput[3][i]);
+            out[1] = 255;
+            out += n;
+         }
+      } else {
+         stbi_uc *y = coutput[0];
+         if (n == 1)
+            for (i=0; i < z->s->img_x; ++i) out[i] = y[i];
+         else
+            for (i=0; i < z->s->img_x; ++i) { *out++ = y[i]; *out++ = 255; }
+      }
+   }
+   if (tick) stbi__jpeg_stage(tick, &stbi__jpeg_ticks.color);
+}
+
+typedef struct
+{
+   stbi__jpeg *z;
+   stbi__resample *res_comp; // state at the first row
+   stbi_uc *output, *buffers; // line buffers and a spill row for every task
+   int n, decode_n, is_rgb, rows_per_task, tasks, task_bytes;
+} stbi__jpeg_output_job;
+
+static void stbi__jpeg_output_rows(void *task_data, int index)
+{
+   stbi__jpeg_output_job *job = (stbi__jpeg_output_job *) task_data;
+   stbi__jpeg *z = job->z;
+   stbi__resample res_comp[4];
+   stbi_uc *linebuf[4], *spill = job->buffers + (size_t) index * job->task_bytes;
+   unsigned int first = index * job->rows_per_task, last = first + job->rows_per_task, j;
+   unsigned long long tick = stbi__jpeg_timing ? stbi__ticks() : 0;
+   int k;
+   if (last > z->s->img_y) last = z->s->img_y;
+   for (k=0; k < job->decode_n; ++k) {
+      stbi__resample *r = &res_comp[k];
+      *r = job->res_comp[k];
+      linebuf[k] = spill;
+      spill += z->s->img_x + 3;
+      // replay the vertical steps of the rows before this band
+      for (j=0; j < first; ++j) {
+         if (++r->ystep >= r->vs) {
+            r->ystep = 0;
+            r->line0 = r->line1;
+            if (++r->ypos < z->img_comp[k].y)
+               r->line1 += z->img_comp[k].w2;
+         }
+      }
+   }
+   for (j=first; j < last; ++j) {
+      stbi_uc *out = job->output + (size_t) job->n * z->s->img_x * j;
+      // the converters may write a byte past the end of the row, which here would
+      // race with the task converting the next band
+      if (j+1 == last && last < z->s->img_y) {
+         stbi__jpeg_output_row(z, res_comp, linebuf, spill, job->n, job->decode_n, job->is_rgb, NULL);
+         memcpy(out, spill, (size_t) job->n * z->s->img_x);
+      } else
+         stbi__jpeg_output_row(z, res_comp, linebuf, out, job->n, job->decode_n, job->is_rgb, job->tasks == 1 ? &tick : NULL);
+   }
+}
+
+// number of components to decode for n output components, also deciding whether the
+// three components are RGB rather than YCbCr
+static int stbi__jpeg_output_format(stbi__jpeg *z, int req_comp, int *n, int *is_rgb)
+{
+   // determine actual number of components to generate
+   *n = req_comp ? req_comp : z->s->img_n >= 3 ? 3 : 1;
+
+   *is_rgb = z->s->img_n == 3 && (z->rgb == 3 || (z->app14_color_transform == 0 && !z->jfif));
+
+   if (z->s->img_n == 3 && *n < 3 && !*is_rgb)
+      return 1;
+   else
+      return z->s->img_n;
+}
+
+static void stbi__jpeg_resample_setup(stbi__jpeg *z, stbi__resample *res_comp, int decode_n)
+{
+   int k;
+   for (k=0; k < decode_n; ++k) {
+      stbi__resample *r = &res_comp[k];
+
+      r->hs      = z->img_h_max / z->img_comp[k].h;
+      r->vs      = z->img_v_max / z->img_comp[k].v;
+      r->ystep   = r->vs >> 1;
+      r->w_lores = (z->s->img_x + r->hs-1) / r->hs;
+      r->ypos    = 0;
+      r->line0   = r->line1 = z->img_comp[k].data;
+
+      if      (r->hs == 1 && r->vs == 1) r->resample = resample_row_1;
+      else if (r->hs == 1 && r->vs == 2) r->resample = z->resample_row_v_2_kernel;
+      else if (r->hs == 2 && r->vs == 1) r->resample = z->resample_row_h_2_kernel;
+      else if (r->hs == 2 && r->vs == 2) r->resample = z->resample_row_hv_2_kernel;
+      else                               r->resample = stbi__resample_row_generic;
+   }
+}
+
+// baseline rows are upsampled, color converted and put to stbi__context.rows as soon as
+// the MCU rows they need are decoded, with each plane only holding two units of rows;
+// the rows of other images are put once they are decoded whole
+typedef struct stbi__jpeg_stream
+{
+   stbi__resample res_comp[4];
+   stbi_uc *linebuf[4], *out, *buffer;
+   int req_comp, n, decode_n, is_rgb;
+   int scans;
+   int units; // MCU rows decoded, or block rows of a lone component
+   int y;     // rows put
+} stbi__jpeg_stream;
+
+static int stbi__jpeg_stream_scan(stbi__jpeg *z)
+{
+   int i;
+   if (!z->window) return 1;
+   if (z->stream->scans++) return stbi__err("multiple scans","JPEG not supported: streaming a sequential image in more than one scan");
+   if (z->scan_n == z->s->img_n) return 1;
+   // components in separate scans: decode whole planes and put the rows at the end
+   for (i=0; i < z->s->img_n; ++i) {
+      STBI_FREE(z->img_comp[i].raw_data);
+      z->img_comp[i].data = NULL;
+      z->img_comp[i].raw_data = stbi__malloc_mad2(z->img_comp[i].w2, z->img_comp[i].h2, 15);
+      if (z->img_comp[i].raw_data == NULL) return stbi__err("outofmem", "Out of memory");
+      z->img_comp[i].data = (stbi_uc*) (((size_t) z->img_comp[i].raw_data + 15) & ~15);
+   }
+   z->window = 0;
+   return 1;
+}
+
+// put the rows the decoded units are enough for; every unit after the first two slides the
+// planes up by one unit
+static int stbi__jpeg_stream_output(stbi__jpeg *z)
+{
+   stbi__jpeg_stream *st = z->stream;
+   int k, limit = z->s->img_y;
+   if (!st->buffer) {
+      st->decode_n = stbi__jpeg_output_format(z, st->req_comp, &st->n, &st->is_rgb);
+      stbi__jpeg_resample_setup(z, st->res_comp, st->decode_n);
+      // line buffers big enough for upsampling off the edges with upsample factor of 4
+      st->buffer = (stbi_uc *) stbi__malloc_mad2(st->decode_n, z->s->img_x + 3, st->n * z->s->img_x + 1);
+      if (st->buffer == NULL) return stbi__err("outofmem", "Out of memory");
+      for (k=0; k < st->decode_n; ++k)
+         st->linebuf[k] = st->buffer + k * (z->s->img_x + 3);
+      st->out = st->buffer + st->decode_n * (z->s->img_x + 3);
+      if (!stbi__rows_begin(z->s->rows, z->s->img_x, z->s->img_y, z->s->img_n >= 3 ? 3 : 1, st->req_comp)) return 0;
+   }
+   if (z->window) {
+      // upsampling reads half a row of the lowest resolution plane ahead
+      int unit = z->s->img_n == 1 ? 8 : z->img_mcu_h;
+      if (++st->units * unit < limit)
+         limit = st->units * unit - (z->img_v_max >> 1);
+   }
+   for (; st->y < limit; ++st->y) {
+      stbi__jpeg_output_row(z, st->res_comp, st->linebuf, st->out, st->n, st->decode_n, st->is_rgb, NULL);
+      if (!stbi__rows_put(z->s->rows, st->out, 8)) return 0;
+   }
+   if (z->window && st->units >= 2 && st->y < (int) z->s->img_y) {
+      for (k=0; k < z->s->img_n; ++k) {
+         int rows = z->s->img_n == 1 ? 8 : z->img_comp[k].v * 8;
+         size_t bytes = (size_t) rows * z->img_comp[k].w2;
+         memmove(z->img_comp[k].data, z->img_comp[k].data + bytes, bytes);
+         z->img_comp[k].row0 += rows;
+         if (k < st->decode_n) {
+            st->res_comp[k].line0 -= bytes;
+            st->res_comp[k].line1 -= bytes;
+         }
+      }
+   }
+   return 1;
+}
+
+// called after each unit of the scan is decoded
+static int stbi__jpeg_stream_unit(stbi__jpeg *z)
 {
-   unsigned int t = x*y + 128;
-   return (stbi_uc) ((t + (t >>8)) >> 8);
+   return !z->window || stbi__jpeg_stream_output(z);
 }
 
 static stbi_uc *load_jpeg_image(stbi__jpeg *z, int *out_x, int *out_y, int *comp, int req_comp)
@@ -3872,15 +5245,16 @@ static stbi_uc *load_jpeg_image(stbi__jpeg *z, int *out_x, int *out_y, int *comp
    // load a jpeg image from whichever source, but leave in YCbCr format
    if (!stbi__decode_jpeg_image(z)) { stbi__cleanup_jpeg(z); return NULL; }
 
-   // determine actual number of components to generate
-   n = req_comp ? req_comp : z->s->img_n >= 3 ? 3 : 1;
-
-   is_rgb = z->s->img_n == 3 && (z->rgb == 3 || (z->app14_color_transform == 0 && !z->jfif));
+   if (z->stream) {
+      // the rest of the rows, all of them unless the planes were windowed
+      while (z->stream->y < (int) z->s->img_y)
+         if (!stbi__jpeg_stream_output(z)) { stbi__cleanup_jpeg(z); return NULL; }
+      z->s->rows->finished = 1;
+      stbi__cleanup_jpeg(z);
+      return NULL;
+   }
 
-   if (z->s->img_n == 3 && n < 3 && !is_rgb)
-      decode_n = 1;
-   else
-      decode_n = z->s->img_n;
+   decode_n = stbi__jpeg_output_format(z, req_comp, &n, &is_rgb);
 
    // nothing to do if no components requested; check this now to avoid
    // accessing uninitialized coutput[0] later
@@ -3888,139 +5262,38 @@ static stbi_uc *load_jpeg_image(stbi__jpeg *z, int *out_x, int *out_y, int *comp
 
    // resample and color-convert
    {
-      int k;
-      unsigned int i,j;
-      stbi_uc *output;
-      stbi_uc *coutput[4] = { NULL, NULL, NULL, NULL };
-
+      unsigned long long tick;
+      stbi__jpeg_output_job job;
       stbi__resample res_comp[4];
 
-      for (k=0; k < decode_n; ++k) {
-         stbi__resample *r = &res_comp[k];
-
-         // allocate line buffer big enough for upsampling off the edges
-         // with upsample factor of 4
-         z->img_comp[k].linebuf = (stbi_uc *) stbi__malloc(z->s->img_x + 3);
-         if (!z->img_comp[k].linebuf) { stbi__cleanup_jpeg(z); return stbi__errpuc("outofmem", "Out of memory"); }
-
-         r->hs      = z->img_h_max / z->img_comp[k].h;
-         r->vs      = z->img_v_max / z->img_comp[k].v;
-         r->ystep   = r->vs >> 1;
-         r->w_lores = (z->s->img_x + r->hs-1) / r->hs;
-         r->ypos    = 0;
-         r->line0   = r->line1 = z->img_comp[k].data;
-
-         if      (r->hs == 1 && r->vs == 1) r->resample = resample_row_1;
-         else if (r->hs == 1 && r->vs == 2) r->resample = stbi__resample_row_v_2;
-         else if (r->hs == 2 && r->vs == 1) r->resample = stbi__resample_row_h_2;
-         else if (r->hs == 2 && r->vs == 2) r->resample = z->resample_row_hv_2_kernel;
-         else                               r->resample = stbi__resample_row_generic;
-      }
+      stbi__jpeg_resample_setup(z, res_comp, decode_n);
+
+      // bands of rows convert in parallel, each with its own line buffers big enough
+      // for upsampling off the edges with upsample factor of 4
+      job.z = z;
+      job.res_comp = res_comp;
+      job.n = n;
+      job.decode_n = decode_n;
+      job.is_rgb = is_rgb;
+      job.tasks = stbi__jpeg_split(z->s->img_y, stbi__jpeg_parallel(z), &job.rows_per_task);
+      job.task_bytes = decode_n * (z->s->img_x + 3) + n * z->s->img_x + 1;
+      job.buffers = (stbi_uc *) stbi__malloc_mad2(job.tasks, job.task_bytes, 0);
+      if (!job.buffers) { stbi__cleanup_jpeg(z); return stbi__errpuc("outofmem", "Out of memory"); }
 
       // can't error after this so, this is safe
-      output = (stbi_uc *) stbi__malloc_mad3(n, z->s->img_x, z->s->img_y, 1);
-      if (!output) { stbi__cleanup_jpeg(z); return stbi__errpuc("outofmem", "Out of memory"); }
+      job.output = (stbi_uc *) stbi__malloc_mad3(n, z->s->img_x, z->s->img_y, 1);
+      if (!job.output) { STBI_FREE(job.buffers); stbi__cleanup_jpeg(z); return stbi__errpuc("outofmem", "Out of memory"); }
 
       // now go ahead and resample
-      for (j=0; j < z->s->img_y; ++j) {
-         stbi_uc *out = output + n * z->s->img_x * j;
-         for (k=0; k < decode_n; ++k) {
-            stbi__resample *r = &res_comp[k];
-            int y_bot = r->ystep >= (r->vs >> 1);
-            coutput[k] = r->resample(z->img_comp[k].linebuf,
-                                     y_bot ? r->line1 : r->line0,
-                                     y_bot ? r->line0 : r->line1,
-                                     r->w_lores, r->hs);
-            if (++r->ystep >= r->vs) {
-               r->ystep = 0;
-               r->line0 = r->line1;
-               if (++r->ypos < z->img_comp[k].y)
-                  r->line1 += z->img_comp[k].w2;
-            }
-         }
-         if (n >= 3) {
-            stbi_uc *y = coutput[0];
-            if (z->s->img_n == 3) {
-               if (is_rgb) {
-                  for (i=0; i < z->s->img_x; ++i) {
-                     out[0] = y[i];
-                     out[1] = coutput[1][i];
-                     out[2] = coutput[2][i];
-                     out[3] = 255;
-                     out += n;
-                  }
-               } else {
-                  z->YCbCr_to_RGB_kernel(out, y, coutput[1], coutput[2], z->s->img_x, n);
-               }
-            } else if (z->s->img_n == 4) {
-               if (z->app14_color_transform == 0) { // CMYK
-                  for (i=0; i < z->s->img_x; ++i) {
-                     stbi_uc m = coutput[3][i];
-                     out[0] = stbi__blinn_8x8(coutput[0][i], m);
-                     out[1] = stbi__blinn_8x8(coutput[1][i], m);
-                     out[2] = stbi__blinn_8x8(coutput[2][i], m);
-                     out[3] = 255;
-                     out += n;
-                  }
-               } else if (z->app14_color_transform == 2) { // YCCK
-                  z->YCbCr_to_RGB_kernel(out, y, coutput[1], coutput[2], z->s->img_x, n);
-                  for (i=0; i < z->s->img_x; ++i) {
-                     stbi_uc m = coutput[3][i];
-                     out[0] = stbi__blinn_8x8(255 - out[0], m);
-                     out[1] = stbi__blinn_8x8(255 - out[1], m);
-                     out[2] = stbi__blinn_8x8(255 - out[2], m);
-                     out += n;
-                  }
-               } else { // YCbCr + alpha?  Ignore the fourth channel for now
-                  z->YCbCr_to_RGB_kernel(out, y, coutput[1], coutput[2], z->s->img_x, n);
-               }
-            } else
-               for (i=0; i < z->s->img_x; ++i) {
-                  out[0] = out[1] = out[2] = y[i];
-                  out[3] = 255; // not used if n==3
-                  out += n;
-               }
-         } else {
-            if (is_rgb) {
-               if (n == 1)
-                  for (i=0; i < z->s->img_x; ++i)
-                     *out++ = stbi__compute_y(coutput[0][i], coutput[1][i], coutput[2][i]);
-               else {
-                  for (i=0; i < z->s->img_x; ++i, out += 2) {
-                     out[0] = stbi__compute_y(coutput[0][i], coutput[1][i], coutput[2][i]);
-                     out[1] = 255;
-                  }
-               }
-            } else if (z->s->img_n == 4 && z->app14_color_transform == 0) {
-               for (i=0; i < z->s->img_x; ++i) {
-                  stbi_uc m = coutput[3][i];
-                  stbi_uc r = stbi__blinn_8x8(coutput[0][i], m);
-                  stbi_uc g = stbi__blinn_8x8(coutput[1][i], m);
-                  stbi_uc b = stbi__blinn_8x8(coutput[2][i], m);
-                  out[0] = stbi__compute_y(r, g, b);
-                  out[1] = 255;
-                  out += n;
-               }
-            } else if (z->s->img_n == 4 && z->app14_color_transform == 2) {
-               for (i=0; i < z->s->img_x; ++i) {
-                  out[0] = stbi__blinn_8x8(255 - coutput[0][i], coutput[3][i]);
-                  out[1] = 255;
-                  out += n;
-               }
-            } else {
-               stbi_uc *y = coutput[0];
-               if (n == 1)
-                  for (i=0; i < z->s->img_x; ++i) out[i] = y[i];
-               else
-                  for (i=0; i < z->s->img_x; ++i) { *out++ = y[i]; *out++ = 255; }
-            }
-         }
-      }
+      tick = stbi__jpeg_timing ? stbi__ticks() : 0;
+      stbi__jpeg_run(stbi__jpeg_output_rows, &job, job.tasks);
+      if (job.tasks > 1) stbi__jpeg_stage(&tick, &stbi__jpeg_ticks.color);
+      STBI_FREE(job.buffers);
       stbi__cleanup_jpeg(z);
       *out_x = z->s->img_x;
       *out_y = z->s->img_y;
       if (comp) *comp = z->s->img_n >= 3 ? 3 : 1; // report original components, not output
-      return output;
+      return job.output;
    }
 }
 
@@ -4032,8 +5305,18 @@ static void *stbi__jpeg_load(stbi__context *s, int *x, int *y, int *comp, int re
    memset(j, 0, sizeof(stbi__jpeg));
    STBI_NOTUSED(ri);
    j->s = s;
+   if (s->rows) {
+      j->stream = (stbi__jpeg_stream *) stbi__malloc(sizeof(stbi__jpeg_stream));
+      if (!j->stream) { STBI_FREE(j); return stbi__errpuc("outofmem", "Out of memory"); }
+      memset(j->stream, 0, sizeof(stbi__jpeg_stream));
+      j->stream->req_comp = req_comp;
+   }
    stbi__setup_jpeg(j);
    result = load_jpeg_image(j, x,y,comp,req_comp);
+   if (j->stream) {
+      STBI_FREE(j->stream->buffer);
+      STBI_FREE(j->stream);
+   }
    STBI_FREE(j);
    return result;
 }
@@ -4173,6 +5456,10 @@ static int stbi__zbuild_huffman(stbi__zhuffman *z, const stbi_uc *sizelist, int
 //    we require PNG read all the IDATs and combine them into a single
 //    memory buffer
 
+// tables of the fast inflate engine, see stbi__zbuild_fast
+#define STBI__ZFAST_LENGTH_BITS    11
+#define STBI__ZFAST_DISTANCE_BITS  10
+
 typedef struct
 {
    stbi_uc *zbuffer, *zbuffer_end;
@@ -4186,11 +5473,21 @@ typedef struct
    int   z_expandable;
 
    stbi__zhuffman z_length, z_distance;
+   stbi__uint32 zfast_length[1 << STBI__ZFAST_LENGTH_BITS];
+   stbi__uint32 zfast_distance[1 << STBI__ZFAST_DISTANCE_BITS];
+
+   // streaming, see stbi__png_stream: refill tops the input up to at least 8 bytes, keeping
+   // the 8 before zbuffer, and clears itself once the data runs out; drain takes the output
+   // from zout_drained to zout so all but the last 32K can be dropped
+   void *stream;
+   int (*refill)(void *stream);
+   int (*drain)(void *stream);
+   char *zout_drained;
 } stbi__zbuf;
 
 stbi_inline static int stbi__zeof(stbi__zbuf *z)
 {
-   return (z->zbuffer >= z->zbuffer_end);
+   return (z->zbuffer >= z->zbuffer_end && (!z->refill || !z->refill(z->stream)));
 }
 
 stbi_inline static stbi_uc stbi__zget8(stbi__zbuf *z)
@@ -4203,6 +5500,7 @@ static void stbi__fill_bits(stbi__zbuf *z)
    do {
       if (z->code_buffer >= (1U << z->num_bits)) {
         z->zbuffer = z->zbuffer_end;  /* treat this as EOF so we fail. */
+        z->refill = NULL;
         return;
       }
       z->code_buffer |= (unsigned int) stbi__zget8(z) << z->num_bits;
@@ -4274,6 +5572,17 @@ static int stbi__zexpand(stbi__zbuf *z, char *zout, int n)  // need to make room
    char *q;
    unsigned int cur, limit, old_limit;
    z->zout = zout;
+   if (z->drain) {
+      // pass the output on and slide the 32K a match can reach back to the start
+      unsigned int keep;
+      if (!z->drain(z->stream)) return 0;
+      cur  = (unsigned int) (zout - z->zout_start);
+      keep = cur < 32768 ? cur : 32768;
+      memmove(z->zout_start, zout - keep, keep);
+      z->zout = z->zout_drained = z->zout_start + keep;
+      if (z->zout_end - z->zout < n) return stbi__err("output buffer limit","Corrupt PNG");
+      return 1;
+   }
    if (!z->z_expandable) return stbi__err("output buffer limit","Corrupt PNG");
    cur   = (unsigned int) (z->zout - z->zout_start);
    limit = old_limit = (unsigned) (z->zout_end - z->zout_start);
@@ -4305,6 +5614,224 @@ static const int stbi__zdist_base[32] = { 1,2,3,4,5,7,9,13,17,25,33,49,65,97,129
 static const int stbi__zdist_extra[32] =
 { 0,0,0,0,1,1,2,2,3,3,4,4,5,5,6,6,7,7,8,8,9,9,10,10,11,11,12,12,13,13};
 
+// fast inflate engine: one table probe on the low bits of a 64-bit bit buffer resolves a
+// whole literal/length symbol (or two literals whose codes fit in the table together), the
+// base and extra bit count of a length or distance included. Codes longer than the table
+// fall back to the canonical decode of stbi__zhuffman. Entries are
+//    bits 0-3 code length, 4-7 extra bits, 8-12 flags, 16-31 base or literal(s)
+#define STBI__ZF_LITERAL  0x100 // one literal, two with STBI__ZF_PAIR
+#define STBI__ZF_PAIR     0x200
+#define STBI__ZF_END      0x400 // end of block
+#define STBI__ZF_SLOW     0x800 // code longer than the table
+#define STBI__ZF_BAD      0x1000
+// output space that lets literals and matches write without bounds checks, covering the
+// longest match plus the overshoot of the 16 byte copies
+#define STBI__ZFAST_ROOM  (258 + 16)
+
+static int stbi__zlib_fast = 1;
+
+STBIDEF void stbi_zlib_set_fast_inflate(int flag_true_if_fast)
+{
+   stbi__zlib_fast = flag_true_if_fast;
+}
+
+static stbi__uint32 stbi__zfast_entry(int sym, int s, int distance)
+{
+   if (distance)
+      return sym < 30 ? (stbi__uint32) stbi__zdist_base[sym] << 16 | stbi__zdist_extra[sym] << 4 | s : STBI__ZF_BAD;
+   if (sym < 256)
+      return (stbi__uint32) sym << 16 | STBI__ZF_LITERAL | s;
+   if (sym == 256)
+      return STBI__ZF_END | s;
+   // per DEFLATE, length codes 286 and 287 must not appear in compressed data
+   if (sym < 286)
+      return (stbi__uint32) stbi__zlength_base[sym-257] << 16 | stbi__zlength_extra[sym-257] << 4 | s;
+   return STBI__ZF_BAD;
+}
+
+// decode a code longer than the fast table the canonical way
+static stbi__uint32 stbi__zfast_slow(stbi__zhuffman *z, stbi__uint64 bits, int distance)
+{
+   int b,s,k = stbi__bit_reverse((int) (bits & 0xffff), 16);
+   for (s=STBI__ZFAST_BITS+1; ; ++s)
+      if (k < z->maxcode[s])
+         break;
+   if (s >= 16) return STBI__ZF_BAD;
+   b = (k >> (16-s)) - z->firstcode[s] + z->firstsymbol[s];
+   if (b >= STBI__ZNSYMS || z->size[b] != s) return STBI__ZF_BAD;
+   return stbi__zfast_entry(z->value[b], s, distance);
+}
+
+// fill a fast table from the canonical codes of z; indices not covered by a code of at
+// most bits bits are left to stbi__zfast_slow, which also rejects unused codes
+static void stbi__zbuild_fast(stbi__uint32 *table, int bits, const stbi__zhuffman *z, int distance)
+{
+   int i,j,s;
+   for (i=0; i < (1 << bits); ++i)
+      table[i] = STBI__ZF_SLOW;
+   for (s=1; s <= bits; ++s) {
+      int count = z->firstsymbol[s+1] - z->firstsymbol[s];
+      for (i=0; i < count; ++i) {
+         stbi__uint32 e = stbi__zfast_entry(z->value[z->firstsymbol[s] + i], s, distance);
+         for (j = stbi__bit_reverse(z->firstcode[s] + i, s); j < (1 << bits); j += 1 << s)
+            table[j] = e;
+      }
+   }
+   if (distance)
+      return;
+   // pair up literals whose codes fit in the table together; going down from the top, the
+   // entry for the bits after the first literal (a lower index) is still a single symbol
+   for (i=(1 << bits)-1; i >= 0; --i) {
+      stbi__uint32 e = table[i], e2;
+      int s1 = e & 15;
+      if (!(e & STBI__ZF_LITERAL)) continue;
+      e2 = table[i >> s1];
+      if ((e2 & STBI__ZF_LITERAL) && s1 + (int) (e2 & 15) <= bits)
+         table[i] = (e & 0xffff0000) | (e2 & 0x00ff0000) << 8 | STBI__ZF_LITERAL | STBI__ZF_PAIR | (s1 + (e2 & 15));
+   }
+}
+
+stbi_inline static stbi__uint64 stbi__zget64(const stbi_uc *p)
+{
+   // byte by byte to stay endian neutral, compilers merge it into one load
+   return (stbi__uint64) p[0]       | (stbi__uint64) p[1] <<  8 | (stbi__uint64) p[2] << 16 | (stbi__uint64) p[3] << 24 |
+          (stbi__uint64) p[4] << 32 | (stbi__uint64) p[5] << 40 | (stbi__uint64) p[6] << 48 | (stbi__uint64) p[7] << 56;
+}
+
+static int stbi__parse_huffman_block_fast(stbi__zbuf *a)
+{
+   char *zout = a->zout;
+   stbi_uc *in = a->zbuffer;
+   stbi__uint64 bits = a->code_buffer;
+   int num_bits = a->num_bits;
+   for (;;) {
+      stbi__uint32 e;
+      int len, dist, room, k;
+      char *src;
+      // one refill per symbol or match: a length with its extra bits and a distance with
+      // its extra bits take at most 48 bits
+      if (a->zbuffer_end - in < 8 && a->refill) {
+         a->zbuffer = in;
+         a->refill(a->stream);
+         in = a->zbuffer;
+      }
+      if (a->zbuffer_end - in >= 8) {
+         bits |= stbi__zget64(in) << num_bits;
+         in += (63 - num_bits) >> 3;
+         num_bits |= 56;
+      } else {
+         // the previous symbol already read past the end of the data
+         if (num_bits < 0) return stbi__err("unexpected end","Corrupt PNG");
+         while (num_bits <= 56 && in < a->zbuffer_end) {
+            bits |= (stbi__uint64) *in++ << num_bits;
+            num_bits += 8;
+         }
+         // like stbi__zhuffman_decode, add 16 zero bits once so decoding can be speculative
+         if (in >= a->zbuffer_end && !a->hit_zeof_once) {
+            a->hit_zeof_once = 1;
+            num_bits += 16;
+         }
+      }
+      room = a->zout_end - zout >= STBI__ZFAST_ROOM;
+      if (!room && a->z_expandable) {
+         if (!stbi__zexpand(a, zout, STBI__ZFAST_ROOM)) return 0;
+         zout = a->zout;
+         room = 1;
+      }
+
+      e = a->zfast_length[bits & ((1 << STBI__ZFAST_LENGTH_BITS) - 1)];
+      if (e & STBI__ZF_SLOW) e = stbi__zfast_slow(&a->z_length, bits, 0);
+      if (e & STBI__ZF_LITERAL) {
+         if (!room && a->zout_end - zout < ((e & STBI__ZF_PAIR) ? 2 : 1))
+            return stbi__err("output buffer limit","Corrupt PNG");
+         zout[0] = (char) (e >> 16);
+         if (e & STBI__ZF_PAIR) zout[1] = (char) (e >> 24);
+         zout += (e & STBI__ZF_PAIR) ? 2 : 1;
+         bits >>= e & 15;
+         num_bits -= e & 15;
+         // the refill covers two more table literals after a slow one (15 + 11 + 11 bits)
+         // and the room check six bytes, so take them without going around the loop
+         for (k=0; room && k < 2; ++k) {
+            e = a->zfast_length[bits & ((1 << STBI__ZFAST_LENGTH_BITS) - 1)];
+            if (!(e & STBI__ZF_LITERAL)) break;
+            zout[0] = (char) (e >> 16);
+            zout[1] = (char) (e >> 24);
+            zout += (e & STBI__ZF_PAIR) ? 2 : 1;
+            bits >>= e & 15;
+            num_bits -= e & 15;
+         }
+         continue;
+      }
+      if (e & (STBI__ZF_END | STBI__ZF_BAD)) {
+         if (e & STBI__ZF_BAD) return stbi__err("bad huffman code","Corrupt PNG");
+         bits >>= e & 15;
+         num_bits -= e & 15;
+         // consuming any of the zero bits added at the end means the stream was cut short
+         if (num_bits < (a->hit_zeof_once ? 16 : 0)) return stbi__err("unexpected end","Corrupt PNG");
+         // hand the whole bytes still in the bit buffer back to the input
+         k = (num_bits - (a->hit_zeof_once ? 16 : 0)) >> 3;
+         in -= k;
+         num_bits -= k * 8;
+         a->zbuffer = in;
+         a->code_buffer = (stbi__uint32) (bits & (((stbi__uint64) 1 << num_bits) - 1));
+         a->num_bits = num_bits;
+         a->zout = zout;
+         return 1;
+      }
+      bits >>= e & 15;
+      num_bits -= e & 15;
+      len = (int) (e >> 16) + (int) (bits & ((1 << ((e >> 4) & 15)) - 1));
+      bits >>= (e >> 4) & 15;
+      num_bits -= (e >> 4) & 15;
+
+      e = a->zfast_distance[bits & ((1 << STBI__ZFAST_DISTANCE_BITS) - 1)];
+      if (e & STBI__ZF_SLOW) e = stbi__zfast_slow(&a->z_distance, bits, 1);
+      if (e & STBI__ZF_BAD) return stbi__err("bad huffman code","Corrupt PNG");
+      bits >>= e & 15;
+      num_bits -= e & 15;
+      dist = (int) (e >> 16) + (int) (bits & ((1 << ((e >> 4) & 15)) - 1));
+      bits >>= (e >> 4) & 15;
+      num_bits -= (e >> 4) & 15;
+      if (zout - a->zout_start < dist) return stbi__err("bad dist","Corrupt PNG");
+      if (!room && len > a->zout_end - zout) return stbi__err("output buffer limit","Corrupt PNG");
+
+      src = zout - dist;
+      if (room && dist >= 16) {
+         // whole 16 byte chunks, each reads only bytes written before it; the overshoot
+         // past the match is rewritten by the following output
+         char *end = zout + len;
+         do {
+            memcpy(zout, src, 16);
+            zout += 16;
+            src += 16;
+         } while (zout < end);
+         zout = end;
+      } else if (dist == 1) { // run of one byte; common in images.
+         if (room) {
+            char v = *src, *end = zout + len;
+            do {
+               memset(zout, v, 16);
+               zout += 16;
+            } while (zout < end);
+            zout = end;
+         } else {
+            memset(zout, *src, len);
+            zout += len;
+         }
+      } else if (room && dist >= 8) {
+         char *end = zout + len;
+         do {
+            memcpy(zout, src, 8);
+            zout += 8;
+            src += 8;
+         } while (zout < end);
+         zout = end;
+      } else {
+         do *zout++ = *src++; while (--len);
+      }
+   }
+}
+
 static int stbi__parse_huffman_block(stbi__zbuf *a)
 {
    char *zout = a->zout;
@@ -4425,9 +5952,18 @@ static int stbi__parse_uncompressed_block(stbi__zbuf *a)
    len  = header[1] * 256 + header[0];
    nlen = header[3] * 256 + header[2];
    if (nlen != (len ^ 0xffff)) return stbi__err("zlib corrupt","Corrupt PNG");
-   if (a->zbuffer + len > a->zbuffer_end) return stbi__err("read past buffer","Corrupt PNG");
    if (a->zout + len > a->zout_end)
       if (!stbi__zexpand(a, a->zout, len)) return 0;
+   while (a->zbuffer + len > a->zbuffer_end) {
+      // streamed input: copy what is there and fetch more
+      k = (int) (a->zbuffer_end - a->zbuffer);
+      if (!a->refill) return stbi__err("read past buffer","Corrupt PNG");
+      memcpy(a->zout, a->zbuffer, k);
+      a->zbuffer += k;
+      a->zout += k;
+      len -= k;
+      if (!a->refill(a->stream)) return stbi__err("read past buffer","Corrupt PNG");
+   }
    memcpy(a->zout, a->zbuffer, len);
    a->zbuffer += len;
    a->zout += len;
@@ -4500,7 +6036,11 @@ static int stbi__parse_zlib(stbi__zbuf *a, int parse_header)
          } else {
             if (!stbi__compute_huffman_codes(a)) return 0;
          }
-         if (!stbi__parse_huffman_block(a)) return 0;
+         if (stbi__zlib_fast) {
+            stbi__zbuild_fast(a->zfast_length, STBI__ZFAST_LENGTH_BITS, &a->z_length, 0);
+            stbi__zbuild_fast(a->zfast_distance, STBI__ZFAST_DISTANCE_BITS, &a->z_distance, 1);
+            if (!stbi__parse_huffman_block_fast(a)) return 0;
+         } else if (!stbi__parse_huffman_block(a)) return 0;
       }
    } while (!final);
    return 1;
@@ -4512,6 +6052,8 @@ static int stbi__do_zlib(stbi__zbuf *a, char *obuf, int olen, int exp, int parse
    a->zout       = obuf;
    a->zout_end   = obuf + olen;
    a->z_expandable = exp;
+   a->refill = NULL;
+   a->drain = NULL;
 
    return stbi__parse_zlib(a, parse_header);
 }
@@ -4691,16 +6233,321 @@ static void stbi__create_png_alpha_expand8(stbi_uc *dest, stbi_uc *src, stbi__ui
    }
 }
 
+static int stbi__png_kernel_cap = STBI_PNG_KERNELS_AVX2;
+
+STBIDEF void stbi_png_set_kernels(int max_level)
+{
+   stbi__png_kernel_cap = max_level;
+}
+
+STBIDEF int stbi_png_kernels(void)
+{
+   int level = STBI_PNG_KERNELS_SCALAR;
+#ifdef STBI_SSE2
+   if (stbi__sse2_available()) level = STBI_PNG_KERNELS_SSE2;
+#endif
+#ifdef STBI_SSSE3
+   if (level == STBI_PNG_KERNELS_SSE2 && stbi__ssse3_available()) level = STBI_PNG_KERNELS_SSSE3;
+#endif
+#ifdef STBI_AVX2
+   if (level == STBI_PNG_KERNELS_SSSE3 && stbi__avx2_available()) level = STBI_PNG_KERNELS_AVX2;
+#endif
+   return level < stbi__png_kernel_cap ? level : stbi__png_kernel_cap;
+}
+
+// unfilter one row of nk bytes into cur; NULL kernels leave it to the scalar loops
+typedef void (*stbi__png_unfilter_kernel)(stbi_uc *cur, stbi_uc *raw, stbi_uc *prior, int nk, int filter_bytes);
+
+#ifdef STBI_SSE2
+// Up adds whole registers of the prior row. Sub is a running sum over pixels, done four
+// pixels at a time with two shifted adds plus the last pixel of the previous four. Avg and
+// Paeth need the pixel just decoded for the next one, so they go a pixel at a time with
+// the channels side by side, which is as wide as those filters get. All of them take
+// filter_bytes 3 or 4 only, and read and write nothing outside the row.
+
+// pixels go through 4 bytes at a time, RGB too, whose fourth byte is the next pixel's
+// first and gets rewritten by it; only a row's last pixel uses 3 bytes (n == 3), put
+// together in registers since a 3 byte memcpy goes through the stack
+static int stbi__png_load_pixel(const stbi_uc *p, int n)
+{
+   int v;
+   if (n == 4) memcpy(&v, p, 4);
+   else        v = p[0] | (p[1] << 8) | (p[2] << 16);
+   return v;
+}
+
+static void stbi__png_store_pixel(stbi_uc *p, int v, int n)
+{
+   if (n == 4) memcpy(p, &v, 4);
+   else {
+      p[0] = STBI__BYTECAST(v);
+      p[1] = STBI__BYTECAST(v >> 8);
+      p[2] = STBI__BYTECAST(v >> 16);
+   }
+}
+
+static void stbi__png_up_sse2(stbi_uc *cur, stbi_uc *raw, stbi_uc *prior, int nk, int filter_bytes)
+{
+   int k = 0;
+   STBI_NOTUSED(filter_bytes);
+   for (; k+16 <= nk; k += 16)
+      _mm_storeu_si128((__m128i *) (cur+k), _mm_add_epi8(_mm_loadu_si128((__m128i *) (raw+k)), _mm_loadu_si128((__m128i *) (prior+k))));
+   for (; k < nk; ++k)
+      cur[k] = STBI__BYTECAST(raw[k] + prior[k]);
+}
+
+static void stbi__png_sub_sse2(stbi_uc *cur, stbi_uc *raw, stbi_uc *prior, int nk, int filter_bytes)
+{
+   __m128i last = _mm_setzero_si128(); // previous pixel in every pixel slot
+   int k = 0;
+   STBI_NOTUSED(prior);
+   if (filter_bytes == 4) {
+      for (; k+16 <= nk; k += 16) {
+         __m128i x = _mm_loadu_si128((__m128i *) (raw+k));
+         x = _mm_add_epi8(x, _mm_slli_si128(x, 4));
+         x = _mm_add_epi8(x, _mm_slli_si128(x, 8));
+         x = _mm_add_epi8(x, last);
+         _mm_storeu_si128((__m128i *) (cur+k), x);
+         last = _mm_shuffle_epi32(x, _MM_SHUFFLE(3,3,3,3));
+      }
+   } else {
+      // four pixels in the low 12 bytes, the top 4 are rewritten by the next step
+      __m128i low3 = _mm_setr_epi8(-1,-1,-1,0, 0,0,0,0, 0,0,0,0, 0,0,0,0);
+      for (; k+16 <= nk; k += 12) {
+         __m128i x = _mm_loadu_si128((__m128i *) (raw+k));
+         x = _mm_add_epi8(x, _mm_slli_si128(x, 3));
+         x = _mm_add_epi8(x, _mm_slli_si128(x, 6));
+         x = _mm_add_epi8(x, last);
+         _mm_storeu_si128((__m128i *) (cur+k), x);
+         last = _mm_and_si128(_mm_srli_si128(x, 9), low3);
+         last = _mm_or_si128(last, _mm_slli_si128(last, 3));
+         last = _mm_or_si128(last, _mm_slli_si128(last, 6));
+      }
+   }
+   for (; k < nk; ++k)
+      cur[k] = STBI__BYTECAST(raw[k] + (k >= filter_bytes ? cur[k-filter_bytes] : 0));
+}
+
+static void stbi__png_avg_sse2(stbi_uc *cur, stbi_uc *raw, stbi_uc *prior, int nk, int filter_bytes)
+{
+   __m128i a = _mm_setzero_si128(), one = _mm_set1_epi8(1);
+   int k;
+   for (k=0; k < nk; k += filter_bytes) {
+      int n = k+4 <= nk ? 4 : 3;
+      __m128i b = _mm_cvtsi32_si128(stbi__png_load_pixel(prior+k, n));
+      __m128i x = _mm_cvtsi32_si128(stbi__png_load_pixel(raw+k, n));
+      // (a+b)>>1: pavgb rounds up, so take off the bit it rounded with
+      __m128i avg = _mm_sub_epi8(_mm_avg_epu8(a, b), _mm_and_si128(_mm_xor_si128(a, b), one));
+      a = _mm_add_epi8(x, avg);
+      stbi__png_store_pixel(cur+k, _mm_cvtsi128_si32(a), n);
+   }
+}
+
+// mask ? x : y
+static __m128i stbi__png_select(__m128i mask, __m128i x, __m128i y)
+{
+   return _mm_or_si128(_mm_and_si128(mask, x), _mm_andnot_si128(mask, y));
+}
+
+// Paeth on 16-bit lanes with p = b-c and q = a-c, so pa = |p|, pb = |q| and pc = |p+q|:
+// a unless pa is beaten by pb or pc, then b unless pb is beaten by pc, as in stbi__paeth.
+// pa and b-or-c are worked out beside the comparisons against pa, which keeps the chain
+// from one pixel to the next short, and so does leaving the pixel in 16-bit lanes, masked
+// back to bytes, instead of packing and unpacking it
+#define STBI__PNG_PAETH_ROW(abs16) \
+   __m128i zero = _mm_setzero_si128(), bytes = _mm_set1_epi16(0xff), a = zero, c = zero; \
+   int k; \
+   for (k=0; k < nk; k += filter_bytes) { \
+      int n = k+4 <= nk ? 4 : 3; \
+      __m128i b = _mm_unpacklo_epi8(_mm_cvtsi32_si128(stbi__png_load_pixel(prior+k, n)), zero); \
+      __m128i x = _mm_unpacklo_epi8(_mm_cvtsi32_si128(stbi__png_load_pixel(raw+k, n)), zero); \
+      __m128i p = _mm_sub_epi16(b, c), q = _mm_sub_epi16(a, c); \
+      __m128i pa = abs16(p), pb = abs16(q), pc = abs16(_mm_add_epi16(p, q)); \
+      __m128i not_a = _mm_or_si128(_mm_cmpgt_epi16(pa, pb), _mm_cmpgt_epi16(pa, pc)); \
+      __m128i pred = stbi__png_select(not_a, stbi__png_select(_mm_cmpgt_epi16(pb, pc), c, b), a); \
+      a = _mm_and_si128(_mm_add_epi16(x, pred), bytes); \
+      stbi__png_store_pixel(cur+k, _mm_cvtsi128_si32(_mm_packus_epi16(a, a)), n); \
+      c = b; \
+   }
+
+static __m128i stbi__png_abs16_sse2(__m128i x)
+{
+   return _mm_max_epi16(x, _mm_sub_epi16(_mm_setzero_si128(), x));
+}
+
+static void stbi__png_paeth_sse2(stbi_uc *cur, stbi_uc *raw, stbi_uc *prior, int nk, int filter_bytes)
+{
+   STBI__PNG_PAETH_ROW(stbi__png_abs16_sse2)
+}
+#endif // STBI_SSE2
+
+#ifdef STBI_SSSE3
+static STBI__SSSE3_TARGET void stbi__png_paeth_ssse3(stbi_uc *cur, stbi_uc *raw, stbi_uc *prior, int nk, int filter_bytes)
+{
+   STBI__PNG_PAETH_ROW(_mm_abs_epi16)
+}
+#endif
+
+#ifdef STBI_AVX2
+static STBI__AVX2_TARGET void stbi__png_up_avx2(stbi_uc *cur, stbi_uc *raw, stbi_uc *prior, int nk, int filter_bytes)
+{
+   int k = 0;
+   STBI_NOTUSED(filter_bytes);
+   for (; k+32 <= nk; k += 32)
+      _mm256_storeu_si256((__m256i *) (cur+k), _mm256_add_epi8(_mm256_loadu_si256((__m256i *) (raw+k)), _mm256_loadu_si256((__m256i *) (prior+k))));
+   for (; k < nk; ++k)
+      cur[k] = STBI__BYTECAST(raw[k] + prior[k]);
+}
+#endif
+
+static void stbi__png_setup_kernels(stbi__png_unfilter_kernel *kernel, int filter_bytes, int depth)
+{
+   int level = stbi_png_kernels(), pixels = depth == 8 && (filter_bytes == 3 || filter_bytes == 4);
+   int k;
+   STBI_NOTUSED(level);
+   STBI_NOTUSED(pixels);
+   for (k=0; k <= STBI__F_avg_first; ++k)
+      kernel[k] = NULL;
+#ifdef STBI_SSE2
+   if (level >= STBI_PNG_KERNELS_SSE2) {
+      kernel[STBI__F_up] = stbi__png_up_sse2;
+      if (pixels) {
+         kernel[STBI__F_sub] = stbi__png_sub_sse2;
+         kernel[STBI__F_avg] = stbi__png_avg_sse2;
+         kernel[STBI__F_paeth] = stbi__png_paeth_sse2;
+      }
+   }
+#endif
+#ifdef STBI_SSSE3
+   if (level >= STBI_PNG_KERNELS_SSSE3 && pixels)
+      kernel[STBI__F_paeth] = stbi__png_paeth_ssse3;
+#endif
+#ifdef STBI_AVX2
+   if (level >= STBI_PNG_KERNELS_AVX2)
+      kernel[STBI__F_up] = stbi__png_up_avx2;
+#endif
+}
+
+// undo the filter of one row of nk bytes, prior being the unfiltered row above
+static void stbi__png_unfilter_row(stbi__png_unfilter_kernel *kernel, int filter, stbi_uc *cur, stbi_uc *raw, stbi_uc *prior, int nk, int filter_bytes)
+{
+   int k;
+   if (kernel[filter]) {
+      kernel[filter](cur, raw, prior, nk, filter_bytes);
+      return;
+   }
+   switch (filter) {
+   case STBI__F_none:
+      memcpy(cur, raw, nk);
+      break;
+   case STBI__F_sub:
+      memcpy(cur, raw, filter_bytes);
+      for (k = filter_bytes; k < nk; ++k)
+         cur[k] = STBI__BYTECAST(raw[k] + cur[k-filter_bytes]);
+      break;
+   case STBI__F_up:
+      for (k = 0; k < nk; ++k)
+         cur[k] = STBI__BYTECAST(raw[k] + prior[k]);
+      break;
+   case STBI__F_avg:
+      for (k = 0; k < filter_bytes; ++k)
+         cur[k] = STBI__BYTECAST(raw[k] + (prior[k]>>1));
+      for (k = filter_bytes; k < nk; ++k)
+         cur[k] = STBI__BYTECAST(raw[k] + ((prior[k] + cur[k-filter_bytes])>>1));
+      break;
+   case STBI__F_paeth:
+      for (k = 0; k < filter_bytes; ++k)
+         cur[k] = STBI__BYTECAST(raw[k] + prior[k]); // prior[k] == stbi__paeth(0,prior[k],0)
+      for (k = filter_bytes; k < nk; ++k)
+         cur[k] = STBI__BYTECAST(raw[k] + stbi__paeth(cur[k-filter_bytes], prior[k], prior[k-filter_bytes]));
+      break;
+   case STBI__F_avg_first:
+      memcpy(cur, raw, filter_bytes);
+      for (k = filter_bytes; k < nk; ++k)
+         cur[k] = STBI__BYTECAST(raw[k] + (cur[k-filter_bytes] >> 1));
+      break;
+   }
+}
+
+// expand the decoded bits of one row in cur to dest, also adding an extra alpha channel if desired
+static void stbi__png_expand_row(stbi_uc *dest, stbi_uc *cur, stbi__uint32 x, int img_n, int out_n, int depth, int color)
+{
+   stbi__uint32 i;
+   if (depth < 8) {
+      stbi_uc scale = (color == 0) ? stbi__depth_scale_table[depth] : 1; // scale grayscale values to 0..255 range
+      stbi_uc *in = cur;
+      stbi_uc *out = dest;
+      stbi_uc inb = 0;
+      stbi__uint32 nsmp = x*img_n;
+
+      // expand bits to bytes first
+      if (depth == 4) {
+         for (i=0; i < nsmp; ++i) {
+            if ((i & 1) == 0) inb = *in++;
+            *out++ = scale * (inb >> 4);
+            inb <<= 4;
+         }
+      } else if (depth == 2) {
+         for (i=0; i < nsmp; ++i) {
+            if ((i & 3) == 0) inb = *in++;
+            *out++ = scale * (inb >> 6);
+            inb <<= 2;
+         }
+      } else {
+         STBI_ASSERT(depth == 1);
+         for (i=0; i < nsmp; ++i) {
+            if ((i & 7) == 0) inb = *in++;
+            *out++ = scale * (inb >> 7);
+            inb <<= 1;
+         }
+      }
+
+      // insert alpha=255 values if desired
+      if (img_n != out_n)
+         stbi__create_png_alpha_expand8(dest, dest, x, img_n);
+   } else if (depth == 8) {
+      if (img_n == out_n)
+         memcpy(dest, cur, x*img_n);
+      else
+         stbi__create_png_alpha_expand8(dest, cur, x, img_n);
+   } else if (depth == 16) {
+      // convert the image data from big-endian to platform-native
+      stbi__uint16 *dest16 = (stbi__uint16*)dest;
+      stbi__uint32 nsmp = x*img_n;
+
+      if (img_n == out_n) {
+         for (i = 0; i < nsmp; ++i, ++dest16, cur += 2)
+            *dest16 = (cur[0] << 8) | cur[1];
+      } else {
+         STBI_ASSERT(img_n+1 == out_n);
+         if (img_n == 1) {
+            for (i = 0; i < x; ++i, dest16 += 2, cur += 2) {
+               dest16[0] = (cur[0] << 8) | cur[1];
+               dest16[1] = 0xffff;
+            }
+         } else {
+            STBI_ASSERT(img_n == 3);
+            for (i = 0; i < x; ++i, dest16 += 4, cur += 6) {
+               dest16[0] = (cur[0] << 8) | cur[1];
+               dest16[1] = (cur[2] << 8) | cur[3];
+               dest16[2] = (cur[4] << 8) | cur[5];
+               dest16[3] = 0xffff;
+            }
+         }
+      }
+   }
+}
+
 // create the png data from post-deflated data
 static int stbi__create_png_image_raw(stbi__png *a, stbi_uc *raw, stbi__uint32 raw_len, int out_n, stbi__uint32 x, stbi__uint32 y, int depth, int color)
 {
    int bytes = (depth == 16 ? 2 : 1);
    stbi__context *s = a->s;
-   stbi__uint32 i,j,stride = x*out_n*bytes;
+   stbi__uint32 j,stride = x*out_n*bytes;
    stbi__uint32 img_len, img_width_bytes;
    stbi_uc *filter_buf;
+   stbi__png_unfilter_kernel kernel[STBI__F_avg_first+1];
    int all_ok = 1;
-   int k;
    int img_n = s->img_n; // copy it into a local for later
 
    int output_bytes = out_n*bytes;
@@ -4732,6 +6579,7 @@ static int stbi__create_png_image_raw(stbi__png *a, stbi_uc *raw, stbi__uint32 r
       filter_bytes = 1;
       width = img_width_bytes;
    }
+   stbi__png_setup_kernels(kernel, filter_bytes, depth);
 
    for (j=0; j < y; ++j) {
       // cur/prior filter buffers alternate
@@ -4751,104 +6599,10 @@ static int stbi__create_png_image_raw(stbi__png *a, stbi_uc *raw, stbi__uint32 r
       if (j == 0) filter = first_row_filter[filter];
 
       // perform actual filtering
-      switch (filter) {
-      case STBI__F_none:
-         memcpy(cur, raw, nk);
-         break;
-      case STBI__F_sub:
-         memcpy(cur, raw, filter_bytes);
-         for (k = filter_bytes; k < nk; ++k)
-            cur[k] = STBI__BYTECAST(raw[k] + cur[k-filter_bytes]);
-         break;
-      case STBI__F_up:
-         for (k = 0; k < nk; ++k)
-            cur[k] = STBI__BYTECAST(raw[k] + prior[k]);
-         break;
-      case STBI__F_avg:
-         for (k = 0; k < filter_bytes; ++k)
-            cur[k] = STBI__BYTECAST(raw[k] + (prior[k]>>1));
-         for (k = filter_bytes; k < nk; ++k)
-            cur[k] = STBI__BYTECAST(raw[k] + ((prior[k] + cur[k-filter_bytes])>>1));
-         break;
-      case STBI__F_paeth:
-         for (k = 0; k < filter_bytes; ++k)
-            cur[k] = STBI__BYTECAST(raw[k] + prior[k]); // prior[k] == stbi__paeth(0,prior[k],0)
-         for (k = filter_bytes; k < nk; ++k)
-            cur[k] = STBI__BYTECAST(raw[k] + stbi__paeth(cur[k-filter_bytes], prior[k], prior[k-filter_bytes]));
-         break;
-      case STBI__F_avg_first:
-         memcpy(cur, raw, filter_bytes);
-         for (k = filter_bytes; k < nk; ++k)
-            cur[k] = STBI__BYTECAST(raw[k] + (cur[k-filter_bytes] >> 1));
-         break;
-      }
-
+      stbi__png_unfilter_row(kernel, filter, cur, raw, prior, nk, filter_bytes);
       raw += nk;
 
-      // expand decoded bits in cur to dest, also adding an extra alpha channel if desired
-      if (depth < 8) {
-         stbi_uc scale = (color == 0) ? stbi__depth_scale_table[depth] : 1; // scale grayscale values to 0..255 range
-         stbi_uc *in = cur;
-         stbi_uc *out = dest;
-         stbi_uc inb = 0;
-         stbi__uint32 nsmp = x*img_n;
-
-         // expand bits to bytes first
-         if (depth == 4) {
-            for (i=0; i < nsmp; ++i) {
-               if ((i & 1) == 0) inb = *in++;
-               *out++ = scale * (inb >> 4);
-               inb <<= 4;
-            }
-         } else if (depth == 2) {
-            for (i=0; i < nsmp; ++i) {
-               if ((i & 3) == 0) inb = *in++;
-               *out++ = scale * (inb >> 6);
-               inb <<= 2;
-            }
-         } else {
-            STBI_ASSERT(depth == 1);
-            for (i=0; i < nsmp; ++i) {
-               if ((i & 7) == 0) inb = *in++;
-               *out++ = scale * (inb >> 7);
-               inb <<= 1;
-            }
-         }
-
-         // insert alpha=255 values if desired
-         if (img_n != out_n)
-            stbi__create_png_alpha_expand8(dest, dest, x, img_n);
-      } else if (depth == 8) {
-         if (img_n == out_n)
-            memcpy(dest, cur, x*img_n);
-         else
-            stbi__create_png_alpha_expand8(dest, cur, x, img_n);
-      } else if (depth == 16) {
-         // convert the image data from big-endian to platform-native
-         stbi__uint16 *dest16 = (stbi__uint16*)dest;
-         stbi__uint32 nsmp = x*img_n;
-
-         if (img_n == out_n) {
-            for (i = 0; i < nsmp; ++i, ++dest16, cur += 2)
-               *dest16 = (cur[0] << 8) | cur[1];
-         } else {
-            STBI_ASSERT(img_n+1 == out_n);
-            if (img_n == 1) {
-               for (i = 0; i < x; ++i, dest16 += 2, cur += 2) {
-                  dest16[0] = (cur[0] << 8) | cur[1];
-                  dest16[1] = 0xffff;
-               }
-            } else {
-               STBI_ASSERT(img_n == 3);
-               for (i = 0; i < x; ++i, dest16 += 4, cur += 6) {
-                  dest16[0] = (cur[0] << 8) | cur[1];
-                  dest16[1] = (cur[2] << 8) | cur[3];
-                  dest16[2] = (cur[4] << 8) | cur[5];
-                  dest16[3] = 0xffff;
-               }
-            }
-         }
-      }
+      stbi__png_expand_row(dest, cur, x, img_n, out_n, depth, color);
    }
 
    STBI_FREE(filter_buf);
@@ -4902,11 +6656,9 @@ static int stbi__create_png_image(stbi__png *a, stbi_uc *image_data, stbi__uint3
    return 1;
 }
 
-static int stbi__compute_transparency(stbi__png *z, stbi_uc tc[3], int out_n)
+static int stbi__compute_transparency(stbi_uc *p, stbi__uint32 pixel_count, stbi_uc tc[3], int out_n)
 {
-   stbi__context *s = z->s;
-   stbi__uint32 i, pixel_count = s->img_x * s->img_y;
-   stbi_uc *p = z->out;
+   stbi__uint32 i;
 
    // compute color-based transparency, assuming we've
    // already got 255 as the alpha value in the output
@@ -4927,11 +6679,9 @@ static int stbi__compute_transparency(stbi__png *z, stbi_uc tc[3], int out_n)
    return 1;
 }
 
-static int stbi__compute_transparency16(stbi__png *z, stbi__uint16 tc[3], int out_n)
+static int stbi__compute_transparency16(stbi__uint16 *p, stbi__uint32 pixel_count, stbi__uint16 tc[3], int out_n)
 {
-   stbi__context *s = z->s;
-   stbi__uint32 i, pixel_count = s->img_x * s->img_y;
-   stbi__uint16 *p = (stbi__uint16*) z->out;
+   stbi__uint32 i;
 
    // compute color-based transparency, assuming we've
    // already got 65535 as the alpha value in the output
@@ -4952,17 +6702,9 @@ static int stbi__compute_transparency16(stbi__png *z, stbi__uint16 tc[3], int ou
    return 1;
 }
 
-static int stbi__expand_png_palette(stbi__png *a, stbi_uc *palette, int len, int pal_img_n)
+static void stbi__png_palette_lookup(stbi_uc *p, const stbi_uc *orig, stbi__uint32 pixel_count, const stbi_uc *palette, int pal_img_n)
 {
-   stbi__uint32 i, pixel_count = a->s->img_x * a->s->img_y;
-   stbi_uc *p, *temp_out, *orig = a->out;
-
-   p = (stbi_uc *) stbi__malloc_mad2(pixel_count, pal_img_n, 0);
-   if (p == NULL) return stbi__err("outofmem", "Out of memory");
-
-   // between here and free(out) below, exitting would leak
-   temp_out = p;
-
+   stbi__uint32 i;
    if (pal_img_n == 3) {
       for (i=0; i < pixel_count; ++i) {
          int n = orig[i]*4;
@@ -4981,6 +6723,17 @@ static int stbi__expand_png_palette(stbi__png *a, stbi_uc *palette, int len, int
          p += 4;
       }
    }
+}
+
+static int stbi__expand_png_palette(stbi__png *a, stbi_uc *palette, int len, int pal_img_n)
+{
+   stbi__uint32 pixel_count = a->s->img_x * a->s->img_y;
+   stbi_uc *temp_out;
+
+   temp_out = (stbi_uc *) stbi__malloc_mad2(pixel_count, pal_img_n, 0);
+   if (temp_out == NULL) return stbi__err("outofmem", "Out of memory");
+
+   stbi__png_palette_lookup(temp_out, a->out, pixel_count, palette, pal_img_n);
    STBI_FREE(a->out);
    a->out = temp_out;
 
@@ -5029,13 +6782,11 @@ STBIDEF void stbi_convert_iphone_png_to_rgb_thread(int flag_true_if_should_conve
                                 : stbi__de_iphone_flag_global)
 #endif // STBI_THREAD_LOCAL
 
-static void stbi__de_iphone(stbi__png *z)
+static void stbi__de_iphone(stbi_uc *p, stbi__uint32 pixel_count, int out_n)
 {
-   stbi__context *s = z->s;
-   stbi__uint32 i, pixel_count = s->img_x * s->img_y;
-   stbi_uc *p = z->out;
+   stbi__uint32 i;
 
-   if (s->img_out_n == 3) {  // convert bgr to rgb
+   if (out_n == 3) {  // convert bgr to rgb
       for (i=0; i < pixel_count; ++i) {
          stbi_uc t = p[0];
          p[0] = p[2];
@@ -5043,7 +6794,7 @@ static void stbi__de_iphone(stbi__png *z)
          p += 3;
       }
    } else {
-      STBI_ASSERT(s->img_out_n == 4);
+      STBI_ASSERT(out_n == 4);
       if (stbi__unpremultiply_on_load) {
          // convert bgr to rgb and unpremultiply
          for (i=0; i < pixel_count; ++i) {
@@ -5074,6 +6825,232 @@ static void stbi__de_iphone(stbi__png *z)
 
 #define STBI__PNG_TYPE(a,b,c,d)  (((unsigned) (a) << 24) + ((unsigned) (b) << 16) + ((unsigned) (c) << 8) + (unsigned) (d))
 
+// size of the compressed input buffer and of the output a stream inflates between drains
+#define STBI__PNG_STREAM_IN   65536
+#define STBI__PNG_STREAM_OUT  131072
+
+// a non-interlaced image inflated into a sliding window and turned into rows as soon as they
+// are complete, so loading with stbi__context.rows set holds a few rows instead of the
+// compressed data, the inflated data and the image
+typedef struct
+{
+   stbi__zbuf z;
+   stbi__context *s;
+   stbi__uint32 idat_left;  // bytes of the current IDAT chunk not yet read
+   int idat_end;            // the chunk after the image data has been read into next
+   stbi__pngchunk next;
+   stbi_uc in[STBI__PNG_STREAM_IN];
+   char window[32768 + STBI__PNG_STREAM_OUT];
+
+   stbi__png_unfilter_kernel kernel[STBI__F_avg_first+1];
+   stbi_uc *raw, *filter_buf, *line, *pal, *conv;
+   stbi__uint32 raw_bytes, raw_fill, rows;
+   int img_n, out_n, final_n, req_comp, depth, color, filter_bytes, width;
+   int has_trans, de_iphone, pal_img_n;
+   stbi_uc tc[3], *palette;
+   stbi__uint16 tc16[3];
+} stbi__png_stream;
+
+// read past the CRC to the next chunk, 0 once it is not IDAT
+static int stbi__png_stream_next(stbi__png_stream *st)
+{
+   if (st->idat_end) return 0;
+   stbi__get32be(st->s);
+   st->next = stbi__get_chunk_header(st->s);
+   if (st->next.type != STBI__PNG_TYPE('I','D','A','T')) {
+      st->idat_end = 1;
+      return 0;
+   }
+   // no size limit as for collected IDAT data, nothing here is sized by the chunk
+   st->idat_left = st->next.length;
+   return 1;
+}
+
+static int stbi__png_stream_refill(void *stream)
+{
+   stbi__png_stream *st = (stbi__png_stream *) stream;
+   stbi__zbuf *z = &st->z;
+   int keep = z->zbuffer - st->in < 8 ? (int) (z->zbuffer - st->in) : 8;
+   int have = (int) (z->zbuffer_end - z->zbuffer), added = 0;
+   // the inflater may hand back up to 7 bytes it already took, so keep 8 before zbuffer
+   memmove(st->in, z->zbuffer - keep, keep + have);
+   z->zbuffer = st->in + keep;
+   z->zbuffer_end = z->zbuffer + have;
+   for (;;) {
+      int n = (int) (st->in + STBI__PNG_STREAM_IN - z->zbuffer_end);
+      if (n == 0) break;
+      if (st->idat_left == 0) {
+         if (!stbi__png_stream_next(st)) break;
+         continue;
+      }
+      if ((stbi__uint32) n > st->idat_left) n = (int) st->idat_left;
+      if (!stbi__getn(st->s, z->zbuffer_end, n)) {
+         // out of data; the inflater reports the stream as cut short
+         st->idat_end = 1;
+         st->idat_left = 0;
+         break;
+      }
+      z->zbuffer_end += n;
+      st->idat_left -= n;
+      added += n;
+   }
+   if (z->zbuffer_end - z->zbuffer < 8) z->refill = NULL; // only the last few bytes are left
+   return added > 0;
+}
+
+// unfilter one row and put it, converted to the output format, to the rows sink
+static int stbi__png_stream_row(stbi__png_stream *st, stbi_uc *raw)
+{
+   stbi__uint32 x = st->s->img_x;
+   stbi_uc *cur = st->filter_buf + (st->rows & 1)*(st->raw_bytes-1);
+   stbi_uc *prior = st->filter_buf + (~st->rows & 1)*(st->raw_bytes-1);
+   stbi_uc *px = st->line;
+   int filter = *raw++;
+   if (filter > 4) return stbi__err("invalid filter","Corrupt PNG");
+   if (st->rows == 0) filter = first_row_filter[filter];
+   stbi__png_unfilter_row(st->kernel, filter, cur, raw, prior, st->width * st->filter_bytes, st->filter_bytes);
+   stbi__png_expand_row(px, cur, x, st->img_n, st->out_n, st->depth, st->color);
+   if (st->has_trans) {
+      if (st->depth == 16)
+         stbi__compute_transparency16((stbi__uint16 *) px, x, st->tc16, st->out_n);
+      else
+         stbi__compute_transparency(px, x, st->tc, st->out_n);
+   }
+   if (st->de_iphone)
+      stbi__de_iphone(px, x, st->out_n);
+   if (st->pal_img_n) {
+      stbi__png_palette_lookup(st->pal, px, x, st->palette, st->final_n);
+      px = st->pal;
+   }
+   if (st->req_comp && st->req_comp != st->final_n) {
+      if (st->depth == 16) {
+         if (!stbi__convert_format16_row((stbi__uint16 *) st->conv, (stbi__uint16 *) px, st->final_n, st->req_comp, x)) return 0;
+      } else {
+         if (!stbi__convert_format_row(st->conv, px, st->final_n, st->req_comp, x)) return 0;
+      }
+      px = st->conv;
+   }
+   ++st->rows;
+   return stbi__rows_put(st->s->rows, px, st->depth == 16 ? 16 : 8);
+}
+
+static int stbi__png_stream_drain(void *stream)
+{
+   stbi__png_stream *st = (stbi__png_stream *) stream;
+   stbi_uc *p = (stbi_uc *) st->z.zout_drained;
+   stbi_uc *end = (stbi_uc *) st->z.zout;
+   // like the whole image path, data after the last row is ignored
+   while (p < end && st->rows < st->s->img_y) {
+      stbi_uc *raw;
+      if (st->raw_fill == 0 && (stbi__uint32) (end - p) >= st->raw_bytes) {
+         // the whole row is in the window
+         raw = p;
+         p += st->raw_bytes;
+      } else {
+         stbi__uint32 n = st->raw_bytes - st->raw_fill;
+         if (n > (stbi__uint32) (end - p)) n = (stbi__uint32) (end - p);
+         memcpy(st->raw + st->raw_fill, p, n);
+         st->raw_fill += n;
+         p += n;
+         if (st->raw_fill < st->raw_bytes) break;
+         st->raw_fill = 0;
+         raw = st->raw;
+      }
+      if (!stbi__png_stream_row(st, raw)) return 0;
+   }
+   st->z.zout_drained = st->z.zout;
+   return 1;
+}
+
+// decode the image data starting with an IDAT chunk of the given length straight to
+// s->rows, leaving the header of the chunk after the image data in next
+static int stbi__png_stream_image(stbi__png *z, stbi__uint32 length, stbi__pngchunk *next, int color, int is_iphone, stbi_uc *palette, int pal_img_n, int has_trans, stbi_uc tc[3], stbi__uint16 tc16[3], int req_comp)
+{
+   stbi__context *s = z->s;
+   stbi__png_stream *st;
+   int bytes = (z->depth == 16 ? 2 : 1);
+   size_t width_bytes, line_bytes;
+   int ok, k;
+
+   if (!stbi__mad3sizes_valid(s->img_n, s->img_x, z->depth, 7)) return stbi__err("too large", "Corrupt PNG");
+   st = (stbi__png_stream *) stbi__malloc(sizeof(*st));
+   if (st == NULL) return stbi__err("outofmem", "Out of memory");
+   st->s = s;
+   st->idat_left = length;
+   st->idat_end = 0;
+   st->next.type = 0;
+   st->rows = 0;
+   st->raw_fill = 0;
+   st->req_comp = req_comp;
+   st->depth = z->depth;
+   st->color = color;
+   st->palette = palette;
+   st->pal_img_n = pal_img_n;
+   st->has_trans = has_trans;
+   for (k=0; has_trans && k < 3; ++k) {
+      st->tc[k] = tc[k];
+      st->tc16[k] = tc16[k];
+   }
+
+   // the same output as at IEND on the whole image path
+   st->img_n = s->img_n;
+   if ((req_comp == s->img_n+1 && req_comp != 3 && !pal_img_n) || has_trans)
+      st->out_n = s->img_n+1;
+   else
+      st->out_n = s->img_n;
+   st->de_iphone = is_iphone && stbi__de_iphone_flag && st->out_n > 2;
+   st->final_n = st->out_n;
+   if (pal_img_n) {
+      s->img_n = pal_img_n;
+      st->final_n = req_comp >= 3 ? req_comp : pal_img_n;
+   } else if (has_trans) {
+      ++s->img_n;
+   }
+   s->img_out_n = req_comp ? req_comp : st->final_n;
+
+   width_bytes = ((st->img_n * s->img_x * z->depth) + 7) >> 3;
+   st->raw_bytes = (stbi__uint32) width_bytes + 1;
+   st->filter_bytes = st->img_n * bytes;
+   st->width = s->img_x;
+   if (z->depth < 8) {
+      st->filter_bytes = 1;
+      st->width = (int) width_bytes;
+   }
+   stbi__png_setup_kernels(st->kernel, st->filter_bytes, z->depth);
+
+   // a row in each of the three pixel formats, two unfiltered rows, then one raw row
+   line_bytes = (size_t) s->img_x * 4 * bytes;
+   st->line = (stbi_uc *) stbi__malloc(3*line_bytes + 3*width_bytes + 1);
+   if (st->line == NULL) {
+      STBI_FREE(st);
+      return stbi__err("outofmem", "Out of memory");
+   }
+   st->pal = st->line + line_bytes;
+   st->conv = st->pal + line_bytes;
+   st->filter_buf = st->conv + line_bytes;
+   st->raw = st->filter_buf + 2*width_bytes;
+
+   st->z.zbuffer = st->z.zbuffer_end = st->in;
+   st->z.zout_start = st->z.zout = st->z.zout_drained = st->window;
+   st->z.zout_end = st->window + sizeof(st->window);
+   st->z.z_expandable = 1; // stbi__zexpand drains instead of growing
+   st->z.stream = st;
+   st->z.refill = stbi__png_stream_refill;
+   st->z.drain = stbi__png_stream_drain;
+
+   ok = stbi__rows_begin(s->rows, s->img_x, s->img_y, s->img_n, req_comp) &&
+        stbi__parse_zlib(&st->z, !is_iphone) && stbi__png_stream_drain(st);
+   if (ok && st->rows < s->img_y) ok = stbi__err("not enough pixels","Corrupt PNG");
+   if (ok) {
+      // the rest of the image data, like the zlib checksum, is not needed
+      do stbi__skip(s, (int) st->idat_left); while (stbi__png_stream_next(st));
+      *next = st->next;
+   }
+   STBI_FREE(st->line);
+   STBI_FREE(st);
+   return ok;
+}
+
 static int stbi__parse_png_file(stbi__png *z, int scan, int req_comp)
 {
    stbi_uc palette[1024], pal_img_n=0;
@@ -5081,6 +7058,8 @@ static int stbi__parse_png_file(stbi__png *z, int scan, int req_comp)
    stbi__uint16 tc16[3];
    stbi__uint32 ioff=0, idata_limit=0, i, pal_len=0;
    int first=1,k,interlace=0, color=0, is_iphone=0;
+   int streamed=0, pending=0;
+   stbi__pngchunk next;
    stbi__context *s = z->s;
 
    z->expanded = NULL;
@@ -5092,7 +7071,12 @@ static int stbi__parse_png_file(stbi__png *z, int scan, int req_comp)
    if (scan == STBI__SCAN_type) return 1;
 
    for (;;) {
-      stbi__pngchunk c = stbi__get_chunk_header(s);
+      stbi__pngchunk c;
+      if (pending) {
+         c = next; // already read by the row stream
+         pending = 0;
+      } else
+         c = stbi__get_chunk_header(s);
       switch (c.type) {
          case STBI__PNG_TYPE('C','g','B','I'):
             is_iphone = 1;
@@ -5144,7 +7128,7 @@ static int stbi__parse_png_file(stbi__png *z, int scan, int req_comp)
 
          case STBI__PNG_TYPE('t','R','N','S'): {
             if (first) return stbi__err("first not IHDR", "Corrupt PNG");
-            if (z->idata) return stbi__err("tRNS after IDAT","Corrupt PNG");
+            if (z->idata || streamed) return stbi__err("tRNS after IDAT","Corrupt PNG");
             if (pal_img_n) {
                if (scan == STBI__SCAN_header) { s->img_n = 4; return 1; }
                if (pal_len == 0) return stbi__err("tRNS before PLTE","Corrupt PNG");
@@ -5176,6 +7160,13 @@ static int stbi__parse_png_file(stbi__png *z, int scan, int req_comp)
                   s->img_n = pal_img_n;
                return 1;
             }
+            if (s->rows && !interlace && scan == STBI__SCAN_load) {
+               // decode straight to the rows sink; interlaced images need all passes first
+               if (streamed) return stbi__err("extra IDAT","Corrupt PNG");
+               if (!stbi__png_stream_image(z, c.length, &next, color, is_iphone, palette, pal_img_n, has_trans, tc, tc16, req_comp)) return 0;
+               streamed = pending = 1;
+               continue; // the stream read the CRC
+            }
             if (c.length > (1u << 30)) return stbi__err("IDAT size limit", "IDAT section larger than 2^30 bytes");
             if ((int)(ioff + c.length) < (int)ioff) return 0;
             if (ioff + c.length > idata_limit) {
@@ -5197,6 +7188,10 @@ static int stbi__parse_png_file(stbi__png *z, int scan, int req_comp)
             stbi__uint32 raw_len, bpl;
             if (first) return stbi__err("first not IHDR", "Corrupt PNG");
             if (scan != STBI__SCAN_load) return 1;
+            if (streamed) {
+               stbi__get32be(s);
+               return 1;
+            }
             if (z->idata == NULL) return stbi__err("no IDAT","Corrupt PNG");
             // initial guess for decoded data size to avoid unnecessary reallocs
             bpl = (s->img_x * z->depth + 7) / 8; // bytes per line, per component
@@ -5211,13 +7206,13 @@ static int stbi__parse_png_file(stbi__png *z, int scan, int req_comp)
             if (!stbi__create_png_image(z, z->expanded, raw_len, s->img_out_n, z->depth, color, interlace)) return 0;
             if (has_trans) {
                if (z->depth == 16) {
-                  if (!stbi__compute_transparency16(z, tc16, s->img_out_n)) return 0;
+                  if (!stbi__compute_transparency16((stbi__uint16 *) z->out, s->img_x * s->img_y, tc16, s->img_out_n)) return 0;
                } else {
-                  if (!stbi__compute_transparency(z, tc, s->img_out_n)) return 0;
+                  if (!stbi__compute_transparency(z->out, s->img_x * s->img_y, tc, s->img_out_n)) return 0;
                }
             }
             if (is_iphone && stbi__de_iphone_flag && s->img_out_n > 2)
-               stbi__de_iphone(z);
+               stbi__de_iphone(z->out, s->img_x * s->img_y, s->img_out_n);
             if (pal_img_n) {
                // pal_img_n == 3 or 4
                s->img_n = pal_img_n; // record the actual colors we had
@@ -5270,7 +7265,9 @@ static void *stbi__do_png(stbi__png *p, int *x, int *y, int *n, int req_comp, st
          return stbi__errpuc("bad bits_per_channel", "PNG not supported: unsupported color depth");
       result = p->out;
       p->out = NULL;
-      if (req_comp && req_comp != p->s->img_out_n) {
+      // NULL when streamed to p->s->rows, which took care of req_comp
+      if (!result) p->s->rows->finished = 1;
+      if (result && req_comp && req_comp != p->s->img_out_n) {
          if (ri->bits_per_channel == 8)
             result = stbi__convert_format((unsigned char *) result, p->s->img_out_n, req_comp, p->s->img_x, p->s->img_y);
          else
@@ -7160,7 +9157,7 @@ static float *stbi__hdr_load(stbi__context *s, int *x, int *y, int *comp, int re
    int width, height;
    stbi_uc *scanline;
    float *hdr_data;
-   int len;
+   int len, row_step;
    unsigned char count, value;
    int i, j, k, c1,c2, z;
    const char *headerToken;
@@ -7203,8 +9200,11 @@ static float *stbi__hdr_load(stbi__context *s, int *x, int *y, int *comp, int re
    if (!stbi__mad4sizes_valid(width, height, req_comp, sizeof(float), 0))
       return stbi__errpf("too large", "HDR image is too large");
 
-   // Read data
-   hdr_data = (float *) stbi__malloc_mad4(width, height, req_comp, sizeof(float), 0);
+   // Read data; when streaming rows, into a single row that goes out as each completes
+   row_step = s->rows ? 0 : width * req_comp;
+   if (s->rows && !stbi__rows_begin(s->rows, width, height, 3, req_comp))
+      return NULL;
+   hdr_data = (float *) stbi__malloc_mad4(width, s->rows ? 1 : height, req_comp, sizeof(float), 0);
    if (!hdr_data)
       return stbi__errpf("outofmem", "Out of memory");
 
@@ -7217,8 +9217,9 @@ static float *stbi__hdr_load(stbi__context *s, int *x, int *y, int *comp, int re
             stbi_uc rgbe[4];
            main_decode_loop:
             stbi__getn(s, rgbe, 4);
-            stbi__hdr_convert(hdr_data + j * width * req_comp + i * req_comp, rgbe, req_comp);
+            stbi__hdr_convert(hdr_data + j * row_step + i * req_comp, rgbe, req_comp);
          }
+         if (s->rows && !stbi__rows_put(s->rows, hdr_data, 32)) { STBI_FREE(hdr_data); return NULL; }
       }
    } else {
       // Read RLE-encoded data
@@ -7232,6 +9233,8 @@ static float *stbi__hdr_load(stbi__context *s, int *x, int *y, int *comp, int re
             // not run-length encoded, so we have to actually use THIS data as a decoded
             // pixel (note this can't be a valid pixel--one of RGB must be >= 128)
             stbi_uc rgbe[4];
+            // the flat decode below starts over at the first row, which has gone out already
+            if (s->rows && j) { STBI_FREE(hdr_data); STBI_FREE(scanline); return stbi__errpf("invalid decoded scanline length", "corrupt HDR"); }
             rgbe[0] = (stbi_uc) c1;
             rgbe[1] = (stbi_uc) c2;
             rgbe[2] = (stbi_uc) len;
@@ -7274,12 +9277,18 @@ static float *stbi__hdr_load(stbi__context *s, int *x, int *y, int *comp, int re
             }
          }
          for (i=0; i < width; ++i)
-            stbi__hdr_convert(hdr_data+(j*width + i)*req_comp, scanline + i*4, req_comp);
+            stbi__hdr_convert(hdr_data + j*row_step + i*req_comp, scanline + i*4, req_comp);
+         if (s->rows && !stbi__rows_put(s->rows, hdr_data, 32)) { STBI_FREE(hdr_data); STBI_FREE(scanline); return NULL; }
       }
       if (scanline)
          STBI_FREE(scanline);
    }
 
+   if (s->rows) {
+      STBI_FREE(hdr_data);
+      s->rows->finished = 1;
+      return NULL;
+   }
    return hdr_data;
 }
 
@@ -0,0 +1,356 @@
+#pragma once
+#ifndef TEXTURE_ARRAY_H
+#define TEXTURE_ARRAY_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include "stb_image.h"
+#include <mapped_file.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+// where one image ended up: sample the array at (rect.xy + uv * rect.zw, layer)
+struct TextureArrayEntry
+{
+    float layer;
+    glm::vec4 rect;
+};
+
+// Packs block images into one GL_TEXTURE_2D_ARRAY so every block material is bound once and
+// a single instanced draw can cover them all, with the entry index carried per instance.
+//
+// Images of one size become one layer each and the driver builds the mip chain. Mixed sizes
+// are shelf packed into square atlas layers instead: every tile is surrounded by PADDING
+// texels of its own edge colour and starts on a multiple of PADDING, and the mip levels are
+// built per tile on the CPU, so no level ever averages texels of two different tiles. Atlas
+// layers stop at ATLAS_LEVELS levels, where the padding is down to one texel.
+//
+//     TextureArrayBuilder builder;
+//     int wood = builder.add("img/wood.png");
+//     builder.build();   // builder.entry(wood) is valid after this returns
+class TextureArrayBuilder
+{
+public:
+    static const int PADDING = 16;
+    static const int ATLAS_LEVELS = 5;
+    // most entries a shader's entry table holds, see shaders/arrayShader.vs
+    static const int MAX_ENTRIES = 64;
+
+    // queue an image, returns its entry index or -1 once MAX_ENTRIES images are queued
+    // ------------------------------------------------------------------------
+    int add(const std::string& path)
+    {
+        if (images.size() >= MAX_ENTRIES)
+        {
+            std::cout << "Texture array is full (" << MAX_ENTRIES << " entries), not adding: " << path << std::endl;
+            return -1;
+        }
+        Image image;
+        image.path = path;
+        images.push_back(image);
+        return (int)images.size() - 1;
+    }
+    // decode every queued image on worker threads and upload the array on the calling (GL)
+    // thread; forceAtlas packs same size images into atlas layers too. false if any image
+    // failed to load, those entries are left pointing at a blank region, or if none were added.
+    // ------------------------------------------------------------------------
+    bool build(bool flipVertically = true, bool forceAtlas = false)
+    {
+        if (images.empty())
+            return false;
+        auto start = std::chrono::steady_clock::now();
+        bool ok = decode(flipVertically);
+        bool sameSize = true;
+        for (const Image& image : images)
+            sameSize = sameSize && image.width == images[0].width && image.height == images[0].height;
+        atlas = forceAtlas || !sameSize;
+        if (atlas && sameSize && !fitsAtlas())
+        {
+            std::cout << "Textures too large for an atlas layer, using one layer per image" << std::endl;
+            atlas = false;
+        }
+
+        glGenTextures(1, &texture);
+        glBindTexture(GL_TEXTURE_2D_ARRAY, texture);
+        GLint unpackAlignment = 4;
+        glGetIntegerv(GL_UNPACK_ALIGNMENT, &unpackAlignment);
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+        if (atlas)
+            ok = uploadAtlas() && ok;
+        else
+            uploadLayers();
+        glPixelStorei(GL_UNPACK_ALIGNMENT, unpackAlignment);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+
+        for (Image& image : images)
+        {
+            stbi_image_free(image.pixels);
+            image.pixels = nullptr;
+        }
+        buildSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        return ok;
+    }
+    GLuint id() const
+    {
+        return texture;
+    }
+    const TextureArrayEntry& entry(int index) const
+    {
+        return entries[index];
+    }
+    size_t entryCount() const
+    {
+        return entries.size();
+    }
+    // ------------------------------------------------------------------------
+    void report(std::ostream& out) const
+    {
+        out << "texture array: " << entries.size() << " images in " << layers << " " << (atlas ? "atlas " : "")
+            << "layers of " << size << " x " << size << ", " << bytes / (1024.0 * 1024.0) << " MB with mips, built in "
+            << buildSeconds * 1000.0 << " ms" << std::endl;
+    }
+    void release()
+    {
+        glDeleteTextures(1, &texture);
+        texture = 0;
+    }
+
+private:
+    struct Image
+    {
+        std::string path;
+        unsigned char* pixels = nullptr;
+        int width = 0, height = 0;
+        // atlas placement of the padded tile, in level 0 texels
+        int layer = 0, x = 0, y = 0;
+    };
+    std::vector<Image> images;
+    std::vector<TextureArrayEntry> entries;
+    GLuint texture = 0;
+    bool atlas = false;
+    int size = 0, layers = 0;
+    size_t bytes = 0;
+    double buildSeconds = 0.0;
+
+    // ------------------------------------------------------------------------
+    bool decode(bool flipVertically)
+    {
+        std::atomic<size_t> next{ 0 };
+        auto worker = [&]()
+        {
+            // the flip flag is thread local in stb_image, set it for this worker
+            stbi_set_flip_vertically_on_load_thread(flipVertically);
+            for (size_t index = next++; index < images.size(); index = next++)
+            {
+                int channels = 0;
+                Image& image = images[index];
+                MappedFile file;
+                if (file.open(image.path, MADV_SEQUENTIAL))
+                    image.pixels = stbi_load_from_memory(file.data(), (int)file.size(), &image.width, &image.height, &channels, 4);
+            }
+        };
+        std::vector<std::thread> workers;
+        unsigned int count = std::min<unsigned int>(std::max(1u, std::thread::hardware_concurrency()), (unsigned int)images.size());
+        for (unsigned int i = 0; i < count; i++)
+            workers.emplace_back(worker);
+        for (std::thread& thread : workers)
+            thread.join();
+
+        bool ok = true;
+        for (Image& image : images)
+        {
+            if (image.pixels)
+                continue;
+            std::cout << "Texture failed to load at path: " << image.path << std::endl;
+            blank(image);
+            ok = false;
+        }
+        return ok;
+    }
+    // one opaque white texel keeps the entry of an image that cannot be used
+    // ------------------------------------------------------------------------
+    static void blank(Image& image)
+    {
+        stbi_image_free(image.pixels);
+        image.pixels = (unsigned char*)STBI_MALLOC(4);
+        memset(image.pixels, 255, 4);
+        image.width = image.height = 1;
+    }
+    // one image per layer, mipmapped by the driver
+    // ------------------------------------------------------------------------
+    void uploadLayers()
+    {
+        size = std::max(images[0].width, images[0].height);
+        layers = (int)images.size();
+        glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_RGBA8, images[0].width, images[0].height, layers, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+        for (int layer = 0; layer < layers; layer++)
+        {
+            glTexSubImage3D(GL_TEXTURE_2D_ARRAY, 0, 0, 0, layer, images[0].width, images[0].height, 1,
+                GL_RGBA, GL_UNSIGNED_BYTE, images[layer].pixels);
+            entries.push_back({ (float)layer, glm::vec4(0.0f, 0.0f, 1.0f, 1.0f) });
+        }
+        glGenerateMipmap(GL_TEXTURE_2D_ARRAY);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_REPEAT);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_REPEAT);
+        bytes = (size_t)images[0].width * images[0].height * 4 * layers * 4 / 3;
+    }
+    static int paddedSize(int extent)
+    {
+        return (extent + 2 * PADDING + PADDING - 1) / PADDING * PADDING;
+    }
+    int largestTile() const
+    {
+        int largest = 0;
+        for (const Image& image : images)
+            largest = std::max(largest, std::max(paddedSize(image.width), paddedSize(image.height)));
+        return largest;
+    }
+    // smallest power of two layer from 512 up that holds the largest tile, at most GL_MAX_TEXTURE_SIZE
+    static int atlasSize(int largest)
+    {
+        GLint maxSize = 2048;
+        glGetIntegerv(GL_MAX_TEXTURE_SIZE, &maxSize);
+        int extent = 512;
+        while (extent < largest && extent * 2 <= maxSize)
+            extent *= 2;
+        return extent;
+    }
+    bool fitsAtlas() const
+    {
+        int largest = largestTile();
+        return largest <= atlasSize(largest);
+    }
+    // shelf pack the padded tiles, tallest first, into as many square layers as needed. false
+    // if a padded tile is larger than a layer can be, that image is blanked like one that
+    // failed to load so the others still pack
+    // ------------------------------------------------------------------------
+    bool pack()
+    {
+        size = atlasSize(largestTile());
+        bool ok = true;
+        for (Image& image : images)
+        {
+            if (std::max(paddedSize(image.width), paddedSize(image.height)) <= size)
+                continue;
+            std::cout << "Texture too large for an atlas layer of " << size << " x " << size << ": " << image.path << std::endl;
+            blank(image);
+            ok = false;
+        }
+
+        std::vector<size_t> order(images.size());
+        for (size_t i = 0; i < order.size(); i++)
+            order[i] = i;
+        std::stable_sort(order.begin(), order.end(), [this](size_t a, size_t b) { return images[a].height > images[b].height; });
+        int x = 0, y = 0, shelfHeight = 0, layer = 0;
+        for (size_t index : order)
+        {
+            Image& image = images[index];
+            int width = paddedSize(image.width), height = paddedSize(image.height);
+            if (x + width > size)
+            {
+                x = 0;
+                y += shelfHeight;
+                shelfHeight = 0;
+            }
+            if (y + height > size)
+            {
+                x = y = shelfHeight = 0;
+                layer++;
+            }
+            image.layer = layer;
+            image.x = x;
+            image.y = y;
+            x += width;
+            shelfHeight = std::max(shelfHeight, height);
+        }
+        layers = layer + 1;
+        return ok;
+    }
+    // the padded tile at level 0: the image with its border texels repeated outwards
+    // ------------------------------------------------------------------------
+    static std::vector<unsigned char> padTile(const Image& image)
+    {
+        int width = paddedSize(image.width), height = paddedSize(image.height);
+        std::vector<unsigned char> tile((size_t)width * height * 4);
+        for (int y = 0; y < height; y++)
+        {
+            int sourceY = std::min(std::max(y - PADDING, 0), image.height - 1);
+            for (int x = 0; x < width; x++)
+            {
+                int sourceX = std::min(std::max(x - PADDING, 0), image.width - 1);
+                memcpy(&tile[((size_t)y * width + x) * 4], &image.pixels[((size_t)sourceY * image.width + sourceX) * 4], 4);
+            }
+        }
+        return tile;
+    }
+    // 2 x 2 box filter, both sizes are even for every level an atlas keeps
+    // ------------------------------------------------------------------------
+    static std::vector<unsigned char> halve(const std::vector<unsigned char>& tile, int width, int height)
+    {
+        int halfWidth = width / 2, halfHeight = height / 2;
+        std::vector<unsigned char> half((size_t)halfWidth * halfHeight * 4);
+        for (int y = 0; y < halfHeight; y++)
+        {
+            const unsigned char* row0 = &tile[(size_t)(2 * y) * width * 4];
+            const unsigned char* row1 = row0 + (size_t)width * 4;
+            for (int x = 0; x < halfWidth; x++)
+                for (int c = 0; c < 4; c++)
+                    half[((size_t)y * halfWidth + x) * 4 + c] = (unsigned char)((row0[8 * x + c] + row0[8 * x + 4 + c]
+                        + row1[8 * x + c] + row1[8 * x + 4 + c] + 2) / 4);
+        }
+        return half;
+    }
+    // ------------------------------------------------------------------------
+    bool uploadAtlas()
+    {
+        bool ok = pack();
+        std::vector<std::vector<unsigned char>> levels(ATLAS_LEVELS);
+        for (int level = 0; level < ATLAS_LEVELS; level++)
+        {
+            int extent = size >> level;
+            levels[level].assign((size_t)extent * extent * layers * 4, 0);
+        }
+        for (const Image& image : images)
+        {
+            int width = paddedSize(image.width), height = paddedSize(image.height);
+            std::vector<unsigned char> tile = padTile(image);
+            for (int level = 0; level < ATLAS_LEVELS; level++)
+            {
+                if (level > 0)
+                {
+                    tile = halve(tile, width, height);
+                    width /= 2;
+                    height /= 2;
+                }
+                int extent = size >> level;
+                unsigned char* layerBase = &levels[level][(size_t)image.layer * extent * extent * 4];
+                for (int y = 0; y < height; y++)
+                    memcpy(layerBase + ((size_t)((image.y >> level) + y) * extent + (image.x >> level)) * 4,
+                        &tile[(size_t)y * width * 4], (size_t)width * 4);
+            }
+            float scale = 1.0f / size;
+            entries.push_back({ (float)image.layer, glm::vec4((image.x + PADDING) * scale, (image.y + PADDING) * scale,
+                image.width * scale, image.height * scale) });
+        }
+        for (int level = 0; level < ATLAS_LEVELS; level++)
+        {
+            int extent = size >> level;
+            glTexImage3D(GL_TEXTURE_2D_ARRAY, level, GL_RGBA8, extent, extent, layers, 0, GL_RGBA, GL_UNSIGNED_BYTE, levels[level].data());
+            bytes += levels[level].size();
+        }
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAX_LEVEL, ATLAS_LEVELS - 1);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        return ok;
+    }
+};
+#endif
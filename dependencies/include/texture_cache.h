@@ -0,0 +1,418 @@
+#pragma once
+#ifndef TEXTURE_CACHE_H
+#define TEXTURE_CACHE_H
+
+#include <glad/glad.h>
+#include <mapped_file.h>
+#include <mip_builder.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <functional>
+#include <string>
+#include <thread>
+#include <vector>
+
+// one cached texture, the level pointers point into the mapping and stay valid while it lives
+struct CachedTexture
+{
+    struct Level
+    {
+        int width, height;
+        size_t size;
+        const unsigned char* data;
+    };
+    MappedFile file;
+    GLenum internalFormat = 0;
+    // pixel format of uncompressed levels, 0 when the levels are block compressed
+    GLenum format = 0;
+    std::vector<Level> levels;
+};
+
+// On-disk cache of decoded textures with their full mip chain, ready to hand to GL. The first
+// load of an image writes an entry; later runs map it and upload every level straight from
+// the mapping, skipping the PNG/JPEG decode and glGenerateMipmap. With compress set, RGB and
+// RGBA images are stored as BC1 and BC3 (GL_EXT_texture_compression_s3tc), encoded on the CPU.
+// Entries are keyed by path, file size, modification time and the load options.
+//
+// file layout: magic "GLTX", format version, 64 bit key, internal format, pixel format,
+// level count, then width, height and byte size of each level, then the level data in order
+class TextureCache
+{
+public:
+    // empty disables the cache
+    static inline std::string directory;
+    static inline bool compress = false;
+    static inline std::atomic<unsigned int> hits{ 0 }, misses{ 0 }, stores{ 0 };
+
+    static bool enabled()
+    {
+        return !directory.empty();
+    }
+    // variant tells apart entries of one image built with different load options; member names
+    // the image inside an asset archive at imagePath
+    // ------------------------------------------------------------------------
+    static uint64_t key(const std::string& imagePath, bool flipVertically, uint32_t variant = 0,
+        const std::string& member = std::string())
+    {
+        std::error_code error;
+        uint64_t size = std::filesystem::file_size(imagePath, error);
+        uint64_t modified = (uint64_t)std::filesystem::last_write_time(imagePath, error).time_since_epoch().count();
+        uint64_t h = 14695981039346656037ull;
+        auto mix = [&h](const void* data, size_t length)
+        {
+            for (size_t i = 0; i < length; i++)
+                h = (h ^ ((const unsigned char*)data)[i]) * 1099511628211ull;
+        };
+        mix(imagePath.data(), imagePath.size());
+        mix(&size, sizeof(size));
+        mix(&modified, sizeof(modified));
+        unsigned char options[2] = { (unsigned char)flipVertically, (unsigned char)useCompression() };
+        mix(options, sizeof(options));
+        mix(&variant, sizeof(variant));
+        mix(member.data(), member.size());
+        return h;
+    }
+    // map an entry and check its level table, false if missing or damaged; safe off the GL thread
+    // ------------------------------------------------------------------------
+    static bool load(uint64_t textureKey, CachedTexture& texture)
+    {
+        texture.levels.clear();
+        if (!texture.file.open(path(textureKey)))
+        {
+            misses++;
+            return false;
+        }
+        const unsigned char* data = texture.file.data();
+        size_t size = texture.file.size();
+        Header header;
+        bool ok = size >= sizeof(header);
+        if (ok)
+        {
+            memcpy(&header, data, sizeof(header));
+            ok = header.magic == MAGIC && header.version == VERSION && header.key == textureKey && header.levels > 0 &&
+                header.levels <= 32 && size >= sizeof(header) + header.levels * sizeof(LevelHeader);
+        }
+        // bytes per pixel of uncompressed levels or per 4 x 4 block of compressed ones, 0 for
+        // formats store() never writes
+        int unitBytes = 0;
+        if (ok && header.format == 0)
+            unitBytes = header.internalFormat == GL_COMPRESSED_RGB_S3TC_DXT1_EXT ? 8 :
+                header.internalFormat == GL_COMPRESSED_RGBA_S3TC_DXT5_EXT ? 16 : 0;
+        else if (ok)
+            unitBytes = header.format == GL_RED ? 1 : header.format == GL_RG ? 2 : header.format == GL_RGB ? 3 :
+                header.format == GL_RGBA ? 4 : 0;
+        ok = ok && unitBytes > 0;
+        size_t offset = sizeof(header) + (ok ? header.levels * sizeof(LevelHeader) : 0);
+        uint32_t width = 0, height = 0;
+        for (uint32_t level = 0; ok && level < header.levels; level++)
+        {
+            LevelHeader entry;
+            memcpy(&entry, data + sizeof(header) + level * sizeof(LevelHeader), sizeof(entry));
+            // the sizes GL will read for these dimensions must be exactly what the file holds,
+            // or a stale or damaged entry would have the driver read past the mapping
+            if (level == 0)
+                ok = entry.width >= 1 && entry.height >= 1 && entry.width <= MAX_SIZE && entry.height <= MAX_SIZE;
+            else
+                ok = entry.width == std::max(1u, width / 2) && entry.height == std::max(1u, height / 2);
+            width = entry.width;
+            height = entry.height;
+            uint64_t expected = header.format == 0 ? (uint64_t)((width + 3) / 4) * ((height + 3) / 4) * unitBytes :
+                (uint64_t)width * height * unitBytes;
+            ok = ok && entry.size == expected && entry.size <= size - offset;
+            if (ok)
+                texture.levels.push_back({ (int)entry.width, (int)entry.height, (size_t)entry.size, data + offset });
+            offset += ok ? (size_t)entry.size : 0;
+        }
+        if (!ok)
+        {
+            texture.file.close();
+            texture.levels.clear();
+            misses++;
+            return false;
+        }
+        texture.internalFormat = header.internalFormat;
+        texture.format = header.format;
+        hits++;
+        return true;
+    }
+    // upload every level into the texture bound to GL_TEXTURE_2D
+    // ------------------------------------------------------------------------
+    static void upload(const CachedTexture& texture)
+    {
+        GLint unpackAlignment = 4;
+        glGetIntegerv(GL_UNPACK_ALIGNMENT, &unpackAlignment);
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+        for (size_t level = 0; level < texture.levels.size(); level++)
+        {
+            const CachedTexture::Level& entry = texture.levels[level];
+            if (texture.format == 0)
+                glCompressedTexImage2D(GL_TEXTURE_2D, (GLint)level, texture.internalFormat, entry.width, entry.height, 0,
+                    (GLsizei)entry.size, entry.data);
+            else
+                glTexImage2D(GL_TEXTURE_2D, (GLint)level, (GLint)texture.internalFormat, entry.width, entry.height, 0,
+                    texture.format, GL_UNSIGNED_BYTE, entry.data);
+        }
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, (GLint)texture.levels.size() - 1);
+        glPixelStorei(GL_UNPACK_ALIGNMENT, unpackAlignment);
+    }
+    // write an entry from the base image and the levels below it; safe off the GL thread
+    // ------------------------------------------------------------------------
+    static void store(uint64_t textureKey, GLenum format, int width, int height, const unsigned char* pixels,
+        const std::vector<MipLevel>& mips)
+    {
+        int channels = format == GL_RED ? 1 : format == GL_RG ? 2 : format == GL_RGB ? 3 : 4;
+        bool compressed = useCompression() && channels >= 3;
+        Header header = { MAGIC, VERSION, textureKey, format, compressed ? 0u : format, (uint32_t)(1 + mips.size()), 0u };
+        if (compressed)
+            header.internalFormat = channels == 3 ? GL_COMPRESSED_RGB_S3TC_DXT1_EXT : GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
+
+        std::vector<LevelHeader> table;
+        std::vector<std::vector<unsigned char>> encoded;
+        std::vector<const unsigned char*> levels;
+        std::vector<unsigned char> rgba;
+        for (uint32_t level = 0; level < header.levels; level++)
+        {
+            const unsigned char* data = level == 0 ? pixels : mips[level - 1].pixels.data();
+            int levelWidth = level == 0 ? width : mips[level - 1].width;
+            int levelHeight = level == 0 ? height : mips[level - 1].height;
+            size_t size = (size_t)levelWidth * levelHeight * channels;
+            if (compressed)
+            {
+                // the encoder always reads four channels
+                if (channels == 3)
+                {
+                    rgba.resize((size_t)levelWidth * levelHeight * 4);
+                    for (size_t i = 0; i < (size_t)levelWidth * levelHeight; i++)
+                    {
+                        memcpy(&rgba[i * 4], &data[i * 3], 3);
+                        rgba[i * 4 + 3] = 255;
+                    }
+                    data = rgba.data();
+                }
+                encoded.push_back(encode(data, levelWidth, levelHeight, channels == 4));
+                data = encoded.back().data();
+                size = encoded.back().size();
+            }
+            levels.push_back(data);
+            table.push_back({ (uint32_t)levelWidth, (uint32_t)levelHeight, (uint64_t)size });
+        }
+
+        std::error_code error;
+        std::filesystem::create_directories(directory, error);
+        // write to a temporary name first so a crash never leaves a truncated entry, one per
+        // thread since workers may store the same image at once
+        char suffix[32];
+        snprintf(suffix, sizeof(suffix), ".%zx.tmp", std::hash<std::thread::id>()(std::this_thread::get_id()));
+        std::string target = path(textureKey), temporary = target + suffix;
+        FILE* f = fopen(temporary.c_str(), "wb");
+        if (!f)
+            return;
+        bool ok = fwrite(&header, sizeof(header), 1, f) == 1 && fwrite(table.data(), sizeof(LevelHeader), table.size(), f) == table.size();
+        for (size_t level = 0; ok && level < levels.size(); level++)
+            ok = fwrite(levels[level], 1, table[level].size, f) == table[level].size;
+        fclose(f);
+        if (ok)
+        {
+            std::filesystem::rename(temporary, target, error);
+            stores += error ? 0 : 1;
+        }
+        else
+        {
+            std::filesystem::remove(temporary, error);
+        }
+    }
+    // read back every level of the texture bound to GL_TEXTURE_2D, mipmapped by the driver,
+    // and write an entry
+    // ------------------------------------------------------------------------
+    static void storeFromTexture(uint64_t textureKey, GLenum format)
+    {
+        int channels = format == GL_RED ? 1 : format == GL_RG ? 2 : format == GL_RGB ? 3 : 4;
+        GLint packAlignment = 4;
+        glGetIntegerv(GL_PACK_ALIGNMENT, &packAlignment);
+        glPixelStorei(GL_PACK_ALIGNMENT, 1);
+        std::vector<MipLevel> levels;
+        for (GLint level = 0; level < 32; level++)
+        {
+            GLint width = 0, height = 0;
+            glGetTexLevelParameteriv(GL_TEXTURE_2D, level, GL_TEXTURE_WIDTH, &width);
+            glGetTexLevelParameteriv(GL_TEXTURE_2D, level, GL_TEXTURE_HEIGHT, &height);
+            if (width <= 0 || height <= 0)
+                break;
+            levels.push_back({ width, height, std::vector<unsigned char>((size_t)width * height * channels) });
+            glGetTexImage(GL_TEXTURE_2D, level, format, GL_UNSIGNED_BYTE, levels.back().pixels.data());
+            if (width == 1 && height == 1)
+                break;
+        }
+        glPixelStorei(GL_PACK_ALIGNMENT, packAlignment);
+        if (levels.empty())
+            return;
+        MipLevel base = std::move(levels.front());
+        levels.erase(levels.begin());
+        store(textureKey, format, base.width, base.height, base.pixels.data(), levels);
+    }
+    // BC1 (8 bytes per 4 x 4 block) or BC3 (16 bytes, alpha block first) of an RGBA8 image
+    // ------------------------------------------------------------------------
+    static std::vector<unsigned char> encode(const unsigned char* rgba, int width, int height, bool alpha)
+    {
+        int blocksX = (width + 3) / 4, blocksY = (height + 3) / 4;
+        size_t blockBytes = alpha ? 16 : 8;
+        std::vector<unsigned char> out((size_t)blocksX * blocksY * blockBytes);
+        unsigned char block[16 * 4];
+        for (int by = 0; by < blocksY; by++)
+        {
+            for (int bx = 0; bx < blocksX; bx++)
+            {
+                // edge blocks repeat the last row and column
+                for (int y = 0; y < 4; y++)
+                {
+                    int sourceY = std::min(by * 4 + y, height - 1);
+                    for (int x = 0; x < 4; x++)
+                    {
+                        int sourceX = std::min(bx * 4 + x, width - 1);
+                        memcpy(&block[(y * 4 + x) * 4], &rgba[((size_t)sourceY * width + sourceX) * 4], 4);
+                    }
+                }
+                unsigned char* target = &out[((size_t)by * blocksX + bx) * blockBytes];
+                if (alpha)
+                {
+                    encodeAlphaBlock(block, target);
+                    target += 8;
+                }
+                encodeColorBlock(block, target);
+            }
+        }
+        return out;
+    }
+
+private:
+    struct Header
+    {
+        uint32_t magic;
+        uint32_t version;
+        uint64_t key;
+        GLenum internalFormat;
+        GLenum format;
+        uint32_t levels;
+        uint32_t reserved;
+    };
+    struct LevelHeader
+    {
+        uint32_t width;
+        uint32_t height;
+        uint64_t size;
+    };
+    static const uint32_t MAGIC = 0x58544C47; // "GLTX"
+    static const uint32_t VERSION = 1;
+    // larger than any GL texture, keeps level sizes far from overflowing
+    static const uint32_t MAX_SIZE = 1 << 16;
+
+    static bool useCompression()
+    {
+        return compress && GLAD_GL_EXT_texture_compression_s3tc;
+    }
+    static std::string path(uint64_t textureKey)
+    {
+        char name[32];
+        snprintf(name, sizeof(name), "%016llx.tex", (unsigned long long)textureKey);
+        return directory + "/" + name;
+    }
+    static uint16_t to565(const int* color)
+    {
+        return (uint16_t)(((color[0] * 31 + 127) / 255) << 11 | ((color[1] * 63 + 127) / 255) << 5 | ((color[2] * 31 + 127) / 255));
+    }
+    static void from565(uint16_t packed, int* color)
+    {
+        int r = (packed >> 11) & 31, g = (packed >> 5) & 63, b = packed & 31;
+        color[0] = (r << 3) | (r >> 2);
+        color[1] = (g << 2) | (g >> 4);
+        color[2] = (b << 3) | (b >> 2);
+    }
+    // endpoints from the block's bounding box inset by 1/16, four colour mode, nearest index
+    // ------------------------------------------------------------------------
+    static void encodeColorBlock(const unsigned char* block, unsigned char* out)
+    {
+        int low[3] = { 255, 255, 255 }, high[3] = { 0, 0, 0 };
+        for (int i = 0; i < 16; i++)
+            for (int c = 0; c < 3; c++)
+            {
+                low[c] = std::min(low[c], (int)block[i * 4 + c]);
+                high[c] = std::max(high[c], (int)block[i * 4 + c]);
+            }
+        for (int c = 0; c < 3; c++)
+        {
+            int inset = (high[c] - low[c]) / 16;
+            low[c] += inset;
+            high[c] -= inset;
+        }
+        // every channel of high is >= low, so c0 >= c1 and c0 == c1 is the only three colour case
+        uint16_t c0 = to565(high), c1 = to565(low);
+        int palette[4][3];
+        from565(c0, palette[0]);
+        from565(c1, palette[1]);
+        for (int c = 0; c < 3; c++)
+        {
+            palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+            palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+        }
+        uint32_t indices = 0;
+        for (int i = 0; c0 != c1 && i < 16; i++)
+        {
+            int best = 0, bestDistance = 1 << 30;
+            for (int p = 0; p < 4; p++)
+            {
+                int distance = 0;
+                for (int c = 0; c < 3; c++)
+                {
+                    int d = (int)block[i * 4 + c] - palette[p][c];
+                    distance += d * d;
+                }
+                if (distance < bestDistance)
+                {
+                    bestDistance = distance;
+                    best = p;
+                }
+            }
+            indices |= (uint32_t)best << (2 * i);
+        }
+        out[0] = (unsigned char)c0;
+        out[1] = (unsigned char)(c0 >> 8);
+        out[2] = (unsigned char)c1;
+        out[3] = (unsigned char)(c1 >> 8);
+        for (int b = 0; b < 4; b++)
+            out[4 + b] = (unsigned char)(indices >> (8 * b));
+    }
+    // alpha endpoints are the block's extremes, eight value mode, nearest 3 bit index
+    // ------------------------------------------------------------------------
+    static void encodeAlphaBlock(const unsigned char* block, unsigned char* out)
+    {
+        int low = 255, high = 0;
+        for (int i = 0; i < 16; i++)
+        {
+            low = std::min(low, (int)block[i * 4 + 3]);
+            high = std::max(high, (int)block[i * 4 + 3]);
+        }
+        int palette[8] = { high, low };
+        for (int p = 1; p < 7; p++)
+            palette[p + 1] = ((7 - p) * high + p * low) / 7;
+        uint64_t indices = 0;
+        for (int i = 0; high != low && i < 16; i++)
+        {
+            int best = 0;
+            for (int p = 1; p < 8; p++)
+                if (std::abs(block[i * 4 + 3] - palette[p]) < std::abs(block[i * 4 + 3] - palette[best]))
+                    best = p;
+            indices |= (uint64_t)best << (3 * i);
+        }
+        out[0] = (unsigned char)high;
+        out[1] = (unsigned char)low;
+        for (int b = 0; b < 6; b++)
+            out[2 + b] = (unsigned char)(indices >> (8 * b));
+    }
+};
+#endif
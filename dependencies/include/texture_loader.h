@@ -0,0 +1,406 @@
+#pragma once
+#ifndef TEXTURE_LOADER_H
+#define TEXTURE_LOADER_H
+
+#include <glad/glad.h>
+#include "stb_image.h"
+#include <asset_archive.h>
+#include <mapped_file.h>
+#include <mip_builder.h>
+#include <texture_cache.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstring>
+#include <deque>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Loads a batch of textures: worker threads map and decode the files while the GL thread
+// uploads each image as soon as it is ready, staging the pixels through a small ring of
+// pixel unpack buffers so the copy into GL memory overlaps with the remaining decodes.
+// Files are mapped with MADV_SEQUENTIAL and decoded straight from the mapping; with an
+// AssetArchive set, paths packed into it are decoded from the one archive mapping instead.
+// When TextureCache is enabled the workers first try to map a cached entry; hits skip the
+// read, decode and mipmap stages and upload every level straight from the mapping, misses
+// load as usual and write an entry for the next run.
+//
+// The mip chain is built by the workers with MipBuilder, gamma-correct and alpha weighted,
+// right after each decode, and the GL thread only copies the finished levels. driverMipmaps
+// leaves it to glGenerateMipmap on the GL thread instead. When there are fewer files than
+// threads, large JPEGs also decode on the spare threads through stbi_jpeg_set_parallel.
+//
+// Images of more than streamPixels pixels are never held decoded: the workers only map
+// them, and the GL thread decodes them with stbi_load_rows straight into glTexSubImage2D
+// a band of rows at a time, then builds their mip chain with glGenerateMipmap. These are
+// not written to the cache.
+//
+//     TextureLoader loader;
+//     GLuint wood = loader.add("img/wood.png");
+//     loader.finish();   // textures are complete after this returns
+class TextureLoader
+{
+public:
+    static const int PBO_RING = 3;
+
+    // build mip chains with glGenerateMipmap instead of MipBuilder, set before finish()
+    static inline bool driverMipmaps = false;
+    static inline MipOptions mipOptions;
+    // larger images stream into their texture on the GL thread, 0 streams every image
+    static inline size_t streamPixels = (size_t)1 << 26;
+    static const size_t STREAM_BAND_BYTES = 1 << 20;
+
+    // stbi_parallel_for for stb_image: pool points to the unsigned int thread count, the
+    // calling thread runs tasks alongside the threads started for this one call
+    // ------------------------------------------------------------------------
+    static void parallelFor(void* pool, stbi_parallel_task* task, void* taskData, int count)
+    {
+        unsigned int threads = std::min(*(const unsigned int*)pool, (unsigned int)count);
+        std::atomic<int> next{ 0 };
+        auto run = [&]()
+        {
+            for (int index = next++; index < count; index = next++)
+                task(taskData, index);
+        };
+        std::vector<std::thread> workers;
+        for (unsigned int t = 1; t < threads; t++)
+            workers.emplace_back(run);
+        run();
+        for (std::thread& worker : workers)
+            worker.join();
+    }
+
+    explicit TextureLoader(unsigned int threads = 0, bool flipVertically = true)
+        : threadCount(threads ? threads : std::max(1u, std::thread::hardware_concurrency())),
+          flip(flipVertically)
+    {
+    }
+    // look paths up in this archive before the file system, it must outlive finish()
+    // ------------------------------------------------------------------------
+    void setArchive(const AssetArchive* assets)
+    {
+        archive = assets;
+    }
+    // queue a file, the returned texture name is valid immediately and filled by finish()
+    // ------------------------------------------------------------------------
+    GLuint add(const std::string& path)
+    {
+        jobs.emplace_back();
+        Job& job = jobs.back();
+        job.path = path;
+        glGenTextures(1, &job.texture);
+        return job.texture;
+    }
+    // decode everything on the worker pool and upload on the calling (GL) thread
+    // ------------------------------------------------------------------------
+    void finish()
+    {
+        auto start = std::chrono::steady_clock::now();
+        nextJob = 0;
+        std::vector<std::thread> workers;
+        unsigned int count = std::min<unsigned int>(threadCount, (unsigned int)jobs.size());
+        // cores left over when there are fewer files than threads go to the JPEG decoder
+        // and the mip filter of each file
+        spareThreads = std::max(1u, threadCount / std::max(1u, count));
+        for (unsigned int i = 0; i < count; i++)
+            workers.emplace_back(&TextureLoader::decodeWorker, this);
+
+        GLuint pbos[PBO_RING];
+        glGenBuffers(PBO_RING, pbos);
+        GLint unpackAlignment = 4;
+        glGetIntegerv(GL_UNPACK_ALIGNMENT, &unpackAlignment);
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+
+        for (size_t uploaded = 0; uploaded < jobs.size(); uploaded++)
+        {
+            size_t index;
+            {
+                std::unique_lock<std::mutex> lock(readyMutex);
+                readyCondition.wait(lock, [this] { return !ready.empty(); });
+                index = ready.front();
+                ready.pop_front();
+            }
+            upload(jobs[index], pbos[uploaded % PBO_RING]);
+        }
+
+        glPixelStorei(GL_UNPACK_ALIGNMENT, unpackAlignment);
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+        glDeleteBuffers(PBO_RING, pbos);
+        for (std::thread& worker : workers)
+            worker.join();
+        mipmapSeconds += glMipmapSeconds;
+        storeSeconds += glStoreSeconds;
+        glMipmapSeconds = glStoreSeconds = 0.0;
+        totalSeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        jobs.clear();
+    }
+    // per stage timings, map/decode/mipmap are summed over worker threads
+    // ------------------------------------------------------------------------
+    void report(std::ostream& out) const
+    {
+        out << "textures: " << loaded << " loaded (" << cached << " from cache, " << archived << " from archive, " << streamed << " streamed) in "
+            << totalSeconds * 1000.0 << " ms on " << threadCount << " threads (map " << readSeconds * 1000.0 << " ms, decode "
+            << decodeSeconds * 1000.0 << " ms, upload " << uploadSeconds * 1000.0 << " ms, mipmap "
+            << mipmapSeconds * 1000.0 << " ms " << (driverMipmaps ? "driver" : mipFilterName(mipOptions.filter)) << ", cache write " << storeSeconds * 1000.0 << " ms)" << std::endl;
+    }
+
+private:
+    struct Job
+    {
+        std::string path;
+        GLuint texture = 0;
+        unsigned char* pixels = nullptr;
+        int width = 0, height = 0, channels = 0;
+        std::vector<MipLevel> mips;
+        uint64_t cacheKey = 0;
+        CachedTexture cached;
+        // undecoded image data for the GL thread to stream
+        bool stream = false;
+        MappedFile file;
+        const unsigned char* data = nullptr;
+        size_t size = 0;
+    };
+    std::vector<Job> jobs;
+    unsigned int threadCount, spareThreads = 1;
+    bool flip;
+    const AssetArchive* archive = nullptr;
+
+    std::atomic<size_t> nextJob{ 0 };
+    std::mutex readyMutex;
+    std::condition_variable readyCondition;
+    std::deque<size_t> ready;
+
+    // stage totals in seconds, the worker ones are only written under readyMutex
+    double readSeconds = 0.0, decodeSeconds = 0.0, uploadSeconds = 0.0, mipmapSeconds = 0.0, storeSeconds = 0.0, totalSeconds = 0.0;
+    // the GL thread's share of the worker stages, added in once the workers are joined
+    double glMipmapSeconds = 0.0, glStoreSeconds = 0.0;
+    unsigned int loaded = 0, cached = 0, archived = 0, streamed = 0;
+
+    static double secondsSince(std::chrono::steady_clock::time_point start)
+    {
+        return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    }
+    // ------------------------------------------------------------------------
+    void decodeWorker()
+    {
+        // the flip flag is thread local in stb_image, set it for this worker
+        stbi_set_flip_vertically_on_load_thread(flip);
+        stbi_jpeg_set_parallel(spareThreads > 1 ? parallelFor : nullptr, &spareThreads, (int)spareThreads);
+        MipBuilder mipBuilder;
+        MipOptions options = mipOptions;
+        options.threads = (int)spareThreads;
+        for (size_t index = nextJob++; index < jobs.size(); index = nextJob++)
+        {
+            Job& job = jobs[index];
+            auto start = std::chrono::steady_clock::now();
+            const AssetArchive::Entry* packed = archive ? archive->find(job.path) : nullptr;
+            if (TextureCache::enabled())
+            {
+                job.cacheKey = packed ? TextureCache::key(archive->archivePath(), flip, cacheVariant(), job.path)
+                                      : TextureCache::key(job.path, flip, cacheVariant());
+                if (TextureCache::load(job.cacheKey, job.cached))
+                {
+                    double mapTime = secondsSince(start);
+                    std::lock_guard<std::mutex> lock(readyMutex);
+                    readSeconds += mapTime;
+                    ready.push_back(index);
+                    readyCondition.notify_one();
+                    continue;
+                }
+            }
+            MappedFile file;
+            const unsigned char* data = packed ? packed->data : nullptr;
+            size_t size = packed ? packed->size : 0;
+            if (!packed && file.open(job.path, MADV_SEQUENTIAL))
+            {
+                data = file.data();
+                size = file.size();
+            }
+            job.stream = data && stbi_info_from_memory(data, (int)size, &job.width, &job.height, &job.channels) &&
+                (size_t)job.width * job.height > streamPixels;
+            if (job.stream)
+            {
+                job.file = std::move(file);
+                job.data = data;
+                job.size = size;
+            }
+            double readTime = secondsSince(start);
+
+            // the page faults of the first touch land in the decode time
+            start = std::chrono::steady_clock::now();
+            if (data && !job.stream)
+                job.pixels = stbi_load_from_memory(data, (int)size, &job.width, &job.height, &job.channels, 0);
+            file.close();
+            double decodeTime = secondsSince(start);
+
+            double mipmapTime = 0.0, storeTime = 0.0;
+            if (job.pixels && !driverMipmaps)
+            {
+                start = std::chrono::steady_clock::now();
+                job.mips = mipBuilder.build(job.pixels, job.width, job.height, job.channels, options);
+                mipmapTime = secondsSince(start);
+                if (TextureCache::enabled())
+                {
+                    start = std::chrono::steady_clock::now();
+                    TextureCache::store(job.cacheKey, formatOf(job.channels), job.width, job.height, job.pixels, job.mips);
+                    storeTime = secondsSince(start);
+                }
+            }
+
+            std::lock_guard<std::mutex> lock(readyMutex);
+            readSeconds += readTime;
+            decodeSeconds += decodeTime;
+            mipmapSeconds += mipmapTime;
+            archived += packed && (job.pixels || job.stream) ? 1 : 0;
+            storeSeconds += storeTime;
+            ready.push_back(index);
+            readyCondition.notify_one();
+        }
+    }
+    // entries built by the driver and by each MipBuilder setup must not be mixed up
+    static uint32_t cacheVariant()
+    {
+        if (driverMipmaps)
+            return 0;
+        return 1 | (uint32_t)mipOptions.filter << 1 | (uint32_t)mipOptions.srgb << 3 | (uint32_t)mipOptions.premultiplyAlpha << 4;
+    }
+    static GLenum formatOf(int channels)
+    {
+        if (channels == 1)
+            return GL_RED;
+        if (channels == 2)
+            return GL_RG;
+        if (channels == 3)
+            return GL_RGB;
+        return GL_RGBA;
+    }
+    // ------------------------------------------------------------------------
+    void upload(Job& job, GLuint pbo)
+    {
+        if (!job.cached.levels.empty())
+        {
+            auto start = std::chrono::steady_clock::now();
+            glBindTexture(GL_TEXTURE_2D, job.texture);
+            TextureCache::upload(job.cached);
+            job.cached.file.close();
+            job.cached.levels.clear();
+            uploadSeconds += secondsSince(start);
+            setParameters();
+            loaded++;
+            cached++;
+            return;
+        }
+        if (job.stream)
+        {
+            uploadRows(job);
+            return;
+        }
+        if (!job.pixels)
+        {
+            std::cout << "Texture failed to load at path: " << job.path << std::endl;
+            return;
+        }
+        GLenum format = formatOf(job.channels);
+
+        auto start = std::chrono::steady_clock::now();
+        // orphan the ring slot so the driver never waits on the previous upload from it
+        size_t size = (size_t)job.width * job.height * job.channels;
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, pbo);
+        glBufferData(GL_PIXEL_UNPACK_BUFFER, size, NULL, GL_STREAM_DRAW);
+        void* dst = glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, size, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+        const void* source = job.pixels;
+        if (dst)
+        {
+            memcpy(dst, job.pixels, size);
+            glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+            source = (const void*)0;
+        }
+        else
+        {
+            glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+        }
+        glBindTexture(GL_TEXTURE_2D, job.texture);
+        glTexImage2D(GL_TEXTURE_2D, 0, format, job.width, job.height, 0, format, GL_UNSIGNED_BYTE, source);
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+        stbi_image_free(job.pixels);
+        job.pixels = nullptr;
+        if (!driverMipmaps)
+        {
+            // the levels are a small fraction of the base, copy them straight from memory
+            for (size_t level = 0; level < job.mips.size(); level++)
+                glTexImage2D(GL_TEXTURE_2D, (GLint)level + 1, format, job.mips[level].width, job.mips[level].height, 0,
+                    format, GL_UNSIGNED_BYTE, job.mips[level].pixels.data());
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, (GLint)job.mips.size());
+            job.mips.clear();
+            job.mips.shrink_to_fit();
+        }
+        uploadSeconds += secondsSince(start);
+
+        if (driverMipmaps)
+        {
+            start = std::chrono::steady_clock::now();
+            glGenerateMipmap(GL_TEXTURE_2D);
+            glMipmapSeconds += secondsSince(start);
+            if (TextureCache::enabled())
+            {
+                start = std::chrono::steady_clock::now();
+                TextureCache::storeFromTexture(job.cacheKey, format);
+                glStoreSeconds += secondsSince(start);
+            }
+        }
+        setParameters();
+        loaded++;
+    }
+    // decode into the texture band by band, so only one band of rows is ever in memory;
+    // the time is all upload, most of it decoding
+    // ------------------------------------------------------------------------
+    void uploadRows(Job& job)
+    {
+        struct Band
+        {
+            GLsizei width;
+            GLenum format;
+        } band = { job.width, formatOf(job.channels) };
+        auto start = std::chrono::steady_clock::now();
+        glBindTexture(GL_TEXTURE_2D, job.texture);
+        glTexImage2D(GL_TEXTURE_2D, 0, band.format, job.width, job.height, 0, band.format, GL_UNSIGNED_BYTE, NULL);
+        // the flip flag is thread local in stb_image, set it for the GL thread as well
+        stbi_set_flip_vertically_on_load_thread(flip);
+        int rows = (int)std::max<size_t>(1, STREAM_BAND_BYTES / ((size_t)job.width * job.channels));
+        int width, height, channels;
+        bool ok = stbi_load_rows_from_memory(job.data, (int)job.size, &width, &height, &channels, job.channels, rows,
+            [](void* user, void* pixels, int y, int count)
+            {
+                const Band* band = (const Band*)user;
+                glTexSubImage2D(GL_TEXTURE_2D, 0, 0, y, band->width, count, band->format, GL_UNSIGNED_BYTE, pixels);
+                return 1;
+            }, &band);
+        job.file.close();
+        uploadSeconds += secondsSince(start);
+        if (!ok)
+        {
+            std::cout << "Texture failed to load at path: " << job.path << std::endl;
+            return;
+        }
+
+        start = std::chrono::steady_clock::now();
+        glGenerateMipmap(GL_TEXTURE_2D);
+        glMipmapSeconds += secondsSince(start);
+        setParameters();
+        loaded++;
+        streamed++;
+    }
+    static void setParameters()
+    {
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    }
+};
+#endif
@@ -0,0 +1,254 @@
+#pragma once
+#ifndef TRANSPARENCY_H
+#define TRANSPARENCY_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <shader_m.h>
+#include <radix_sort.h>
+
+#include <cstdint>
+#include <vector>
+
+// how blended geometry is drawn
+enum TransparencyMode
+{
+    // sorted back to front on the CPU (TransparentQueue), then alpha blended over the scene
+    TRANSPARENCY_SORTED,
+    // weighted blended order independent transparency (McGuire and Bavoil 2013), no sorting
+    TRANSPARENCY_OIT,
+    TRANSPARENCY_MODE_COUNT
+};
+
+inline const char* transparencyModeName(TransparencyMode mode)
+{
+    return mode == TRANSPARENCY_OIT ? "weighted blended oit" : "sorted";
+}
+
+// view space depth of a world position, more negative is further from the camera
+inline float viewDepth(const glm::mat4& view, const glm::vec3& position)
+{
+    return view[0][2] * position.x + view[1][2] * position.y + view[2][2] * position.z + view[3][2];
+}
+
+// Transparent instances of one frame, drawn back to front. push() records an instance with its
+// view space depth, sort() orders them with a radix sort on the depth bits, which is linear in
+// the instance count where a comparison sort is n log n.
+class TransparentQueue
+{
+public:
+    void clear()
+    {
+        keys.clear();
+        items.clear();
+    }
+    void push(uint32_t item, float depth)
+    {
+        keys.push_back(floatToSortableKey(depth));
+        items.push_back(item);
+    }
+    // items from furthest to nearest, valid until the next clear()
+    // ------------------------------------------------------------------------
+    const std::vector<uint32_t>& sort(int threads = 1)
+    {
+        // ascending view space z is back to front
+        sorter.sort(keys, items, threads);
+        return items;
+    }
+    size_t size() const
+    {
+        return items.size();
+    }
+
+private:
+    std::vector<uint32_t> keys, items;
+    RadixSorter sorter;
+};
+
+// Two render targets that transparent surfaces accumulate into in any order:
+//     accumulation  RGBA16F  rgb = sum(color * alpha * weight), a = product(1 - alpha)
+//     weight        R16F     r = sum(alpha * weight)
+// GL 3.3 has no per target blend functions, so one glBlendFuncSeparate(ONE, ONE, ZERO,
+// ONE_MINUS_SRC_ALPHA) covers both: additive colour everywhere, multiplicative revealage in
+// the accumulation alpha. composite() resolves the average colour over the target framebuffer.
+//
+// The opaque depth buffer is copied in with glBlitFramebuffer, which needs the target's depth
+// format to match DEPTH24_STENCIL8 (true for the headless framebuffer and GLFW's default).
+class WeightedBlendedOIT
+{
+public:
+    // bytes blended per transparent fragment, read and write of both targets
+    static const size_t FRAGMENT_BYTES = 2 * (8 + 2);
+    // bytes per pixel of the fixed cost: depth copy (read + write), composite reads both
+    // targets and blends into the RGBA8 target
+    static const size_t PIXEL_BYTES = 2 * 4 + (8 + 2) + 2 * 4;
+
+    // must be called with a current GL context
+    // ------------------------------------------------------------------------
+    void create(int targetWidth, int targetHeight)
+    {
+        glGenFramebuffers(1, &fbo);
+        glGenTextures(1, &accumTexture);
+        glGenTextures(1, &weightTexture);
+        glGenRenderbuffers(1, &depth);
+        glGenVertexArrays(1, &emptyVAO);
+        resize(targetWidth, targetHeight);
+    }
+    // reallocate the targets when the framebuffer size changes, false if incomplete
+    // ------------------------------------------------------------------------
+    bool resize(int targetWidth, int targetHeight)
+    {
+        if (targetWidth == width && targetHeight == height)
+            return true;
+        width = targetWidth;
+        height = targetHeight;
+        allocate(accumTexture, GL_RGBA16F, GL_RGBA);
+        allocate(weightTexture, GL_R16F, GL_RED);
+        glBindRenderbuffer(GL_RENDERBUFFER, depth);
+        glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, width, height);
+
+        GLint previous = 0;
+        glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &previous);
+        glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, accumTexture, 0);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT1, GL_TEXTURE_2D, weightTexture, 0);
+        glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, depth);
+        const GLenum buffers[2] = { GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1 };
+        glDrawBuffers(2, buffers);
+        bool complete = glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE;
+        glBindFramebuffer(GL_FRAMEBUFFER, (GLuint)previous);
+        return complete;
+    }
+    // redirect drawing into the accumulation targets, depth tested against the opaque scene
+    // ------------------------------------------------------------------------
+    void begin()
+    {
+        GLint previous = 0;
+        glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &previous);
+        target = (GLuint)previous;
+        glBindFramebuffer(GL_READ_FRAMEBUFFER, target);
+        glBindFramebuffer(GL_DRAW_FRAMEBUFFER, fbo);
+        glBlitFramebuffer(0, 0, width, height, 0, 0, width, height, GL_DEPTH_BUFFER_BIT, GL_NEAREST);
+        glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+
+        const GLfloat clearAccum[4] = { 0.0f, 0.0f, 0.0f, 1.0f };
+        const GLfloat clearWeight[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+        glClearBufferfv(GL_COLOR, 0, clearAccum);
+        glClearBufferfv(GL_COLOR, 1, clearWeight);
+        // surfaces behind opaque geometry are rejected, but never occlude each other
+        glDepthMask(GL_FALSE);
+        glBlendFuncSeparate(GL_ONE, GL_ONE, GL_ZERO, GL_ONE_MINUS_SRC_ALPHA);
+    }
+    // blend the resolved transparent layer over the framebuffer that was bound at begin()
+    // ------------------------------------------------------------------------
+    void composite(const Shader& compositeShader)
+    {
+        glBindFramebuffer(GL_FRAMEBUFFER, target);
+        glDepthMask(GL_TRUE);
+        glDisable(GL_DEPTH_TEST);
+        // result = transparent colour * (1 - revealage) + background * revealage
+        glBlendFunc(GL_ONE_MINUS_SRC_ALPHA, GL_SRC_ALPHA);
+        compositeShader.use();
+        glActiveTexture(GL_TEXTURE0);
+        glBindTexture(GL_TEXTURE_2D, accumTexture);
+        glActiveTexture(GL_TEXTURE1);
+        glBindTexture(GL_TEXTURE_2D, weightTexture);
+        glBindVertexArray(emptyVAO);
+        glDrawArrays(GL_TRIANGLES, 0, 3);
+
+        glActiveTexture(GL_TEXTURE0);
+        glEnable(GL_DEPTH_TEST);
+        glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+    }
+    size_t pixelCount() const
+    {
+        return (size_t)width * height;
+    }
+    void release()
+    {
+        glDeleteFramebuffers(1, &fbo);
+        glDeleteTextures(1, &accumTexture);
+        glDeleteTextures(1, &weightTexture);
+        glDeleteRenderbuffers(1, &depth);
+        glDeleteVertexArrays(1, &emptyVAO);
+    }
+
+private:
+    GLuint fbo = 0, accumTexture = 0, weightTexture = 0, depth = 0, emptyVAO = 0;
+    GLuint target = 0;
+    int width = 0, height = 0;
+
+    void allocate(GLuint texture, GLint internalFormat, GLenum format)
+    {
+        glBindTexture(GL_TEXTURE_2D, texture);
+        glTexImage2D(GL_TEXTURE_2D, 0, internalFormat, width, height, 0, format, GL_HALF_FLOAT, NULL);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        glBindTexture(GL_TEXTURE_2D, 0);
+    }
+};
+
+// Counts samples that pass the depth test between begin() and end() with GL_SAMPLES_PASSED,
+// read back QUERY_RING frames later like FrameStats. Results are summed per tag so frames
+// drawn in different modes can be compared within one run.
+class SampleCounter
+{
+public:
+    static const int QUERY_RING = 4;
+    static const int MAX_TAGS = 4;
+
+    SampleCounter()
+    {
+        glGenQueries(QUERY_RING, queries);
+    }
+    // ------------------------------------------------------------------------
+    void begin(int tag)
+    {
+        int slot = (int)(frame % QUERY_RING);
+        if (frame >= QUERY_RING)
+            collect(slot);
+        tags[slot] = tag;
+        glBeginQuery(GL_SAMPLES_PASSED, queries[slot]);
+    }
+    void end()
+    {
+        glEndQuery(GL_SAMPLES_PASSED);
+        frame++;
+    }
+    // read back every outstanding query, once at the end of a run
+    // ------------------------------------------------------------------------
+    void flush()
+    {
+        unsigned long long first = frame > QUERY_RING ? frame - QUERY_RING : 0;
+        for (unsigned long long f = first; f < frame; f++)
+            collect((int)(f % QUERY_RING));
+    }
+    unsigned long long samples(int tag) const
+    {
+        return totals[tag];
+    }
+    unsigned long long frames(int tag) const
+    {
+        return counts[tag];
+    }
+    void release()
+    {
+        glDeleteQueries(QUERY_RING, queries);
+    }
+
+private:
+    GLuint queries[QUERY_RING];
+    int tags[QUERY_RING] = {};
+    unsigned long long frame = 0;
+    unsigned long long totals[MAX_TAGS] = {};
+    unsigned long long counts[MAX_TAGS] = {};
+
+    void collect(int slot)
+    {
+        GLuint64 passed = 0;
+        glGetQueryObjectui64v(queries[slot], GL_QUERY_RESULT, &passed);
+        totals[tags[slot]] += passed;
+        counts[tags[slot]]++;
+    }
+};
+#endif
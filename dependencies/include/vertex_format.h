@@ -0,0 +1,155 @@
+#pragma once
+#ifndef VERTEX_FORMAT_H
+#define VERTEX_FORMAT_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+// Describes how position (location 0), normal (1) and texture coordinate (2) are stored in a
+// vertex buffer. Source data is always the interleaved 8 float layout used in main.cpp:
+//     x y z  nx ny nz  u v
+// The compact layout packs a vertex into 16 bytes and relies on normalized fetch, so the
+// shaders still see plain vec3/vec2 attributes:
+//     position  3 x GL_SHORT normalized (snorm16), or 3 x GL_HALF_FLOAT if outside [-1, 1]
+//     normal    GL_INT_2_10_10_10_REV normalized
+//     uv        2 x GL_HALF_FLOAT
+struct VertexFormat
+{
+    struct Attribute
+    {
+        GLint size;
+        GLenum type;
+        GLboolean normalized;
+        size_t offset;
+    };
+    Attribute position, normal, texCoord;
+    GLsizei stride = 0;
+
+    // 32 byte layout of three float attributes
+    // ------------------------------------------------------------------------
+    static VertexFormat float32()
+    {
+        VertexFormat format;
+        format.position = { 3, GL_FLOAT, GL_FALSE, 0 };
+        format.normal = { 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float) };
+        format.texCoord = { 2, GL_FLOAT, GL_FALSE, 6 * sizeof(float) };
+        format.stride = 8 * sizeof(float);
+        return format;
+    }
+    // 16 byte layout, snorm16 positions only when every coordinate fits in [-1, 1]
+    // ------------------------------------------------------------------------
+    static VertexFormat compact(bool snormPositions)
+    {
+        VertexFormat format;
+        if (snormPositions)
+            format.position = { 3, GL_SHORT, GL_TRUE, 0 };
+        else
+            format.position = { 3, GL_HALF_FLOAT, GL_FALSE, 0 };
+        format.normal = { 4, GL_INT_2_10_10_10_REV, GL_TRUE, 8 };
+        format.texCoord = { 2, GL_HALF_FLOAT, GL_FALSE, 12 };
+        format.stride = 16;
+        return format;
+    }
+    // pick the tightest compact layout that represents the given vertices
+    // ------------------------------------------------------------------------
+    static VertexFormat compactFor(const float* vertices, size_t vertexCount)
+    {
+        bool fits = true;
+        for (size_t i = 0; i < vertexCount && fits; i++)
+            for (int c = 0; c < 3; c++)
+                if (std::fabs(vertices[i * 8 + c]) > 1.0f)
+                    fits = false;
+        return compact(fits);
+    }
+    bool isFloat32() const
+    {
+        return position.type == GL_FLOAT;
+    }
+    // set attribute pointers 0-2 for the VAO and GL_ARRAY_BUFFER currently bound
+    // ------------------------------------------------------------------------
+    void setupPointers() const
+    {
+        const Attribute* attributes[3] = { &position, &normal, &texCoord };
+        for (GLuint i = 0; i < 3; i++)
+        {
+            const Attribute& a = *attributes[i];
+            glVertexAttribPointer(i, a.size, a.type, a.normalized, stride, (void*)a.offset);
+            glEnableVertexAttribArray(i);
+        }
+    }
+    // convert interleaved 8 float vertices into this layout
+    // ------------------------------------------------------------------------
+    std::vector<unsigned char> pack(const float* vertices, size_t vertexCount) const
+    {
+        std::vector<unsigned char> data(vertexCount * stride, 0);
+        if (isFloat32())
+        {
+            memcpy(data.data(), vertices, data.size());
+            return data;
+        }
+        for (size_t i = 0; i < vertexCount; i++)
+        {
+            const float* v = vertices + i * 8;
+            unsigned char* out = data.data() + i * stride;
+            uint16_t p[3];
+            for (int c = 0; c < 3; c++)
+                p[c] = position.type == GL_SHORT ? (uint16_t)packSnorm(v[c], 32767) : packHalf(v[c]);
+            memcpy(out + position.offset, p, sizeof(p));
+            // x in bits 0-9, y in 10-19, z in 20-29, w left 0
+            uint32_t n = (packSnorm(v[3], 511) & 0x3FF) | (packSnorm(v[4], 511) & 0x3FF) << 10 | (packSnorm(v[5], 511) & 0x3FF) << 20;
+            memcpy(out + normal.offset, &n, sizeof(n));
+            uint16_t uv[2] = { packHalf(v[6]), packHalf(v[7]) };
+            memcpy(out + texCoord.offset, uv, sizeof(uv));
+        }
+        return data;
+    }
+
+private:
+    // the packing is done here rather than with glm/gtc/packing.hpp, which warns under -Wall
+    // ------------------------------------------------------------------------
+    static uint32_t packSnorm(float value, int maximum)
+    {
+        return (uint32_t)(int32_t)std::lround(std::min(std::max(value, -1.0f), 1.0f) * maximum);
+    }
+    // IEEE half float, rounded to nearest even
+    // ------------------------------------------------------------------------
+    static uint16_t packHalf(float value)
+    {
+        uint32_t bits;
+        memcpy(&bits, &value, sizeof(bits));
+        uint16_t sign = (uint16_t)(bits >> 16 & 0x8000);
+        uint32_t exponent = bits >> 23 & 0xFF;
+        uint32_t mantissa = bits & 0x7FFFFF;
+        if (exponent == 0xFF)
+            return sign | 0x7C00 | (mantissa ? 0x200 : 0);
+        int halfExponent = (int)exponent - 127 + 15;
+        if (halfExponent >= 31)
+            return sign | 0x7C00;
+        if (halfExponent <= 0)
+        {
+            // subnormal half, or zero below half the smallest one
+            if (halfExponent < -10)
+                return sign;
+            mantissa |= 0x800000;
+            int shift = 14 - halfExponent;
+            uint32_t half = mantissa >> shift;
+            uint32_t rest = mantissa & ((1u << shift) - 1), halfway = 1u << (shift - 1);
+            if (rest > halfway || (rest == halfway && (half & 1)))
+                half++;
+            return sign | (uint16_t)half;
+        }
+        uint32_t half = (uint32_t)halfExponent << 10 | mantissa >> 13;
+        uint32_t rest = mantissa & 0x1FFF;
+        // a carry out of the mantissa moves into the exponent, up to infinity
+        if (rest > 0x1000 || (rest == 0x1000 && (half & 1)))
+            half++;
+        return sign | (uint16_t)half;
+    }
+};
+#endif
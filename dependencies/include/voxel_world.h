@@ -0,0 +1,419 @@
+#pragma once
+#ifndef VOXEL_WORLD_H
+#define VOXEL_WORLD_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+// block ids stored one byte per voxel, 0 is empty
+enum BlockId : uint8_t
+{
+    BLOCK_AIR = 0,
+    BLOCK_WOOD,
+    BLOCK_LEAVES,
+    BLOCK_BRICKS,
+    BLOCK_COUNT
+};
+
+const int CHUNK_SIZE = 32;
+const int CHUNK_VOLUME = CHUNK_SIZE * CHUNK_SIZE * CHUNK_SIZE;
+
+// Chunk mesh in the interleaved 8 float layout (position, normal, uv), one index range per
+// block id so each material can be drawn with its own texture. Greedy quads span several
+// blocks and their uvs count blocks, so GL_REPEAT tiles the texture once per block.
+struct ChunkMesh
+{
+    std::vector<float> vertices;
+    std::vector<unsigned int> indices;
+    unsigned int materialFirst[BLOCK_COUNT] = {};
+    unsigned int materialCount[BLOCK_COUNT] = {};
+    // visible faces before greedy merging, for comparison
+    unsigned int visibleFaces = 0;
+
+    size_t triangleCount() const { return indices.size() / 3; }
+};
+
+struct Chunk
+{
+    glm::ivec3 coord;
+    std::vector<uint8_t> blocks = std::vector<uint8_t>(CHUNK_VOLUME, BLOCK_AIR);
+    ChunkMesh mesh;
+    bool dirty = true;
+    bool uploaded = false;
+    GLuint vao = 0, vbo = 0, ebo = 0;
+
+    static int index(int x, int y, int z) { return (y * CHUNK_SIZE + z) * CHUNK_SIZE + x; }
+};
+
+// Sparse grid of 32^3 chunks. Blocks are unit cubes centred on integer coordinates, like the
+// cubes in main.cpp. Editing a block marks its chunk (and neighbours on a border) dirty;
+// remeshDirty() rebuilds only those chunks on a pool of worker threads.
+class VoxelWorld
+{
+public:
+    uint8_t getBlock(glm::ivec3 p) const
+    {
+        const Chunk* chunk = findChunk(chunkCoord(p));
+        if (!chunk)
+            return BLOCK_AIR;
+        glm::ivec3 l = p - chunk->coord * CHUNK_SIZE;
+        return chunk->blocks[Chunk::index(l.x, l.y, l.z)];
+    }
+    // ------------------------------------------------------------------------
+    void setBlock(glm::ivec3 p, uint8_t block)
+    {
+        glm::ivec3 c = chunkCoord(p);
+        Chunk& chunk = chunks[key(c)];
+        chunk.coord = c;
+        glm::ivec3 l = p - c * CHUNK_SIZE;
+        uint8_t& current = chunk.blocks[Chunk::index(l.x, l.y, l.z)];
+        if (current == block)
+            return;
+        current = block;
+        chunk.dirty = true;
+        // faces of the neighbouring chunk may have been exposed or hidden
+        for (int axis = 0; axis < 3; axis++)
+        {
+            glm::ivec3 step(0);
+            step[axis] = 1;
+            if (l[axis] == 0)
+                markDirty(c - step);
+            if (l[axis] == CHUNK_SIZE - 1)
+                markDirty(c + step);
+        }
+    }
+    // mesh every dirty chunk, returns how many were rebuilt
+    // ------------------------------------------------------------------------
+    size_t remeshDirty(unsigned int threads = 0)
+    {
+        std::vector<Chunk*> dirty;
+        for (auto& entry : chunks)
+            if (entry.second.dirty)
+                dirty.push_back(&entry.second);
+        if (dirty.empty())
+            return 0;
+
+        if (!threads)
+            threads = std::max(1u, std::thread::hardware_concurrency());
+        threads = std::min<unsigned int>(threads, (unsigned int)dirty.size());
+        std::atomic<size_t> next{ 0 };
+        auto worker = [&]()
+        {
+            for (size_t i = next++; i < dirty.size(); i = next++)
+            {
+                meshChunk(*dirty[i], dirty[i]->mesh);
+                dirty[i]->dirty = false;
+                dirty[i]->uploaded = false;
+            }
+        };
+        std::vector<std::thread> pool;
+        for (unsigned int i = 1; i < threads; i++)
+            pool.emplace_back(worker);
+        worker();
+        for (std::thread& t : pool)
+            t.join();
+        return dirty.size();
+    }
+    // upload rebuilt meshes, GL thread only
+    // ------------------------------------------------------------------------
+    void uploadMeshes()
+    {
+        for (auto& entry : chunks)
+        {
+            Chunk& chunk = entry.second;
+            if (chunk.uploaded || chunk.dirty)
+                continue;
+            if (!chunk.vao)
+            {
+                glGenVertexArrays(1, &chunk.vao);
+                glGenBuffers(1, &chunk.vbo);
+                glGenBuffers(1, &chunk.ebo);
+                glBindVertexArray(chunk.vao);
+                glBindBuffer(GL_ARRAY_BUFFER, chunk.vbo);
+                glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, chunk.ebo);
+                glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)0);
+                glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)(3 * sizeof(float)));
+                glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)(6 * sizeof(float)));
+                glEnableVertexAttribArray(0);
+                glEnableVertexAttribArray(1);
+                glEnableVertexAttribArray(2);
+            }
+            glBindVertexArray(chunk.vao);
+            glBindBuffer(GL_ARRAY_BUFFER, chunk.vbo);
+            glBufferData(GL_ARRAY_BUFFER, chunk.mesh.vertices.size() * sizeof(float), chunk.mesh.vertices.data(), GL_STATIC_DRAW);
+            glBufferData(GL_ELEMENT_ARRAY_BUFFER, chunk.mesh.indices.size() * sizeof(unsigned int), chunk.mesh.indices.data(), GL_STATIC_DRAW);
+            chunk.uploaded = true;
+        }
+        glBindVertexArray(0);
+    }
+    // draw all chunks material by material, textures indexed by block id; returns draw calls
+    // ------------------------------------------------------------------------
+    unsigned int draw(const GLuint* textures) const
+    {
+        unsigned int draws = 0;
+        for (int material = 1; material < BLOCK_COUNT; material++)
+        {
+            bool bound = false;
+            for (const auto& entry : chunks)
+            {
+                const Chunk& chunk = entry.second;
+                if (!chunk.vao || !chunk.mesh.materialCount[material])
+                    continue;
+                if (!bound)
+                {
+                    glBindTexture(GL_TEXTURE_2D, textures[material]);
+                    bound = true;
+                }
+                glBindVertexArray(chunk.vao);
+                glDrawElements(GL_TRIANGLES, chunk.mesh.materialCount[material], GL_UNSIGNED_INT,
+                    (void*)(chunk.mesh.materialFirst[material] * sizeof(unsigned int)));
+                draws++;
+            }
+        }
+        return draws;
+    }
+    // ------------------------------------------------------------------------
+    void release()
+    {
+        for (auto& entry : chunks)
+        {
+            Chunk& chunk = entry.second;
+            if (!chunk.vao)
+                continue;
+            glDeleteVertexArrays(1, &chunk.vao);
+            glDeleteBuffers(1, &chunk.vbo);
+            glDeleteBuffers(1, &chunk.ebo);
+            chunk.vao = chunk.vbo = chunk.ebo = 0;
+        }
+    }
+    // rolling bricks terrain with trees covering chunksX * chunksZ chunk columns from origin
+    // ------------------------------------------------------------------------
+    void generateTerrain(int chunksX, int chunksZ, glm::ivec3 origin = glm::ivec3(0), unsigned int seed = 1)
+    {
+        int sizeX = chunksX * CHUNK_SIZE, sizeZ = chunksZ * CHUNK_SIZE;
+        for (int z = 0; z < sizeZ; z++)
+            for (int x = 0; x < sizeX; x++)
+            {
+                int height = 8 + (int)(4.0f * std::sin(x * 0.11f + seed) * std::cos(z * 0.07f - seed) + (hash(x, z, seed) & 1));
+                for (int y = 0; y < height; y++)
+                    setBlock(origin + glm::ivec3(x, y, z), BLOCK_BRICKS);
+                // roughly one tree per 200 columns, clear of the terrain edges
+                if (hash(x, z, seed + 7) % 200 == 0 && x > 2 && z > 2 && x < sizeX - 3 && z < sizeZ - 3)
+                    plantTree(origin + glm::ivec3(x, height, z));
+            }
+    }
+    // ------------------------------------------------------------------------
+    void plantTree(glm::ivec3 base)
+    {
+        for (int y = 0; y < 5; y++)
+            setBlock(base + glm::ivec3(0, y, 0), BLOCK_WOOD);
+        for (int y = 3; y <= 5; y++)
+            for (int z = -2; z <= 2; z++)
+                for (int x = -2; x <= 2; x++)
+                    if ((x || z || y == 5) && std::abs(x) + std::abs(z) <= (y == 5 ? 1 : 3))
+                        setBlock(base + glm::ivec3(x, y, z), BLOCK_LEAVES);
+    }
+
+    // force a full rebuild, used by the meshing benchmark
+    void markAllDirty()
+    {
+        for (auto& entry : chunks)
+            entry.second.dirty = true;
+    }
+
+    size_t chunkCount() const { return chunks.size(); }
+    // ------------------------------------------------------------------------
+    size_t triangleCount() const
+    {
+        size_t count = 0;
+        for (const auto& entry : chunks)
+            count += entry.second.mesh.triangleCount();
+        return count;
+    }
+    size_t vertexBytes() const
+    {
+        size_t bytes = 0;
+        for (const auto& entry : chunks)
+            bytes += entry.second.mesh.vertices.size() * sizeof(float);
+        return bytes;
+    }
+    size_t visibleFaceCount() const
+    {
+        size_t count = 0;
+        for (const auto& entry : chunks)
+            count += entry.second.mesh.visibleFaces;
+        return count;
+    }
+    size_t blockCount() const
+    {
+        size_t count = 0;
+        for (const auto& entry : chunks)
+            for (uint8_t block : entry.second.blocks)
+                count += block != BLOCK_AIR;
+        return count;
+    }
+
+    // greedy mesh one chunk with hidden face removal, reading neighbours across chunk borders
+    // ------------------------------------------------------------------------
+    void meshChunk(const Chunk& chunk, ChunkMesh& out) const
+    {
+        // copy the chunk plus a one block border from its neighbours
+        const int P = CHUNK_SIZE + 2;
+        std::vector<uint8_t> padded(P * P * P, BLOCK_AIR);
+        glm::ivec3 origin = chunk.coord * CHUNK_SIZE;
+        for (int y = -1; y <= CHUNK_SIZE; y++)
+            for (int z = -1; z <= CHUNK_SIZE; z++)
+                for (int x = -1; x <= CHUNK_SIZE; x++)
+                {
+                    bool inside = x >= 0 && y >= 0 && z >= 0 && x < CHUNK_SIZE && y < CHUNK_SIZE && z < CHUNK_SIZE;
+                    padded[((y + 1) * P + (z + 1)) * P + (x + 1)] = inside
+                        ? chunk.blocks[Chunk::index(x, y, z)]
+                        : getBlock(origin + glm::ivec3(x, y, z));
+                }
+        auto at = [&](glm::ivec3 p) { return padded[((p.y + 1) * P + (p.z + 1)) * P + (p.x + 1)]; };
+
+        std::vector<float> vertices[BLOCK_COUNT];
+        std::vector<unsigned int> indices[BLOCK_COUNT];
+        uint8_t mask[CHUNK_SIZE * CHUNK_SIZE];
+        out.visibleFaces = 0;
+
+        for (int d = 0; d < 3; d++)
+        {
+            int u = (d + 1) % 3, v = (d + 2) % 3;
+            for (int side = 0; side < 2; side++)
+            {
+                glm::ivec3 normal(0);
+                normal[d] = side ? 1 : -1;
+                for (int slice = 0; slice < CHUNK_SIZE; slice++)
+                {
+                    // faces of this slice that look into air
+                    for (int j = 0; j < CHUNK_SIZE; j++)
+                        for (int i = 0; i < CHUNK_SIZE; i++)
+                        {
+                            glm::ivec3 p;
+                            p[d] = slice;
+                            p[u] = i;
+                            p[v] = j;
+                            uint8_t block = at(p);
+                            uint8_t face = block != BLOCK_AIR && at(p + normal) == BLOCK_AIR ? block : (uint8_t)BLOCK_AIR;
+                            mask[j * CHUNK_SIZE + i] = face;
+                            out.visibleFaces += face != BLOCK_AIR;
+                        }
+                    // merge equal neighbours into rectangles, widest first then tallest
+                    for (int j = 0; j < CHUNK_SIZE; j++)
+                        for (int i = 0; i < CHUNK_SIZE;)
+                        {
+                            uint8_t face = mask[j * CHUNK_SIZE + i];
+                            if (face == BLOCK_AIR)
+                            {
+                                i++;
+                                continue;
+                            }
+                            int w = 1;
+                            while (i + w < CHUNK_SIZE && mask[j * CHUNK_SIZE + i + w] == face)
+                                w++;
+                            int h = 1;
+                            for (; j + h < CHUNK_SIZE; h++)
+                            {
+                                bool row = true;
+                                for (int k = 0; k < w && row; k++)
+                                    row = mask[(j + h) * CHUNK_SIZE + i + k] == face;
+                                if (!row)
+                                    break;
+                            }
+                            for (int y = 0; y < h; y++)
+                                memset(&mask[(j + y) * CHUNK_SIZE + i], BLOCK_AIR, w);
+
+                            glm::vec3 base(origin);
+                            base -= glm::vec3(0.5f);
+                            base[d] += (float)(slice + side);
+                            base[u] += (float)i;
+                            base[v] += (float)j;
+                            glm::vec3 du(0.0f), dv(0.0f);
+                            du[u] = (float)w;
+                            dv[v] = (float)h;
+                            emitQuad(vertices[face], indices[face], base, du, dv, glm::vec3(normal), side == 1, (float)w, (float)h);
+                            i += w;
+                        }
+                }
+            }
+        }
+
+        // concatenate the per material lists
+        out.vertices.clear();
+        out.indices.clear();
+        for (int material = 0; material < BLOCK_COUNT; material++)
+        {
+            unsigned int baseVertex = (unsigned int)(out.vertices.size() / 8);
+            out.materialFirst[material] = (unsigned int)out.indices.size();
+            out.materialCount[material] = (unsigned int)indices[material].size();
+            out.vertices.insert(out.vertices.end(), vertices[material].begin(), vertices[material].end());
+            for (unsigned int index : indices[material])
+                out.indices.push_back(baseVertex + index);
+        }
+    }
+
+private:
+    std::unordered_map<uint64_t, Chunk> chunks;
+
+    static int floorDiv(int a, int b)
+    {
+        return (a >= 0 ? a : a - b + 1) / b;
+    }
+    static glm::ivec3 chunkCoord(glm::ivec3 p)
+    {
+        return glm::ivec3(floorDiv(p.x, CHUNK_SIZE), floorDiv(p.y, CHUNK_SIZE), floorDiv(p.z, CHUNK_SIZE));
+    }
+    static uint64_t key(glm::ivec3 c)
+    {
+        // 21 bits per axis
+        return ((uint64_t)(c.x & 0x1FFFFF) << 42) | ((uint64_t)(c.y & 0x1FFFFF) << 21) | (uint64_t)(c.z & 0x1FFFFF);
+    }
+    static unsigned int hash(int x, int z, unsigned int seed)
+    {
+        unsigned int h = (unsigned int)x * 374761393u + (unsigned int)z * 668265263u + seed * 2246822519u;
+        h = (h ^ (h >> 13)) * 1274126177u;
+        return h ^ (h >> 16);
+    }
+    const Chunk* findChunk(glm::ivec3 c) const
+    {
+        auto found = chunks.find(key(c));
+        return found == chunks.end() ? nullptr : &found->second;
+    }
+    void markDirty(glm::ivec3 c)
+    {
+        auto found = chunks.find(key(c));
+        if (found != chunks.end())
+            found->second.dirty = true;
+    }
+    // ------------------------------------------------------------------------
+    static void emitQuad(std::vector<float>& vertices, std::vector<unsigned int>& indices, glm::vec3 base,
+        glm::vec3 du, glm::vec3 dv, glm::vec3 normal, bool front, float w, float h)
+    {
+        unsigned int first = (unsigned int)(vertices.size() / 8);
+        glm::vec3 corners[4] = { base, base + du, base + du + dv, base + dv };
+        float uvs[4][2] = { { 0.0f, 0.0f }, { w, 0.0f }, { w, h }, { 0.0f, h } };
+        for (int c = 0; c < 4; c++)
+        {
+            const float vertex[8] = { corners[c].x, corners[c].y, corners[c].z, normal.x, normal.y, normal.z, uvs[c][0], uvs[c][1] };
+            vertices.insert(vertices.end(), vertex, vertex + 8);
+        }
+        // counter clockwise seen from the side the normal points to
+        static const unsigned int frontOrder[6] = { 0, 1, 2, 2, 3, 0 };
+        static const unsigned int backOrder[6] = { 0, 3, 2, 2, 1, 0 };
+        const unsigned int* order = front ? frontOrder : backOrder;
+        for (int k = 0; k < 6; k++)
+            indices.push_back(first + order[k]);
+    }
+};
+#endif
@@ -1,33 +1,285 @@
 #include <glad/glad.h>
 #include <GLFW/glfw3.h>
 #include <iostream>
+#include <vector>
+#include <chrono>
+#include <cstring>
+#include <cstdlib>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
 
 #define STB_IMAGE_IMPLEMENTATION
 #include "stb_image.h"
+//later includes of stb_image.h only need the declarations
+#undef STB_IMAGE_IMPLEMENTATION
 
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/type_ptr.hpp>
 
 #include <shader_m.h>
+#include <frame_stats.h>
+#include <texture_loader.h>
+#include <mesh_builder.h>
+#include <vertex_format.h>
+#include <voxel_world.h>
+#include <frustum_cull.h>
+#include <profiler.h>
+#include <program_cache.h>
+#include <frame_uniforms.h>
+#include <transparency.h>
+#include <render_queue.h>
+#include <gl_state_shadow.h>
+#include <texture_array.h>
+#include <texture_cache.h>
+#include <mip_builder.h>
+#include <asset_archive.h>
 
 void framebuffer_size_callback(GLFWwindow* window, int width, int height);
 void processInput(GLFWwindow* window);
-GLuint loadTexture(const char* path);
-void setupVertexPointers();
+void setupVertexPointers(const VertexFormat& format);
+void setupInstanceVAO(GLuint vao, GLuint cubeVBO, GLuint cubeEBO, const VertexFormat& format, GLuint instanceVBO, const std::vector<glm::vec3>& offsets);
+void setupArrayInstanceVAO(GLuint vao, GLuint cubeVBO, GLuint cubeEBO, const VertexFormat& format, GLuint instanceVBO, const std::vector<glm::vec4>& instances);
+VertexFormat uploadIndexedMesh(const IndexedMesh& mesh, bool compact, GLuint vbo, GLuint ebo);
+void reportMesh(const char* name, size_t unindexedVertices, const IndexedMesh& mesh);
+int runMeshBenchmark(int worldSize);
+void uploadVisibleOffsets(GLuint instanceVBO, const std::vector<glm::vec3>& offsets, const std::vector<uint32_t>& visible,
+	size_t visibleCount, std::vector<glm::vec3>& scratch);
+int runCullBenchmark(size_t boxCount);
+int runShaderBenchmark(int permutations);
+int runUniformBenchmark(int maxPrograms);
+int runTextureBenchmark(int textureCount);
+int runMipBenchmark(int size);
+int runAssetBenchmark(int imageCount);
+int runJpegBenchmark(const char* directory);
+int runJpegLatencyBenchmark(const char* path);
+int runInflateBenchmark(const char* directory);
+int runUnfilterBenchmark(int size);
+int runStreamBenchmark(const char* path);
+int packAssets(const char* archivePath);
+int runSortBenchmark(size_t maxInstances);
+void buildForest(int blockCount, const glm::vec3* wood, int woodCount, const glm::vec3* leaves, int leavesCount,
+	std::vector<glm::vec3>& woodBlocks, std::vector<glm::vec3>& leavesBlocks);
+std::vector<glm::vec3> buildWindows(int windowCount);
+std::vector<GLuint> createMaterialTextures(int materialCount);
 
 static int SCR_WIDTH = 800;
 static int SCR_HEIGHT = 600;
 
 glm::vec3 lightPos(1.2f, 0.5f, 2.0f);
 
-int main() {
+//switched with T while running
+static TransparencyMode transparencyMode = TRANSPARENCY_SORTED;
+
+int main(int argc, char* argv[]) {
+
+	//command line options
+	//  --instanced   draw each material batch with one glDrawElementsInstanced
+	//  --blocks N    grow the scene to at least N blocks by tiling the tree
+	//  --headless    hidden window, render into an offscreen framebuffer with a fixed camera path
+	//  --frames N    stop after N frames (headless default 300)
+	//  --compact-vertices  16 byte quantized vertices instead of 32 byte floats
+	//  --voxel       put the blocks in a chunked voxel world drawn from greedy meshes
+	//  --world N     add N x N chunks of generated terrain to the voxel world
+	//  --mesh-bench N  time greedy meshing of an N x N chunk world and exit
+	//  --cull        frustum cull the wood and leaf blocks before submitting them
+	//  --cull-bench N  time scalar vs SIMD culling of N random boxes and exit
+	//  --profile FILE  time named CPU/GPU scopes and write a Chrome trace to FILE
+	//  --windows N   draw N transparent window quads (default 1)
+	//  --oit         start with weighted blended OIT instead of sorted blending (T toggles)
+	//  --buckets     submit blocks and light as sort-keyed draw commands through a GL state cache
+	//  --buckets-naive  the same commands in submission order, every bind issued (the baseline)
+	//  --materials N  give the blocks N distinct textures and colours
+	//  --sort-bench N  time radix vs std::sort ordering of 10k up to N transparent instances and exit
+	//  --no-shader-cache  always compile shaders from source instead of restoring cached binaries
+	//  --uniform-bench N  time per-program camera uniforms vs one shared uniform buffer for up to N programs, then exit
+	//  --shader-bench N  time serial vs batched compiles and cold vs warm binary cache with N extra permutations, then exit
+	//  --gl-shadow   track bind/use/enable state under glad and drop calls that change nothing
+	//  --gl-count    count the same calls without dropping any (the baseline for --gl-shadow)
+	//  --texture-array  pack the block textures into one texture array and draw all blocks with one instanced call
+	//  --atlas       the same, but pack the images into padded atlas layers (implies --texture-array)
+	//  --no-texture-cache  always decode images and build mipmaps instead of mapping cached mip chains
+	//  --compress-textures  store cached RGB/RGBA textures as BC1/BC3 blocks
+	//  --texture-bench N  time loading N textures from img/ without the cache, writing it and mapped from it, then exit
+	//  --driver-mipmaps  build mip chains with glGenerateMipmap instead of the CPU filter
+	//  --mip-filter F  CPU mip filter: box, kaiser (default) or lanczos
+	//  --mip-bench N  time the CPU mip filters on an N x N image against glGenerateMipmap, then exit
+	//  --pack-assets FILE  pack every image in img/ into one asset archive, then exit
+	//  --assets FILE  load textures from an asset archive made by --pack-assets, files not in it from img/
+	//  --asset-bench N  decode N images from img/ through stdio, mapped one by one and from one archive, then exit
+	//  --jpeg-bench DIR  decode every JPEG under DIR with each stb_image kernel set, report MB/s and stage times, then exit
+	//  --jpeg-latency FILE  decode one large JPEG on 1, 2, 4, 8 and 16 threads, report the median time of each, then exit
+	//  --inflate-bench DIR  inflate the image data of every PNG under DIR with the original and the fast zlib decoder, then exit
+	//  --unfilter-bench N  check the PNG unfilter kernels against the scalar code, time each filter on N x N images, then exit
+	//  --stream-textures  decode every texture into its GL texture a band of rows at a time instead of whole
+	//  --stream-bench FILE  decode one image whole and in bands of rows, report time and peak memory of each, then exit
+	bool instanced = false;
+	bool headless = false;
+	bool compactVertices = false;
+	bool voxel = false;
+	int worldSize = 0;
+	int meshBenchSize = 0;
+	bool cull = false;
+	long long cullBenchSize = 0;
+	const char* profilePath = NULL;
+	bool shaderCache = true;
+	int shaderBenchSize = 0;
+	int uniformBenchSize = 0;
+	int windowCount = 1;
+	long long sortBenchSize = 0;
+	bool buckets = false;
+	bool bucketsNaive = false;
+	int materialCount = 0;
+	bool glShadow = false;
+	bool glCount = false;
+	bool textureArray = false;
+	bool forceAtlas = false;
+	bool textureCache = true;
+	int textureBenchSize = 0;
+	int mipBenchSize = 0;
+	const char* packPath = NULL;
+	const char* assetsPath = NULL;
+	int assetBenchSize = 0;
+	const char* jpegBenchPath = NULL;
+	const char* jpegLatencyPath = NULL;
+	const char* inflateBenchPath = NULL;
+	int unfilterBenchSize = 0;
+	const char* streamBenchPath = NULL;
+	int blockCount = 0;
+	long long frameLimit = -1;
+	for (int i = 1; i < argc; i++) {
+		if (strcmp(argv[i], "--instanced") == 0)
+			instanced = true;
+		else if (strcmp(argv[i], "--blocks") == 0 && i + 1 < argc)
+			blockCount = atoi(argv[++i]);
+		else if (strcmp(argv[i], "--headless") == 0)
+			headless = true;
+		else if (strcmp(argv[i], "--frames") == 0 && i + 1 < argc)
+			frameLimit = atoll(argv[++i]);
+		else if (strcmp(argv[i], "--compact-vertices") == 0)
+			compactVertices = true;
+		else if (strcmp(argv[i], "--voxel") == 0)
+			voxel = true;
+		else if (strcmp(argv[i], "--world") == 0 && i + 1 < argc) {
+			worldSize = atoi(argv[++i]);
+			voxel = true;
+		}
+		else if (strcmp(argv[i], "--mesh-bench") == 0 && i + 1 < argc)
+			meshBenchSize = atoi(argv[++i]);
+		else if (strcmp(argv[i], "--cull") == 0)
+			cull = true;
+		else if (strcmp(argv[i], "--cull-bench") == 0 && i + 1 < argc)
+			cullBenchSize = atoll(argv[++i]);
+		else if (strcmp(argv[i], "--profile") == 0 && i + 1 < argc)
+			profilePath = argv[++i];
+		else if (strcmp(argv[i], "--windows") == 0 && i + 1 < argc)
+			windowCount = std::max(1, atoi(argv[++i]));
+		else if (strcmp(argv[i], "--oit") == 0)
+			transparencyMode = TRANSPARENCY_OIT;
+		else if (strcmp(argv[i], "--buckets") == 0)
+			buckets = true;
+		else if (strcmp(argv[i], "--buckets-naive") == 0)
+			buckets = bucketsNaive = true;
+		else if (strcmp(argv[i], "--materials") == 0 && i + 1 < argc)
+			materialCount = std::max(0, atoi(argv[++i]));
+		else if (strcmp(argv[i], "--sort-bench") == 0 && i + 1 < argc)
+			sortBenchSize = atoll(argv[++i]);
+		else if (strcmp(argv[i], "--no-shader-cache") == 0)
+			shaderCache = false;
+		else if (strcmp(argv[i], "--shader-bench") == 0 && i + 1 < argc)
+			shaderBenchSize = atoi(argv[++i]);
+		else if (strcmp(argv[i], "--uniform-bench") == 0 && i + 1 < argc)
+			uniformBenchSize = atoi(argv[++i]);
+		else if (strcmp(argv[i], "--gl-shadow") == 0)
+			glShadow = true;
+		else if (strcmp(argv[i], "--gl-count") == 0)
+			glCount = true;
+		else if (strcmp(argv[i], "--texture-array") == 0)
+			textureArray = true;
+		else if (strcmp(argv[i], "--atlas") == 0) {
+			forceAtlas = true;
+			textureArray = true;
+		}
+		else if (strcmp(argv[i], "--no-texture-cache") == 0)
+			textureCache = false;
+		else if (strcmp(argv[i], "--compress-textures") == 0)
+			TextureCache::compress = true;
+		else if (strcmp(argv[i], "--texture-bench") == 0 && i + 1 < argc)
+			textureBenchSize = atoi(argv[++i]);
+		else if (strcmp(argv[i], "--driver-mipmaps") == 0)
+			TextureLoader::driverMipmaps = true;
+		else if (strcmp(argv[i], "--mip-filter") == 0 && i + 1 < argc) {
+			const char* filter = argv[++i];
+			if (strcmp(filter, "box") == 0)
+				TextureLoader::mipOptions.filter = MIP_FILTER_BOX;
+			else if (strcmp(filter, "lanczos") == 0)
+				TextureLoader::mipOptions.filter = MIP_FILTER_LANCZOS;
+			else
+				TextureLoader::mipOptions.filter = MIP_FILTER_KAISER;
+		}
+		else if (strcmp(argv[i], "--mip-bench") == 0 && i + 1 < argc)
+			mipBenchSize = atoi(argv[++i]);
+		else if (strcmp(argv[i], "--pack-assets") == 0 && i + 1 < argc)
+			packPath = argv[++i];
+		else if (strcmp(argv[i], "--assets") == 0 && i + 1 < argc)
+			assetsPath = argv[++i];
+		else if (strcmp(argv[i], "--asset-bench") == 0 && i + 1 < argc)
+			assetBenchSize = atoi(argv[++i]);
+		else if (strcmp(argv[i], "--jpeg-bench") == 0 && i + 1 < argc)
+			jpegBenchPath = argv[++i];
+		else if (strcmp(argv[i], "--jpeg-latency") == 0 && i + 1 < argc)
+			jpegLatencyPath = argv[++i];
+		else if (strcmp(argv[i], "--inflate-bench") == 0 && i + 1 < argc)
+			inflateBenchPath = argv[++i];
+		else if (strcmp(argv[i], "--unfilter-bench") == 0 && i + 1 < argc)
+			unfilterBenchSize = atoi(argv[++i]);
+		else if (strcmp(argv[i], "--stream-textures") == 0)
+			TextureLoader::streamPixels = 0;
+		else if (strcmp(argv[i], "--stream-bench") == 0 && i + 1 < argc)
+			streamBenchPath = argv[++i];
+		else
+			std::cout << "Unknown option: " << argv[i] << std::endl;
+	}
+	//a headless run has no window to close, so it always needs a frame limit
+	if (frameLimit <= 0)
+		frameLimit = headless ? 300 : 0;
+	if (meshBenchSize > 0)
+		return runMeshBenchmark(meshBenchSize);
+	if (cullBenchSize > 0)
+		return runCullBenchmark((size_t)cullBenchSize);
+	if (sortBenchSize > 0)
+		return runSortBenchmark((size_t)sortBenchSize);
+	if (assetBenchSize > 0)
+		return runAssetBenchmark(assetBenchSize);
+	if (jpegBenchPath)
+		return runJpegBenchmark(jpegBenchPath);
+	if (jpegLatencyPath)
+		return runJpegLatencyBenchmark(jpegLatencyPath);
+	if (inflateBenchPath)
+		return runInflateBenchmark(inflateBenchPath);
+	if (unfilterBenchSize > 0)
+		return runUnfilterBenchmark(unfilterBenchSize);
+	if (streamBenchPath)
+		return runStreamBenchmark(streamBenchPath);
+	if (packPath)
+		return packAssets(packPath);
+	//linked program binaries are kept next to the executable's working directory
+	if (shaderCache)
+		ProgramCache::directory = "shader_cache";
+	//and decoded textures with their mip chains
+	if (textureCache)
+		TextureCache::directory = "texture_cache";
+	auto startupBegin = std::chrono::steady_clock::now();
 
 	//initialize, set window hints
 	glfwInit();
 	glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
 	glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
 	glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+	//headless runs still need a context, keep its window off screen
+	if (headless)
+		glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
 
 	//create the window
 	GLFWwindow* window = glfwCreateWindow(SCR_WIDTH, SCR_HEIGHT, "Tutorial7", NULL, NULL);
@@ -49,16 +301,85 @@ int main() {
 		std::cout << "Failed to initialize GLAD" << std::endl;
 		return -1;
 	}
+	if (shaderBenchSize > 0) {
+		int result = runShaderBenchmark(shaderBenchSize);
+		glfwTerminate();
+		return result;
+	}
+	if (uniformBenchSize > 0) {
+		int result = runUniformBenchmark(uniformBenchSize);
+		glfwTerminate();
+		return result;
+	}
+	if (textureBenchSize > 0) {
+		int result = runTextureBenchmark(textureBenchSize);
+		glfwTerminate();
+		return result;
+	}
+	if (mipBenchSize > 0) {
+		int result = runMipBenchmark(mipBenchSize);
+		glfwTerminate();
+		return result;
+	}
+	//every later GL call goes through the shadow, before any state is set
+	if (glShadow || glCount)
+		GLStateShadow::install(glShadow);
+
+	//headless: render into an offscreen framebuffer and never wait on vsync
+	GLuint offscreenFBO = 0, offscreenColor = 0, offscreenDepth = 0;
+	if (headless) {
+		glfwSwapInterval(0);
+		glGenFramebuffers(1, &offscreenFBO);
+		glGenRenderbuffers(1, &offscreenColor);
+		glGenRenderbuffers(1, &offscreenDepth);
+		glBindRenderbuffer(GL_RENDERBUFFER, offscreenColor);
+		glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, SCR_WIDTH, SCR_HEIGHT);
+		glBindRenderbuffer(GL_RENDERBUFFER, offscreenDepth);
+		glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, SCR_WIDTH, SCR_HEIGHT);
+		glBindFramebuffer(GL_FRAMEBUFFER, offscreenFBO);
+		glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, offscreenColor);
+		glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, offscreenDepth);
+		if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+			std::cout << "Offscreen framebuffer is not complete" << std::endl;
+			glfwTerminate();
+			return -1;
+		}
+		glViewport(0, 0, SCR_WIDTH, SCR_HEIGHT);
+	}
 
 	//enable opengl depth test, blend, alpha params
 	glEnable(GL_DEPTH_TEST);
 	glEnable(GL_BLEND);
 	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
 
-	//build and compile shaders
-	Shader shader("shaders/shader.vs", "shaders/shader.fs");
-	Shader lightShader("shaders/lightingShader.vs", "shaders/lightingShader.fs");
-	Shader blendShader("shaders/blendShader.vs", "shaders/blendShader.fs");
+	//build and compile shaders, restored from the program binary cache when possible
+	//all of them are submitted before any status is checked so the driver can compile them in parallel
+	auto shaderStart = std::chrono::steady_clock::now();
+	ShaderBatch shaderBatch;
+	shaderBatch.add("shaders/shader.vs", "shaders/shader.fs");
+	shaderBatch.add("shaders/lightingShader.vs", "shaders/lightingShader.fs");
+	shaderBatch.add("shaders/blendShader.vs", "shaders/blendShader.fs");
+	shaderBatch.add("shaders/blendShader.vs", "shaders/oitShader.fs");
+	shaderBatch.add("shaders/oitComposite.vs", "shaders/oitComposite.fs");
+	shaderBatch.add("shaders/arrayShader.vs", "shaders/arrayShader.fs");
+	std::vector<Shader> shaders = shaderBatch.finish();
+	Shader& shader = shaders[0];
+	Shader& lightShader = shaders[1];
+	Shader& blendShader = shaders[2];
+	Shader& oitShader = shaders[3];
+	Shader& oitCompositeShader = shaders[4];
+	Shader& arrayShader = shaders[5];
+	oitCompositeShader.use();
+	oitCompositeShader.setInt("accumTexture", 0);
+	oitCompositeShader.setInt("weightTexture", 1);
+	//camera and light live in one uniform buffer shared by all programs
+	for (const Shader& program : shaders)
+		FrameUniforms::attach(program.ID);
+	FrameUniforms frameUniforms;
+	frameUniforms.create();
+	std::cout << "shaders: " << std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - shaderStart).count()
+		<< " ms, " << ProgramCache::hits << " cached, " << ProgramCache::misses << " compiled"
+		<< (ProgramCache::available() ? "" : " (program binary cache unavailable)") << std::endl;
 
 	//cube vertices
 	float vertices[] = {
@@ -152,163 +473,544 @@ int main() {
 		glm::vec3(-1.0f, 3.0f - 2.0f, 1.0f),
 		glm::vec3(-1.0f, 3.0f - 2.0f, -1.0f),
 	};
+
+	//tile the tree across a grid until the scene holds the requested number of blocks
+	std::vector<glm::vec3> woodBlocks, leavesBlocks;
+	buildForest(blockCount, cubePositions, 5, leavesPositions, 12, woodBlocks, leavesBlocks);
+
+	//unit boxes around every block for culling, visible lists start out as every block
+	AabbList woodBounds, leavesBounds;
+	std::vector<uint32_t> woodVisibleIndices(woodBlocks.size()), leavesVisibleIndices(leavesBlocks.size());
+	for (size_t i = 0; i < woodBlocks.size(); i++) {
+		woodBounds.add(woodBlocks[i] - glm::vec3(0.5f), woodBlocks[i] + glm::vec3(0.5f));
+		woodVisibleIndices[i] = (uint32_t)i;
+	}
+	for (size_t i = 0; i < leavesBlocks.size(); i++) {
+		leavesBounds.add(leavesBlocks[i] - glm::vec3(0.5f), leavesBlocks[i] + glm::vec3(0.5f));
+		leavesVisibleIndices[i] = (uint32_t)i;
+	}
+	std::vector<glm::vec3> visibleOffsets;
+	unsigned long long visibleBlocks = 0;
+
+	//transparent windows, drawn sorted back to front or accumulated in any order
+	std::vector<glm::vec3> windows = buildWindows(windowCount);
+	std::vector<uint32_t> unsortedWindows(windows.size());
+	for (size_t i = 0; i < windows.size(); i++)
+		unsortedWindows[i] = (uint32_t)i;
+	TransparentQueue transparentQueue;
+	int sortThreads = (int)std::max(1u, std::thread::hardware_concurrency());
+	int framebufferWidth = SCR_WIDTH, framebufferHeight = SCR_HEIGHT;
+	if (!headless)
+		glfwGetFramebufferSize(window, &framebufferWidth, &framebufferHeight);
+	WeightedBlendedOIT oit;
+	oit.create(framebufferWidth, framebufferHeight);
+	SampleCounter transparentSamples;
+	double transparencySortSeconds[TRANSPARENCY_MODE_COUNT] = {};
+	unsigned long long transparencyFrames[TRANSPARENCY_MODE_COUNT] = {};
+
+	//voxel mode: the same blocks (plus optional terrain underneath) as greedy meshed chunks
+	VoxelWorld world;
+	if (voxel) {
+		for (const glm::vec3& p : woodBlocks)
+			world.setBlock(glm::ivec3(glm::round(p)), BLOCK_WOOD);
+		for (const glm::vec3& p : leavesBlocks)
+			world.setBlock(glm::ivec3(glm::round(p)), BLOCK_LEAVES);
+		if (worldSize > 0)
+			world.generateTerrain(worldSize, worldSize, glm::ivec3(-worldSize * CHUNK_SIZE / 2, -12, -worldSize * CHUNK_SIZE / 2));
+		auto meshStart = std::chrono::steady_clock::now();
+		size_t meshed = world.remeshDirty();
+		std::cout << "voxel world: " << meshed << " chunks meshed in "
+			<< std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - meshStart).count() << " ms, "
+			<< world.triangleCount() << " triangles" << std::endl;
+		world.uploadMeshes();
+	}
  
+	//weld the triangle lists into indexed meshes ordered for the post-transform cache
+	IndexedMesh cubeMesh = buildIndexedMesh(vertices, sizeof(vertices) / sizeof(float) / 8, 8);
+	IndexedMesh planeMesh = buildIndexedMesh(planeVertices, sizeof(planeVertices) / sizeof(float) / 8, 8);
+	IndexedMesh transparentMesh = buildIndexedMesh(transparentVertices, sizeof(transparentVertices) / sizeof(float) / 8, 8);
+	reportMesh("cube", sizeof(vertices) / sizeof(float) / 8, cubeMesh);
+	reportMesh("plane", sizeof(planeVertices) / sizeof(float) / 8, planeMesh);
+	reportMesh("window", sizeof(transparentVertices) / sizeof(float) / 8, transparentMesh);
+	GLsizei cubeIndexCount = (GLsizei)cubeMesh.indices.size();
+	GLsizei transparentIndexCount = (GLsizei)transparentMesh.indices.size();
+
 	//load vertex data into VBO buffer, create VAO + EBO 
-	unsigned int VBO, VAO;
+	unsigned int VBO, EBO, VAO;
 	glGenBuffers(1, &VBO);
+	glGenBuffers(1, &EBO);
 	glGenVertexArrays(1, &VAO);
 	glBindVertexArray(VAO);
-	glBindBuffer(GL_ARRAY_BUFFER, VBO);
-	glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
+	VertexFormat cubeFormat = uploadIndexedMesh(cubeMesh, compactVertices, VBO, EBO);
 
 	//setup vertex pointers
-	setupVertexPointers();
+	setupVertexPointers(cubeFormat);
 
 	//create VAO for light
 	unsigned int lightVAO;
 	glGenVertexArrays(1, &lightVAO);
 	glBindVertexArray(lightVAO);
 	glBindBuffer(GL_ARRAY_BUFFER, VBO);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
 	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void*)0);
 	glEnableVertexAttribArray(0);
 
 	//setup vertex pointers
-	setupVertexPointers();
+	setupVertexPointers(cubeFormat);
 
-	unsigned int planeVAO, planeVBO;
+	unsigned int planeVAO, planeVBO, planeEBO;
     glGenVertexArrays(1, &planeVAO);
     glGenBuffers(1, &planeVBO);
+    glGenBuffers(1, &planeEBO);
     glBindVertexArray(planeVAO);
-    glBindBuffer(GL_ARRAY_BUFFER, planeVBO);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(planeVertices), &planeVertices, GL_STATIC_DRAW);
+    VertexFormat planeFormat = uploadIndexedMesh(planeMesh, compactVertices, planeVBO, planeEBO);
     glEnableVertexAttribArray(0);
 
 	//setup vertex pointers
-	setupVertexPointers();
+	setupVertexPointers(planeFormat);
 
 	// transparent VAO
-    unsigned int transparentVAO, transparentVBO;
+    unsigned int transparentVAO, transparentVBO, transparentEBO;
     glGenVertexArrays(1, &transparentVAO);
     glGenBuffers(1, &transparentVBO);
+    glGenBuffers(1, &transparentEBO);
     glBindVertexArray(transparentVAO);
-    glBindBuffer(GL_ARRAY_BUFFER, transparentVBO);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(transparentVertices), transparentVertices, GL_STATIC_DRAW);
+    VertexFormat transparentFormat = uploadIndexedMesh(transparentMesh, compactVertices, transparentVBO, transparentEBO);
     glEnableVertexAttribArray(0);
     
 	//setup vertex pointers
-	setupVertexPointers();
+	setupVertexPointers(transparentFormat);
+
+	//vertex data fetched by one draw of each mesh
+	size_t cubeVertexBytes = cubeMesh.vertexCount() * cubeFormat.stride;
+	size_t transparentVertexBytes = transparentMesh.vertexCount() * transparentFormat.stride;
+	std::cout << "vertex format: " << cubeFormat.stride << " bytes per vertex" << std::endl;
+
+	//instanced VAOs, the cube VBO/EBO plus one per-instance offset buffer per material
+	unsigned int woodVAO, leavesVAO, woodInstanceVBO, leavesInstanceVBO;
+	glGenVertexArrays(1, &woodVAO);
+	glGenVertexArrays(1, &leavesVAO);
+	glGenBuffers(1, &woodInstanceVBO);
+	glGenBuffers(1, &leavesInstanceVBO);
+	setupInstanceVAO(woodVAO, VBO, EBO, cubeFormat, woodInstanceVBO, woodBlocks);
+	setupInstanceVAO(leavesVAO, VBO, EBO, cubeFormat, leavesInstanceVBO, leavesBlocks);
+
+	//decode textures on worker threads (flipped on load), upload here as each one finishes
+	TextureLoader textureLoader;
+	AssetArchive assets;
+	if (assetsPath) {
+		if (assets.open(assetsPath))
+			textureLoader.setArchive(&assets);
+		else
+			std::cout << "Asset archive failed to open at path: " << assetsPath << ", loading from img/" << std::endl;
+	}
+	GLuint woodTexture = textureLoader.add("img/wood.png");
+	GLuint leavesTexture = textureLoader.add("img/leaves.png");
+	GLuint windowTexture = textureLoader.add("img/window.png");
+	GLuint bricksTexture = voxel ? textureLoader.add("img/bricks.jpg") : 0;
+	textureLoader.finish();
+	//indexed by block id
+	GLuint voxelTextures[BLOCK_COUNT] = { 0, woodTexture, leavesTexture, bricksTexture };
+
+	//texture array path: wood and leaves as entries of one array texture, every block one instance
+	//of a single draw carrying its offset and entry index
+	TextureArrayBuilder blockTextures;
+	unsigned int blocksVAO = 0, blocksInstanceVBO = 0;
+	std::vector<glm::vec4> blockInstances, visibleInstances;
+	if (textureArray) {
+		int woodEntry = blockTextures.add("img/wood.png");
+		int leavesEntry = blockTextures.add("img/leaves.png");
+		blockTextures.build(true, forceAtlas);
+		blockTextures.report(std::cout);
+		std::vector<glm::vec4> rects(blockTextures.entryCount());
+		std::vector<float> layers(blockTextures.entryCount());
+		for (size_t e = 0; e < blockTextures.entryCount(); e++) {
+			rects[e] = blockTextures.entry((int)e).rect;
+			layers[e] = blockTextures.entry((int)e).layer;
+		}
+		arrayShader.use();
+		arrayShader.setInt("blockTextures", 0);
+		glUniform4fv(arrayShader.uniform("entryRects[0]").location, (GLsizei)rects.size(), &rects[0][0]);
+		glUniform1fv(arrayShader.uniform("entryLayers[0]").location, (GLsizei)layers.size(), layers.data());
+		//the box at the origin, then wood, then leaves, the order the culled upload keeps
+		blockInstances.push_back(glm::vec4(0.0f, 0.0f, 0.0f, (float)woodEntry));
+		for (const glm::vec3& p : woodBlocks)
+			blockInstances.push_back(glm::vec4(p, (float)woodEntry));
+		for (const glm::vec3& p : leavesBlocks)
+			blockInstances.push_back(glm::vec4(p, (float)leavesEntry));
+		glGenVertexArrays(1, &blocksVAO);
+		glGenBuffers(1, &blocksInstanceVBO);
+		setupArrayInstanceVAO(blocksVAO, VBO, EBO, cubeFormat, blocksInstanceVBO, blockInstances);
+	}
 
-	//load textures using function
-	//load textures using function
-	GLuint woodTexture, leavesTexture, windowTexture;
-	//h-flip on load
-	stbi_set_flip_vertically_on_load(true);
-	woodTexture = loadTexture("img/wood.png");
-	leavesTexture = loadTexture("img/leaves.png");
-	windowTexture = loadTexture("img/window.png");
+	//materials of the per-block path: wood and leaves, or N generated ones spread over all blocks
+	struct Material {
+		GLuint texture;
+		glm::vec3 color;
+	};
+	std::vector<Material> materials;
+	std::vector<GLuint> materialTextures = createMaterialTextures(materialCount);
+	for (size_t m = 0; m < materialTextures.size(); m++)
+		materials.push_back({ materialTextures[m], glm::vec3(0.1f + 0.8f * (m % 5) / 4.0f, 0.5f, 0.31f) });
+	std::vector<uint32_t> woodMaterials(woodBlocks.size(), 0), leavesMaterials(leavesBlocks.size(), 0);
+	if (materials.empty()) {
+		materials.push_back({ woodTexture, glm::vec3(0.1f, 0.5f, 0.31f) });
+		materials.push_back({ leavesTexture, glm::vec3(0.1f, 0.5f, 0.31f) });
+		std::fill(leavesMaterials.begin(), leavesMaterials.end(), 1);
+	}
+	else {
+		//scattered so neighbouring blocks rarely share one, the worst case for submission order
+		for (size_t i = 0; i < woodBlocks.size(); i++)
+			woodMaterials[i] = (uint32_t)((i * 2654435761u) % materials.size());
+		for (size_t i = 0; i < leavesBlocks.size(); i++)
+			leavesMaterials[i] = (uint32_t)(((i + woodBlocks.size()) * 2654435761u) % materials.size());
+	}
+	CommandBucket commandBucket;
+	GLStateCache stateCache(!bucketsNaive);
+	unsigned long long bucketFrames = 0;
 
 	shader.use();
 	//shader.setInt("woodTexture", 0);
 	//shader.setInt("leavesTexture", 1);
 
-	//pass projection matrix to shader
+	//projection goes into the per-frame uniform buffer with the view
 	glm::mat4 projection = glm::perspective(glm::radians(45.0f), (float)SCR_WIDTH / (float)SCR_HEIGHT, 0.1f, 100.0f);
-	shader.setMat4("projection", projection);
+
+	//resolve uniform handles once so the render loop never looks names up
+	UniformHandle shaderModel = shader.uniform("model");
+	UniformHandle shaderObjectColor = shader.uniform("objectColor");
+	UniformHandle lightModel = lightShader.uniform("model");
+	UniformHandle blendModel = blendShader.uniform("model");
+	UniformHandle oitModel = oitShader.uniform("model");
+
+	//uniform lookups that reached the driver, startup vs render loop
+	unsigned int startupUniformLookups = Shader::driverUniformLookups;
+	unsigned long long frameUniformLookups = 0;
+
+	//frame timing, gpu timing and draw call counts
+	FrameStats stats;
+	if (profilePath)
+		Profiler::instance().enable();
+
+	//block submission stats
+	unsigned long long blockDrawCalls = 0, blockTextureBinds = 0;
+	double blockSubmitSeconds = 0.0;
+	std::cout << "scene: " << (voxel ? world.blockCount() : woodBlocks.size() + leavesBlocks.size()) << " blocks, "
+		<< (voxel ? "voxel chunks" : instanced ? "instanced" : "one draw per block") << std::endl;
 
 	//clear
 	glBindBuffer(GL_ARRAY_BUFFER, 0);
 	glBindVertexArray(0);
 
-	while (!glfwWindowShouldClose(window)) {
+	textureLoader.report(std::cout);
+	std::cout << "startup: " << std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - startupBegin).count()
+		<< " ms" << std::endl;
+
+	while (headless || !glfwWindowShouldClose(window)) {
+		if (frameLimit > 0 && stats.frames() >= (unsigned long long)frameLimit)
+			break;
 		//MAIN LOOP
 		//get input
 		processInput(window);
+		Shader::driverUniformLookups = 0;
+		stats.beginFrame();
+		Profiler::instance().beginFrame();
+		PROFILE_CPU("frame");
+		//only render loop calls are reported
+		if (stats.frames() == 0)
+			GLStateShadow::resetCounters();
+		//headless runs follow a fixed 60Hz camera path so every run renders the same frames
+		double time = headless ? stats.frames() / 60.0 : glfwGetTime();
 
 		//rendering commands here =============
 
+		//render with camera
+		glm::mat4 view = glm::mat4(1.0f);
+		float radius = 10.0f;
+		float camX = static_cast<float>(sin(time) * radius);
+		float camZ = static_cast<float>(cos(time) * radius);
+		view = glm::lookAt(glm::vec3(camX, 0.0f, camZ), glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+
+		//one upload of camera and light for every program this frame
+		FrameData frameData;
+		frameData.view = view;
+		frameData.projection = projection;
+		frameData.viewProjection = projection * view;
+		frameData.viewPos = glm::vec4(camX, 0.0f, camZ, 1.0f);
+		frameData.lightPos = glm::vec4(lightPos, 1.0f);
+		frameData.lightColor = glm::vec4(1.0f);
+		frameUniforms.update(frameData);
+
 		//clear colour set & clear
 		glClearColor(0.1f, 0.1f, 0.1f, 1.0f);
 		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
-		//load textures
-		glActiveTexture(GL_TEXTURE0);
-		glBindTexture(GL_TEXTURE_2D, woodTexture);
+		//set by the opaque paths that draw the light cube with the blocks
+		bool lightSubmitted = false;
+		{
+			PROFILE_CPU("opaque");
+			PROFILE_GPU("opaque");
+			//load textures, the texture array path binds its own
+			glActiveTexture(GL_TEXTURE0);
+			if (!textureArray || voxel) {
+				glBindTexture(GL_TEXTURE_2D, woodTexture);
+				blockTextureBinds++;
+			}
 
-		//use shader for model
-		shader.use();
-		//set model colour and light colour
-		shader.setVec3("objectColor", 0.1, 0.5f, 0.31f);
-		shader.setVec3("lightColor", 1.0f, 1.0f, 1.0);
-		shader.setVec3("lightPos", lightPos);
+			//use shader for model
+			shader.use();
+			//set model colour, light colour comes from the frame uniforms
+			shader.setVec3(shaderObjectColor, 0.1, 0.5f, 0.31f);
 
-		//render with camera
-		glm::mat4 view = glm::mat4(1.0f);
-		float radius = 10.0f;
-		float camX = static_cast<float>(sin(glfwGetTime()) * radius);
-		float camZ = static_cast<float>(cos(glfwGetTime()) * radius);
-		view = glm::lookAt(glm::vec3(camX, 0.0f, camZ), glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
-		shader.setMat4("view", view);
+			auto submitStart = std::chrono::steady_clock::now();
+			//cull against the planes of projection * view, four or eight boxes at a time
+			size_t woodVisible = woodBlocks.size(), leavesVisible = leavesBlocks.size();
+			if (cull && !voxel) {
+				Frustum frustum = Frustum::fromMatrix(frameData.viewProjection);
+				woodVisible = cullAabbs(frustum, woodBounds, woodVisibleIndices.data());
+				leavesVisible = cullAabbs(frustum, leavesBounds, leavesVisibleIndices.data());
+			}
+			visibleBlocks += woodVisible + leavesVisible;
+			if (voxel) {
+				//rebuild and upload chunks edited since the last frame
+				if (world.remeshDirty())
+					world.uploadMeshes();
+				shader.setMat4(shaderModel, glm::mat4(1.0f));
+				unsigned int chunkDraws = world.draw(voxelTextures);
+				blockDrawCalls += chunkDraws;
+				stats.addDraws(chunkDraws, world.vertexBytes());
+			}
+			else if (textureArray) {
+				//one bind and one draw for every block, whatever its material
+				size_t instanceCount = blockInstances.size();
+				if (cull) {
+					visibleInstances.resize(1 + woodVisible + leavesVisible);
+					visibleInstances[0] = blockInstances[0];
+					for (size_t i = 0; i < woodVisible; i++)
+						visibleInstances[1 + i] = blockInstances[1 + woodVisibleIndices[i]];
+					for (size_t i = 0; i < leavesVisible; i++)
+						visibleInstances[1 + woodVisible + i] = blockInstances[1 + woodBlocks.size() + leavesVisibleIndices[i]];
+					instanceCount = visibleInstances.size();
+					glBindBuffer(GL_ARRAY_BUFFER, blocksInstanceVBO);
+					glBufferSubData(GL_ARRAY_BUFFER, 0, instanceCount * sizeof(glm::vec4), visibleInstances.data());
+				}
+				arrayShader.use();
+				glBindTexture(GL_TEXTURE_2D_ARRAY, blockTextures.id());
+				glBindVertexArray(blocksVAO);
+				glDrawElementsInstanced(GL_TRIANGLES, cubeIndexCount, GL_UNSIGNED_SHORT, (void*)0, (GLsizei)instanceCount);
+				blockTextureBinds++;
+				blockDrawCalls++;
+				stats.addDraws(1, cubeVertexBytes * instanceCount);
+			}
+			else if (instanced) {
+				//offsets come from the instance buffer, model stays identity
+				shader.setMat4(shaderModel, glm::mat4(1.0f));
+				//culled: compact the surviving offsets to the front of each instance buffer
+				if (cull) {
+					uploadVisibleOffsets(woodInstanceVBO, woodBlocks, woodVisibleIndices, woodVisible, visibleOffsets);
+					uploadVisibleOffsets(leavesInstanceVBO, leavesBlocks, leavesVisibleIndices, leavesVisible, visibleOffsets);
+				}
+				glBindVertexArray(woodVAO);
+				glDrawElementsInstanced(GL_TRIANGLES, cubeIndexCount, GL_UNSIGNED_SHORT, (void*)0, (GLsizei)woodVisible);
 
-		//draw the box
-		glBindVertexArray(VAO);
-		glDrawArrays(GL_TRIANGLES, 0, 36);
+				glBindTexture(GL_TEXTURE_2D, leavesTexture);
+				glBindVertexArray(leavesVAO);
+				glDrawElementsInstanced(GL_TRIANGLES, cubeIndexCount, GL_UNSIGNED_SHORT, (void*)0, (GLsizei)leavesVisible);
+				blockTextureBinds++;
+				blockDrawCalls += 2;
+				stats.addDraws(2, cubeVertexBytes * (woodVisible + leavesVisible));
+			}
+			else if (buckets) {
+				//record every block with its sort key
+				commandBucket.clear();
+				auto addBlock = [&](const glm::vec3& position, const Material& material) {
+					DrawCommand command = { shader.ID, material.texture, VAO, cubeIndexCount, shaderModel.location,
+						shaderObjectColor.location, glm::translate(glm::mat4(1.0f), position), material.color };
+					commandBucket.add(drawSortKey(PASS_OPAQUE, shader.ID, material.texture, VAO, -viewDepth(view, position), 100.0f), command);
+				};
+				addBlock(glm::vec3(0.0f), materials[0]);
+				for (size_t i = 0; i < woodVisible; i++)
+					addBlock(woodBlocks[woodVisibleIndices[i]], materials[woodMaterials[woodVisibleIndices[i]]]);
+				for (size_t i = 0; i < leavesVisible; i++)
+					addBlock(leavesBlocks[leavesVisibleIndices[i]], materials[leavesMaterials[leavesVisibleIndices[i]]]);
+				//the glowing cube, a different program sorted in with the blocks
+				glm::mat4 lightCube = glm::scale(glm::translate(glm::mat4(1.0f), lightPos), glm::vec3(0.2f));
+				DrawCommand light = { lightShader.ID, 0, lightVAO, cubeIndexCount, lightModel.location, -1, lightCube, glm::vec3(1.0f) };
+				commandBucket.add(drawSortKey(PASS_OPAQUE, lightShader.ID, 0, lightVAO, -viewDepth(view, lightPos), 100.0f), light);
+				//replay in key order through the state cache, or as recorded for the baseline
+				if (!bucketsNaive)
+					commandBucket.sort();
+				commandBucket.submit(stateCache);
+				lightSubmitted = true;
+				bucketFrames++;
+				blockDrawCalls += 1 + woodVisible + leavesVisible;
+				stats.addDraws((unsigned int)(2 + woodVisible + leavesVisible), cubeVertexBytes * (2 + woodVisible + leavesVisible));
+			}
+			else {
+				//draw the box
+				glBindVertexArray(VAO);
+				glDrawElements(GL_TRIANGLES, cubeIndexCount, GL_UNSIGNED_SHORT, (void*)0);
 
-		//draw each wood piece
-		for (unsigned int i = 0; i < 5; i++) {
-			glm::mat4 model = glm::mat4(1.0f);
-			model = glm::translate(model, cubePositions[i]);
-			shader.setMat4("model", model);
-			glDrawArrays(GL_TRIANGLES, 0, 36);
-		}
+				//draw each wood piece
+				for (size_t i = 0; i < woodVisible; i++) {
+					glm::mat4 model = glm::mat4(1.0f);
+					model = glm::translate(model, woodBlocks[woodVisibleIndices[i]]);
+					shader.setMat4(shaderModel, model);
+					glDrawElements(GL_TRIANGLES, cubeIndexCount, GL_UNSIGNED_SHORT, (void*)0);
+				}
+
+				//change texture to leaves
+				glActiveTexture(GL_TEXTURE0);
+				glBindTexture(GL_TEXTURE_2D, leavesTexture);
+				blockTextureBinds++;
 
-		//change texture to leaves
-		glActiveTexture(GL_TEXTURE0);
-		glBindTexture(GL_TEXTURE_2D, leavesTexture);
+				//draw each leaf block
+				for (size_t i = 0; i < leavesVisible; i++) {
+					glm::mat4 model = glm::mat4(1.0f);
+					model = glm::translate(model, leavesBlocks[leavesVisibleIndices[i]]);
+					shader.setMat4(shaderModel, model);
+					glDrawElements(GL_TRIANGLES, cubeIndexCount, GL_UNSIGNED_SHORT, (void*)0);
+				}
+				blockDrawCalls += 1 + woodVisible + leavesVisible;
+				stats.addDraws((unsigned int)(1 + woodVisible + leavesVisible), cubeVertexBytes * (1 + woodVisible + leavesVisible));
+			}
+			blockSubmitSeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - submitStart).count();
+		}
 
-		//draw each leaf block
-		for (unsigned int i = 0; i < 12; i++) {
+		//draw the light cube unless the opaque path already sorted it in with the blocks
+		if (!lightSubmitted) {
+			PROFILE_CPU("light");
+			PROFILE_GPU("light");
+			//set up glowing cube
+			lightShader.use();
 			glm::mat4 model = glm::mat4(1.0f);
-			model = glm::translate(model, leavesPositions[i]);
-			shader.setMat4("model", model);
-			glDrawArrays(GL_TRIANGLES, 0, 36);
-		}
-
-		//set up glowing cube
-		lightShader.use();
-		lightShader.setMat4("projection", projection);
-		lightShader.setMat4("view", view);
-		glm::mat4 model = glm::mat4(1.0f);
-		model = glm::translate(model, lightPos);
-		model = glm::scale(model, glm::vec3(0.2f));
-		lightShader.setMat4("model", model);
-
-		//draw glowing cube
-		glBindVertexArray(lightVAO);
-		glDrawArrays(GL_TRIANGLES, 0, 36);
-
-		//draw transparency test plane
-		blendShader.use();
-		blendShader.setMat4("projection", projection);
-		blendShader.setMat4("view", view);
-		// Render the window
-        glBindVertexArray(transparentVAO);
-        glBindTexture(GL_TEXTURE_2D, windowTexture);
-        model = glm::mat4(1.0f);
-        model = glm::translate(model, glm::vec3(0.0f, 0.0f, -2.0f));
-		model = glm::scale(model, glm::vec3(2.0f));
-        blendShader.setMat4("model", model);
-        glDrawArrays(GL_TRIANGLES, 0, 6);
+			model = glm::translate(model, lightPos);
+			model = glm::scale(model, glm::vec3(0.2f));
+			lightShader.setMat4(lightModel, model);
+
+			//draw glowing cube
+			glBindVertexArray(lightVAO);
+			glDrawElements(GL_TRIANGLES, cubeIndexCount, GL_UNSIGNED_SHORT, (void*)0);
+			stats.addDraws(1, cubeVertexBytes);
+		}
+
+		{
+			PROFILE_CPU("blend");
+			PROFILE_GPU("blend");
+			TransparencyMode mode = transparencyMode;
+			transparencyFrames[mode]++;
+			Shader& windowShader = mode == TRANSPARENCY_OIT ? oitShader : blendShader;
+			UniformHandle windowModel = mode == TRANSPARENCY_OIT ? oitModel : blendModel;
+			const std::vector<uint32_t>* windowOrder = &unsortedWindows;
+			if (mode == TRANSPARENCY_OIT) {
+				//follow window resizes, the accumulation targets must match the framebuffer
+				if (!headless)
+					glfwGetFramebufferSize(window, &framebufferWidth, &framebufferHeight);
+				oit.resize(framebufferWidth, framebufferHeight);
+				oit.begin();
+			}
+			else {
+				//back to front so each window blends over everything behind it
+				auto sortStart = std::chrono::steady_clock::now();
+				transparentQueue.clear();
+				for (size_t i = 0; i < windows.size(); i++)
+					transparentQueue.push((uint32_t)i, viewDepth(view, windows[i]));
+				windowOrder = &transparentQueue.sort(sortThreads);
+				transparencySortSeconds[mode] += std::chrono::duration<double>(std::chrono::steady_clock::now() - sortStart).count();
+			}
+			windowShader.use();
+			// Render the windows
+	        glBindVertexArray(transparentVAO);
+	        glBindTexture(GL_TEXTURE_2D, windowTexture);
+			transparentSamples.begin(mode);
+			for (uint32_t index : *windowOrder) {
+				glm::mat4 model = glm::mat4(1.0f);
+				model = glm::translate(model, windows[index]);
+				model = glm::scale(model, glm::vec3(2.0f));
+				windowShader.setMat4(windowModel, model);
+				glDrawElements(GL_TRIANGLES, transparentIndexCount, GL_UNSIGNED_SHORT, (void*)0);
+			}
+			transparentSamples.end();
+			stats.addDraws((unsigned int)windows.size(), transparentVertexBytes * windows.size());
+			if (mode == TRANSPARENCY_OIT) {
+				oit.composite(oitCompositeShader);
+				stats.addDraws(1);
+			}
+		}
 
 		//====================================
 
+		stats.endFrame();
+		Profiler::instance().endFrame();
+		frameUniformLookups += Shader::driverUniformLookups;
+
 		//check and call events and swap buffers
-		glfwSwapBuffers(window);
+		if (!headless)
+			glfwSwapBuffers(window);
 		glfwPollEvents();
 	}
+	unsigned long long frameCount = stats.frames();
+	stats.report(std::cout);
+	if (profilePath) {
+		Profiler::instance().report(std::cout);
+		Profiler::instance().writeChromeTrace(profilePath);
+	}
+	std::cout << "uniform lookups: " << startupUniformLookups << " at startup, "
+		<< (frameCount ? (double)frameUniformLookups / frameCount : 0.0) << " per frame" << std::endl;
+	if (frameCount)
+		std::cout << "block draw calls: " << (double)blockDrawCalls / frameCount << " per frame, "
+			<< (double)blockTextureBinds / frameCount << " texture binds per frame, CPU submit "
+			<< blockSubmitSeconds * 1000.0 / frameCount << " ms per frame, "
+			<< (double)visibleBlocks / frameCount << " blocks visible per frame" << std::endl;
+	if (bucketFrames) {
+		double binds = (double)stateCache.issued / bucketFrames;
+		double calls = binds + (double)(commandBucket.uniformCalls + commandBucket.drawCalls) / bucketFrames;
+		std::cout << "command buckets (" << (bucketsNaive ? "submission order, no state cache" : "sorted, state cache") << "): "
+			<< materials.size() << " materials, " << (double)commandBucket.drawCalls / bucketFrames << " draws, "
+			<< binds << " state changes, " << calls << " GL calls, "
+			<< (double)stateCache.skipped / bucketFrames << " redundant binds skipped per frame" << std::endl;
+	}
+	GLStateShadow::report(std::cout, frameCount);
+	//sorting costs CPU time, OIT costs fill: RGBA8 blending reads and writes 8 bytes per fragment,
+	//the accumulation targets 20, plus a depth copy and composite over the whole framebuffer
+	transparentSamples.flush();
+	for (int m = 0; m < TRANSPARENCY_MODE_COUNT; m++) {
+		unsigned long long measured = transparentSamples.frames(m);
+		if (!transparencyFrames[m] || !measured)
+			continue;
+		double fragments = (double)transparentSamples.samples(m) / measured;
+		double bytes = m == TRANSPARENCY_OIT ? fragments * WeightedBlendedOIT::FRAGMENT_BYTES
+			+ (double)oit.pixelCount() * WeightedBlendedOIT::PIXEL_BYTES : fragments * 8.0;
+		std::cout << "transparency " << transparencyModeName((TransparencyMode)m) << ": " << windows.size() << " windows, "
+			<< transparencyFrames[m] << " frames, CPU sort " << transparencySortSeconds[m] * 1000.0 / transparencyFrames[m]
+			<< " ms per frame, " << fragments << " fragments, " << bytes / (1024.0 * 1024.0) << " MB blend traffic per frame" << std::endl;
+	}
 	//delete all resources
 	glDeleteVertexArrays(1, &VAO);
 	glDeleteVertexArrays(1, &lightVAO);
+	glDeleteVertexArrays(1, &woodVAO);
+	glDeleteVertexArrays(1, &leavesVAO);
 	glDeleteBuffers(1, &VBO);
+	glDeleteBuffers(1, &EBO);
+	glDeleteBuffers(1, &woodInstanceVBO);
+	glDeleteBuffers(1, &leavesInstanceVBO);
+	if (textureArray) {
+		glDeleteVertexArrays(1, &blocksVAO);
+		glDeleteBuffers(1, &blocksInstanceVBO);
+		blockTextures.release();
+	}
+	world.release();
+	frameUniforms.release();
+	oit.release();
+	transparentSamples.release();
+	stats.release();
+	Profiler::instance().release();
+	glDeleteTextures((GLsizei)materialTextures.size(), materialTextures.data());
+	if (headless) {
+		glDeleteFramebuffers(1, &offscreenFBO);
+		glDeleteRenderbuffers(1, &offscreenColor);
+		glDeleteRenderbuffers(1, &offscreenDepth);
+	}
 
 	glfwTerminate();
 	return 0;
@@ -321,48 +1023,1188 @@ void framebuffer_size_callback(GLFWwindow* window, int width, int height) {
 void processInput(GLFWwindow* window) {
 	if (glfwGetKey(window, GLFW_KEY_ESCAPE) == GLFW_PRESS)
 		glfwSetWindowShouldClose(window, true);
+	//switch transparency mode once per key press
+	static bool togglePressed = false;
+	bool pressed = glfwGetKey(window, GLFW_KEY_T) == GLFW_PRESS;
+	if (pressed && !togglePressed) {
+		transparencyMode = transparencyMode == TRANSPARENCY_OIT ? TRANSPARENCY_SORTED : TRANSPARENCY_OIT;
+		std::cout << "transparency: " << transparencyModeName(transparencyMode) << std::endl;
+	}
+	togglePressed = pressed;
 }
 
-//load texture from path function
-GLuint loadTexture(const char* path) {
-	GLuint textureID;
-	glGenTextures(1, &textureID);
-	int width, height, nrChannels;
-	unsigned char* data = stbi_load(path, &width, &height, &nrChannels, 0);
-	if (data) {
-		GLenum format;
-		if (nrChannels == 3)
-			format = GL_RGB;
-		else if (nrChannels == 4)
-			format = GL_RGBA;
-		else
-			format = GL_RGBA;
+void setupVertexPointers(const VertexFormat& format) {
+	//setup vertex pointers
+	format.setupPointers();
+}
+
+//cube VBO layout plus a vec3 offset per instance at location 3
+void setupInstanceVAO(GLuint vao, GLuint cubeVBO, GLuint cubeEBO, const VertexFormat& format, GLuint instanceVBO, const std::vector<glm::vec3>& offsets) {
+	glBindVertexArray(vao);
+	glBindBuffer(GL_ARRAY_BUFFER, cubeVBO);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, cubeEBO);
+	setupVertexPointers(format);
+	glBindBuffer(GL_ARRAY_BUFFER, instanceVBO);
+	glBufferData(GL_ARRAY_BUFFER, offsets.size() * sizeof(glm::vec3), offsets.data(), GL_STATIC_DRAW);
+	glVertexAttribPointer(3, 3, GL_FLOAT, GL_FALSE, sizeof(glm::vec3), (void*)0);
+	glEnableVertexAttribArray(3);
+	glVertexAttribDivisor(3, 1);
+	glBindVertexArray(0);
+}
+
+//same as setupInstanceVAO with a vec4 per instance: translation in xyz, texture array entry in w
+void setupArrayInstanceVAO(GLuint vao, GLuint cubeVBO, GLuint cubeEBO, const VertexFormat& format, GLuint instanceVBO, const std::vector<glm::vec4>& instances) {
+	glBindVertexArray(vao);
+	glBindBuffer(GL_ARRAY_BUFFER, cubeVBO);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, cubeEBO);
+	setupVertexPointers(format);
+	glBindBuffer(GL_ARRAY_BUFFER, instanceVBO);
+	glBufferData(GL_ARRAY_BUFFER, instances.size() * sizeof(glm::vec4), instances.data(), GL_DYNAMIC_DRAW);
+	glVertexAttribPointer(3, 4, GL_FLOAT, GL_FALSE, sizeof(glm::vec4), (void*)0);
+	glEnableVertexAttribArray(3);
+	glVertexAttribDivisor(3, 1);
+	glBindVertexArray(0);
+}
+
+//repeat the tree on a square grid, 4 units apart, until at least blockCount blocks exist
+void buildForest(int blockCount, const glm::vec3* wood, int woodCount, const glm::vec3* leaves, int leavesCount,
+	std::vector<glm::vec3>& woodBlocks, std::vector<glm::vec3>& leavesBlocks) {
+	int perTree = woodCount + leavesCount;
+	int trees = blockCount > perTree ? (blockCount + perTree - 1) / perTree : 1;
+	int side = 1;
+	while (side * side < trees)
+		side++;
+	woodBlocks.reserve(trees * woodCount);
+	leavesBlocks.reserve(trees * leavesCount);
+	for (int t = 0; t < trees; t++) {
+		//first tree stays at the origin, the rest fill the grid along +x/+z
+		glm::vec3 offset((float)(t % side) * 4.0f, 0.0f, (float)(t / side) * 4.0f);
+		for (int i = 0; i < woodCount; i++)
+			woodBlocks.push_back(wood[i] + offset);
+		for (int i = 0; i < leavesCount; i++)
+			leavesBlocks.push_back(leaves[i] + offset);
+	}
+}
+
+//the original window in front of the tree, then windowCount - 1 more scattered around it
+std::vector<glm::vec3> buildWindows(int windowCount) {
+	std::vector<glm::vec3> windows;
+	windows.push_back(glm::vec3(0.0f, 0.0f, -2.0f));
+	unsigned int seed = 7;
+	auto random = [&seed](float low, float high) {
+		seed = seed * 1664525u + 1013904223u;
+		return low + (float)(seed >> 8) / (float)(1 << 24) * (high - low);
+	};
+	while ((int)windows.size() < windowCount) {
+		float x = random(-8.0f, 8.0f);
+		float y = random(-1.5f, 3.0f);
+		float z = random(-8.0f, 8.0f);
+		windows.push_back(glm::vec3(x, y, z));
+	}
+	return windows;
+}
+
+//tiny solid colour textures, one per material
+std::vector<GLuint> createMaterialTextures(int materialCount) {
+	std::vector<GLuint> textures(materialCount);
+	if (materialCount == 0)
+		return textures;
+	glGenTextures(materialCount, textures.data());
+	for (int m = 0; m < materialCount; m++) {
+		unsigned int hash = (unsigned int)(m + 1) * 2654435761u;
+		unsigned char texel[4] = { (unsigned char)hash, (unsigned char)(hash >> 8), (unsigned char)(hash >> 16), 255 };
+		unsigned char pixels[4 * 4 * 4];
+		for (int i = 0; i < 16; i++)
+			memcpy(pixels + i * 4, texel, 4);
+		glBindTexture(GL_TEXTURE_2D, textures[m]);
+		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, 4, 4, 0, GL_RGBA, GL_UNSIGNED_BYTE, pixels);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	}
+	glBindTexture(GL_TEXTURE_2D, 0);
+	return textures;
+}
+
+//upload an indexed mesh into the currently bound VAO, packed as 32 byte float or 16 byte compact vertices
+VertexFormat uploadIndexedMesh(const IndexedMesh& mesh, bool compact, GLuint vbo, GLuint ebo) {
+	VertexFormat format = compact ? VertexFormat::compactFor(mesh.vertices.data(), mesh.vertexCount()) : VertexFormat::float32();
+	std::vector<unsigned char> packed = format.pack(mesh.vertices.data(), mesh.vertexCount());
+	glBindBuffer(GL_ARRAY_BUFFER, vbo);
+	glBufferData(GL_ARRAY_BUFFER, packed.size(), packed.data(), GL_STATIC_DRAW);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ebo);
+	glBufferData(GL_ELEMENT_ARRAY_BUFFER, mesh.indices.size() * sizeof(unsigned short), mesh.indices.data(), GL_STATIC_DRAW);
+	return format;
+}
+
+//vertex counts and ACMR of the raw triangle list vs the indexed mesh
+void reportMesh(const char* name, size_t unindexedVertices, const IndexedMesh& mesh) {
+	std::vector<unsigned short> unindexed(unindexedVertices);
+	for (size_t i = 0; i < unindexedVertices; i++)
+		unindexed[i] = (unsigned short)i;
+	std::cout << "mesh " << name << ": " << unindexedVertices << " -> " << mesh.vertexCount() << " vertices, ACMR "
+		<< computeACMR(unindexed) << " -> " << computeACMR(mesh.indices) << std::endl;
+}
+
+//generate an N x N chunk world, mesh it single threaded and on all cores, print triangle counts and throughput
+int runMeshBenchmark(int worldSize) {
+	VoxelWorld world;
+	auto start = std::chrono::steady_clock::now();
+	world.generateTerrain(worldSize, worldSize);
+	double generateMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+	size_t blocks = world.blockCount();
+	std::cout << "world: " << world.chunkCount() << " chunks, " << blocks << " blocks, generated in " << generateMs << " ms" << std::endl;
+
+	unsigned int threadCounts[2] = { 1, std::max(1u, std::thread::hardware_concurrency()) };
+	for (unsigned int threads : threadCounts) {
+		world.markAllDirty();
+		start = std::chrono::steady_clock::now();
+		size_t meshed = world.remeshDirty(threads);
+		double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+		std::cout << "meshing on " << threads << " threads: " << meshed / seconds << " chunks/s ("
+			<< seconds * 1000.0 << " ms)" << std::endl;
+	}
+	size_t visibleFaces = world.visibleFaceCount();
+	std::cout << "triangles: " << blocks * 12 << " full cubes, " << visibleFaces * 2 << " after face culling ("
+		<< blocks * 6 - visibleFaces << " hidden faces removed), " << world.triangleCount() << " greedy" << std::endl;
+	return 0;
+}
+
+//gather the offsets of visible blocks and overwrite the front of the instance buffer with them
+void uploadVisibleOffsets(GLuint instanceVBO, const std::vector<glm::vec3>& offsets, const std::vector<uint32_t>& visible,
+	size_t visibleCount, std::vector<glm::vec3>& scratch) {
+	scratch.resize(visibleCount);
+	for (size_t i = 0; i < visibleCount; i++)
+		scratch[i] = offsets[visible[i]];
+	glBindBuffer(GL_ARRAY_BUFFER, instanceVBO);
+	glBufferSubData(GL_ARRAY_BUFFER, 0, visibleCount * sizeof(glm::vec3), scratch.data());
+}
+
+//cull N random unit boxes against the default camera with every available path
+int runCullBenchmark(size_t boxCount) {
+	AabbList boxes;
+	unsigned int seed = 1;
+	for (size_t i = 0; i < boxCount; i++) {
+		glm::vec3 center;
+		for (int c = 0; c < 3; c++) {
+			seed = seed * 1664525u + 1013904223u;
+			center[c] = (float)(seed >> 8) / (float)(1 << 24) * 100.0f - 50.0f;
+		}
+		boxes.add(center - glm::vec3(0.5f), center + glm::vec3(0.5f));
+	}
+	glm::mat4 projection = glm::perspective(glm::radians(45.0f), (float)SCR_WIDTH / (float)SCR_HEIGHT, 0.1f, 100.0f);
+	glm::mat4 view = glm::lookAt(glm::vec3(0.0f, 0.0f, 10.0f), glm::vec3(0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+	Frustum frustum = Frustum::fromMatrix(projection * view);
+	std::vector<uint32_t> visible(boxCount);
+
+	auto run = [&](const char* name, size_t (*cullFunction)(const Frustum&, const AabbList&, uint32_t*)) {
+		const int repeats = 10;
+		size_t count = 0;
+		auto start = std::chrono::steady_clock::now();
+		for (int r = 0; r < repeats; r++)
+			count = cullFunction(frustum, boxes, visible.data());
+		double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count() / repeats;
+		std::cout << name << ": " << boxCount / seconds / 1.0e6 << " M boxes/s, " << count << " visible" << std::endl;
+	};
+	run("scalar", [](const Frustum& f, const AabbList& b, uint32_t* v) { return cullAabbsScalar(f, b, v); });
+#ifdef FRUSTUM_CULL_SSE
+	run("sse", cullAabbsSSE);
+#endif
+#ifdef FRUSTUM_CULL_AVX
+	if (frustumCullAvxAvailable())
+		run("avx", cullAabbsAVX);
+	else
+		std::cout << "avx: not supported by this CPU" << std::endl;
+#endif
+	return 0;
+}
+
+//build the three scene programs plus N variants of shader.fs: serially, batched, then batched
+//against an empty binary cache and once more warm
+int runShaderBenchmark(int permutations) {
+	auto readFile = [](const char* path) {
+		std::ifstream file(path);
+		std::stringstream stream;
+		stream << file.rdbuf();
+		return stream.str();
+	};
+	const char* paths[3][2] = {
+		{ "shaders/shader.vs", "shaders/shader.fs" },
+		{ "shaders/lightingShader.vs", "shaders/lightingShader.fs" },
+		{ "shaders/blendShader.vs", "shaders/blendShader.fs" },
+	};
+	std::vector<std::pair<std::string, std::string>> baseSources;
+	for (auto& pair : paths)
+		baseSources.push_back({ readFile(pair[0]), readFile(pair[1]) });
+	//defines after the #version line make every program of every pass distinct, so neither the
+	//driver's in-memory cache nor our binary cache can serve a pass from an earlier one
+	auto tag = [](const std::string& source, const std::string& defines) {
+		std::string tagged = source;
+		tagged.insert(tagged.find('\n') + 1, defines);
+		return tagged;
+	};
+	auto makeSources = [&](int passId) {
+		std::string pass = "#define PASS " + std::to_string(passId) + "\n";
+		std::vector<std::pair<std::string, std::string>> sources;
+		for (auto& base : baseSources)
+			sources.push_back({ base.first, tag(base.second, pass) });
+		for (int i = 0; i < permutations; i++)
+			sources.push_back({ baseSources[0].first, tag(baseSources[0].second, pass + "#define PERMUTATION " + std::to_string(i) + "\n") });
+		return sources;
+	};
+
+	auto run = [&](const char* name, const std::vector<std::pair<std::string, std::string>>& sources, bool batched) {
+		unsigned int hits = ProgramCache::hits, misses = ProgramCache::misses;
+		std::vector<Shader> built;
+		unsigned int polls = 0;
+		auto start = std::chrono::steady_clock::now();
+		if (batched) {
+			ShaderBatch batch;
+			for (auto& source : sources)
+				batch.addSource(source.first, source.second);
+			built = batch.finish();
+			polls = batch.pollCount();
+		}
+		else {
+			for (auto& source : sources)
+				built.push_back(Shader::fromSource(source.first, source.second));
+		}
+		//make sure the driver has really finished before stopping the clock
+		glFinish();
+		double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+		std::cout << name << ": " << built.size() << " programs in " << ms << " ms";
+		if (ProgramCache::available())
+			std::cout << " (" << ProgramCache::hits - hits << " cached, " << ProgramCache::misses - misses << " compiled)";
+		if (batched)
+			std::cout << ", " << polls << " completion polls";
+		std::cout << std::endl;
+		for (const Shader& shader : built)
+			glDeleteProgram(shader.ID);
+	};
+
+	std::cout << "parallel shader compile: " << (GLAD_GL_KHR_parallel_shader_compile ? "KHR" :
+		GLAD_GL_ARB_parallel_shader_compile ? "ARB" : "unavailable") << std::endl;
+	//compile from source only
+	std::string cacheDirectory = ProgramCache::directory;
+	ProgramCache::directory.clear();
+	run("serial", makeSources(0), false);
+	run("batched", makeSources(1), true);
+	ProgramCache::directory = cacheDirectory;
+
+	if (!ProgramCache::available()) {
+		std::cout << "program binary cache unavailable (needs GL_ARB_get_program_binary with at least one format, "
+			"and not --no-shader-cache)" << std::endl;
+		return 0;
+	}
+	ProgramCache::directory = "shader_cache/bench";
+	std::error_code error;
+	std::filesystem::remove_all(ProgramCache::directory, error);
+	std::vector<std::pair<std::string, std::string>> cachedSources = makeSources(2);
+	run("cache cold", cachedSources, true);
+	run("cache warm", cachedSources, true);
+	std::cout << "Mesa keeps its own shader cache, set MESA_SHADER_CACHE_DISABLE=true to time a truly cold compile" << std::endl;
+	return 0;
+}
+
+//load N textures cycled from img/ three times: decoded and mipmapped with no cache, the same
+//while writing cache entries, and mapped from the cache with every level uploaded directly
+int runTextureBenchmark(int textureCount) {
+	const char* files[] = { "img/bricks.jpg", "img/cloud.png", "img/container.jpg", "img/leaves.png",
+		"img/mario.png", "img/qBlock.png", "img/window.png", "img/wood.png" };
+	const int fileCount = sizeof(files) / sizeof(files[0]);
+	auto run = [&](const char* name) {
+		unsigned int hits = TextureCache::hits;
+		TextureLoader loader;
+		std::vector<GLuint> textures;
+		auto start = std::chrono::steady_clock::now();
+		for (int i = 0; i < textureCount; i++)
+			textures.push_back(loader.add(files[i % fileCount]));
+		loader.finish();
+		//make sure the driver has really finished before stopping the clock
+		glFinish();
+		double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+		std::cout << name << ": " << textureCount << " textures in " << ms << " ms, " << ms / textureCount << " ms each, "
+			<< TextureCache::hits - hits << " from cache" << std::endl << "    ";
+		loader.report(std::cout);
+		glDeleteTextures((GLsizei)textures.size(), textures.data());
+	};
 
-		glBindTexture(GL_TEXTURE_2D, textureID);
-		glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format, GL_UNSIGNED_BYTE, data);
+	std::string cacheDirectory = TextureCache::directory;
+	TextureCache::directory.clear();
+	run("decode + mipmap");
+	if (cacheDirectory.empty()) {
+		std::cout << "texture cache disabled by --no-texture-cache" << std::endl;
+		return 0;
+	}
+	TextureCache::directory = cacheDirectory + "/bench";
+	std::error_code error;
+	std::filesystem::remove_all(TextureCache::directory, error);
+	run("decode + mipmap, writing the cache");
+	run("mapped from the cache");
+	uintmax_t cacheBytes = 0;
+	for (const auto& entry : std::filesystem::directory_iterator(TextureCache::directory, error))
+		cacheBytes += entry.file_size(error);
+	std::cout << "cache: " << cacheBytes / (1024.0 * 1024.0) << " MB for " << fileCount << " images"
+		<< (TextureCache::compress ? GLAD_GL_EXT_texture_compression_s3tc ? ", BC1/BC3 compressed" : ", uncompressed (no GL_EXT_texture_compression_s3tc)" : "")
+		<< std::endl;
+	return 0;
+}
+
+//build the full mip chain of a synthetic N x N RGBA image with every CPU filter on every SIMD
+//path, on one thread and on all of them, then with glGenerateMipmap on the driver
+int runMipBenchmark(int size) {
+	//a colour gradient with a cutout pattern, so the sRGB and alpha handling both do work
+	std::vector<unsigned char> pixels((size_t)size * size * 4);
+	for (int y = 0; y < size; y++)
+		for (int x = 0; x < size; x++) {
+			unsigned char* texel = &pixels[((size_t)y * size + x) * 4];
+			texel[0] = (unsigned char)(x * 255 / size);
+			texel[1] = (unsigned char)(y * 255 / size);
+			texel[2] = (unsigned char)((x ^ y) & 255);
+			texel[3] = ((x / 8 + y / 8) & 1) ? 255 : 0;
+		}
+	double megapixels = (double)size * size / 1e6;
+	const int repeats = 3;
+	unsigned int cores = std::max(1u, std::thread::hardware_concurrency());
+	MipBuilder builder;
+	for (MipFilter filter : { MIP_FILTER_BOX, MIP_FILTER_KAISER, MIP_FILTER_LANCZOS })
+		for (MipSimd simd : { MIP_SIMD_SCALAR, MIP_SIMD_SSE, MIP_SIMD_AVX2 }) {
+			//paths this CPU lacks would fall back to the widest one it has
+			if (simd > MipBuilder::bestSimd())
+				continue;
+			for (unsigned int threads : { 1u, cores }) {
+				MipOptions options;
+				options.filter = filter;
+				options.simd = simd;
+				options.threads = (int)threads;
+				auto start = std::chrono::steady_clock::now();
+				size_t levels = 0;
+				for (int i = 0; i < repeats; i++)
+					levels = builder.build(pixels.data(), size, size, 4, options).size();
+				double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count() / repeats;
+				std::cout << mipFilterName(filter) << " " << MipBuilder::simdName(simd) << " " << threads << " thread"
+					<< (threads == 1 ? "" : "s") << ": " << levels << " levels in " << ms << " ms, "
+					<< megapixels / (ms / 1000.0) << " MP/s" << std::endl;
+				if (threads == cores)
+					break;
+			}
+		}
+
+	GLuint texture;
+	glGenTextures(1, &texture);
+	glBindTexture(GL_TEXTURE_2D, texture);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, size, size, 0, GL_RGBA, GL_UNSIGNED_BYTE, pixels.data());
+	glFinish();
+	auto start = std::chrono::steady_clock::now();
+	for (int i = 0; i < repeats; i++)
 		glGenerateMipmap(GL_TEXTURE_2D);
+	//make sure the driver has really finished before stopping the clock
+	glFinish();
+	double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count() / repeats;
+	std::cout << "glGenerateMipmap: " << ms << " ms, " << megapixels / (ms / 1000.0) << " MP/s (box, no sRGB or alpha weighting)" << std::endl;
+	glDeleteTextures(1, &texture);
+	return 0;
+}
 
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+//every image in img/, in name order so an archive packs them the same way each time
+std::vector<std::string> listImages() {
+	std::vector<std::string> paths;
+	std::error_code error;
+	for (const auto& entry : std::filesystem::directory_iterator("img", error)) {
+		std::string extension = entry.path().extension().string();
+		if (extension == ".png" || extension == ".jpg")
+			paths.push_back(entry.path().generic_string());
+	}
+	std::sort(paths.begin(), paths.end());
+	return paths;
+}
 
-		stbi_image_free(data);
+int packAssets(const char* archivePath) {
+	std::vector<std::string> paths = listImages();
+	if (!AssetArchive::pack(archivePath, paths)) {
+		std::cout << "failed to write asset archive " << archivePath << std::endl;
+		return -1;
 	}
-	else {
-		std::cout << "Texture failed to load at path: " << path << std::endl;
-		stbi_image_free(data);
+	std::cout << "packed " << paths.size() << " images into " << archivePath << std::endl;
+	return 0;
+}
+
+//decode N images cycled from img/ three ways: stbi_load on the path (stdio reads into stb's
+//buffer), each file mapped and decoded from memory, and every image from one mapped archive.
+//read syscalls come from /proc/self/io where there is one (Linux), page faults from getrusage;
+//the files are warm in the page cache after the first pass, so this measures the syscall and
+//copy cost, not the disk
+int runAssetBenchmark(int imageCount) {
+	std::vector<std::string> paths = listImages();
+	if (paths.empty()) {
+		std::cout << "no images in img/" << std::endl;
+		return -1;
 	}
+	struct Counters {
+		bool io = false;
+		long long readCalls = 0, readBytes = 0, minorFaults = 0, majorFaults = 0;
+	};
+	auto sample = []() {
+		Counters counters;
+		std::ifstream io("/proc/self/io");
+		counters.io = io.is_open();
+		std::string name;
+		long long value;
+		while (io >> name >> value) {
+			if (name == "syscr:")
+				counters.readCalls = value;
+			else if (name == "rchar:")
+				counters.readBytes = value;
+		}
+		rusage usage;
+		getrusage(RUSAGE_SELF, &usage);
+		counters.minorFaults = usage.ru_minflt;
+		counters.majorFaults = usage.ru_majflt;
+		return counters;
+	};
+	//what one sample itself costs in reads, taken off every run
+	long long sampleReads = -sample().readCalls;
+	sampleReads += sample().readCalls;
+	auto run = [&](const char* name, auto decode) {
+		Counters before = sample();
+		auto start = std::chrono::steady_clock::now();
+		int decoded = 0;
+		for (int i = 0; i < imageCount; i++) {
+			int width, height, channels;
+			unsigned char* pixels = decode(paths[i % paths.size()], &width, &height, &channels);
+			decoded += pixels ? 1 : 0;
+			stbi_image_free(pixels);
+		}
+		double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+		Counters after = sample();
+		std::cout << name << ": " << decoded << " images in " << ms << " ms, " << ms / imageCount << " ms each, ";
+		if (after.io)
+			std::cout << after.readCalls - before.readCalls - sampleReads << " read syscalls (" << (after.readBytes - before.readBytes) / 1024
+				<< " KB copied), ";
+		else
+			std::cout << "read syscalls unavailable (no /proc/self/io), ";
+		std::cout << after.minorFaults - before.minorFaults << " minor / " << after.majorFaults - before.majorFaults
+			<< " major page faults" << std::endl;
+	};
 
-	return textureID;
+	std::error_code error;
+	std::string archivePath = (std::filesystem::temp_directory_path(error) / "bench_assets.pak").string();
+	if (!AssetArchive::pack(archivePath, paths)) {
+		std::cout << "failed to write asset archive " << archivePath << std::endl;
+		return -1;
+	}
+	run("stdio", [](const std::string& path, int* width, int* height, int* channels) {
+		return stbi_load(path.c_str(), width, height, channels, 0);
+	});
+	run("mapped", [](const std::string& path, int* width, int* height, int* channels) {
+		MappedFile file;
+		if (!file.open(path, MADV_SEQUENTIAL))
+			return (unsigned char*)NULL;
+		return stbi_load_from_memory(file.data(), (int)file.size(), width, height, channels, 0);
+	});
+	AssetArchive archive;
+	auto start = std::chrono::steady_clock::now();
+	if (!archive.open(archivePath)) {
+		std::cout << "failed to open asset archive " << archivePath << std::endl;
+		std::filesystem::remove(archivePath, error);
+		return -1;
+	}
+	double openMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+	run("archive", [&archive](const std::string& path, int* width, int* height, int* channels) {
+		const AssetArchive::Entry* entry = archive.find(path);
+		return entry ? stbi_load_from_memory(entry->data, (int)entry->size, width, height, channels, 0) : NULL;
+	});
+	std::cout << "archive: " << archive.entryCount() << " images, " << archive.size() / 1024 << " KB, opened in " << openMs
+		<< " ms; the mapped path costs open, fstat, mmap, madvise, close and munmap per image, the archive those once" << std::endl;
+	archive.close();
+	std::filesystem::remove(archivePath, error);
+	return 0;
 }
 
-void setupVertexPointers() {
-	//setup vertex pointers
-	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)0);
-	glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)(3 * sizeof(float)));
-	glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)(6 * sizeof(float)));
+//decode every JPEG under a directory with the scalar, SSE2 and AVX2 stb_image kernels, baseline
+//and progressive files apart: throughput first, then a pass with stage timing for the split
+//between Huffman decoding, IDCT, chroma upsampling and colour conversion. Images are decoded
+//to their own channel count as TextureLoader does, so colour conversion writes RGB
+int runJpegBenchmark(const char* directory) {
+	struct JpegFile {
+		MappedFile file;
+		bool progressive = false;
+		int pixels = 0;
+	};
+	std::vector<JpegFile> files;
+	std::error_code error;
+	for (const auto& entry : std::filesystem::recursive_directory_iterator(directory, error)) {
+		std::string extension = entry.path().extension().string();
+		if (extension != ".jpg" && extension != ".jpeg")
+			continue;
+		JpegFile jpeg;
+		int width, height, channels;
+		if (!jpeg.file.open(entry.path().string()) || !stbi_info_from_memory(jpeg.file.data(), (int)jpeg.file.size(), &width, &height, &channels))
+			continue;
+		jpeg.pixels = width * height;
+		//walk the marker segments up to the frame header: SOF2 is progressive, SOF0/SOF1 baseline
+		const unsigned char* data = jpeg.file.data();
+		for (size_t at = 2; at + 4 <= jpeg.file.size() && data[at] == 0xFF; at += 2 + (data[at + 2] << 8 | data[at + 3])) {
+			if (data[at + 1] >= 0xC0 && data[at + 1] <= 0xC2) {
+				jpeg.progressive = data[at + 1] == 0xC2;
+				break;
+			}
+		}
+		files.push_back(std::move(jpeg));
+	}
+	if (files.empty()) {
+		std::cout << "no JPEG files under " << directory << std::endl;
+		return -1;
+	}
+
+	const char* levelNames[] = { "scalar", "sse2", "avx2" };
+	int bestLevel = stbi_jpeg_kernels();
+	for (int level = STBI_JPEG_KERNELS_SCALAR; level <= bestLevel; level++) {
+		stbi_jpeg_set_kernels(level);
+		for (bool progressive : { false, true }) {
+			std::vector<const JpegFile*> set;
+			size_t bytes = 0, pixels = 0;
+			for (const JpegFile& jpeg : files)
+				if (jpeg.progressive == progressive) {
+					set.push_back(&jpeg);
+					bytes += jpeg.file.size();
+					pixels += jpeg.pixels;
+				}
+			if (set.empty())
+				continue;
+			auto decodeAll = [&set]() {
+				for (const JpegFile* jpeg : set) {
+					int width, height, channels;
+					stbi_image_free(stbi_load_from_memory(jpeg->file.data(), (int)jpeg->file.size(), &width, &height, &channels, 0));
+				}
+			};
+			//whole passes over the set for at least half a second
+			int passes = 0;
+			auto start = std::chrono::steady_clock::now();
+			double seconds = 0.0;
+			while (seconds < 0.5) {
+				decodeAll();
+				passes++;
+				seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+			}
+			stbi_jpeg_stage_ticks ticks;
+			stbi_jpeg_get_stage_ticks(&ticks, 1);
+			stbi_jpeg_stage_timing(1);
+			for (int i = 0; i < passes; i++)
+				decodeAll();
+			stbi_jpeg_stage_timing(0);
+			stbi_jpeg_get_stage_ticks(&ticks, 1);
+			double total = (double)(ticks.entropy + ticks.idct + ticks.upsample + ticks.color);
+			double msPerImage = seconds * 1000.0 / ((double)passes * set.size());
+			auto share = [&](unsigned long long stage) { return total > 0.0 ? stage / total : 0.0; };
+			std::cout << levelNames[level] << " " << (progressive ? "progressive" : "baseline") << ": " << set.size() << " files, "
+				<< bytes * passes / seconds / 1e6 << " MB/s in, " << pixels * passes / seconds / 1e6 << " MP/s out, "
+				<< msPerImage << " ms per image (entropy " << share(ticks.entropy) * 100.0 << "%, idct " << share(ticks.idct) * 100.0
+				<< "%, upsample " << share(ticks.upsample) * 100.0 << "%, color " << share(ticks.color) * 100.0 << "%)" << std::endl;
+		}
+	}
+	stbi_jpeg_set_kernels(STBI_JPEG_KERNELS_AVX2);
+	return 0;
+}
+
+//decode one JPEG from memory on 1, 2, 4, 8 and 16 threads through TextureLoader::parallelFor.
+//Restart intervals only decode in parallel if the file has them, `jpegtran -restart 1` adds
+//one per MCU row; without them only the IDCT and the upsample/colour pass are split
+int runJpegLatencyBenchmark(const char* path) {
+	MappedFile file;
+	int width, height, channels;
+	//stbi_info accepts every format stb reads, so look for the JPEG start of image marker first
+	bool jpeg = file.open(path) && file.size() >= 2 && file.data()[0] == 0xFF && file.data()[1] == 0xD8;
+	if (!jpeg || !stbi_info_from_memory(file.data(), (int)file.size(), &width, &height, &channels)) {
+		std::cout << "not a JPEG file: " << path << std::endl;
+		return -1;
+	}
+	//walk the marker segments up to the first scan looking for a restart interval (DRI)
+	const unsigned char* data = file.data();
+	bool restarts = false, progressive = false;
+	for (size_t at = 2; at + 4 <= file.size() && data[at] == 0xFF && data[at + 1] != 0xDA; at += 2 + (data[at + 2] << 8 | data[at + 3])) {
+		if (data[at + 1] == 0xDD)
+			restarts = at + 6 <= file.size() && (data[at + 4] << 8 | data[at + 5]) != 0;
+		if (data[at + 1] == 0xC2)
+			progressive = true;
+	}
+	std::cout << path << ": " << width << "x" << height << ", " << (progressive ? "progressive" : "baseline") << ", "
+		<< (restarts ? "restart markers" : "no restart markers") << ", " << std::thread::hardware_concurrency() << " cores" << std::endl;
+
+	//serial decodes for half a second first, or the 1 thread run also pays for the page faults
+	//of the first touches and the clock ramping up
+	auto warmup = std::chrono::steady_clock::now();
+	while (std::chrono::duration<double>(std::chrono::steady_clock::now() - warmup).count() < 0.5)
+		stbi_image_free(stbi_load_from_memory(data, (int)file.size(), &width, &height, &channels, 0));
+	double singleMs = 0.0;
+	for (unsigned int threads : { 1u, 2u, 4u, 8u, 16u }) {
+		stbi_jpeg_set_parallel(threads > 1 ? TextureLoader::parallelFor : NULL, &threads, (int)threads);
+		//at least five decodes and half a second, the median is the latency
+		std::vector<double> times;
+		double seconds = 0.0;
+		while (times.size() < 5 || seconds < 0.5) {
+			auto start = std::chrono::steady_clock::now();
+			stbi_image_free(stbi_load_from_memory(data, (int)file.size(), &width, &height, &channels, 0));
+			times.push_back(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+			seconds += times.back() / 1000.0;
+		}
+		std::sort(times.begin(), times.end());
+		double ms = times[times.size() / 2];
+		if (threads == 1)
+			singleMs = ms;
+		std::cout << threads << " threads: " << ms << " ms median over " << times.size() << " decodes, "
+			<< (double)width * height / (ms * 1000.0) << " MP/s, " << singleMs / ms << "x" << std::endl;
+	}
+	stbi_jpeg_set_parallel(NULL, NULL, 0);
+	return 0;
+}
+
+//inflate the concatenated IDAT chunks of every PNG under a directory with stb_image's original
+//zlib decoder and the fast one, checking both give the same bytes, then time whole PNG loads
+//both ways so the share of unfiltering shows. Output MB/s is what matters, compressed input
+//MB/s drops with the compression level for the same image
+int runInflateBenchmark(const char* directory) {
+	struct PngFile {
+		std::string path;
+		MappedFile file;
+		std::vector<char> idat;
+		int rawSize = 0;
+	};
+	std::vector<PngFile> files;
+	std::error_code error;
+	for (const auto& entry : std::filesystem::recursive_directory_iterator(directory, error)) {
+		if (entry.path().extension().string() != ".png")
+			continue;
+		PngFile png;
+		png.path = entry.path().generic_string();
+		if (!png.file.open(png.path) || png.file.size() < 8)
+			continue;
+		//chunks are a 4 byte big endian length, a 4 byte type, the data and a 4 byte CRC
+		const unsigned char* data = png.file.data();
+		for (size_t at = 8; at + 8 <= png.file.size();) {
+			size_t length = (size_t)data[at] << 24 | data[at + 1] << 16 | data[at + 2] << 8 | data[at + 3];
+			if (length > png.file.size() - at - 8)
+				break;
+			if (memcmp(data + at + 4, "IDAT", 4) == 0)
+				png.idat.insert(png.idat.end(), data + at + 8, data + at + 8 + length);
+			at += 12 + length;
+		}
+		char* raw = stbi_zlib_decode_malloc(png.idat.data(), (int)png.idat.size(), &png.rawSize);
+		if (!raw)
+			continue;
+		free(raw);
+		files.push_back(std::move(png));
+	}
+	if (files.empty()) {
+		std::cout << "no PNG files under " << directory << std::endl;
+		return -1;
+	}
+	std::sort(files.begin(), files.end(), [](const PngFile& a, const PngFile& b) { return a.path < b.path; });
+
+	//repeat for at least a fifth of a second, seconds per call
+	auto timeCalls = [](const auto& call) {
+		int calls = 0;
+		double seconds = 0.0;
+		auto start = std::chrono::steady_clock::now();
+		while (seconds < 0.2) {
+			call();
+			calls++;
+			seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+		}
+		return seconds / calls;
+	};
+	double inflateSeconds[2] = {}, loadSeconds[2] = {};
+	size_t rawBytes = 0;
+	for (const PngFile& png : files) {
+		double inflate[2], load[2];
+		std::vector<char> outputs[2];
+		for (int fast = 0; fast < 2; fast++) {
+			stbi_zlib_set_fast_inflate(fast);
+			outputs[fast].resize(png.rawSize);
+			inflate[fast] = timeCalls([&]() {
+				stbi_zlib_decode_buffer(outputs[fast].data(), png.rawSize, png.idat.data(), (int)png.idat.size());
+			});
+			load[fast] = timeCalls([&]() {
+				int width, height, channels;
+				stbi_image_free(stbi_load_from_memory(png.file.data(), (int)png.file.size(), &width, &height, &channels, 0));
+			});
+			inflateSeconds[fast] += inflate[fast];
+			loadSeconds[fast] += load[fast];
+		}
+		rawBytes += png.rawSize;
+		std::cout << png.path << ": " << png.idat.size() / 1024 << " KB -> " << png.rawSize / 1024 << " KB, inflate "
+			<< png.rawSize / inflate[0] / 1e6 << " -> " << png.rawSize / inflate[1] / 1e6 << " MB/s (" << inflate[0] / inflate[1]
+			<< "x), load " << load[0] * 1000.0 << " -> " << load[1] * 1000.0 << " ms" << (outputs[0] == outputs[1] ? "" : ", OUTPUT DIFFERS") << std::endl;
+	}
+	stbi_zlib_set_fast_inflate(1);
+	std::cout << files.size() << " files: inflate " << rawBytes / inflateSeconds[0] / 1e6 << " -> " << rawBytes / inflateSeconds[1] / 1e6
+		<< " MB/s (" << inflateSeconds[0] / inflateSeconds[1] << "x), load " << loadSeconds[0] * 1000.0 << " -> " << loadSeconds[1] * 1000.0
+		<< " ms (" << loadSeconds[0] / loadSeconds[1] << "x)" << std::endl;
+	return 0;
+}
+
+//unfilter N x N RGB and RGBA images whose rows all use one PNG filter with each stb_image
+//kernel set, after checking every set gives the scalar code's pixels on random small images
+//of every colour type and bit depth. The images are built in memory from stored deflate
+//blocks so inflating is a copy, and the load time of a filter none image is taken off to
+//leave the unfiltering alone
+int runUnfilterBenchmark(int size) {
+	unsigned int seed = 1;
+	auto random = [&seed]() {
+		seed = seed * 1664525u + 1013904223u;
+		return seed >> 8;
+	};
+	//rows are a filter type byte followed by the filtered bytes of the row
+	auto buildPng = [](int width, int height, int colorType, int depth, const std::vector<unsigned char>& rows) {
+		std::vector<unsigned char> png = { 137, 80, 78, 71, 13, 10, 26, 10 };
+		auto put32 = [&png](uint32_t value) {
+			for (int shift = 24; shift >= 0; shift -= 8)
+				png.push_back((unsigned char)(value >> shift));
+		};
+		//a big endian length, the type, the data and a CRC, which stb_image does not check
+		auto chunk = [&](const char* type, const std::vector<unsigned char>& data) {
+			put32((uint32_t)data.size());
+			png.insert(png.end(), type, type + 4);
+			png.insert(png.end(), data.begin(), data.end());
+			put32(0);
+		};
+		std::vector<unsigned char> header(13, 0);
+		for (int i = 0; i < 4; i++) {
+			header[i] = (unsigned char)(width >> (24 - 8 * i));
+			header[4 + i] = (unsigned char)(height >> (24 - 8 * i));
+		}
+		header[8] = (unsigned char)depth;
+		header[9] = (unsigned char)colorType;
+		chunk("IHDR", header);
+		//zlib header, stored blocks of up to 65535 bytes, then the adler32 of the rows
+		std::vector<unsigned char> zlib = { 0x78, 0x01 };
+		for (size_t at = 0; at < rows.size();) {
+			size_t length = std::min(rows.size() - at, (size_t)65535);
+			zlib.push_back(at + length == rows.size() ? 1 : 0);
+			zlib.insert(zlib.end(), { (unsigned char)length, (unsigned char)(length >> 8), (unsigned char)~length, (unsigned char)(~length >> 8) });
+			zlib.insert(zlib.end(), rows.begin() + at, rows.begin() + at + length);
+			at += length;
+		}
+		uint32_t s1 = 1, s2 = 0;
+		for (unsigned char byte : rows) {
+			s1 = (s1 + byte) % 65521;
+			s2 = (s2 + s1) % 65521;
+		}
+		for (int shift = 24; shift >= 0; shift -= 8)
+			zlib.push_back((unsigned char)((s2 << 16 | s1) >> shift));
+		chunk("IDAT", zlib);
+		chunk("IEND", {});
+		return png;
+	};
+	stbi_png_set_kernels(STBI_PNG_KERNELS_AVX2);
+	int maxLevel = stbi_png_kernels();
+	const char* levelNames[] = { "scalar", "sse2", "ssse3", "avx2" };
+	std::cout << "kernels up to " << levelNames[maxLevel] << std::endl;
+
+	//colour type and bit depth; the 16 bit loader returns every depth exactly
+	static const int formats[][2] = { { 0, 1 }, { 0, 2 }, { 0, 4 }, { 0, 8 }, { 0, 16 }, { 2, 8 }, { 2, 16 }, { 4, 8 }, { 4, 16 }, { 6, 8 }, { 6, 16 } };
+	int tests = 0, failures = 0;
+	for (int test = 0; test < 2000; test++) {
+		const int* format = formats[test % 11];
+		int channels = format[0] == 2 ? 3 : format[0] == 4 ? 2 : format[0] == 6 ? 4 : 1;
+		int width = 1 + random() % 80, height = 1 + random() % 6;
+		size_t rowBytes = ((size_t)width * channels * format[1] + 7) / 8;
+		std::vector<unsigned char> rows;
+		for (int y = 0; y < height; y++) {
+			rows.push_back((unsigned char)(random() % 5));
+			for (size_t i = 0; i < rowBytes; i++)
+				rows.push_back((unsigned char)random());
+		}
+		std::vector<unsigned char> png = buildPng(width, height, format[0], format[1], rows);
+		std::vector<stbi_us> expected;
+		for (int level = STBI_PNG_KERNELS_SCALAR; level <= maxLevel; level++) {
+			stbi_png_set_kernels(level);
+			int w, h, n;
+			stbi_us* pixels = stbi_load_16_from_memory(png.data(), (int)png.size(), &w, &h, &n, 0);
+			std::vector<stbi_us> decoded;
+			if (pixels)
+				decoded.assign(pixels, pixels + (size_t)w * h * n);
+			stbi_image_free(pixels);
+			tests++;
+			if (level == STBI_PNG_KERNELS_SCALAR)
+				expected = decoded;
+			else if (!pixels || decoded != expected) {
+				if (failures++ < 10)
+					std::cout << levelNames[level] << " differs from scalar on " << width << "x" << height << ", colour type "
+						<< format[0] << ", " << format[1] << " bit" << std::endl;
+			}
+		}
+	}
+	std::cout << tests << " random images decoded, " << failures << " differ from scalar" << std::endl;
+
+	//repeat for at least a fifth of a second, the fastest call; the filter none time is taken
+	//off every other one, which leaves too little for a mean to be steady
+	auto timeCalls = [](const auto& call) {
+		double seconds = 0.0, fastest = 1e9;
+		while (seconds < 0.2) {
+			auto start = std::chrono::steady_clock::now();
+			call();
+			double once = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+			fastest = std::min(fastest, once);
+			seconds += once;
+		}
+		return fastest;
+	};
+	const char* filterNames[] = { "none", "sub", "up", "avg", "paeth" };
+	for (int channels : { 3, 4 }) {
+		size_t rowBytes = (size_t)size * channels;
+		double seconds[5][4] = {};
+		for (int filter = 0; filter < 5; filter++) {
+			std::vector<unsigned char> rows;
+			rows.reserve((rowBytes + 1) * size);
+			for (int y = 0; y < size; y++) {
+				rows.push_back((unsigned char)filter);
+				for (size_t i = 0; i < rowBytes; i++)
+					rows.push_back((unsigned char)random());
+			}
+			std::vector<unsigned char> png = buildPng(size, size, channels == 3 ? 2 : 6, 8, rows);
+			for (int level = STBI_PNG_KERNELS_SCALAR; level <= maxLevel; level++) {
+				stbi_png_set_kernels(level);
+				seconds[filter][level] = timeCalls([&]() {
+					int w, h, n;
+					stbi_image_free(stbi_load_from_memory(png.data(), (int)png.size(), &w, &h, &n, 0));
+				});
+			}
+		}
+		//kernels that leave well under a millisecond are lost in the load's noise, so whole
+		//load times with what unfiltering adds to them rather than ratios of the differences
+		std::cout << (channels == 3 ? "RGB" : "RGBA") << " load with filter none: " << seconds[0][0] * 1000.0 << " ms" << std::endl;
+		for (int filter = 1; filter < 5; filter++) {
+			std::cout << (channels == 3 ? "RGB " : "RGBA ") << filterNames[filter] << ":";
+			for (int level = STBI_PNG_KERNELS_SCALAR; level <= maxLevel; level++) {
+				double unfilter = std::max(seconds[filter][level] - seconds[0][level], 0.0);
+				std::cout << (level > STBI_PNG_KERNELS_SCALAR ? ", " : " ") << levelNames[level] << " " << seconds[filter][level] * 1000.0
+					<< " ms (+" << unfilter * 1000.0 << " ms, " << rowBytes * size / std::max(unfilter, 1e-6) / 1e6 << " MB/s)";
+			}
+			std::cout << std::endl;
+		}
+	}
+	stbi_png_set_kernels(STBI_PNG_KERNELS_AVX2);
+	return failures == 0 ? 0 : -1;
+}
+
+//decode one image with stbi_load and with stbi_load_rows in bands of 16 and 256 rows, reporting
+//the time, decoded MB/s and peak resident memory of each. Every run is a forked child, so its
+//peak is the child's own getrusage ru_maxrss (KB on Linux, bytes on macOS), shown over that of
+//a child which decodes nothing. The timed calls drop the rows; each child then hashes what it
+//decoded so both paths are checked to give the same pixels
+int runStreamBenchmark(const char* path) {
+	int width, height, channels;
+	if (!stbi_info(path, &width, &height, &channels)) {
+		std::cout << "not an image: " << path << std::endl;
+		return -1;
+	}
+	//FNV-1a over the rows in order, the bands of stbi_load_rows arrive top to bottom
+	struct Hash {
+		uint64_t value = 1469598103934665603ull;
+		size_t rowBytes = 0;
+		void add(const unsigned char* bytes, size_t size) {
+			for (size_t i = 0; i < size; i++)
+				value = (value ^ bytes[i]) * 1099511628211ull;
+		}
+	};
+	auto hashRows = [](void* user, void* rows, int, int count) {
+		Hash* hash = (Hash*)user;
+		hash->add((const unsigned char*)rows, hash->rowBytes * count);
+		return 1;
+	};
+	auto dropRows = [](void*, void*, int, int) {
+		return 1;
+	};
+	struct Run {
+		bool ok = false;
+		double ms = 0.0;
+		long peakKB = 0;
+		uint64_t hash = 0;
+	};
+	//run decode in a child, which sends its result and peak back through a pipe
+	auto measure = [](auto decode) {
+		Run run;
+		int fds[2];
+		if (pipe(fds) != 0)
+			return run;
+		pid_t child = fork();
+		if (child == 0) {
+			close(fds[0]);
+			run = decode();
+			rusage usage;
+			getrusage(RUSAGE_SELF, &usage);
+#ifdef __APPLE__
+			run.peakKB = (long)(usage.ru_maxrss / 1024);
+#else
+			run.peakKB = (long)usage.ru_maxrss;
+#endif
+			_exit(write(fds[1], &run, sizeof(run)) == (ssize_t)sizeof(run) ? 0 : 1);
+		}
+		close(fds[1]);
+		if (child < 0 || read(fds[0], &run, sizeof(run)) != (ssize_t)sizeof(run))
+			run = Run();
+		close(fds[0]);
+		if (child > 0)
+			waitpid(child, NULL, 0);
+		return run;
+	};
+	double megabytes = (double)width * height * channels / 1e6;
+	std::cout << path << ": " << width << " x " << height << ", " << channels << " channels, " << megabytes << " MB decoded" << std::endl;
+	//read once so the file is in the page cache for every run
+	if (FILE* f = fopen(path, "rb")) {
+		std::vector<char> buffer(1 << 16);
+		while (fread(buffer.data(), 1, buffer.size(), f) == buffer.size())
+			;
+		fclose(f);
+	}
+	Run idle = measure([]() {
+		Run run;
+		run.ok = true;
+		return run;
+	});
+	auto report = [&](const std::string& name, const Run& run) {
+		std::cout << name << ": ";
+		if (!run.ok) {
+			std::cout << "failed" << std::endl;
+			return;
+		}
+		std::cout << run.ms << " ms, " << megabytes / (run.ms / 1000.0) << " MB/s, peak RSS ";
+		if (run.peakKB > 0 && idle.peakKB > 0)
+			std::cout << run.peakKB / 1024.0 << " MB (" << (run.peakKB - idle.peakKB) / 1024.0 << " MB over idle)" << std::endl;
+		else
+			std::cout << "unavailable" << std::endl;
+	};
+
+	Run whole = measure([&]() {
+		Run run;
+		int w, h, n;
+		auto start = std::chrono::steady_clock::now();
+		unsigned char* pixels = stbi_load(path, &w, &h, &n, 0);
+		run.ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+		run.ok = pixels != NULL;
+		if (pixels) {
+			Hash hash;
+			hash.add(pixels, (size_t)w * h * n);
+			run.hash = hash.value;
+		}
+		stbi_image_free(pixels);
+		return run;
+	});
+	report("stbi_load", whole);
+	if (!whole.ok) {
+		std::cout << "failed to decode " << path << std::endl;
+		return -1;
+	}
+
+	bool match = true;
+	for (int rows : { 16, 256 }) {
+		Run streamed = measure([&]() {
+			Run run;
+			int w = 0, h = 0, n = 0;
+			auto start = std::chrono::steady_clock::now();
+			run.ok = stbi_load_rows(path, &w, &h, &n, 0, rows, dropRows, NULL) != 0;
+			run.ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+			Hash hash;
+			if (run.ok) {
+				hash.rowBytes = (size_t)w * n;
+				run.ok = stbi_load_rows(path, &w, &h, &n, 0, rows, hashRows, &hash) != 0;
+			}
+			run.hash = hash.value;
+			return run;
+		});
+		report("stbi_load_rows, " + std::to_string(rows) + " rows a band", streamed);
+		match = match && streamed.ok && streamed.hash == whole.hash;
+	}
+	std::cout << (match ? "streamed pixels match stbi_load" : "STREAMED PIXELS DIFFER FROM stbi_load") << std::endl;
+	return match ? 0 : -1;
+}
+
+//draw one triangle with each of 1, 2, 4 ... N programs per frame, setting camera and light either
+//as plain uniforms on every program or once per frame through the FrameData uniform buffer
+int runUniformBenchmark(int maxPrograms) {
+	const char* vertexHeader =
+		"#version 330 core\n"
+		"layout (location = 0) in vec3 aPos;\n"
+		"uniform mat4 model;\n"
+		"out vec3 FragPos;\n";
+	const char* vertexBody =
+		"void main()\n"
+		"{\n"
+		"    FragPos = vec3(model * vec4(aPos, 1.0));\n"
+		"    gl_Position = projection * view * vec4(FragPos, 1.0);\n"
+		"}\n";
+	const char* fragmentHeader =
+		"#version 330 core\n"
+		"out vec4 FragColor;\n"
+		"in vec3 FragPos;\n"
+		"uniform vec3 objectColor;\n";
+	const char* fragmentBody =
+		"void main()\n"
+		"{\n"
+		"    float light = max(dot(normalize(lightPos.xyz - FragPos), normalize(viewPos.xyz - FragPos)), 0.1);\n"
+		"    FragColor = vec4(light * lightColor.rgb * objectColor, 1.0);\n"
+		"}\n";
+	//the same block as the scene shaders, vs the uniforms it replaced
+	const char* uniformBlock =
+		"layout (std140) uniform FrameData\n"
+		"{\n"
+		"    mat4 view;\n"
+		"    mat4 projection;\n"
+		"    mat4 viewProjection;\n"
+		"    vec4 viewPos;\n"
+		"    vec4 lightPos;\n"
+		"    vec4 lightColor;\n"
+		"};\n";
+	const char* plainVertex = "uniform mat4 view;\nuniform mat4 projection;\n";
+	const char* plainFragment = "uniform vec4 viewPos;\nuniform vec4 lightPos;\nuniform vec4 lightColor;\n";
+
+	//a define per program keeps the driver from sharing one compiled program between them
+	auto build = [&](const char* vertexUniforms, const char* fragmentUniforms) {
+		ShaderBatch batch;
+		for (int i = 0; i < maxPrograms; i++) {
+			std::string define = "#define PERMUTATION " + std::to_string(i) + "\n";
+			batch.addSource(std::string(vertexHeader) + define + vertexUniforms + vertexBody,
+				std::string(fragmentHeader) + define + fragmentUniforms + fragmentBody);
+		}
+		return batch.finish();
+	};
+	std::vector<Shader> plainPrograms = build(plainVertex, plainFragment);
+	std::vector<Shader> blockPrograms = build(uniformBlock, uniformBlock);
+	for (const Shader& program : blockPrograms)
+		FrameUniforms::attach(program.ID);
+
+	float triangle[] = { -0.5f, -0.5f, 0.0f, 0.5f, -0.5f, 0.0f, 0.0f, 0.5f, 0.0f };
+	GLuint vao, vbo;
+	glGenVertexArrays(1, &vao);
+	glGenBuffers(1, &vbo);
+	glBindVertexArray(vao);
+	glBindBuffer(GL_ARRAY_BUFFER, vbo);
+	glBufferData(GL_ARRAY_BUFFER, sizeof(triangle), triangle, GL_STATIC_DRAW);
+	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void*)0);
 	glEnableVertexAttribArray(0);
-	glEnableVertexAttribArray(1);
-	glEnableVertexAttribArray(2);
+	FrameUniforms frameUniforms;
+	frameUniforms.create();
+
+	glm::mat4 projection = glm::perspective(glm::radians(45.0f), (float)SCR_WIDTH / (float)SCR_HEIGHT, 0.1f, 100.0f);
+	const int frames = 200;
+	auto run = [&](std::vector<Shader>& programs, int count, bool shared) {
+		size_t bytes = 0;
+		double seconds = 0.0;
+		for (int frame = 0; frame < frames; frame++) {
+			float angle = frame * 0.01f;
+			glm::vec3 eye(sin(angle) * 10.0f, 0.0f, cos(angle) * 10.0f);
+			FrameData data;
+			data.view = glm::lookAt(eye, glm::vec3(0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+			data.projection = projection;
+			data.viewProjection = projection * data.view;
+			data.viewPos = glm::vec4(eye, 1.0f);
+			data.lightPos = glm::vec4(lightPos, 1.0f);
+			data.lightColor = glm::vec4(1.0f);
+			auto start = std::chrono::steady_clock::now();
+			if (shared) {
+				frameUniforms.update(data);
+				bytes += sizeof(FrameData);
+			}
+			for (int i = 0; i < count; i++) {
+				Shader& program = programs[i];
+				program.use();
+				if (!shared) {
+					program.setMat4("view", data.view);
+					program.setMat4("projection", data.projection);
+					program.setVec4("viewPos", data.viewPos);
+					program.setVec4("lightPos", data.lightPos);
+					program.setVec4("lightColor", data.lightColor);
+					bytes += 2 * sizeof(glm::mat4) + 3 * sizeof(glm::vec4);
+				}
+				//per-draw uniforms, the same in both modes
+				program.setMat4("model", glm::mat4(1.0f));
+				program.setVec3("objectColor", 1.0f, 0.5f, 0.31f);
+				bytes += sizeof(glm::mat4) + sizeof(glm::vec3);
+				glDrawArrays(GL_TRIANGLES, 0, 3);
+			}
+			seconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+			//keep the queue short so every frame is timed under the same conditions
+			glFinish();
+		}
+		std::cout << (shared ? "  uniform buffer: " : "  plain uniforms: ") << bytes / frames << " bytes, "
+			<< seconds * 1000.0 / frames << " ms CPU per frame" << std::endl;
+	};
+	for (int count = 1; ; count *= 2) {
+		count = std::min(count, maxPrograms);
+		std::cout << count << (count == 1 ? " program" : " programs") << std::endl;
+		run(plainPrograms, count, false);
+		run(blockPrograms, count, true);
+		if (count == maxPrograms)
+			break;
+	}
+
+	frameUniforms.release();
+	glDeleteVertexArrays(1, &vao);
+	glDeleteBuffers(1, &vbo);
+	for (const Shader& program : plainPrograms)
+		glDeleteProgram(program.ID);
+	for (const Shader& program : blockPrograms)
+		glDeleteProgram(program.ID);
+	return 0;
+}
+
+//order 10k, 100k ... N random instances back to front for a moving camera, with std::sort on the
+//view depth (what the sorted transparency mode used before) and with the radix sorted queue
+int runSortBenchmark(size_t maxInstances) {
+	std::vector<glm::vec3> positions(maxInstances);
+	unsigned int seed = 1;
+	for (glm::vec3& p : positions)
+		for (int c = 0; c < 3; c++) {
+			seed = seed * 1664525u + 1013904223u;
+			p[c] = (float)(seed >> 8) / (float)(1 << 24) * 100.0f - 50.0f;
+		}
+	int threads = (int)std::max(1u, std::thread::hardware_concurrency());
+	const int repeats = 10;
+
+	for (size_t count = std::min<size_t>(10000, maxInstances); ; count = std::min(count * 10, maxInstances)) {
+		std::cout << count << " instances" << std::endl;
+		std::vector<float> depth(count);
+		std::vector<uint32_t> order(count);
+		auto view = [](int repeat) {
+			float angle = repeat * 0.3f;
+			return glm::lookAt(glm::vec3(sin(angle) * 60.0f, 5.0f, cos(angle) * 60.0f), glm::vec3(0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+		};
+
+		double seconds = 0.0;
+		for (int r = 0; r < repeats; r++) {
+			glm::mat4 v = view(r);
+			auto start = std::chrono::steady_clock::now();
+			for (size_t i = 0; i < count; i++) {
+				depth[i] = viewDepth(v, positions[i]);
+				order[i] = (uint32_t)i;
+			}
+			std::sort(order.begin(), order.end(), [&depth](uint32_t a, uint32_t b) { return depth[a] < depth[b]; });
+			seconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+		}
+		std::cout << "  std::sort: " << seconds * 1000.0 / repeats << " ms" << std::endl;
+
+		TransparentQueue queue;
+		for (int t : { 1, threads }) {
+			seconds = 0.0;
+			bool ordered = true;
+			for (int r = 0; r < repeats; r++) {
+				glm::mat4 v = view(r);
+				auto start = std::chrono::steady_clock::now();
+				queue.clear();
+				for (size_t i = 0; i < count; i++)
+					queue.push((uint32_t)i, viewDepth(v, positions[i]));
+				const std::vector<uint32_t>& sorted = queue.sort(t);
+				seconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+				for (size_t i = 1; i < count && ordered; i++)
+					ordered = viewDepth(v, positions[sorted[i - 1]]) <= viewDepth(v, positions[sorted[i]]);
+			}
+			std::cout << "  radix, " << t << (t == 1 ? " thread: " : " threads: ") << seconds * 1000.0 / repeats << " ms"
+				<< (ordered ? "" : " (NOT ORDERED)") << std::endl;
+			if (threads == 1)
+				break;
+		}
+		if (count == maxInstances)
+			break;
+	}
+	return 0;
 }
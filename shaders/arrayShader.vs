@@ -0,0 +1,35 @@
+#version 330 core
+layout (location = 0) in vec3 aPos;
+layout (location = 1) in vec3 aNormal;
+layout (location = 2) in vec2 aTexCoords;
+// per-instance translation in xyz, texture array entry in w
+layout (location = 3) in vec4 aOffset;
+
+out vec3 TexCoords;
+
+out vec3 FragPos;
+out vec3 Normal;
+
+// per-frame camera and light data, shared by every program
+layout (std140) uniform FrameData
+{
+    mat4 view;
+    mat4 projection;
+    mat4 viewProjection;
+    vec4 viewPos;
+    vec4 lightPos;
+    vec4 lightColor;
+};
+
+// TextureArrayBuilder entries: region of the layer in xy/zw, layer index
+uniform vec4 entryRects[64];
+uniform float entryLayers[64];
+
+void main()
+{
+    int entry = int(aOffset.w);
+    FragPos = aPos + aOffset.xyz;
+    Normal = aNormal;
+    TexCoords = vec3(entryRects[entry].xy + aTexCoords * entryRects[entry].zw, entryLayers[entry]);
+    gl_Position = viewProjection * vec4(FragPos, 1.0);
+}
\ No newline at end of file
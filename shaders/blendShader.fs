@@ -3,6 +3,16 @@ out vec4 FragColor;
 
 in vec2 TexCoords;
 
+layout (std140) uniform FrameData
+{
+    mat4 view;
+    mat4 projection;
+    mat4 viewProjection;
+    vec4 viewPos;
+    vec4 lightPos;
+    vec4 lightColor;
+};
+
 uniform sampler2D texture1;
 
 void main()
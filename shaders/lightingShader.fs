@@ -1,6 +1,16 @@
 #version 330 core
 out vec4 FragColor;
 
+layout (std140) uniform FrameData
+{
+    mat4 view;
+    mat4 projection;
+    mat4 viewProjection;
+    vec4 viewPos;
+    vec4 lightPos;
+    vec4 lightColor;
+};
+
 void main()
 {
 	FragColor = vec4(1.0);
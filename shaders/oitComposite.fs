@@ -0,0 +1,17 @@
+#version 330 core
+out vec4 FragColor;
+
+uniform sampler2D accumTexture;
+uniform sampler2D weightTexture;
+
+void main()
+{
+    ivec2 pixel = ivec2(gl_FragCoord.xy);
+    vec4 accum = texelFetch(accumTexture, pixel, 0);
+    float revealage = accum.a;
+    // nothing transparent covers this pixel
+    if (revealage >= 0.9999)
+        discard;
+    float weight = texelFetch(weightTexture, pixel, 0).r;
+    FragColor = vec4(accum.rgb / max(weight, 1e-5), revealage);
+}
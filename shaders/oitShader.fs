@@ -0,0 +1,17 @@
+#version 330 core
+// accumulation pass of weighted blended order independent transparency
+layout (location = 0) out vec4 accum;
+layout (location = 1) out float weight;
+
+in vec2 TexCoords;
+
+uniform sampler2D texture1;
+
+void main()
+{
+    vec4 color = texture(texture1, TexCoords);
+    // nearer and more opaque surfaces count for more (McGuire and Bavoil, equation 10)
+    float w = clamp(pow(min(1.0, color.a * 10.0) + 0.01, 3.0) * 1e8 * pow(1.0 - gl_FragCoord.z * 0.9, 3.0), 1e-2, 3e3);
+    accum = vec4(color.rgb * color.a * w, color.a);
+    weight = color.a * w;
+}